@@ -0,0 +1,169 @@
+/** @addtogroup 22 autofire Autofire
+ *
+ * @file autofire.c Autofire of held keys, toggled on the MSX reads of their column.
+ *
+ * @brief <b>Autofire of held keys, toggled on the MSX reads of their column.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+
+#include "autofire.h"
+#include "main_events.h"
+
+
+#define AUTOFIRE_FREE             0           //ps2_key of a free slot
+
+
+//Global vars
+struct autofire autofire_slots[AUTOFIRE_SLOTS];
+volatile uint8_t autofire_columns;
+volatile uint8_t autofire_reads[AUTOFIRE_COLUMNS];  //Reads of each column on autofire_columns, wrapping
+
+
+//Local prototypes
+void autofire_update_columns(void);
+
+
+uint8_t autofire_period(uint8_t control)
+{
+  uint8_t period = control >> AUTOFIRE_PERIOD_SHIFT;
+
+  return (period <= AUTOFIRE_MAX_PERIOD) ? period : 0;
+}
+
+
+void autofire_update_columns(void)
+{
+  uint8_t columns = 0;
+
+  for(uint8_t i = 0; i < AUTOFIRE_SLOTS; i++)
+    if(autofire_slots[i].ps2_key != AUTOFIRE_FREE)
+      columns |= (uint8_t)(1 << (autofire_slots[i].key >> 4));
+  autofire_columns = columns;
+}
+
+
+void autofire_clear(void)
+{
+  for(uint8_t i = 0; i < AUTOFIRE_SLOTS; i++)
+    autofire_slots[i].ps2_key = AUTOFIRE_FREE;
+  autofire_columns = 0;
+}
+
+
+bool autofire_start(uint16_t ps2_key, uint8_t key, uint8_t period)
+{
+  struct autofire *free_slot = NULL;
+  uint8_t y = key >> 4;
+
+  if( (ps2_key == AUTOFIRE_FREE) || (y >= AUTOFIRE_COLUMNS) || !period || (period > AUTOFIRE_MAX_PERIOD) )
+    return false;
+  for(uint8_t i = 0; i < AUTOFIRE_SLOTS; i++)
+  {
+    if(autofire_slots[i].ps2_key == ps2_key)
+      return true;
+    if( !free_slot && (autofire_slots[i].ps2_key == AUTOFIRE_FREE) )
+      free_slot = &autofire_slots[i];
+  }
+  if(!free_slot)
+    return false;
+  free_slot->key = key & (uint8_t)~AUTOFIRE_KEY_RELEASE;
+  free_slot->period = period;
+  free_slot->mark = autofire_reads[y];
+  free_slot->released = false;
+  free_slot->ps2_key = ps2_key;
+  autofire_update_columns();
+  return true;
+}
+
+
+bool autofire_held(uint16_t ps2_key)
+{
+  if(ps2_key == AUTOFIRE_FREE)
+    return false;
+  for(uint8_t i = 0; i < AUTOFIRE_SLOTS; i++)
+    if(autofire_slots[i].ps2_key == ps2_key)
+      return true;
+  return false;
+}
+
+
+uint8_t autofire_stop(uint16_t ps2_key)
+{
+  struct autofire *slot;
+
+  if(ps2_key == AUTOFIRE_FREE)
+    return AUTOFIRE_NONE;
+  for(uint8_t i = 0; i < AUTOFIRE_SLOTS; i++)
+  {
+    slot = &autofire_slots[i];
+    if(slot->ps2_key != ps2_key)
+      continue;
+    slot->ps2_key = AUTOFIRE_FREE;
+    autofire_update_columns();
+    return slot->released ? slot->key : AUTOFIRE_NONE;
+  }
+  return AUTOFIRE_NONE;
+}
+
+
+uint8_t autofire_next(void)
+{
+  struct autofire *slot;
+  uint8_t reads;
+
+  for(uint8_t i = 0; i < AUTOFIRE_SLOTS; i++)
+  {
+    slot = &autofire_slots[i];
+    if(slot->ps2_key == AUTOFIRE_FREE)
+      continue;
+    reads = autofire_reads[slot->key >> 4];
+    if((uint8_t)(reads - slot->mark) < slot->period)
+      continue;
+    slot->mark = reads;
+    slot->released = !slot->released;
+    return slot->released ? (slot->key | AUTOFIRE_KEY_RELEASE) : slot->key;
+  }
+  return AUTOFIRE_NONE;
+}
+
+
+void autofire_y_served(uint8_t y)
+{
+  if( (y >= AUTOFIRE_COLUMNS) || !(autofire_columns & (1 << y)) )
+    return;
+  autofire_reads[y]++;
+  main_event_set(EVT_AUTOFIRE);
+}
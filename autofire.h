@@ -0,0 +1,156 @@
+/** @defgroup 22 autofire Autofire
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file autofire.h Autofire of held keys, toggled on the MSX reads of their column.
+ *
+ * @brief <b>Autofire of held keys, toggled on the MSX reads of their column. Header file of autofire.c.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * A Database line of case type 0 with a period n (1 to AUTOFIRE_MAX_PERIOD) on the high nibble of
+ * its control byte is an autofire key: while it is held, its first MSX key (of Y0 to Y7) is pressed
+ * during n MSX reads of its column, then released during the next n, and so on. The legacy
+ * Databases keep that nibble at 0xF (0 is taken as no autofire as well). On host/db-compiler
+ * layouts and on console "remap", the control byte is written with "a" and the period, as "0a2".
+ *
+ * A timer toggle would beat with the 60Hz scan of the BIOS, so that some pulses are never read.
+ * Here the Y scan ISR's only count the reads of the columns on autofire_columns, and the main loop
+ * toggles the key right after the n-th read: MSX sees each press and each release n times (one
+ * read per frame, as the BIOS does), the highest rate it can follow with no lost edge. A read that
+ * comes before the main loop toggles the key is counted on the phase it saw, so a phase is never
+ * shorter than n reads. If MSX stops scanning, the key stays as it is.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined AUTOFIRE_H
+#define AUTOFIRE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "system.h"
+
+
+/** Autofire sizes and coding
+@{*/
+#define AUTOFIRE_SLOTS            4           //Autofire keys held at once
+#define AUTOFIRE_PERIOD_SHIFT     4           //The period is the high nibble of the control byte
+#define AUTOFIRE_MAX_PERIOD       14          //0xF is the legacy value of the nibble: no autofire
+#define AUTOFIRE_COLUMNS          8           //Y0 to Y7
+#define AUTOFIRE_KEY_RELEASE      0x08
+#define AUTOFIRE_NONE             0xFF        //autofire_next() and autofire_stop(): no MSX key
+/**@}*/
+
+/**
+ * A held autofire key.
+ */
+struct autofire
+{
+  uint16_t ps2_key;                           //As msx_pairing_key(), or AUTOFIRE_FREE
+  uint8_t  key;                               //MSX key: Y << 4 | X
+  uint8_t  period;
+  uint8_t  mark;                              //autofire_reads[] of its column at the last toggle
+  bool     released;
+};
+
+/**
+ * @brief Columns of the held autofire keys, whose reads are counted on autofire_reads[].
+ */
+extern volatile uint8_t autofire_columns;
+
+/**
+ * @brief Period of a Database line.
+ *
+ * @param control The control byte of the line.
+ * @return 1 to AUTOFIRE_MAX_PERIOD, or 0 if it is not an autofire key.
+ */
+uint8_t autofire_period(uint8_t control);
+
+/**
+ * @brief Forgets the autofire keys, when all MSX keys are released.
+ */
+void autofire_clear(void);
+
+/**
+ * @brief Starts the autofire of a PS/2 key, whose make is about to press its MSX key. A key already on autofire
+ * is left as it is.
+ *
+ * @param ps2_key PS/2 key, as msx_pairing_key().
+ * @param key MSX key coded as the Database: Y (0 to 7) on bits 7-4, X on bits 2-0.
+ * @param period 1 to AUTOFIRE_MAX_PERIOD reads of its column.
+ * @return false if there is no free slot.
+ */
+bool autofire_start(uint16_t ps2_key, uint8_t key, uint8_t period);
+
+/**
+ * @brief Tells if a PS/2 key is on autofire.
+ *
+ * @param ps2_key PS/2 key, as msx_pairing_key().
+ * @return true between its make and its break.
+ */
+bool autofire_held(uint16_t ps2_key);
+
+/**
+ * @brief Stops the autofire of a PS/2 key, on its break.
+ *
+ * @param ps2_key PS/2 key, as msx_pairing_key().
+ * @return The MSX key, if the autofire left it released (its break expects it pressed), or AUTOFIRE_NONE.
+ */
+uint8_t autofire_stop(uint16_t ps2_key);
+
+/**
+ * @brief Next autofire toggle due, once MSX read its column the period times. To be called from main loop, on
+ * EVT_AUTOFIRE, until it returns AUTOFIRE_NONE.
+ *
+ * @return The MSX key, with AUTOFIRE_KEY_RELEASE for a release, or AUTOFIRE_NONE.
+ */
+uint8_t autofire_next(void);
+
+/**
+ * @brief Counts a read of a column on autofire_columns, and wakes up the main loop. Called from the Y scan ISR's.
+ *
+ * @param y Column read (16 is all columns).
+ */
+void autofire_y_served(uint8_t y);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined AUTOFIRE_H
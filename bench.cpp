@@ -0,0 +1,502 @@
+/** @addtogroup 17 bench Hot Path Microbenchmarks
+ *
+ * @file bench.cpp Microbenchmarks of the key path and console hot functions.
+ *
+ * @brief <b>Microbenchmarks of the key path and console hot functions.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * The key kernels alternate press and release of BENCH_PS2_KEY on the live matrix, and the
+ * key path state they touch (x_bits, NKRO pressed set, pairings, autofire, latency tracer) is
+ * restored after each kernel. Interrupts stay enabled: the MSX keeps being served, so it sees
+ * the key toggling while the bench runs, and the min of each kernel is the batch that was not
+ * hit by any ISR.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <string.h>
+
+#include "bench.h"
+#include "msxmap.h"
+#include "console.h"
+#include "version.h"
+#if LATENCY_TRACE == true
+#include "latency.h"
+#endif  //#if LATENCY_TRACE == true
+
+
+#define DB_CASE0_KEY0             4           //As CASE0_KEY0 of msxmap.cpp
+#define PS2_BREAK_PREFIX          0xF0
+#define BENCH_RING_SIZE           64          //Must be a power of 2
+#define BENCH_MAX_CALLS           65536
+#define BENCH_X_PINS              (CTRL_PIN | SHIFT_PIN | RUSLAT_PIN) //Driven by compute_x_bits_and_check_interrupt_stuck()
+
+enum BENCH_KERNEL{
+  BENCH_OVERHEAD =                0,          //Empty kernel: clock and loop costs, included on all others
+  BENCH_CONVERT2MSX,
+  BENCH_MSX_DISPATCH,
+  BENCH_COMPUTE_X_BITS,
+  BENCH_Y_SCAN_ISR,
+  BENCH_MOUNT_SCANCODE,
+  BENCH_RING_PUT_CH,
+  BENCH_RING_GET_CH,
+  BENCH_CON_SEND_STRING,
+};
+
+const char *const bench_kernel_names[BENCH_NUM_KERNELS] =
+{
+  "overhead",
+  "convert2msx",
+  "msx_dispatch",
+  "compute_x_bits",
+  "y_scan_isr",
+  "mount_scancode",
+  "ring_put_ch",
+  "ring_get_ch",
+  "con_send_string",
+};
+
+//Firmware state touched by the kernels
+struct bench_state
+{
+  uint32_t x_bits[16 + 1];
+  uint8_t scancode[4];
+  uint16_t scanline;
+  bool shiftstate;
+#if CHORDS == true
+  struct chord_state chords;
+#else
+  uint8_t ctrl_alt_del;
+#endif  //#if CHORDS == true
+  uint32_t x_pins;
+  uint8_t ps2_recv_put_ptr, ps2_recv_get_ptr;
+  bool mount_scancode_OK, ps2_keystr_e0, ps2_keystr_e1, ps2_keystr_f0;
+  uint8_t mount_scancode_count_status;
+#if MSX_NKRO == true
+  uint8_t msx_pressed[MSX_NKRO_COLUMNS];
+  uint8_t msx_key_refs[MSX_NKRO_COLUMNS][8];
+  uint8_t msx_modifier_pressed[MSX_NKRO_COLUMNS];
+  uint16_t msx_nkro_last_make;
+  bool msx_nkro_repeat, msx_nkro_modifier_dependent;
+#endif  //#if MSX_NKRO == true
+#if MSX_PAIRING == true
+  struct msx_pairing msx_pairings[MSX_PAIRING_SLOTS];
+  struct msx_pairing *msx_pairing_recording;
+#endif  //#if MSX_PAIRING == true
+#if AUTOFIRE == true
+  struct autofire autofire_slots[AUTOFIRE_SLOTS];
+  uint8_t autofire_columns;
+  uint8_t autofire_reads[AUTOFIRE_COLUMNS];
+#endif  //#if AUTOFIRE == true
+#if LATENCY_TRACE == true
+  uint8_t latency_wait_y, latency_state;
+  struct latency_record latency_current;
+#endif  //#if LATENCY_TRACE == true
+};
+
+extern uint32_t x_bits[16 + 1];                   //Declared on msxmap.cpp
+extern volatile uint8_t scancode[4];              //Declared on msxmap.cpp
+extern volatile uint16_t scanline;                //Declared on msxmap.cpp
+extern volatile bool shiftstate;                  //Declared on msxmap.cpp
+#if CHORDS == true
+extern struct chord_state chord_state;            //Declared on chord.c
+#else
+extern uint8_t CtrlAltDel;                        //Declared on msxmap.cpp
+#endif  //#if CHORDS == true
+extern uint8_t* base_of_database;                 //Declared on msxmap.cpp
+extern volatile uint8_t ps2_recv_buffer[PS2_RECV_BUFFER_SIZE];  //Declared on ps2handl.c
+extern volatile uint8_t ps2_recv_put_ptr;         //Declared on ps2handl.c
+extern volatile uint8_t ps2_recv_get_ptr;         //Declared on ps2handl.c
+extern volatile bool mount_scancode_OK;           //Declared on ps2handl.c
+extern volatile bool ps2_keystr_e0, ps2_keystr_e1, ps2_keystr_f0; //Declared on ps2handl.c
+extern volatile uint8_t mount_scancode_count_status;  //Declared on ps2handl.c
+#if MSX_NKRO == true
+extern uint8_t msx_pressed[MSX_NKRO_COLUMNS];     //Declared on msxmap.cpp
+extern uint8_t msx_key_refs[MSX_NKRO_COLUMNS][8]; //Declared on msxmap.cpp
+extern uint8_t msx_modifier_pressed[MSX_NKRO_COLUMNS];  //Declared on msxmap.cpp
+extern uint16_t msx_nkro_last_make;               //Declared on msxmap.cpp
+extern bool msx_nkro_repeat;                      //Declared on msxmap.cpp
+extern bool msx_nkro_modifier_dependent;          //Declared on msxmap.cpp
+#endif  //#if MSX_NKRO == true
+#if MSX_PAIRING == true
+extern struct msx_pairing msx_pairings[MSX_PAIRING_SLOTS];  //Declared on msxmap.cpp
+extern struct msx_pairing *msx_pairing_recording; //Declared on msxmap.cpp
+#endif  //#if MSX_PAIRING == true
+#if AUTOFIRE == true
+extern struct autofire autofire_slots[AUTOFIRE_SLOTS];  //Declared on autofire.c
+extern volatile uint8_t autofire_reads[AUTOFIRE_COLUMNS]; //Declared on autofire.c
+#endif  //#if AUTOFIRE == true
+#if LATENCY_TRACE == true
+extern volatile uint8_t latency_state;            //Declared on latency.c
+extern volatile struct latency_record latency_current;  //Declared on latency.c
+#endif  //#if LATENCY_TRACE == true
+
+//Global vars
+struct bench_state bench_saved;
+uint32_t bench_iter;                              //Calls of the running kernel: even ones press, odd ones release
+                                                  //(position on bench_ps2_sequence for mount_scancode)
+uint16_t bench_scanline[2];                       //Database lines of BENCH_PS2_KEY make and break
+uint8_t bench_y, bench_x;                         //MSX key of BENCH_PS2_KEY
+const uint8_t bench_ps2_sequence[3] = { BENCH_PS2_KEY, PS2_BREAK_PREFIX, BENCH_PS2_KEY };
+struct sring bench_ring;
+uint8_t bench_ring_buffer[BENCH_RING_SIZE];
+
+
+//Local prototypes
+void bench_save(void);
+void bench_restore(void);
+void bench_set_scancode(bool release);
+void bench_send_hundredths(uint64_t value);
+void bench_overhead(void);
+void bench_convert2msx(void);
+void bench_msx_dispatch(void);
+void bench_compute_x_bits(void);
+void bench_y_scan_isr(void);
+void bench_mount_scancode(void);
+void bench_ring_put_ch(void);
+void bench_ring_get_ch(void);
+void bench_con_send_string(void);
+
+void (*const bench_kernels[BENCH_NUM_KERNELS])(void) =
+{
+  bench_overhead,
+  bench_convert2msx,
+  bench_msx_dispatch,
+  bench_compute_x_bits,
+  bench_y_scan_isr,
+  bench_mount_scancode,
+  bench_ring_put_ch,
+  bench_ring_get_ch,
+  bench_con_send_string,
+};
+
+
+void bench_save(void)
+{
+  for(uint8_t i = 0; i < 16 + 1; i++)
+    bench_saved.x_bits[i] = x_bits[i];
+  for(uint8_t i = 0; i < 4; i++)
+    bench_saved.scancode[i] = scancode[i];
+  bench_saved.scanline = scanline;
+  bench_saved.shiftstate = shiftstate;
+#if CHORDS == true
+  bench_saved.chords = chord_state;
+#else
+  bench_saved.ctrl_alt_del = CtrlAltDel;
+#endif  //#if CHORDS == true
+  bench_saved.x_pins = GPIO_ODR(CTRL_PORT) & BENCH_X_PINS;
+  bench_saved.ps2_recv_put_ptr = ps2_recv_put_ptr;
+  bench_saved.ps2_recv_get_ptr = ps2_recv_get_ptr;
+  bench_saved.mount_scancode_OK = mount_scancode_OK;
+  bench_saved.ps2_keystr_e0 = ps2_keystr_e0;
+  bench_saved.ps2_keystr_e1 = ps2_keystr_e1;
+  bench_saved.ps2_keystr_f0 = ps2_keystr_f0;
+  bench_saved.mount_scancode_count_status = mount_scancode_count_status;
+#if MSX_NKRO == true
+  memcpy(bench_saved.msx_pressed, msx_pressed, sizeof(msx_pressed));
+  memcpy(bench_saved.msx_key_refs, msx_key_refs, sizeof(msx_key_refs));
+  memcpy(bench_saved.msx_modifier_pressed, msx_modifier_pressed, sizeof(msx_modifier_pressed));
+  bench_saved.msx_nkro_last_make = msx_nkro_last_make;
+  bench_saved.msx_nkro_repeat = msx_nkro_repeat;
+  bench_saved.msx_nkro_modifier_dependent = msx_nkro_modifier_dependent;
+#endif  //#if MSX_NKRO == true
+#if MSX_PAIRING == true
+  memcpy(bench_saved.msx_pairings, msx_pairings, sizeof(msx_pairings));
+  bench_saved.msx_pairing_recording = msx_pairing_recording;
+#endif  //#if MSX_PAIRING == true
+#if AUTOFIRE == true
+  memcpy(bench_saved.autofire_slots, autofire_slots, sizeof(autofire_slots));
+  bench_saved.autofire_columns = autofire_columns;
+  for(uint8_t i = 0; i < AUTOFIRE_COLUMNS; i++)
+    bench_saved.autofire_reads[i] = autofire_reads[i];
+#endif  //#if AUTOFIRE == true
+#if LATENCY_TRACE == true
+  bench_saved.latency_wait_y = latency_wait_y;
+  bench_saved.latency_state = latency_state;
+  memcpy(&bench_saved.latency_current, (const void*)&latency_current, sizeof(latency_current));
+#endif  //#if LATENCY_TRACE == true
+}
+
+
+void bench_restore(void)
+{
+  for(uint8_t i = 0; i < 16 + 1; i++)
+    x_bits[i] = bench_saved.x_bits[i];
+  for(uint8_t i = 0; i < 4; i++)
+    scancode[i] = bench_saved.scancode[i];
+  scanline = bench_saved.scanline;
+  shiftstate = bench_saved.shiftstate;
+#if CHORDS == true
+  chord_state = bench_saved.chords;
+#else
+  CtrlAltDel = bench_saved.ctrl_alt_del;
+#endif  //#if CHORDS == true
+  gpio_set(CTRL_PORT, bench_saved.x_pins);
+  gpio_clear(CTRL_PORT, ~bench_saved.x_pins & BENCH_X_PINS);
+  ps2_recv_put_ptr = bench_saved.ps2_recv_put_ptr;
+  ps2_recv_get_ptr = bench_saved.ps2_recv_get_ptr;
+  mount_scancode_OK = bench_saved.mount_scancode_OK;
+  ps2_keystr_e0 = bench_saved.ps2_keystr_e0;
+  ps2_keystr_e1 = bench_saved.ps2_keystr_e1;
+  ps2_keystr_f0 = bench_saved.ps2_keystr_f0;
+  mount_scancode_count_status = bench_saved.mount_scancode_count_status;
+#if MSX_NKRO == true
+  memcpy(msx_pressed, bench_saved.msx_pressed, sizeof(msx_pressed));
+  memcpy(msx_key_refs, bench_saved.msx_key_refs, sizeof(msx_key_refs));
+  memcpy(msx_modifier_pressed, bench_saved.msx_modifier_pressed, sizeof(msx_modifier_pressed));
+  msx_nkro_last_make = bench_saved.msx_nkro_last_make;
+  msx_nkro_repeat = bench_saved.msx_nkro_repeat;
+  msx_nkro_modifier_dependent = bench_saved.msx_nkro_modifier_dependent;
+#endif  //#if MSX_NKRO == true
+#if MSX_PAIRING == true
+  memcpy(msx_pairings, bench_saved.msx_pairings, sizeof(msx_pairings));
+  msx_pairing_recording = bench_saved.msx_pairing_recording;
+#endif  //#if MSX_PAIRING == true
+#if AUTOFIRE == true
+  memcpy(autofire_slots, bench_saved.autofire_slots, sizeof(autofire_slots));
+  for(uint8_t i = 0; i < AUTOFIRE_COLUMNS; i++)
+    autofire_reads[i] = bench_saved.autofire_reads[i];
+  autofire_columns = bench_saved.autofire_columns;
+#endif  //#if AUTOFIRE == true
+#if LATENCY_TRACE == true
+  memcpy((void*)&latency_current, &bench_saved.latency_current, sizeof(latency_current));
+  latency_state = bench_saved.latency_state;
+  latency_wait_y = bench_saved.latency_wait_y;
+#endif  //#if LATENCY_TRACE == true
+}
+
+
+void bench_set_scancode(bool release)
+{
+  if(release)
+  {
+    scancode[0] = 2;
+    scancode[1] = PS2_BREAK_PREFIX;
+    scancode[2] = BENCH_PS2_KEY;
+  }
+  else
+  {
+    scancode[0] = 1;
+    scancode[1] = BENCH_PS2_KEY;
+  }
+}
+
+
+void bench_overhead(void)
+{
+}
+
+
+void bench_convert2msx(void)
+{
+  msxmap object;
+
+  bench_set_scancode(bench_iter++ & 1);
+  object.convert2msx();
+}
+
+
+void bench_msx_dispatch(void)
+{
+  msxmap object;
+  bool release = bench_iter++ & 1;
+
+  bench_set_scancode(release);
+  scanline = bench_scanline[release];
+  object.msx_dispatch();
+}
+
+
+void bench_compute_x_bits(void)
+{
+  msxmap object;
+
+  object.compute_x_bits_and_check_interrupt_stuck(bench_y, bench_x, bench_iter++ & 1);
+}
+
+
+void bench_y_scan_isr(void)
+{
+  exti9_5_isr();
+}
+
+
+//One byte arrives before each call, as from ps2_clock_receive(): make, break prefix, then break.
+void bench_mount_scancode(void)
+{
+  uint8_t i = ps2_recv_put_ptr;
+
+  ps2_recv_buffer[i] = bench_ps2_sequence[bench_iter];
+  ps2_recv_put_ptr = (i + 1) & (uint8_t)(PS2_RECV_BUFFER_SIZE - 1);
+  if(++bench_iter == sizeof(bench_ps2_sequence))
+    bench_iter = 0;
+  mount_scancode_OK = false;
+  mount_scancode();
+}
+
+
+void bench_ring_put_ch(void)
+{
+  ring_put_ch(&bench_ring, 'A');
+  bench_ring.get_ptr = bench_ring.put_ptr;
+}
+
+
+void bench_ring_get_ch(void)
+{
+  uint16_t qty_in_buffer;
+
+  bench_ring.put_ptr = (bench_ring.get_ptr + 1) & bench_ring.bufSzMask;
+  ring_get_ch(&bench_ring, &qty_in_buffer);
+}
+
+
+void bench_con_send_string(void)
+{
+  con_send_string((uint8_t*)"\r");
+}
+
+
+void bench_run(uint32_t calls, uint32_t (*clock)(void), struct bench_result *results)
+{
+  msxmap object;
+  uint32_t start, elapsed, kernel_calls;
+  uint8_t key;
+
+  calls = (calls + BENCH_BATCH - 1) & ~(uint32_t)(BENCH_BATCH - 1);
+  bench_save();
+  ring_init(&bench_ring, bench_ring_buffer, BENCH_RING_SIZE);
+
+  //The Database lines of make and break, as found by convert2msx()
+  bench_set_scancode(false);
+  object.convert2msx();
+  bench_scanline[0] = scanline;
+  bench_set_scancode(true);
+  object.convert2msx();
+  bench_scanline[1] = scanline;
+  key = base_of_database[bench_scanline[0] * DB_NUM_COLS + DB_CASE0_KEY0];
+  bench_y = key >> 4;
+  bench_x = key & 0x07;
+  bench_restore();
+
+  for(uint8_t k = 0; k < BENCH_NUM_KERNELS; k++)
+  {
+    kernel_calls = calls;
+    if(k == BENCH_CON_SEND_STRING)
+    {
+      if(kernel_calls > BENCH_CON_MAX_CALLS)
+        kernel_calls = BENCH_CON_MAX_CALLS;
+      //Starts with an empty TX ring, so no call waits the UART
+      con_wait_tx_empty();
+    }
+    results[k].calls = kernel_calls;
+    results[k].min = UINT32_MAX;
+    results[k].max = 0;
+    results[k].sum = 0;
+    bench_iter = 0;
+    for(uint32_t batch = 0; batch < kernel_calls; batch += BENCH_BATCH)
+    {
+      start = clock();
+      for(uint8_t i = 0; i < BENCH_BATCH; i++)
+        bench_kernels[k]();
+      elapsed = clock() - start;
+      if(elapsed < results[k].min)
+        results[k].min = elapsed;
+      if(elapsed > results[k].max)
+        results[k].max = elapsed;
+      results[k].sum += elapsed;
+    }
+    bench_restore();
+  }
+}
+
+
+void bench_send_hundredths(uint64_t value)
+{
+  uint8_t mountstring[16];
+
+  conv_uint32_to_dec((uint32_t)(value / 100), mountstring);
+  con_send_string(mountstring);
+  mountstring[0] = '.';
+  mountstring[1] = '0' + (uint8_t)((value / 10) % 10);
+  mountstring[2] = '0' + (uint8_t)(value % 10);
+  mountstring[3] = 0;
+  con_send_string(mountstring);
+}
+
+
+void bench_print(const struct bench_result *results, const char *unit)
+{
+  uint8_t mountstring[16];
+
+  con_send_string((uint8_t*)"\r\nbench,firmware,unit,kernel,calls,min,avg,max\r\n");
+  for(uint8_t k = 0; k < BENCH_NUM_KERNELS; k++)
+  {
+    con_send_string((uint8_t*)"bench," FIRMWARE_VERSION ",");
+    con_send_string((uint8_t*)unit);
+    con_send_string((uint8_t*)",");
+    con_send_string((uint8_t*)bench_kernel_names[k]);
+    con_send_string((uint8_t*)",");
+    conv_uint32_to_dec(results[k].calls, mountstring);
+    con_send_string(mountstring);
+    con_send_string((uint8_t*)",");
+    bench_send_hundredths((uint64_t)results[k].min * 100 / BENCH_BATCH);
+    con_send_string((uint8_t*)",");
+    bench_send_hundredths(results[k].sum * 100 / results[k].calls);
+    con_send_string((uint8_t*)",");
+    bench_send_hundredths((uint64_t)results[k].max * 100 / BENCH_BATCH);
+    con_send_string((uint8_t*)"\r\n");
+  }
+}
+
+
+void bench_console_cmd(uint8_t *args)
+{
+  uint8_t *word = console_next_word(&args);
+  uint32_t calls = BENCH_DEFAULT_CALLS;
+  struct bench_result results[BENCH_NUM_KERNELS];
+
+  if( *word && (!console_word_to_uint32(word, &calls) || !calls || (calls > BENCH_MAX_CALLS)) )
+  {
+    con_send_string((uint8_t*)"Usage: bench [calls], up to 65536\r\n");
+    return;
+  }
+#if MACROS == true
+  if(macro_recording())
+  {
+    con_send_string((uint8_t*)"Stop the macro recording first: it would record the bench key.\r\n");
+    return;
+  }
+#endif  //#if MACROS == true
+  bench_run(calls, dwt_read_cycle_counter, results);
+  bench_print(results, "cycles");
+}
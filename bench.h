@@ -0,0 +1,113 @@
+/** @defgroup 17 bench Hot Path Microbenchmarks
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file bench.h Microbenchmarks of the key path and console hot functions.
+ *
+ * @brief <b>Microbenchmarks of the key path and console hot functions. Header file of bench.cpp.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Each kernel is called in batches of BENCH_BATCH calls, timed by a free running clock: the DWT
+ * cycle counter on target (console command "bench"), or nanoseconds on host (bench-host).
+ * Results are CSV lines, one per kernel, to be compared between firmware versions:
+ * bench,firmware,unit,kernel,calls,min,avg,max (per call, over the batches).
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined BENCH_H
+#define BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <libopencm3/cm3/dwt.h>
+
+#include "system.h"
+#include "serial.h"
+
+
+/** Benchmark sizes
+@{*/
+#define BENCH_BATCH               16          //Calls timed together: a batch hit by an ISR is discarded by min
+#define BENCH_DEFAULT_CALLS       1024
+#define BENCH_CON_MAX_CALLS       (UART_TX_RING_BUFFER_SIZE / 2)  //con_send_string() must not wait the UART
+#define BENCH_PS2_KEY             0x14        //Left Control: its press is harmless to the MSX
+#define BENCH_NUM_KERNELS         9
+/**@}*/
+
+/** Result of a kernel, in clock units per batch */
+struct bench_result
+{
+  uint32_t calls, min, max;
+  uint64_t sum;
+};
+
+/** Names of the kernels, on the order of the results */
+extern const char *const bench_kernel_names[BENCH_NUM_KERNELS];
+
+/**
+ * @brief Runs all kernels. The firmware state they touch (MSX matrix, scan code machine, rings) is
+ * saved and restored. Must be called from the main loop, as mount_scancode() and convert2msx() are.
+ *
+ * @param calls Calls per kernel, rounded up to BENCH_BATCH. con_send_string() is limited to BENCH_CON_MAX_CALLS.
+ * @param clock Free running up counter.
+ * @param results BENCH_NUM_KERNELS results.
+ */
+void bench_run(uint32_t calls, uint32_t (*clock)(void), struct bench_result *results);
+
+/**
+ * @brief Prints the results on console, as CSV lines with a header.
+ *
+ * @param results BENCH_NUM_KERNELS results of bench_run().
+ * @param unit Name of the clock unit.
+ */
+void bench_print(const struct bench_result *results, const char *unit);
+
+/**
+ * @brief Console command "bench": runs all kernels, timed on DWT cycles.
+ *
+ * @param args Optional number of calls per kernel (default BENCH_DEFAULT_CALLS).
+ */
+void bench_console_cmd(uint8_t *args);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined BENCH_H
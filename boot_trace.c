@@ -0,0 +1,86 @@
+/** @addtogroup 12 boot_trace Boot Timeline Trace
+ *
+ * @file boot_trace.c Boot timeline trace.
+ *
+ * @brief <b>Boot timeline trace.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include "boot_trace.h"
+
+
+struct boot_milestone
+{
+  const char *label;
+  uint32_t t_usec;
+};
+
+//Global vars
+struct boot_milestone boot_timeline[BOOT_TRACE_SIZE];
+uint8_t boot_timeline_qty;
+
+
+void boot_mark(const char *label)
+{
+  if(boot_timeline_qty >= BOOT_TRACE_SIZE)
+    return;
+  boot_timeline[boot_timeline_qty].t_usec = hr_timer_now();
+  boot_timeline[boot_timeline_qty].label = label;
+  boot_timeline_qty++;
+}
+
+
+void boot_trace_console_cmd(uint8_t *args)
+{
+  uint8_t mountstring[16];
+  uint32_t former = 0;
+
+  (void)args;
+  con_send_string((uint8_t*)"  Time(us)  Delta(us) Milestone\r\n");
+  for(uint8_t i = 0; i < boot_timeline_qty; i++)
+  {
+    conv_uint32_to_dec(boot_timeline[i].t_usec, mountstring);
+    for(uint8_t len = strlen((const char*)mountstring); len < 10; len++)
+      con_send_string((uint8_t*)" ");
+    con_send_string(mountstring);
+    conv_uint32_to_dec(boot_timeline[i].t_usec - former, mountstring);
+    for(uint8_t len = strlen((const char*)mountstring); len < 11; len++)
+      con_send_string((uint8_t*)" ");
+    con_send_string(mountstring);
+    con_send_string((uint8_t*)" ");
+    con_send_string((uint8_t*)boot_timeline[i].label);
+    con_send_string((uint8_t*)"\r\n");
+    former = boot_timeline[i].t_usec;
+  }
+}
@@ -0,0 +1,83 @@
+/** @defgroup 12 boot_trace Boot Timeline Trace
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file boot_trace.h Boot timeline trace.
+ *
+ * @brief <b>Boot timeline trace. Header file of boot_trace.c.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Boot runs as concurrent state machines (USB enumeration, PS/2 keyboard BAT and detection,
+ * LED test), so each milestone is timestamped with the 1MHz TIM_HR counter to show where the
+ * time goes. The timeline is shown by the console command "boot".
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "system.h"
+#include "hr_timer.h"
+#include "serial.h"
+
+
+#define BOOT_TRACE_SIZE           16          //Max number of milestones
+
+
+/**
+ * @brief Timestamps a boot milestone. Milestones after the BOOT_TRACE_SIZE-th are discarded.
+ *
+ * @param label Constant ASCIIZ string describing the milestone.
+ */
+void boot_mark(const char *label);
+
+/**
+ * @brief Console command "boot": prints the boot timeline.
+ *
+ * @param args Rest of the command line (not used).
+ */
+void boot_trace_console_cmd(uint8_t *args);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined BOOT_TRACE_H
@@ -49,6 +49,11 @@
 
 #include "cdcacm.h"
 #include "usb_descriptors.h"
+#include "main_events.h"
+#include "console.h"
+#if USB_TELEMETRY == true
+#include "telemetry.h"
+#endif  //#if USB_TELEMETRY == true
 
 //Global variables
 #if USE_USB == true
@@ -56,6 +61,10 @@ usbd_device *usb_dev;
 int usb_configured;
 bool nak_cleared[2][EP_UART_COMM_OUT];            //IN and OUT for first dimension and last defined OUT endpoint
 uint8_t usbd_control_buffer[4 * USBD_DATA_BUFFER_SIZE]; // Buffer to be used for control requests.
+bool zlp_due[3];                                  //The last packet was a full one: index 0 console, 1 UART, 2 telemetry
+#if USB_TELEMETRY == true
+volatile bool telemetry_in_flight;                //A packet of telemetry_ring was written and its callback will follow
+#endif  //#if USB_TELEMETRY == true
 /**
  * Defines the struct of transmit and receive buffers
  * 
@@ -77,6 +86,12 @@ extern bool   xonoff_sendnow;                     //Declared on serial.c
 extern bool   ok_to_rx;                           //Declared on serial.c
 /**@}*/
 
+#if USE_USB == true
+//Local prototypes
+bool ring_span_onto_ep(struct sring *ring, uint8_t ep);
+void packet_onto_ring(struct sring *ring, uint8_t ep, const uint8_t *buf, uint16_t len);
+#endif  //#if USE_USB == true
+
 
 
 #if USE_USB == true
@@ -172,102 +187,50 @@ static enum usbd_request_return_codes
 
 static void cdcacm_con_data_rx_cb(usbd_device *usbd_dev, uint8_t ep)
 {
-  (void)usbd_dev;
   (void)ep;
-  char buf_con[USBD_DATA_BUFFER_SIZE];
-  uint16_t len_con, result = 0;
+  uint8_t buf_con[USBD_DATA_BUFFER_SIZE];
+  uint16_t len_con;
 
   len_con = (uint16_t)usbd_ep_read_packet(usbd_dev, EP_CON_DATA_OUT, buf_con, USBD_DATA_BUFFER_SIZE);
   if (len_con)
   {
-    for(uint16_t i = 0; (i < len_con) && (result != 0xFFFF); i++)
-      while( (result = ring_put_ch(&con_rx_ring, buf_con[i])) == 0xFFFF) __asm("nop");
-    if(result > ((3 * (uart_tx_ring.bufSzMask + 1)) >> 2)) //X_OFF_TRIGGER
-    {
-      //Put EP in nak. On con_rx_ring read, check con_rx_ring room (X_ON_TRIGGER) to clear nak.
-      nak_cleared[(EP_CON_DATA_OUT & USB_REQ_TYPE_IN) >> 8][EP_CON_DATA_OUT & ~USB_REQ_TYPE_IN] = false;
-      usbd_ep_nak_set(usbd_dev, EP_CON_DATA_OUT, 1);
-    }
+    packet_onto_ring(&con_rx_ring, EP_CON_DATA_OUT, buf_con, len_con);
+    main_event_set(EVT_CON_RX);
   }
 }
 
 
 static void cdcacm_con_data_tx_cb(usbd_device *usbd_dev, uint8_t ep)
 {
-  (void)usbd_dev;
   (void)ep;
-  char buf[USBD_DATA_BUFFER_SIZE];
-  uint16_t i, len, max_transf, qty_accepted, local_getptr;
-
-  len = QTTY_CHAR_IN(con_tx_ring);
-  if(len)
-  {
-    max_transf = (len > (USBD_DATA_BUFFER_SIZE - 1)) ? (USBD_DATA_BUFFER_SIZE - 1) : len;
-    local_getptr = con_tx_ring.get_ptr;
-
-    CHECK_XONXOFF_SENDNOW_START_WITH_OPEN_BRACKET
-      // Transmit char through usb console.
-      buf[0] = data;
-      for(i = 1; i < max_transf; i++)
-      {
-        #if defined CHECK_INDEX
-        check_idx_u16(i, (uintptr_t)buf, USBD_DATA_BUFFER_SIZE);
-        #endif
-        buf[i] = con_tx_ring.data[local_getptr++];
-        local_getptr &= con_tx_ring.bufSzMask;
-      }
-    CHECK_XONXOFF_SENDNOW_CLOSE_BRACKET
-    else  //else CHECK_XONXOFF_SENDNOW_START_WITH_OPEN_BRACKET
-    {
-      for(i = 0; i < max_transf; i++)
-      {
-        #if defined CHECK_INDEX
-        check_idx_u16(i, (uintptr_t)buf, USBD_DATA_BUFFER_SIZE);
-        #endif
-        buf[i] = con_tx_ring.data[local_getptr++];
-        local_getptr &= con_tx_ring.bufSzMask;
-      }
-    } //else CHECK_XONXOFF_SENDNOW_START_WITH_OPEN_BRACKET
 
-    qty_accepted = usbd_ep_write_packet(usb_dev, EP_CON_DATA_IN, buf, max_transf);
-    //This following two passes warranties that con_tx_ring.get_ptr to be an atomic update.
-    con_tx_ring.get_ptr = (con_tx_ring.get_ptr + qty_accepted) & con_tx_ring.bufSzMask;
-  }
-  else  //if(len)
-  { //As len = 0, set this EP to NAK requests, but first check XONXOFF SENDNOW
-    CHECK_XONXOFF_SENDNOW_START_WITH_OPEN_BRACKET
-      // Put char in console ring.
-      ring_put_ch(&con_tx_ring, data);
-      buf[0] = data;
-      usbd_ep_write_packet(usb_dev, EP_CON_DATA_IN, buf, 1);
-    CHECK_XONXOFF_SENDNOW_CLOSE_BRACKET //CHECK_XONXOFF_SENDNOW_START_WITH_OPEN_BRACKET
-    else  //else CHECK_XONXOFF_SENDNOW_START_WITH_OPEN_BRACKET
-      usbd_ep_nak_set(usbd_dev, EP_CON_DATA_IN, 1);
-  }
+  CHECK_XONXOFF_SENDNOW_START_WITH_OPEN_BRACKET
+    //Alone on its packet: the ring content is sent from the ring itself
+    usbd_ep_write_packet(usbd_dev, EP_CON_DATA_IN, &data, 1);
+    zlp_due[0] = false;
+  CHECK_XONXOFF_SENDNOW_CLOSE_BRACKET
+  else if(!ring_span_onto_ep(&con_tx_ring, EP_CON_DATA_IN))
+    //Nothing to send: set this EP to NAK requests
+    usbd_ep_nak_set(usbd_dev, EP_CON_DATA_IN, 1);
 }
 
 
 static void cdcacm_uart_data_rx_cb(usbd_device *usbd_dev, uint8_t ep)
 {
-  (void)usbd_dev;
   (void)ep;
-  uint8_t buf_uart[USBD_DATA_BUFFER_SIZE + 1];
-  uint16_t result;
-  uint32_t len;
+  uint8_t buf_uart[USBD_DATA_BUFFER_SIZE];
+  uint16_t len;
 
-  len = (uint16_t)usbd_ep_read_packet(usbd_dev, EP_UART_DATA_OUT, (char*)buf_uart, USBD_DATA_BUFFER_SIZE);
+  len = (uint16_t)usbd_ep_read_packet(usbd_dev, EP_UART_DATA_OUT, buf_uart, USBD_DATA_BUFFER_SIZE);
   if (len && ok_to_rx)
   {
-    for(uint16_t i = 0; (i < len) && (result != 0xFFFF); i++)
-      while( (result = ring_put_ch(&uart_tx_ring, buf_uart[i])) == 0xFFFF)
-        do_dma_usart_tx_ring(len);
-    do_dma_usart_tx_ring(len);
-    if(result > ((3 * (uart_tx_ring.bufSzMask + 1)) >> 2))
-    {
-      //Put EP in nak. On uart_tx_ring read, check uart_rx_ring room (X_ON_TRIGGER) to clear nak.
-      set_nak_endpoint(EP_UART_DATA_OUT);
-    } //if(result > (3 * (uart_tx_ring.bufSzMask + 1) / 4))
-  } //if (len)
+    packet_onto_ring(&uart_tx_ring, EP_UART_DATA_OUT, buf_uart, len);
+    //If DMA is idle, start it up to the end of the buffer: ISR_DMA_CH_USART_TX sends the bytes after the wrap
+    if(uart_tx_ring.put_ptr < uart_tx_ring.get_ptr)
+      do_dma_usart_tx_ring(uart_tx_ring.bufSzMask - uart_tx_ring.get_ptr + 1);
+    else
+      do_dma_usart_tx_ring(uart_tx_ring.put_ptr - uart_tx_ring.get_ptr);
+  } //if (len && ok_to_rx)
 }
 
 
@@ -275,46 +238,96 @@ static void cdcacm_uart_data_tx_cb(usbd_device *usbd_dev, uint8_t ep)
 {
   (void)usbd_dev;
   (void)ep;
-  char buf[USBD_DATA_BUFFER_SIZE];
-  uint16_t i, len, max_transf, qty_accepted, local_getptr;
 
-  len = QTTY_CHAR_IN(uart_rx_ring);
-  if(len)
+  ring_span_onto_ep(&uart_rx_ring, EP_UART_DATA_IN);
+}
+
+
+#if USB_TELEMETRY == true
+static void cdcacm_telemetry_tx_cb(usbd_device *usbd_dev, uint8_t ep)
+{
+  (void)usbd_dev;
+  (void)ep;
+
+  //When the ring is empty, the endpoint goes idle: cdcacm_telemetry_poll() restarts it
+  telemetry_in_flight = ring_span_onto_ep(&telemetry_ring, EP_TELEMETRY_IN);
+}
+
+
+static enum usbd_request_return_codes
+    cdcacm_telemetry_request(usbd_device *usbd_dev, struct usb_setup_data *req, uint8_t **buf, uint16_t *len,
+                             void (**complete)(usbd_device *usbd_dev, struct usb_setup_data *req))
+{
+  (void)usbd_dev;
+  (void)buf;
+  (void)complete;
+
+  if(req->wIndex != INTF_TELEMETRY)
+    return USBD_REQ_NEXT_CALLBACK;
+  switch (req->bRequest)
   {
-    max_transf = (len > (USBD_DATA_BUFFER_SIZE - 1)) ? (USBD_DATA_BUFFER_SIZE - 1) : len;
-    local_getptr = uart_rx_ring.get_ptr;
-    for(i = 0; i < max_transf; i++)
-    {
-      #if defined CHECK_INDEX
-      check_idx_u16(i, (uintptr_t)buf, USBD_DATA_BUFFER_SIZE);
-      #endif
-      buf[i] = uart_rx_ring.data[local_getptr++];
-      local_getptr &= (uart_rx_ring.bufSzMask);
-    }
-    qty_accepted = usbd_ep_write_packet(usb_dev, EP_UART_DATA_IN, buf, max_transf);
-    //This following two passes warranties that uart_rx_ring.get_ptr to be an atomic update.
-    uart_rx_ring.get_ptr = (uart_rx_ring.get_ptr + qty_accepted) & (uart_rx_ring.bufSzMask);
+    case TELEMETRY_REQ_START:
+      telemetry_start();
+      *len = 0;
+      return USBD_REQ_HANDLED;
+    break;
+    case TELEMETRY_REQ_STOP:
+      telemetry_stop();
+      *len = 0;
+      return USBD_REQ_HANDLED;
+    break;
+    default:
+      return USBD_REQ_NOTSUPP;
+    break;
   }
 }
 
 
+//Restarts the telemetry endpoint when it is idle and the ring has records. The USB ISR is held meanwhile, as its IN
+//callback is the other writer of the endpoint and of telemetry_ring.get_ptr.
+void cdcacm_telemetry_poll(void)
+{
+  if(!usb_configured || telemetry_in_flight || !QTTY_CHAR_IN(telemetry_ring))
+    return;
+  nvic_disable_irq(USB_NVIC);
+  if(!telemetry_in_flight)
+    telemetry_in_flight = ring_span_onto_ep(&telemetry_ring, EP_TELEMETRY_IN);
+  nvic_enable_irq(USB_NVIC);
+}
+#endif  //#if USB_TELEMETRY == true
+
+
 static void cdcacm_set_config(usbd_device *usbd_dev, uint16_t wValue)
 {
   usb_configured = wValue;
+  main_event_set(EVT_USB);
+  zlp_due[0] = zlp_due[1] = zlp_due[2] = false;
 
   //Console interface
-  usbd_ep_setup(usbd_dev, EP_CON_COMM_IN, USB_ENDPOINT_ATTR_INTERRUPT, COMM_PACKET_SIZE, NULL);
+  usbd_ep_setup(usbd_dev, EP_CON_NOTIF, USB_ENDPOINT_ATTR_INTERRUPT, COMM_PACKET_SIZE, NULL);
   usbd_ep_setup(usbd_dev, EP_CON_DATA_OUT, USB_ENDPOINT_ATTR_BULK, USBD_DATA_BUFFER_SIZE, cdcacm_con_data_rx_cb);
   usbd_ep_setup(usbd_dev, EP_CON_DATA_IN, USB_ENDPOINT_ATTR_BULK, USBD_DATA_BUFFER_SIZE, cdcacm_con_data_tx_cb);
   //UART interface
   usbd_ep_setup(usbd_dev, EP_UART_COMM_IN, USB_ENDPOINT_ATTR_INTERRUPT, COMM_PACKET_SIZE, NULL);
   usbd_ep_setup(usbd_dev, EP_UART_DATA_OUT, USB_ENDPOINT_ATTR_BULK, USBD_DATA_BUFFER_SIZE, cdcacm_uart_data_rx_cb);
   usbd_ep_setup(usbd_dev, EP_UART_DATA_IN, USB_ENDPOINT_ATTR_BULK, USBD_DATA_BUFFER_SIZE, cdcacm_uart_data_tx_cb);
+#if USB_TELEMETRY == true
+  //Telemetry interface: stopped until the reader asks for it
+  telemetry_stop();
+  telemetry_in_flight = false;
+  usbd_ep_setup(usbd_dev, EP_TELEMETRY_IN, USB_ENDPOINT_ATTR_BULK, USBD_DATA_BUFFER_SIZE, cdcacm_telemetry_tx_cb);
+#endif  //#if USB_TELEMETRY == true
 
   usbd_register_control_callback(usbd_dev,
         USB_REQ_TYPE_CLASS | USB_REQ_TYPE_INTERFACE,
         USB_REQ_TYPE_TYPE | USB_REQ_TYPE_RECIPIENT,
         cdcacm_control_request);
+#if USB_TELEMETRY == true
+  usbd_register_control_callback(usbd_dev,
+        USB_REQ_TYPE_VENDOR | USB_REQ_TYPE_INTERFACE,
+        USB_REQ_TYPE_TYPE | USB_REQ_TYPE_RECIPIENT,
+        cdcacm_telemetry_request);
+#endif  //#if USB_TELEMETRY == true
 
   /* Notify the host that DCD is asserted.
    * Allows the use of /dev/tty* devices on *BSD/MacOS
@@ -328,30 +341,106 @@ static void cdcacm_set_config(usbd_device *usbd_dev, uint16_t wValue)
 //It returns ring->get_ptr updated.
 void first_put_ring_content_onto_ep(struct sring *ring, uint8_t ep)
 {
-  if(usb_configured)
+  if(usb_configured && QTTY_CHAR_IN((*ring)))
   {
-    char buf[USBD_DATA_BUFFER_SIZE];
-    uint16_t i, len, max_transf, qty_accepted, local_getptr;
-
-    len = (ring->bufSzMask + 1 - ring->get_ptr + ring->put_ptr) & ring->bufSzMask;
-    local_getptr = ring->get_ptr; //update ring->get_ptr only at the end of the process
-    if(len)
-    {
-      clear_nak_endpoint(ep); //disable nak on ep
-      max_transf = (len > (USBD_DATA_BUFFER_SIZE - 1)) ? (USBD_DATA_BUFFER_SIZE - 1) : len;
-      for(i = 0; i < max_transf; i++)
-      {
-        #if defined CHECK_INDEX
-        check_idx_u16(i, (uintptr_t)buf, USBD_DATA_BUFFER_SIZE);
-        #endif
-        buf[i] = ring->data[local_getptr++];
-        local_getptr &= ring->bufSzMask;
-      }
-      qty_accepted = usbd_ep_write_packet(usb_dev, ep, buf, max_transf);
-      //This following two passes warranties that ring->get_ptr to be an atomic update.
-      ring->get_ptr = (ring->get_ptr + qty_accepted) & ring->bufSzMask;
-    }
-  } //if(usb_configured)
+    clear_nak_endpoint(ep); //disable nak on ep
+    ring_span_onto_ep(ring, ep);
+  } //if(usb_configured && QTTY_CHAR_IN((*ring)))
+}
+
+
+//Puts a received packet on the ring, with no wait: the OUT endpoint is kept on NAK while the ring has no room for a
+//full packet, so all bytes fit (a byte with no room would be dropped, never waited for: its consumer runs after this
+//ISR). NAK is set when the ring reaches its X_OFF trigger or has less than a packet of room, and it is cleared by the
+//consumer, under the X_ON trigger (serial.c).
+void packet_onto_ring(struct sring *ring, uint8_t ep, const uint8_t *buf, uint16_t len)
+{
+  uint16_t qty = QTTY_CHAR_IN((*ring));
+
+  for(uint16_t i = 0; (i < len) && (qty != 0xFFFF); i++)
+    qty = ring_put_ch(ring, buf[i]);
+  if(qty == 0xFFFF)
+    qty = ring->bufSzMask;
+  if( (qty >= ring->xoff_trigger) || ((uint16_t)(ring->bufSzMask - qty) < USBD_DATA_BUFFER_SIZE) )
+    set_nak_endpoint(ep);
+}
+
+
+//Writes the next packet of the ring straight from its buffer, with no copy on the way: a full packet, or the bytes
+//left up to the end of the buffer (the ones after the wrap go on the next packet). A full packet that empties the
+//ring is followed by a zero length packet, otherwise the host would wait for more data to end its transfer.
+//The span may start on any address: the libopencm3 packet writes load it by halfwords (STM32F103) or words
+//(STM32F401), that Cortex-M3 and M4 take unaligned. It returns false if there was nothing to send.
+bool ring_span_onto_ep(struct sring *ring, uint8_t ep)
+{
+  bool *zlp = &zlp_due[(ep == EP_CON_DATA_IN) ? 0 : ((ep == EP_UART_DATA_IN) ? 1 : 2)];
+  uint16_t len, span, qty_accepted;
+
+  len = QTTY_CHAR_IN((*ring));
+  if(!len)
+  {
+    if(!*zlp)
+      return false;
+    usbd_ep_write_packet(usb_dev, ep, NULL, 0);
+    *zlp = false;
+    return true;
+  }
+  span = ring->bufSzMask + 1 - ring->get_ptr;
+  if(len > span)
+    len = span;
+  if(len > USBD_DATA_BUFFER_SIZE)
+    len = USBD_DATA_BUFFER_SIZE;
+  qty_accepted = usbd_ep_write_packet(usb_dev, ep, &ring->data[ring->get_ptr], len);
+  if(qty_accepted)
+  {
+    //A single store: get_ptr is an atomic update to the ring producer.
+    ring->get_ptr = (ring->get_ptr + qty_accepted) & ring->bufSzMask;
+    *zlp = qty_accepted == USBD_DATA_BUFFER_SIZE;
+  }
+  return true;
+}
+
+
+//Console command "usbtx": the console pipe as fast as it goes, then its throughput
+void cdcacm_tx_console_cmd(uint8_t *args)
+{
+  uint8_t *word = console_next_word(&args);
+  uint8_t line[CDCACM_TX_BENCH_LINE + 1], mountstring[16];
+  uint32_t kbytes = CDCACM_TX_BENCH_DEFAULT_KB, bytes, start, cycles, rate;
+
+  if( *word && (!console_word_to_uint32(word, &kbytes) || !kbytes || (kbytes > CDCACM_TX_BENCH_MAX_KB)) )
+  {
+    con_send_string((uint8_t*)"Usage: usbtx [KB], up to 1024\r\n");
+    return;
+  }
+  if(!usb_configured)
+  {
+    con_send_string((uint8_t*)"usbtx: USB is not configured\r\n");
+    return;
+  }
+  //Printable lines: the terminal shows them as they come
+  for(uint8_t i = 0; i < CDCACM_TX_BENCH_LINE - 2; i++)
+    line[i] = (uint8_t)('0' + i % 10);
+  line[CDCACM_TX_BENCH_LINE - 2] = '\r';
+  line[CDCACM_TX_BENCH_LINE - 1] = '\n';
+  line[CDCACM_TX_BENCH_LINE] = 0;
+  con_wait_tx_empty();
+  start = dwt_read_cycle_counter();
+  for(bytes = 0; bytes < kbytes * 1024; bytes += CDCACM_TX_BENCH_LINE)
+    con_send_string(line);
+  con_wait_tx_empty();
+  cycles = dwt_read_cycle_counter() - start;
+  rate = (uint32_t)((uint64_t)bytes * rcc_ahb_frequency / 1024 / (cycles ? cycles : 1));
+  con_send_string((uint8_t*)"usbtx,bytes,ms,KB/s\r\nusbtx,");
+  conv_uint32_to_dec(bytes, mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)",");
+  conv_uint32_to_dec(cycles / (rcc_ahb_frequency / 1000), mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)",");
+  conv_uint32_to_dec(rate, mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)"\r\n");
 }
 
 
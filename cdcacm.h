@@ -58,6 +58,7 @@ extern "C" {
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/usb/usbd.h>
+#include <libopencm3/cm3/dwt.h>
 #include <libopencm3/cm3/scb.h>
 
 #include "system.h"
@@ -78,6 +79,14 @@ static const struct usb_cdc_line_coding line_coding = {
 };
 
 
+/** Console command "usbtx"
+@{*/
+#define CDCACM_TX_BENCH_LINE      64          //Bytes per line, CR and LF included
+#define CDCACM_TX_BENCH_DEFAULT_KB 64
+#define CDCACM_TX_BENCH_MAX_KB    1024
+/**@}*/
+
+
 /**
  * @brief Inits the cdcacm sub system.
  * 
@@ -118,6 +127,23 @@ void first_put_ring_content_onto_ep(struct sring* ring, uint8_t ep);
 int cdcacm_get_config(void);
 
 
+#if USB_TELEMETRY == true
+/**
+ * @brief Restarts the telemetry endpoint when it is idle and telemetry_ring has records. To be called from main loop.
+ */
+void cdcacm_telemetry_poll(void);
+#endif  //#if USB_TELEMETRY == true
+
+
+/**
+ * @brief Console command "usbtx": sends lines on console as fast as USB takes them, and prints the bytes, the
+ * milliseconds and the KB/s (K = 1024).
+ *
+ * @param args Optional KB to send (default CDCACM_TX_BENCH_DEFAULT_KB).
+ */
+void cdcacm_tx_console_cmd(uint8_t *args);
+
+
 /**
  * @brief Disables the USB to make host disconnect.
  * 
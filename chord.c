@@ -0,0 +1,316 @@
+/** @addtogroup 20 chord Chord Table
+ *
+ * @file chord.c Chords, sequences and tap/hold keys of the Database, matched on each PS/2 event.
+ *
+ * @brief <b>Chords, sequences and tap/hold keys of the Database, matched on each PS/2 event.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * The records of DB_EXT_CHORDS are one payload line each: {kind << 4 | keys, action, argument,
+ * make code byte of keys 0 to 2, E0 mask (bit n for key n)}. Records out of the format are skipped.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#include <string.h>
+
+#include "chord.h"
+
+
+#define CHORD_RECORD_SIZE         DB_EXT_PAYLOAD_COLS
+#define CHORD_KIND_SHIFT          4
+#define CHORD_KEYS_MASK           0x0F
+
+
+//Global vars
+struct chord chord_table[CHORD_SLOTS];
+uint8_t chord_count;
+uint8_t chord_key_class[CHORD_KEYS];
+struct chord_state chord_state;
+extern uint8_t *base_of_database;                 //Declared on msxmap.cpp
+extern uint32_t systicks;                         //Declared on sys_timer.cpp
+
+//When the Database has no DB_EXT_CHORDS lines: what convert2msx() used to check
+const struct chord CHORD_DEFAULTS[] =
+{
+  { DB_CHORD_CHORD, 3, { 0x14, 0x11, 0x71 }, DB_CHORD_ACT_RESET,   0 },   //Left Ctrl + Left Alt + Num pad Del
+  { DB_CHORD_CHORD, 1, { 0x77 },             DB_CHORD_ACT_NUMLOCK, 0 },
+};
+
+//Their breaks release the MSX keys mapped by them. The first two are the Shifts
+const uint16_t CHORD_MODIFIERS[] =
+{
+  0x12, 0x59, CHORD_KEY_E0 | 0x1F, CHORD_KEY_E0 | 0x27, 0x14, CHORD_KEY_E0 | 0x14, 0x11, CHORD_KEY_E0 | 0x11
+};
+
+
+//Local prototypes
+const uint8_t* chord_find_ext(uint8_t type);
+void chord_add(uint8_t kind, uint8_t n_keys, const uint16_t *keys, uint8_t action, uint8_t arg);
+bool chord_is_held(uint16_t key);
+bool chord_others_held(const struct chord *c);
+bool chord_sequence_done(const struct chord *c);
+bool chord_taphold_armed(uint16_t key);
+
+
+//Header line of an extension of the Database, or NULL
+const uint8_t* chord_find_ext(uint8_t type)
+{
+  const uint8_t *p;
+
+  for(uint16_t line = 1; line < N_DATABASE_REGISTERS - 1; line++)
+  {
+    p = base_of_database + line * DB_NUM_COLS;
+    if( (p[0] != DB_EXT_MARK) || (p[1] != DB_EXT_TAG) )
+      continue;
+    if(p[2] == type)
+      return p;
+    line += p[5];
+  }
+  return NULL;
+}
+
+
+void chord_add(uint8_t kind, uint8_t n_keys, const uint16_t *keys, uint8_t action, uint8_t arg)
+{
+  struct chord *c;
+  uint16_t last;
+
+  if( (chord_count >= CHORD_SLOTS) || (kind > DB_CHORD_HOLD) || !n_keys || (n_keys > DB_CHORD_MAX_KEYS) ||
+      !action || (action > DB_CHORD_ACT_MACRO_REC) )
+    return;
+  for(uint8_t i = 0; i < n_keys; i++)
+    if( (keys[i] == CHORD_KEY_NONE) || (keys[i] >= CHORD_KEYS) )
+      return;
+  c = &chord_table[chord_count++];
+  c->kind = kind;
+  c->n_keys = n_keys;
+  memcpy(c->keys, keys, n_keys * sizeof(keys[0]));
+  c->action = action;
+  c->arg = arg;
+  last = keys[n_keys - 1];
+  chord_key_class[last] |= (kind <= DB_CHORD_SEQUENCE) ? CHORD_CLASS_TRIGGER : CHORD_CLASS_TAPHOLD;
+}
+
+
+void chord_setup(void)
+{
+  const uint8_t *p, *r;
+  uint16_t keys[DB_CHORD_MAX_KEYS];
+
+  memset(chord_key_class, 0, sizeof(chord_key_class));
+  for(uint8_t i = 0; i < sizeof(CHORD_MODIFIERS) / sizeof(CHORD_MODIFIERS[0]); i++)
+    chord_key_class[CHORD_MODIFIERS[i]] = (i < 2) ? (CHORD_CLASS_MODIFIER | CHORD_CLASS_SHIFT) : CHORD_CLASS_MODIFIER;
+  chord_count = 0;
+  p = chord_find_ext(DB_EXT_CHORDS);
+  if(p && (p[4] == CHORD_RECORD_SIZE))
+  {
+    for(uint8_t i = 0; i < p[3]; i++)
+    {
+      r = p + (1 + i) * DB_NUM_COLS + 1;
+      for(uint8_t k = 0; k < DB_CHORD_MAX_KEYS; k++)
+        keys[k] = r[3 + k] | ((r[6] & (1 << k)) ? CHORD_KEY_E0 : 0);
+      chord_add(r[0] >> CHORD_KIND_SHIFT, r[0] & CHORD_KEYS_MASK, keys, r[1], r[2]);
+    }
+  }
+  else
+    for(uint8_t i = 0; i < sizeof(CHORD_DEFAULTS) / sizeof(CHORD_DEFAULTS[0]); i++)
+      chord_add(CHORD_DEFAULTS[i].kind, CHORD_DEFAULTS[i].n_keys, CHORD_DEFAULTS[i].keys, CHORD_DEFAULTS[i].action,
+                CHORD_DEFAULTS[i].arg);
+  chord_clear();
+}
+
+
+void chord_clear(void)
+{
+  memset(&chord_state, 0, sizeof(chord_state));
+}
+
+
+uint16_t chord_key_of(const volatile uint8_t *scancode, bool *release)
+{
+  uint16_t key = 0;
+  uint8_t idx = 1, code;
+
+  *release = false;
+  if( (scancode[0] >= 2) && (scancode[1] == 0xE0) )
+  {
+    key = CHORD_KEY_E0;
+    idx++;
+  }
+  if( (idx < scancode[0]) && (scancode[idx] == 0xF0) )
+  {
+    *release = true;
+    idx++;
+  }
+  if(idx != scancode[0])
+    return CHORD_KEY_NONE;
+  code = scancode[idx];
+  if( !code || (code == 0xE0) || (code == 0xE1) || (code == 0xF0) )
+    return CHORD_KEY_NONE;
+  return key | code;
+}
+
+
+bool chord_is_held(uint16_t key)
+{
+  return (chord_state.held[key >> 5] & ((uint32_t)1 << (key & 31))) != 0;
+}
+
+
+bool chord_others_held(const struct chord *c)
+{
+  for(uint8_t i = 0; i < c->n_keys - 1; i++)
+    if(!chord_is_held(c->keys[i]))
+      return false;
+  return true;
+}
+
+
+//The keys before the last one were the last makes, in order
+bool chord_sequence_done(const struct chord *c)
+{
+  for(uint8_t i = 0; i < c->n_keys - 1; i++)
+    if(chord_state.last_makes[i] != c->keys[c->n_keys - 2 - i])
+      return false;
+  return true;
+}
+
+
+bool chord_taphold_armed(uint16_t key)
+{
+  for(uint8_t i = 0; i < chord_count; i++)
+  {
+    const struct chord *c = &chord_table[i];
+    if( (c->kind >= DB_CHORD_TAP) && (c->keys[c->n_keys - 1] == key) && chord_others_held(c) )
+      return true;
+  }
+  return false;
+}
+
+
+const struct chord* chord_match(uint16_t key, bool release)
+{
+  uint8_t kind;
+
+  if( (key == CHORD_KEY_NONE) || (key >= CHORD_KEYS) )
+    return NULL;
+  if(!release)
+  {
+    //Typematic repeats do not fire it again
+    if( !(chord_key_class[key] & CHORD_CLASS_TRIGGER) || chord_is_held(key) )
+      return NULL;
+    for(uint8_t i = 0; i < chord_count; i++)
+    {
+      const struct chord *c = &chord_table[i];
+      if(c->keys[c->n_keys - 1] != key)
+        continue;
+      if( (c->kind == DB_CHORD_CHORD) && chord_others_held(c) )
+        return c;
+      if( (c->kind == DB_CHORD_SEQUENCE) && chord_sequence_done(c) )
+        return c;
+    }
+    return NULL;
+  }
+  if( !(chord_key_class[key] & CHORD_CLASS_TAPHOLD) || (key != chord_state.taphold_key) )
+    return NULL;
+  kind = (systicks - chord_state.taphold_since >= CHORD_HOLD_SYSTICKS) ? DB_CHORD_HOLD : DB_CHORD_TAP;
+  for(uint8_t i = 0; i < chord_count; i++)
+  {
+    const struct chord *c = &chord_table[i];
+    if( (c->kind == kind) && (c->keys[c->n_keys - 1] == key) && chord_others_held(c) )
+      return c;
+  }
+  return NULL;
+}
+
+
+uint8_t chord_event(const volatile uint8_t *scancode, const struct chord **fired)
+{
+  uint16_t key;
+  uint32_t bit;
+  uint8_t word, class;
+  bool release;
+
+  *fired = NULL;
+  key = chord_key_of(scancode, &release);
+  if(key == CHORD_KEY_NONE)
+    return 0;
+  word = (uint8_t)(key >> 5);
+  bit = (uint32_t)1 << (key & 31);
+  class = chord_key_class[key];
+  if(!release)
+  {
+    if(chord_state.held[word] & bit)
+    {
+      //Typematic repeat
+      if(chord_state.swallowed[word] & bit)
+        return CHORD_SWALLOW;
+      return (class & CHORD_CLASS_SHIFT) ? CHORD_SHIFT_MAKE : 0;
+    }
+    if(class & (CHORD_CLASS_TRIGGER | CHORD_CLASS_TAPHOLD))
+    {
+      *fired = chord_match(key, false);
+      if( *fired || ((class & CHORD_CLASS_TAPHOLD) && chord_taphold_armed(key)) )
+      {
+        chord_state.held[word] |= bit;
+        chord_state.swallowed[word] |= bit;
+        if(*fired)
+          memset(chord_state.last_makes, 0, sizeof(chord_state.last_makes));
+        else
+        {
+          chord_state.taphold_key = key;
+          chord_state.taphold_since = systicks;
+        }
+        return CHORD_SWALLOW;
+      }
+    }
+    chord_state.held[word] |= bit;
+    memmove(&chord_state.last_makes[1], &chord_state.last_makes[0],
+            (DB_CHORD_MAX_KEYS - 1) * sizeof(chord_state.last_makes[0]));
+    chord_state.last_makes[0] = key;
+    return (class & CHORD_CLASS_SHIFT) ? CHORD_SHIFT_MAKE : 0;
+  }
+  chord_state.held[word] &= ~bit;
+  if(chord_state.swallowed[word] & bit)
+  {
+    chord_state.swallowed[word] &= ~bit;
+    if(key == chord_state.taphold_key)
+    {
+      *fired = chord_match(key, true);
+      chord_state.taphold_key = CHORD_KEY_NONE;
+    }
+    return CHORD_SWALLOW;
+  }
+  return ((class & CHORD_CLASS_MODIFIER) ? CHORD_MODIFIER_BREAK : 0) |
+         ((class & CHORD_CLASS_SHIFT) ? CHORD_SHIFT_BREAK : 0);
+}
@@ -0,0 +1,158 @@
+/** @defgroup 20 chord Chord Table
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file chord.h Chords, sequences and tap/hold keys of the Database, matched on each PS/2 event.
+ *
+ * @brief <b>Chords, sequences and tap/hold keys of the Database, matched on each PS/2 event. Header file of chord.c.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * The chords are loaded from the DB_EXT_CHORDS extension lines of the Database (host/db-compiler
+ * "[chords]" section), or from a built-in table (Ctrl + Alt + Num pad Del and NumLock) when the
+ * Database has none. A key is coded as its make code byte, plus CHORD_KEY_E0 if E0 prefixed.
+ *
+ * Each event costs one load of the class of its key and one bit of the held set: only the last key
+ * of a chord searches the table, so adding chords costs nothing to the other keys. The class also
+ * tells the modifiers (Shift, Ctrl, Graph and Code), whose breaks release the MSX keys they changed.
+ * A make that fires a chord (or starts a tap/hold) is swallowed, and so is its break.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined CHORD_H
+#define CHORD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "system.h"
+
+
+/** Chord table sizes and key coding
+@{*/
+#define CHORD_SLOTS               16
+#define CHORD_KEYS                0x200       //Make code byte, plus CHORD_KEY_E0
+#define CHORD_KEY_E0              0x100
+#define CHORD_KEY_NONE            0           //Pause and other sequences are not keys
+#define CHORD_HOLD_SYSTICKS       (FREQ_INT_SYSTICK / 2)  //A longer press is a hold, a shorter one a tap
+/**@}*/
+
+/** Class of a key, on chord_key_class[]
+@{*/
+#define CHORD_CLASS_TRIGGER       (1 << 0)    //Last key of a chord or sequence
+#define CHORD_CLASS_TAPHOLD       (1 << 1)    //Last key of a tap or hold
+#define CHORD_CLASS_MODIFIER      (1 << 2)    //Shift, Ctrl, Graph (Windows) or Code (Alt)
+#define CHORD_CLASS_SHIFT         (1 << 3)
+/**@}*/
+
+/** Flags returned by chord_event()
+@{*/
+#define CHORD_SWALLOW             (1 << 0)    //The event must not be mapped
+#define CHORD_MODIFIER_BREAK      (1 << 1)
+#define CHORD_SHIFT_MAKE          (1 << 2)
+#define CHORD_SHIFT_BREAK         (1 << 3)
+/**@}*/
+
+/**
+ * A chord of the table: DB_CHORD_xxx kind, keys (the last one fires it) and DB_CHORD_ACT_xxx action.
+ */
+struct chord
+{
+  uint8_t  kind;
+  uint8_t  n_keys;
+  uint16_t keys[DB_CHORD_MAX_KEYS];
+  uint8_t  action;
+  uint8_t  arg;
+};
+
+/**
+ * What the matching follows of the PS/2 events.
+ */
+struct chord_state
+{
+  uint32_t held[CHORD_KEYS / 32];
+  uint32_t swallowed[CHORD_KEYS / 32];        //Swallowed makes: their breaks are swallowed as well
+  uint16_t last_makes[DB_CHORD_MAX_KEYS];     //Newest first, typematic repeats not included
+  uint16_t taphold_key;                       //Key pressed as a tap or hold, or CHORD_KEY_NONE
+  uint32_t taphold_since;                     //systicks of its make
+};
+
+/**
+ * @brief Loads the chords of the Database on base_of_database, or the built-in ones, and forgets the held keys.
+ *
+ * To be called after database_setup(), and each time base_of_database changes.
+ */
+void chord_setup(void);
+
+/**
+ * @brief Forgets the held keys, when the PS/2 keyboard is lost or the MSX keys are all released.
+ */
+void chord_clear(void);
+
+/**
+ * @brief Key of a mounted scan code.
+ *
+ * @param scancode Mounted scan code: scancode[0] is the quantity of bytes.
+ * @param release Set true if it is a break code.
+ * @return The make code byte, plus CHORD_KEY_E0 if E0 prefixed, or CHORD_KEY_NONE.
+ */
+uint16_t chord_key_of(const volatile uint8_t *scancode, bool *release);
+
+/**
+ * @brief Chord fired by the make or break of a key, without changing the state.
+ *
+ * @param key As chord_key_of().
+ * @param release true for its break.
+ * @return The chord, or NULL.
+ */
+const struct chord* chord_match(uint16_t key, bool release);
+
+/**
+ * @brief Follows a PS/2 event, and tells what convert2msx() has to do with it.
+ *
+ * @param scancode Mounted scan code: scancode[0] is the quantity of bytes.
+ * @param fired Set to the chord to be run, or NULL.
+ * @return CHORD_xxx flags.
+ */
+uint8_t chord_event(const volatile uint8_t *scancode, const struct chord **fired);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined CHORD_H
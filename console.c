@@ -0,0 +1,240 @@
+/** @addtogroup 10 console Console Command Line
+ *
+ * @file console.c Non blocking console command line interpreter.
+ *
+ * @brief <b>Non blocking console command line interpreter.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * This library collects the chars received on the console (UART or USB), echoes them and,
+ * when a line is completed, runs the matching diagnostic command, on the STM32F4 and STM32F1
+ * series of ARM Cortex Microcontrollers by ST Microelectronics.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include "console.h"
+#include "boot_trace.h"
+#include "main_events.h"
+#if LATENCY_TRACE == true
+#include "latency.h"
+#endif  //#if LATENCY_TRACE == true
+#if BENCH_KERNELS == true
+#include "bench.h"
+#endif  //#if BENCH_KERNELS == true
+#if PS2_TRACE == true
+#include "ps2_trace.h"
+#endif  //#if PS2_TRACE == true
+#if DB_REMAP == true
+#include "remap.h"
+#endif  //#if DB_REMAP == true
+#if MACROS == true
+#include "macro.h"
+#endif  //#if MACROS == true
+#if USB_TELEMETRY == true
+#include "telemetry.h"
+#endif  //#if USB_TELEMETRY == true
+#if USE_USB == true
+#include "cdcacm.h"
+#endif  //#if USE_USB == true
+
+
+struct console_cmd
+{
+  const char *name;
+  console_cmd_handler handler;
+  const char *help;
+};
+
+
+//Local prototypes
+void console_help(uint8_t *args);
+void console_run_line(uint8_t *line);
+
+
+//Commands table. Keep help as the first one.
+const struct console_cmd console_cmds[] =
+{
+  {"help",  console_help,         "- This list"},
+  {"boot",  boot_trace_console_cmd, "- Boot timeline (us)"},
+  {"idle",  main_events_console_cmd, "[reset] - Main loop sleep ratio and wake ups"},
+#if LATENCY_TRACE == true
+  {"lat",   latency_console_cmd,  "[reset|dump] - Key latency per stage (us)"},
+#endif  //#if LATENCY_TRACE == true
+#if BENCH_KERNELS == true
+  {"bench", bench_console_cmd,    "[calls] - Hot path cycles per call (CSV). MSX sees Left Control toggling"},
+#endif  //#if BENCH_KERNELS == true
+#if PS2_TRACE == true
+  {"ps2rec", ps2_trace_console_cmd, "[start|stop|dump|play [speed]] - PS/2 byte stream record/replay"},
+#endif  //#if PS2_TRACE == true
+#if DB_REMAP == true
+  {"remap", remap_console_cmd,    "[code : case keys|del code|clear|save|load] - Database lines remapped on RAM"},
+#endif  //#if DB_REMAP == true
+#if MACROS == true
+  {"macro", macro_console_cmd,    "[rec n [delays]|stop|play n|clear n|save|load] - MSX key macros"},
+#endif  //#if MACROS == true
+#if USE_USB == true
+  {"usbtx", cdcacm_tx_console_cmd, "[KB] - USB console throughput (KB/s)"},
+#endif  //#if USE_USB == true
+#if USB_TELEMETRY == true
+  {"telem", telemetry_console_cmd, "[on|off] - Binary records on the USB telemetry interface"},
+#endif  //#if USB_TELEMETRY == true
+};
+#define CONSOLE_NUM_CMDS          (sizeof(console_cmds) / sizeof(console_cmds[0]))
+
+
+//Global vars
+uint8_t console_line[CONSOLE_LINE_SIZE];
+uint8_t console_line_len;
+
+
+void console_poll(void)
+{
+  uint8_t ch, m_str[2];
+
+  //Keep RX serial buffer empty and echoes to output
+  while(con_available_get_char())
+  {
+    ch = con_get_char();
+    if( (ch == '\r') || (ch == '\n') )
+    {
+      if(console_line_len == 0)
+        continue;
+      con_send_string((uint8_t*)"\r\n");
+      console_line[console_line_len] = 0;
+      console_line_len = 0;
+      console_run_line(console_line);
+    }
+    else if( (ch == 0x7F) || (ch == '\b') )  //Backspace
+    {
+      if(console_line_len > 0)
+      {
+        // send ^H ^H to erase previous character
+        con_send_string((uint8_t*)"\b \b");
+        console_line_len--;
+      }
+    }
+    else if(ch == X_OFF)
+    {
+      //Don't send X_OFF to avoid to lock the remote terminal, if it has X_ON/X_OFF enabled
+      con_send_string((uint8_t*)"<X_OFF>");
+    }
+    else if( (ch >= ' ') && (console_line_len < (CONSOLE_LINE_SIZE - 1)) )
+    {
+      console_line[console_line_len++] = ch;
+      m_str[0] = ch;
+      m_str[1] = 0;
+      con_send_string(m_str);
+    }
+  }
+}
+
+
+uint8_t* console_next_word(uint8_t **args)
+{
+  uint8_t *word;
+
+  while(**args == ' ')
+    (*args)++;
+  word = *args;
+  while( (**args != ' ') && (**args != 0) )
+    (*args)++;
+  if(**args == ' ')
+  {
+    **args = 0;
+    (*args)++;
+  }
+  return word;
+}
+
+
+bool console_word_to_uint32(uint8_t *word, uint32_t *value)
+{
+  uint32_t result = 0;
+  uint8_t digit;
+
+  if(*word == 0)
+    return false;
+  if( (word[0] == '0') && ((word[1] | 0x20) == 'x') && (word[2] != 0) )
+  {
+    for(word += 2; *word != 0; word++)
+    {
+      if( (*word >= '0') && (*word <= '9') )
+        digit = *word - '0';
+      else if( ((*word | 0x20) >= 'a') && ((*word | 0x20) <= 'f') )
+        digit = (*word | 0x20) - 'a' + 10;
+      else
+        return false;
+      result = (result << 4) | digit;
+    }
+  }
+  else
+  {
+    for(; *word != 0; word++)
+    {
+      if( (*word < '0') || (*word > '9') )
+        return false;
+      result = result * 10 + (*word - '0');
+    }
+  }
+  *value = result;
+  return true;
+}
+
+
+void console_run_line(uint8_t *line)
+{
+  uint8_t *args = line;
+  uint8_t *word = console_next_word(&args);
+
+  for(uint8_t i = 0; i < CONSOLE_NUM_CMDS; i++)
+  {
+    if(strcmp((const char*)word, console_cmds[i].name) == 0)
+    {
+      console_cmds[i].handler(args);
+      return;
+    }
+  }
+  con_send_string((uint8_t*)"Unknown command. Type help.\r\n");
+}
+
+
+void console_help(uint8_t *args)
+{
+  (void)args;
+  for(uint8_t i = 0; i < CONSOLE_NUM_CMDS; i++)
+  {
+    con_send_string((uint8_t*)console_cmds[i].name);
+    con_send_string((uint8_t*)" ");
+    con_send_string((uint8_t*)console_cmds[i].help);
+    con_send_string((uint8_t*)"\r\n");
+  }
+}
@@ -0,0 +1,99 @@
+/** @defgroup 10 console Console Command Line
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file console.h Non blocking console command line interpreter.
+ *
+ * @brief <b>Non blocking console command line interpreter. Header file of console.c.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * This library collects the chars received on the console (UART or USB), echoes them and,
+ * when a line is completed, runs the matching diagnostic command, on the STM32F4 and STM32F1
+ * series of ARM Cortex Microcontrollers by ST Microelectronics.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined CONSOLE_H
+#define CONSOLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "system.h"
+#include "serial.h"
+
+
+#define CONSOLE_LINE_SIZE         64          //Max size of a command line, including the ending 0
+
+
+/**
+ * @brief Command handler. args points to the rest of the line, after the command word (ASCIIZ).
+ */
+typedef void (*console_cmd_handler)(uint8_t *args);
+
+/**
+ * @brief Polls the console RX: echoes the received chars and runs the command when a line is completed.
+ *
+ * To be called from main loop. It never blocks.
+ */
+void console_poll(void);
+
+/**
+ * @brief Gets the next word of a command line.
+ *
+ * Spaces before the word are skipped, and the word is closed with 0 (ASCIIZ) in place.
+ * @param args Pointer to the line pointer. It is advanced to after the word.
+ * @return uint8_t* The word, or an empty string if there is no more words.
+ */
+uint8_t* console_next_word(uint8_t **args);
+
+/**
+ * @brief Converts a word into a number. Accepts decimal or hexadecimal with the 0x prefix.
+ *
+ * @param word ASCIIZ word.
+ * @param value Where the number is put on.
+ * @return true if the word is a valid number.
+ */
+bool console_word_to_uint32(uint8_t *word, uint32_t *value);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined CONSOLE_H
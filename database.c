@@ -52,7 +52,7 @@ const uint8_t
 __attribute__((section("MSXDATABASE"))) 
 #endif  //#if MCU == STM32F103
 DEFAULT_MSX_KEYB_DATABASE_CONVERSION[(uint16_t)N_DATABASE_REGISTERS][(uint8_t)DB_NUM_COLS] =
-//Paste here the generated excel Conversion Database to make it as a default.
+//Generated by host/db-compiler from default.layout: edit the layout, not this file.
 {
     {1, 0, 255, 255, 255, 255, 255, 255},
     {1, 0, 0, 244, 144, 6, 255, 255},
@@ -239,6 +239,16 @@ DEFAULT_MSX_KEYB_DATABASE_CONVERSION[(uint16_t)N_DATABASE_REGISTERS][(uint8_t)DB
     {240, 123, 0, 244, 61, 255, 255, 255},
     {240, 124, 0, 244, 58, 152, 255, 255},
     {240, 125, 0, 253, 57, 144, 255, 255},
+    {255, 88, 3, 5, 7, 5, 255, 255},
+    {255, 3, 1, 0, 20, 17, 113, 0},
+    {255, 1, 2, 0, 119, 0, 0, 0},
+    {255, 1, 4, 116, 126, 0, 0, 1},
+    {255, 33, 5, 1, 126, 0, 0, 0},
+    {255, 49, 6, 1, 126, 0, 0, 0},
+    {255, 88, 4, 4, 4, 3, 255, 255},
+    {255, 0, 76, 102, 255, 0, 82, 116},
+    {255, 255, 0, 65, 66, 255, 0, 73},
+    {255, 64, 255, 255, 255, 255, 255, 255},
     {255, 255, 255, 255, 255, 255, 255, 255},
     {255, 255, 255, 255, 255, 255, 255, 255},
     {255, 255, 255, 255, 255, 255, 255, 255},
@@ -363,15 +373,5 @@ DEFAULT_MSX_KEYB_DATABASE_CONVERSION[(uint16_t)N_DATABASE_REGISTERS][(uint8_t)DB
     {255, 255, 255, 255, 255, 255, 255, 255},
     {255, 255, 255, 255, 255, 255, 255, 255},
     {255, 255, 255, 255, 255, 255, 255, 255},
-    {255, 255, 255, 255, 255, 255, 255, 255},
-    {255, 255, 255, 255, 255, 255, 255, 255},
-    {255, 255, 255, 255, 255, 255, 255, 255},
-    {255, 255, 255, 255, 255, 255, 255, 255},
-    {255, 255, 255, 255, 255, 255, 255, 255},
-    {255, 255, 255, 255, 255, 255, 255, 255},
-    {255, 255, 255, 255, 255, 255, 255, 255},
-    {255, 255, 255, 255, 255, 255, 255, 255},
-    {255, 255, 255, 255, 255, 255, 255, 255},
-    {255, 255, 255, 255, 255, 255, 255, 255},
-    {255, 255, 255, 255, 255, 255, 1, 117}
+    {255, 255, 255, 255, 255, 255, 228, 126}
 };
@@ -86,19 +86,14 @@ bool check_page_erased(uint32_t, bool*, uint16_t*);
 
 
 
-void database_setup(void)
+bool database_reset_request(void)
 {
   uint8_t ch, str_mount[STRING_MOUNT_BUFFER_SIZE];
   uint32_t iter;
-  volatile uint32_t*base_of_database32;
-  volatile uint8_t*base_of_database8;
   void *void_ptr;
   bool sector_erased = true;
   uint16_t attempts_erasing_page;
 
-  compatible_database = true;
-  flash_locked = true;
-  
   //Any character received via serial during the time of waiting PS/2 BAT enables Cleanup Database Flash
   if (con_available_get_char())
   {
@@ -161,8 +156,24 @@ void database_setup(void)
           con_send_string((uint8_t*)"\r\n");
         } //while (attempts_erasing_page < MAX_ERASE_TRIES) //3 tries
       } //for(uint16_t sect_num = DATABASE_BASE_PAGE; sect_num < (DATABASE_TOP_PAGE+1); sect_num++)
+      flash_lock();
+      flash_locked = true;
+      return true;
     } //if(ch == '&')
   } //if (!con_available_get_char())
+  return false;
+}
+
+
+void database_setup(void)
+{
+  uint32_t iter;
+  volatile uint32_t*base_of_database32;
+  volatile uint8_t*base_of_database8;
+
+  compatible_database = true;
+  flash_locked = true;
+  
 
   // if INITIAL_DATABASE is unprogrammed
   bool empty_database = true;
@@ -488,7 +499,7 @@ uint32_t flash_program_data(uint8_t *flash_buffer_ram)
     uint32_t iter_div4 = iter / sizeof(uint32_t);// Pointer of uint32_t has a step of 4 bytes
     if( *(base_of_database + iter_div4) != *((uint32_t*)(flash_buffer_ram + iter)) )
     {
-      if(*(base_of_database + iter) == 0xFFFFFFFF)
+      if(*(base_of_database + iter_div4) == 0xFFFFFFFF)
       {
         con_send_string((uint8_t*)"(RAM buffer address = 0x");
         conv_uint32_to_8a_hex((uintptr_t)(flash_buffer_ram + iter), void_ptr);
@@ -595,69 +606,78 @@ extern bool ps2_keyb_detected;                    //Declared on ps2handl.c
 extern uint32_t systicks;                         //Declared on sys_timer.cpp
 
 
-void database_setup(void)
+bool database_reset_request(void)
 {
   uint8_t           ch, str_mount[STRING_MOUNT_BUFFER_SIZE];
-  uint32_t          iter;
-  volatile uint32_t *base_of_database32;
-  volatile uint8_t  *base_of_database8;
-  void              *void_ptr;
   uint16_t          attempts_erasing_sector;
   bool              sector_erased = true;
-  
-  void_ptr = &str_mount;
 
-  if (!ps2_keyb_detected) // The user request to force init Database is done only if there is no keyboard
+  if (ps2_keyb_detected) // The user request to force init Database is done only if there is no keyboard
+    return false;
+  //The user wants to reset Database to system's defaults
+  //Firstly verify if some character was sent to USART or USER_KEY was pressed during BAT waiting
+  if ( con_available_get_char() || (!gpio_get(USER_KEY_PORT, USER_KEY_PIN)) )
   {
-    //The user wants to reset Database to system's defaults
-    //Firstly verify if some character was sent to USART or USER_KEY was pressed during BAT waiting
-    if ( con_available_get_char() || (!gpio_get(USER_KEY_PORT, USER_KEY_PIN)) )
+    //Cleanup RX serial buffer
+    while (con_available_get_char())
+      ch = con_get_char();
+    if (!gpio_get(USER_KEY_PORT, USER_KEY_PIN)) //USER_KEY is exclusive of WeAct board
     {
-      //Cleanup RX serial buffer
-      while (con_available_get_char())
-        ch = con_get_char();
-      if (!gpio_get(USER_KEY_PORT, USER_KEY_PIN)) //USER_KEY is exclusive of WeAct board
-      {
-        con_send_string((uint8_t*)"\r\n\nOk. Now release user key...");
-        while (!gpio_get(USER_KEY_PORT, USER_KEY_PIN))  //But stay here until the button is released
-          __asm("NOP");
-      }
-      con_send_string((uint8_t*)"\r\nReset Database to factory default. Press ""&"" to proceed or any other key to abort\r\n");
-      //Wait for user action
-      uint32_t lastsysticks = systicks;
-      bool print_message = true;
-      while (!con_available_get_char())
+      con_send_string((uint8_t*)"\r\n\nOk. Now release user key...");
+      while (!gpio_get(USER_KEY_PORT, USER_KEY_PIN))  //But stay here until the button is released
+        __asm("NOP");
+    }
+    con_send_string((uint8_t*)"\r\nReset Database to factory default. Press ""&"" to proceed or any other key to abort\r\n");
+    //Wait for user action
+    uint32_t lastsysticks = systicks;
+    bool print_message = true;
+    while (!con_available_get_char())
+    {
+      if( ((systicks - lastsysticks) % FREQ_INT_SYSTICK) == 0 )
       {
-        if( ((systicks - lastsysticks) % FREQ_INT_SYSTICK) == 0 )
-        {
-          ch = (MAX_TIMEOUT2AMPERSAND - (systicks - lastsysticks)) / FREQ_INT_SYSTICK;
-          if(print_message && ch < (MAX_TIMEOUT2AMPERSAND / FREQ_INT_SYSTICK))
-          {
-            con_send_string((uint8_t*)"Timeout to answer: ");
-            conv_uint32_to_dec((uint32_t)ch, str_mount);
-            con_send_string(str_mount);
-            con_send_string((uint8_t*)"s \r");
-            print_message = false;
-          }
-        }
-        else
-        {
-          print_message = true;
-        }
-        //Check timeout
-        if( (systicks - lastsysticks) > MAX_TIMEOUT2AMPERSAND )
+        ch = (MAX_TIMEOUT2AMPERSAND - (systicks - lastsysticks)) / FREQ_INT_SYSTICK;
+        if(print_message && ch < (MAX_TIMEOUT2AMPERSAND / FREQ_INT_SYSTICK))
         {
-          //User messages
-          con_send_string((uint8_t*)"\r\n\nTimeout to answer: Proceeding without Reset the Database.\r\n");
-          //put a " " into console input (con_rx_ring if uart_rx_ring) to answer "no" to the next question
-          insert_in_con_rx(' ');
+          con_send_string((uint8_t*)"Timeout to answer: ");
+          conv_uint32_to_dec((uint32_t)ch, str_mount);
+          con_send_string(str_mount);
+          con_send_string((uint8_t*)"s \r");
+          print_message = false;
         }
       }
-      ch = con_get_char();
-      if(ch == '&')
-        cleanupFlash(&sector_erased, &attempts_erasing_sector);
-    } //if ( con_available_get_char() || (!gpio_get(USER_KEY_PORT, USER_KEY_PIN)) )
-  } //if (!ps2_keyb_detected) // The user request to force init Database is done only if there is no keyboard
+      else
+      {
+        print_message = true;
+      }
+      //Check timeout
+      if( (systicks - lastsysticks) > MAX_TIMEOUT2AMPERSAND )
+      {
+        //User messages
+        con_send_string((uint8_t*)"\r\n\nTimeout to answer: Proceeding without Reset the Database.\r\n");
+        //put a " " into console input (con_rx_ring if uart_rx_ring) to answer "no" to the next question
+        insert_in_con_rx(' ');
+      }
+    }
+    ch = con_get_char();
+    if(ch == '&')
+    {
+      cleanupFlash(&sector_erased, &attempts_erasing_sector);
+      return true;
+    }
+  } //if ( con_available_get_char() || (!gpio_get(USER_KEY_PORT, USER_KEY_PIN)) )
+  return false;
+}
+
+
+void database_setup(void)
+{
+  uint8_t           str_mount[STRING_MOUNT_BUFFER_SIZE];
+  uint32_t          iter;
+  volatile uint32_t *base_of_database32;
+  volatile uint8_t  *base_of_database8;
+  void              *void_ptr;
+  
+  void_ptr = &str_mount;
 
   // if (INITIAL_DATABASE is unprogrammed)
   bool empty_database = true;
@@ -721,7 +741,7 @@ void database_setup(void)
     checksum += *(base_of_database8 + iter);
     bcc ^= *(base_of_database8 + iter);
   } //for (iter = 0; iter < (DATABASE_SIZE - DB_NUM_COLS); iter ++)
-  if( ((*(base_of_database8 + (DATABASE_SIZE - 1)) + checksum) != 0)  ||
+  if( ((uint8_t)(*(base_of_database8 + (DATABASE_SIZE - 1)) + checksum) != 0)  ||
       ((*(base_of_database8 + (DATABASE_SIZE - 2)))            != bcc)||
        (*(base_of_database8 + 0)                               != 1)  ||
        (*(base_of_database8 + 1)                               != 0)  )
@@ -979,7 +999,7 @@ uint32_t flash_program_data(uint8_t *flash_buffer_ram)  //Local flash_buffer_ram
     uint32_t iter_div4 = iter / sizeof(uint32_t);// Pointer of uint32_t has a step of 4 bytes
     if( *(base_of_database + iter_div4) != *((uint32_t*)(flash_buffer_ram + iter)) )
     {
-      if(*(base_of_database + iter) == 0xFFFFFFFF)
+      if(*(base_of_database + iter_div4) == 0xFFFFFFFF)
       {
         con_send_string((uint8_t*)"\r\n(RAM buffer address = 0x");
         conv_uint32_to_8a_hex((uintptr_t)(flash_buffer_ram + iter), void_ptr);
@@ -1105,4 +1125,47 @@ int flash_rw(void)  //was main. It is int to allow simulate as a single module
   return result;
 } //int flashF4_rw(void)  //was main. It is int to allow simulate as a single module
 
+
+//The records are only appended, with no erase: the log is erased with the whole sector, when a Database
+//update finds no free image place. A record cut by a power off fails its checksum, and the scan skips it
+//by the size on its header line.
+uint32_t flash_log_scan(const flash_log_t *log, void (*found)(const uint8_t *record, void *ctx), void *ctx)
+{
+  const uint8_t *record = (const uint8_t*)log->base;
+  const uint8_t *top = (const uint8_t*)(log->base + log->size);
+  uint32_t size;
+  bool valid;
+
+  while( ((uint32_t)(top - record) >= DB_NUM_COLS) && (record[0] == log->tag0) && (record[1] == log->tag1) )
+  {
+    size = log->check(record, &valid);
+    if( !size || ((uint32_t)(top - record) < size) )
+      break;
+    if(valid && found)
+      found(record, ctx);
+    record += size;
+  }
+  return (uint32_t)record;
+}
+
+
+uint8_t flash_log_append(const flash_log_t *log, const uint8_t *header, const uint8_t *body, uint32_t len)
+{
+  uint32_t end, size;
+  bool valid = false;
+
+  end = flash_log_scan(log, NULL, NULL);
+  size = DB_NUM_COLS + ((len + DB_NUM_COLS - 1) & ~(uint32_t)(DB_NUM_COLS - 1));
+  if(end + size > log->base + log->size)
+    return FLASH_LOG_FULL;
+  flash_unlock();
+  flash_program(end, header, DB_NUM_COLS);
+  if(len)
+    flash_program(end + DB_NUM_COLS, body, len);
+  flash_lock();
+  if( (flash_log_scan(log, NULL, NULL) != end + size) || (log->check((const uint8_t*)end, &valid) != size) || !valid )
+    return FLASH_LOG_WRITE_ERROR;
+  return FLASH_LOG_OK;
+}
+
 #endif  //#if MCU == STM32F401
@@ -82,6 +82,52 @@ int flash_rw(void);
  */
 void database_setup(void);
 
+/**
+ * @brief Offers to reset the Database flash to factory default, if the user asked it during PS/2 BAT waiting
+ * (USER_KEY held or a character on console; on STM32F401 only when no keyboard was detected).
+ * To be called once the boot detection of the keyboard is finished, as it waits the user answer.
+ *
+ * @return true if the flash was erased, so database_setup() must be called again.
+ */
+bool database_reset_request(void);
+
+#if MCU == STM32F401
+#define FLASH_LOG_OK              0
+#define FLASH_LOG_FULL            1           //No room for the record: it is freed by the sector erase of a Database update
+#define FLASH_LOG_WRITE_ERROR     2
+
+//A log of tagged records on a room of flash sector 3, below the Database images
+typedef struct flash_log_t
+{
+  uint32_t base;
+  uint32_t size;
+  uint8_t tag0, tag1;                         //Bytes 0 and 1 of the header line of each record
+  //Size of the record (header line included) by its header, or 0 if it is not valid. Sets valid by its checksum
+  uint32_t (*check)(const uint8_t *record, bool *valid);
+} flash_log_t;
+
+/**
+ * @brief Scans the records of a flash log, from the oldest one.
+ *
+ * @param log The log.
+ * @param found Called with each record that has a valid checksum, may be NULL.
+ * @param ctx Passed to found.
+ * @return Address of the first free line of the log.
+ */
+uint32_t flash_log_scan(const flash_log_t *log, void (*found)(const uint8_t *record, void *ctx), void *ctx);
+
+/**
+ * @brief Appends a record to a flash log and checks it on a new scan.
+ *
+ * @param log The log.
+ * @param header Header line, with the tags and the checksum.
+ * @param body Record bytes after the header line. Its last line is padded as erased.
+ * @param len Bytes of body.
+ * @return FLASH_LOG_OK, FLASH_LOG_FULL or FLASH_LOG_WRITE_ERROR.
+ */
+uint8_t flash_log_append(const flash_log_t *log, const uint8_t *header, const uint8_t *body, uint32_t len);
+#endif  //#if MCU == STM32F401
+
 #ifdef __cplusplus
 }
 #endif
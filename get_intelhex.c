@@ -55,6 +55,7 @@
 //Processor related sizes and adress:
 #define USART_ECHO_EN             1 //All chars received in Intel Hex are echoed in serial routines
 #define STRING_MOUNT_BUFFER_SIZE  128
+#define INTEL_HEX_RECORD_OVERHEAD 11  //":llaaaatt" + "cc": characters of a record besides its data
 
 
 //Global var area:
@@ -71,19 +72,18 @@ extern uint32_t systicks;                         //Declared on sys_timer.cpp
 //Usart operations
 void usart_get_string_line(uint8_t*, uint16_t);
 //Intel Hex operations
-void usart_get_intel_hex(uint8_t*, uint16_t, uint8_t*);
+void usart_get_intel_hex(uint8_t*, uint16_t, uint8_t*, uint16_t);
 bool validate_intel_hex_record(uint8_t*, uint8_t*, uint8_t*, uint16_t*, uint8_t*);
 
 
 void get_intelhex_to_RAM(uint8_t *ram_buffer, uint16_t ram_buffer_max_size)
 {
-  (void) ram_buffer_max_size;
   uint8_t str_mount[STRING_MOUNT_BUFFER_SIZE];
   error_intel_hex = true;
   abort_intelhex_reception = false;
   while (error_intel_hex == true)
   {
-    usart_get_intel_hex(str_mount, STRING_MOUNT_BUFFER_SIZE, ram_buffer);
+    usart_get_intel_hex(str_mount, STRING_MOUNT_BUFFER_SIZE, ram_buffer, ram_buffer_max_size);
     if (error_intel_hex == true)
     {
       con_send_string((uint8_t*)"\r\n\n\n\nERROR in Intel Hex. ERROR\r\n\nPlease resend the Intel Hex...");
@@ -91,6 +91,9 @@ void get_intelhex_to_RAM(uint8_t *ram_buffer, uint16_t ram_buffer_max_size)
     else if (abort_intelhex_reception)
     {
       con_send_string((uint8_t*)"\r\n\n\n\n!!!!!INTERRUPTED!!!!!\r\n\nPlease resend the Intel Hex...");
+      //The interrupted file must not be programmed: restart the reception
+      abort_intelhex_reception = false;
+      error_intel_hex = true;
     }
     else
       return;
@@ -100,7 +103,7 @@ void get_intelhex_to_RAM(uint8_t *ram_buffer, uint16_t ram_buffer_max_size)
 
 
 void usart_get_string_line(uint8_t *ser_inp_line, uint16_t str_max_size)
-{ //Reads until CR and returns an ASCIIZ on *ser_inp_line
+{ //Reads until CR and returns an ASCIIZ on *ser_inp_line (a line longer than str_max_size - 1 is truncated)
   uint8_t   sign = 0;
   uint16_t  iter = 0;
   uint32_t  lastsysticks;
@@ -110,7 +113,7 @@ void usart_get_string_line(uint8_t *ser_inp_line, uint16_t str_max_size)
   lastsysticks = systicks;
   print_message = true;
 redohere:
-  while(iter < str_max_size)
+  while(iter < (str_max_size - 1))  //Last position is kept to close the ASCIIZ
   {
     //wait until next char is available
     while (!con_available_get_char())
@@ -138,6 +141,8 @@ redohere:
         con_send_string((uint8_t*)"\r\n\nTimeout to start to receive Intel Hex is reached=>\r\n- Reset requested by the system.\r\n");
         reset_requested();
       }
+      //Any interrupt (SysTick or reception) ends this sleep, so both conditions above are checked in time
+      __asm("wfi");
     }
     lastsysticks = systicks;
     sign = con_get_char();
@@ -183,13 +188,14 @@ redohere:
         goto redohere;
       }
     }
-  } //while(iter < str_max_size)
+  } //while(iter < (str_max_size - 1))
+  ser_inp_line[str_max_size - 1] = 0; //A truncated line is closed here too, to be refused by validate_intel_hex_record
   // Indicates that we received new line data, and it is going to be shiftingalidated.
   gpio_toggle(EMBEDDED_LED_PORT, EMBEDDED_LED_PIN); //Toggle LED each received line
 }
 
 
-void usart_get_intel_hex(uint8_t *ser_inp_line, uint16_t str_max_size, uint8_t *ram_buffer)
+void usart_get_intel_hex(uint8_t *ser_inp_line, uint16_t str_max_size, uint8_t *ram_buffer, uint16_t ram_buffer_max_size)
 {
   uint8_t intel_hex_localreg_data[STRING_MOUNT_BUFFER_SIZE / 2], intel_hex_numofdatabytes, intel_hex_type;
   uint16_t i, count_rx_intelhex_bytes, count_IHdata_record, intel_hex_address, first_data_address_intel_hex;
@@ -207,7 +213,7 @@ void usart_get_intel_hex(uint8_t *ser_inp_line, uint16_t str_max_size, uint8_t *
   seek_first_intel_hex_address_for_data = true;
 
   //Init RAM Buffer
-  for(i=0 ; i < (DATABASE_SIZE) ; i++)
+  for(i=0 ; i < ram_buffer_max_size ; i++)
   {
     ram_buffer[i] = (uint8_t)0xFF;
   }
@@ -239,9 +245,16 @@ void usart_get_intel_hex(uint8_t *ser_inp_line, uint16_t str_max_size, uint8_t *
               seek_first_intel_hex_address_for_data = false;
             }
             //Now fill in RAM Buffer with data record
+            shifting = ((uint16_t)intel_hex_address - (uint16_t)first_data_address_intel_hex);
+            //An address below the first one wraps around to a big shifting, so it is refused here too
+            if (((uint32_t)shifting + intel_hex_numofdatabytes) > ram_buffer_max_size)
+            {
+              con_send_string((uint8_t*)" Error: Out of Database range");
+              error_intel_hex = true;
+              break;
+            }
             for (i = 0; i < intel_hex_numofdatabytes; i++)
             {
-              shifting = ((uint16_t)intel_hex_address - (uint16_t)first_data_address_intel_hex);
               ram_buffer[shifting + i] = intel_hex_localreg_data[i];
               count_rx_intelhex_bytes++;
             }
@@ -299,6 +312,8 @@ void usart_get_intel_hex(uint8_t *ser_inp_line, uint16_t str_max_size, uint8_t *
         error_intel_hex = true;
       }
     } //if (validate_intel_hex_record(ser_inp_line, &intel_hex_numofdatabytes, &intel_hex_type, &intel_hex_address, &intel_hex_localreg_data[0]))
+    else
+      return; //Interrupted (^C): get_intelhex_to_RAM asks to resend the whole file
   } //while (intel_hex_type != 0) //Run until case 1: means end-of-file record
 }
 
@@ -322,6 +337,15 @@ bool validate_intel_hex_record(uint8_t *ser_inp_line, uint8_t *intel_hex_numofda
   //":llaaaatt[dd...]cc" ll is the record-length field that represents the number of data bytes (dd) in the record
   *intel_hex_numofdatabytes = conv_2a_hex_to_uint8(ser_inp_line, 1);
 
+  //ll is not trusted: the record must have exactly 2 * ll data characters, and they must fit on intel_hex_localreg_data
+  //(STRING_MOUNT_BUFFER_SIZE / 2 bytes). Otherwise data and checksum would be read and written out of their buffers.
+  if ((*intel_hex_numofdatabytes > ((STRING_MOUNT_BUFFER_SIZE - INTEL_HEX_RECORD_OVERHEAD) / 2)) ||
+      (strlen((char*)ser_inp_line) != (size_t)(2 * (*intel_hex_numofdatabytes) + INTEL_HEX_RECORD_OVERHEAD)))
+  {
+    error_intel_hex = true;
+    return false;
+  }
+
   //":llaaaatt[dd...]cc" aaaa is the address field that represents the starting address for subsequent data in the record
   *intel_hex_address = (conv_2a_hex_to_uint8(ser_inp_line, 3) << 8) + (conv_2a_hex_to_uint8(ser_inp_line, 5));
   
@@ -53,6 +53,7 @@ extern "C" {
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "system.h"
 #include "ps2handl.h"
@@ -0,0 +1,114 @@
+/** @addtogroup 17 bench Hot Path Microbenchmarks
+ *
+ * @file bench_host.cpp Hot path microbenchmarks of the converter, timed in nanoseconds on host.
+ *
+ * @brief <b>Hot path microbenchmarks of the converter, timed in nanoseconds on host.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Usage: bench-host [-n calls]
+ * Boots the firmware with the keyboard model, then runs the kernels of bench.cpp, as the console
+ * command "bench" does on target, but timed by CLOCK_MONOTONIC. The CSV lines go to stdout, on
+ * the target format, with unit "ns". Peripheral accesses run on the shim, so the results are
+ * only comparable between host runs.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "system.h"
+#include "host_firmware.h"
+#include "bench.h"
+
+#define BENCH_HOST_MAX_CALLS      (1 << 24)
+
+//Prototype area
+static void console_discard(const uint8_t *data, uint16_t len);
+static uint32_t clock_ns(void);
+
+
+int main(int argc, char *argv[])
+{
+  void (*console_stdout)(const uint8_t *data, uint16_t len) = host_uart_tx_hook;
+  struct bench_result results[BENCH_NUM_KERNELS];
+  uint32_t calls = 65536;
+  int i;
+
+  for(i = 1; i < argc; i++)
+  {
+    if(i + 1 >= argc)
+      break;
+    else if(!strcmp(argv[i], "-n"))
+      calls = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else
+      break;
+  }
+  if( (i < argc) || !calls || (calls > BENCH_HOST_MAX_CALLS) )
+  {
+    fprintf(stderr, "Usage: %s [-n calls]\n"
+                    "Calls per kernel, up to %u (con_send_string is limited to %u).\n",
+                    argv[0], BENCH_HOST_MAX_CALLS, (unsigned)BENCH_CON_MAX_CALLS);
+    return EXIT_FAILURE;
+  }
+
+  host_uart_tx_hook = console_discard;
+  if(!host_firmware_boot())
+  {
+    fprintf(stderr, "bench-host: keyboard not detected\n");
+    return EXIT_FAILURE;
+  }
+  bench_run(calls, clock_ns, results);
+  host_uart_tx_hook = console_stdout;
+  bench_print(results, "ns");
+  fflush(stdout);
+  return EXIT_SUCCESS;
+}
+
+
+static void console_discard(const uint8_t *data, uint16_t len)
+{
+  (void)data;
+  (void)len;
+}
+
+
+//Wraps every 4.3s, as DWT_CYCCNT does: only differences are used
+static uint32_t clock_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
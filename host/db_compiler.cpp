@@ -0,0 +1,1480 @@
+/** @addtogroup 05 dbasemgt Database Management
+ *
+ * @file db_compiler.cpp Command line Database compiler: text layouts to database.c and Intel Hex.
+ *
+ * @brief <b>Command line Database compiler: text layouts to database.c and Intel Hex.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Usage: db-compiler [-c file.c] [-x file.hex] [-o dir] [-k] [-m] [-w bytes] [-a address] [-v] layout...
+ *        db-compiler -d file.hex [-l file.layout]
+ * - -c / -x: database.c (DEFAULT_MSX_KEYB_DATABASE_CONVERSION) / Intel Hex of one layout;
+ * - -o dir: both of them for each layout, as dir/name.c and dir/name.hex;
+ * - -k / -m: adds the lookup index / the char map extension lines (see DB_EXT_xxx on system.h);
+ * - -w: data bytes per Intel Hex record (16, up to 58 as get_intelhex.c accepts);
+ * - -a: Intel Hex address of the Database (INITIAL_DATABASE);
+ * - -d: decompiles an Intel Hex Database (as the Excel workbook sends) into a layout, to stdout or -l.
+ * A layout is a text file; # starts a comment. Header directives: "version 1.0", "y_dummy 15",
+ * "numlock on|off", "xon_xoff on|off", or "header" and the 8 bytes of line 0 in hex. Then one
+ * line per PS/2 scan code, on ascending order (the order convert2msx() searches them):
+ *   F0 1C : 1s Y2X6r -- Y4X6r
+ * Scan code bytes in hex, then the control byte: case type 0, 1 or 2 plus "s" for combined shift
+ * and "a" with the autofire period (autofire.c) if any, as "0a2" (or $hh raw), then up to 4 MSX
+ * keys (columns 4 to 7): YyXx, with "r" for release, or "--".
+ * After a "[chars]" line, each line gives the MSX key typing a char: "A Y2X6 shift", where the
+ * char is itself or 0xhh (space and # must be written as 0x20 and 0x23), and the modifiers are
+ * shift, ctrl, graph and code. After a "[chords]" line, each line gives a chord of the firmware
+ * (chord.c), always written as DB_EXT_CHORDS extension lines: the kind (chord, sequence, tap or
+ * hold), up to 3 make codes (E0 prefixes the next byte), ":" and the action: reset, numlock,
+ * layout, key and a MSX key, macro and a slot (macro.c), or record, a slot and "delays" if kept:
+ *   chord 14 E0 7E : key Y7X4
+ * After a "[layers]" line, each line overrides a key while a LED is lit (layer.c): the LED (ruslat
+ * or kana), the make code (E0 prefixes it), ":" and 1 or 2 MSX keys pressed on its make and
+ * released on its break. The lines are written as DB_EXT_LAYERS extension lines, even if none, so
+ * an empty "[layers]" section turns the built-in RUS/LAT overrides off:
+ *   ruslat 4C : Y6X6
+ * Errors are reported as file:line: message, and exit status is 1.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "system.h"
+
+#define DB_MAX_KEY_LINES          (N_DATABASE_REGISTERS - 2)  //Lines 1 to 318: line 0 is the header, 319 the integrity
+#define DB_CONTROL_FIXED          0xF4      //Reserved bits of the control byte, kept at high state
+#define DB_CONTROL_SHIFT          0x08      //Combined shift
+#define DB_CONTROL_CASE           0x03
+#define DB_CONTROL_PERIOD         0xF0      //Autofire period, or 0xF
+#define DB_CONTROL_PERIOD_SHIFT   4
+#define MAX_AUTOFIRE_PERIOD       14        //AUTOFIRE_MAX_PERIOD of autofire.h
+#define DB_KEY_NONE               0xFF
+#define DB_KEY_RELEASE            0x08
+#define DB_HEADER_FIXED           0xC0      //Reserved bits of line 0 byte 3
+#define DB_HEADER_NUMLOCK         0x10
+#define DB_HEADER_XON_XOFF        0x20
+#define DB_HEADER_Y_DUMMY         0x0F
+#define MAX_TEXT_LINE             512
+#define MAX_CHARS                 255
+#define MAX_CHORDS                16        //CHORD_SLOTS of chord.h
+#define MAX_MACRO_SLOT            4         //MACRO_SLOTS of macro.h
+#define CHORD_REC_DELAYS          0x80      //MACRO_REC_DELAYS of macro.h
+#define CHORD_RECORD_SIZE         DB_EXT_PAYLOAD_COLS
+#define MAX_LAYER_KEYS            16        //LAYER_SLOTS of layer.h
+#define LAYER_RECORD_SIZE         4
+#define LAYER_MSX_KEYS            2
+#define MAX_HEX_RECORD            58        //(128 - 11) / 2: longest record accepted by get_intelhex.c
+#define PS2_BREAK_PREFIX          0xF0
+#define PS2_EXTENDED_PREFIX       0xE0
+#define PS2_PAUSE_PREFIX          0xE1
+#define PS2_FAKE_SHIFT            0x12      //E0 12 and E0 F0 12 are discarded by mount_scancode()
+
+struct layout_key
+{
+  uint8_t code[3];                                //Columns 0 to 2, zero padded
+  uint8_t code_len;
+  uint8_t control;
+  uint8_t keys[4];
+  uint32_t src_line;
+};
+
+struct layout_char
+{
+  uint8_t ch, key, modifiers;
+  uint32_t src_line;
+};
+
+struct layout_chord
+{
+  uint8_t kind, n_keys;
+  uint8_t code[DB_CHORD_MAX_KEYS];
+  uint8_t e0_mask;                                //Bit n: key n is E0 prefixed
+  uint8_t action, arg;
+  uint32_t src_line;
+};
+
+struct layout_layer_key
+{
+  uint8_t source;                                 //DB_LAYER_xxx
+  uint8_t code;
+  bool e0;
+  uint8_t keys[LAYER_MSX_KEYS];
+  uint32_t src_line;
+};
+
+enum LAYOUT_SECTION
+{
+  SECTION_KEYS,
+  SECTION_CHARS,
+  SECTION_CHORDS,
+  SECTION_LAYERS,
+};
+
+struct layout
+{
+  const char *file;
+  uint8_t header[DB_NUM_COLS];
+  struct layout_key keys[DB_MAX_KEY_LINES];
+  uint16_t keys_len;
+  struct layout_char chars[MAX_CHARS];
+  uint16_t chars_len;
+  struct layout_chord chords[MAX_CHORDS];
+  uint16_t chords_len;
+  struct layout_layer_key layer_keys[MAX_LAYER_KEYS];
+  uint16_t layer_keys_len;
+  bool with_layers;                               //A "[layers]" section was found
+};
+
+//Options
+static bool with_index, with_char_map, verbose;
+static uint8_t hex_record_len = 16;
+static uint32_t hex_address = INITIAL_DATABASE;
+
+static const char *const char_modifier_names[4] = { "shift", "ctrl", "graph", "code" };
+static const char *const chord_kind_names[4] = { "chord", "sequence", "tap", "hold" };
+static const char *const chord_action_names[7] = { "", "reset", "numlock", "layout", "key", "macro", "record" };
+static const char *const layer_source_names[DB_LAYER_SOURCES] = { "ruslat", "kana" };
+
+static const char *const c_file_head[] =
+{
+  "/** @addtogroup 05 dbasemgt Database Management",
+  " *",
+  " * @file %s Database definition file input.",
+  " *",
+  " * @brief <b>Database definition, check and maintenance routines.</b>",
+  " *",
+  " * @version 1.0.0",
+  " *",
+  " * @author @htmlonly &copy; @endhtmlonly 2022",
+  " * Evandro Souza <evandro.r.souza@gmail.com>",
+  " *",
+  " * @date 25 September 2022",
+  " *",
+  " * This library executes functions to interface and control a PS/2 keyboard, like:",
+  " * power control of a PS/2 key, general interface to read events and write commands to PS/2",
+  " * keyboard, including interrupt service routines on the STM32F4 and STM32F1 series of ARM",
+  " * Cortex Microcontrollers by ST Microelectronics.",
+  " *",
+  " * LGPL License Terms ref lgpl_license",
+  " */",
+  "",
+  "/*",
+  " * This file is part of the PS/2 to MSX Keyboard converter enviroment:",
+  " * PS/2 to MSX keyboard Converter and MSX Keyboard Subsystem Emulator",
+  " * designs, based on libopencm3 project.",
+  " *",
+  " * Copyright (C) 2022 Evandro Souza <evandro.r.souza@gmail.com>",
+  " *",
+  " * This original SW is compiled to a Sharp/Epcom MSX HB-8000 and a brazilian ABNT2 PS/2 keyboard (ID=275)",
+  " * But it is possible to update the table sending a Intel Hex File through serial or USB",
+  " *",
+  " * This library is free software: you can redistribute it and/or modify",
+  " * it under the terms of the GNU Lesser General Public License as published by",
+  " * the Free Software Foundation, either version 3 of the License, or",
+  " * (at your option) any later version.",
+  " *",
+  " * This library is distributed in the hope that it will be useful,",
+  " * but WITHOUT ANY WARRANTY; without even the implied warranty of",
+  " * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the",
+  " * GNU Lesser General Public License for more details.",
+  " *",
+  " * You should have received a copy of the GNU Lesser General Public License",
+  " * along with this library.  If not, see <http://www.gnu.org/licenses/>.",
+  " */",
+  "",
+  "//Use Tab width=2",
+  "",
+  "",
+  "#include \"system.h\"",
+  "const uint8_t ",
+  "#if MCU == STM32F103",
+  "__attribute__((section(\"MSXDATABASE\"))) ",
+  "#endif  //#if MCU == STM32F103",
+  "DEFAULT_MSX_KEYB_DATABASE_CONVERSION[(uint16_t)N_DATABASE_REGISTERS][(uint8_t)DB_NUM_COLS] =",
+  "//Generated by host/db-compiler from %s: edit the layout, not this file.",
+};
+
+//Prototype area
+static const char *base_name(const char *path);
+static void layout_error(const struct layout *lay, uint32_t src_line, const char *message, const char *token);
+static bool parse_hex_byte(const char *token, uint8_t *value);
+static bool parse_key(const char *token, uint8_t *key);
+static bool parse_control(const char *token, uint8_t *control);
+static bool parse_char(const char *token, uint8_t *ch);
+static bool parse_header_line(struct layout *lay, char **tokens, int n, uint32_t src_line);
+static bool parse_key_line(struct layout *lay, char **tokens, int n, int colon, uint32_t src_line);
+static bool parse_char_line(struct layout *lay, char **tokens, int n, uint32_t src_line);
+static bool parse_chord_line(struct layout *lay, char **tokens, int n, int colon, uint32_t src_line);
+static bool parse_layer_line(struct layout *lay, char **tokens, int n, int colon, uint32_t src_line);
+static bool layout_read(struct layout *lay, const char *file);
+static bool scan_code_shape_ok(const struct layout_key *key, const char **why);
+static bool layout_validate(const struct layout *lay);
+static int code_compare(const uint8_t *a, const uint8_t *b);
+static uint16_t ext_lines(uint16_t records, uint8_t record_size);
+static void ext_put(uint8_t *image, uint16_t *line, uint8_t type, uint8_t record_size, uint16_t records,
+                    const uint8_t *payload);
+static bool layout_build(const struct layout *lay, uint8_t *image);
+static void image_seal(uint8_t *image);
+static bool write_c(const char *file, const char *layout_file, const uint8_t *image);
+static bool write_hex(const char *file, const uint8_t *image);
+static void hex_record(FILE *out, uint8_t len, uint16_t address, uint8_t type, const uint8_t *data);
+static bool read_hex(const char *file, uint8_t *image);
+static void key_to_text(uint8_t key, char *text);
+static void decompile_chords(FILE *out, const uint8_t *header);
+static void decompile_layers(FILE *out, const uint8_t *header);
+static bool decompile(const char *hex_file, const char *layout_file);
+static int usage(const char *argv0);
+
+
+int main(int argc, char *argv[])
+{
+  static struct layout lay;
+  static uint8_t image[DATABASE_SIZE];
+  const char *c_file = NULL, *hex_file = NULL, *out_dir = NULL, *decompile_file = NULL, *layout_file = NULL;
+  char path[1024], name[256];
+  int i, layouts = 0, failed = 0;
+  bool ok;
+  struct timespec t0, t1;
+  double elapsed;
+
+  for(i = 1; i < argc; i++)
+  {
+    if(!strcmp(argv[i], "-k"))
+      with_index = true;
+    else if(!strcmp(argv[i], "-m"))
+      with_char_map = true;
+    else if(!strcmp(argv[i], "-v"))
+      verbose = true;
+    else if(argv[i][0] != '-')
+      break;
+    else if(i + 1 >= argc)
+      return usage(argv[0]);
+    else if(!strcmp(argv[i], "-c"))
+      c_file = argv[++i];
+    else if(!strcmp(argv[i], "-x"))
+      hex_file = argv[++i];
+    else if(!strcmp(argv[i], "-o"))
+      out_dir = argv[++i];
+    else if(!strcmp(argv[i], "-d"))
+      decompile_file = argv[++i];
+    else if(!strcmp(argv[i], "-l"))
+      layout_file = argv[++i];
+    else if(!strcmp(argv[i], "-w"))
+      hex_record_len = (uint8_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-a"))
+      hex_address = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else
+      return usage(argv[0]);
+  }
+  if(decompile_file)
+  {
+    if(i < argc)
+      return usage(argv[0]);
+    return decompile(decompile_file, layout_file) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if( (i >= argc) || !hex_record_len || (hex_record_len > MAX_HEX_RECORD) ||
+      ((c_file || hex_file) && (argc - i != 1)) || layout_file )
+    return usage(argv[0]);
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for(; i < argc; i++)
+  {
+    layouts++;
+    //Validates even a partially read layout, to report all errors at once
+    ok = layout_read(&lay, argv[i]);
+    ok = layout_validate(&lay) && ok;
+    if(!ok || !layout_build(&lay, image))
+    {
+      failed++;
+      continue;
+    }
+    if(c_file && !write_c(c_file, argv[i], image))
+      failed++;
+    if(hex_file && !write_hex(hex_file, image))
+      failed++;
+    if(out_dir)
+    {
+      snprintf(name, sizeof(name), "%s", base_name(argv[i]));
+      if(strrchr(name, '.'))
+        *strrchr(name, '.') = 0;
+      snprintf(path, sizeof(path), "%s/%s.c", out_dir, name);
+      if(!write_c(path, argv[i], image))
+        failed++;
+      snprintf(path, sizeof(path), "%s/%s.hex", out_dir, name);
+      if(!write_hex(path, image))
+        failed++;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  elapsed = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+  if(verbose)
+    fprintf(stderr, "db-compiler: %d layouts (%d failed) in %.3f ms, %.0f layouts/s\n",
+            layouts, failed, elapsed * 1e3, elapsed > 0 ? layouts / elapsed : 0.0);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+static int usage(const char *argv0)
+{
+  fprintf(stderr, "Usage: %s [-c file.c] [-x file.hex] [-o dir] [-k] [-m] [-w bytes] [-a address] [-v] layout...\n"
+                  "       %s -d file.hex [-l file.layout]\n"
+                  "-c and -x take one layout. -k adds the lookup index, -m the char map. -w is up to %u.\n",
+                  argv0, argv0, MAX_HEX_RECORD);
+  return EXIT_FAILURE;
+}
+
+
+static const char *base_name(const char *path)
+{
+  const char *slash = strrchr(path, '/');
+
+  return slash ? slash + 1 : path;
+}
+
+
+static void layout_error(const struct layout *lay, uint32_t src_line, const char *message, const char *token)
+{
+  if(token)
+    fprintf(stderr, "%s:%u: %s: %s\n", lay->file, src_line, message, token);
+  else
+    fprintf(stderr, "%s:%u: %s\n", lay->file, src_line, message);
+}
+
+
+/*************************************************************************************************/
+/****************************************** Parsing **********************************************/
+/*************************************************************************************************/
+static bool parse_hex_byte(const char *token, uint8_t *value)
+{
+  char *end;
+  unsigned long v;
+
+  if(!isxdigit((unsigned char)token[0]) || (strlen(token) > 2))
+    return false;
+  v = strtoul(token, &end, 16);
+  if(*end)
+    return false;
+  *value = (uint8_t)v;
+  return true;
+}
+
+
+//YyXx[r] or --
+static bool parse_key(const char *token, uint8_t *key)
+{
+  char *end;
+  unsigned long y, x;
+
+  if(!strcmp(token, "--"))
+  {
+    *key = DB_KEY_NONE;
+    return true;
+  }
+  if( (toupper((unsigned char)token[0]) != 'Y') || !isdigit((unsigned char)token[1]) )
+    return false;
+  y = strtoul(token + 1, &end, 10);
+  if( (toupper((unsigned char)*end) != 'X') || !isdigit((unsigned char)end[1]) || (y > 15) )
+    return false;
+  x = strtoul(end + 1, &end, 10);
+  if(x > 7)
+    return false;
+  *key = (uint8_t)((y << 4) | x);
+  if(tolower((unsigned char)*end) == 'r')
+  {
+    *key |= DB_KEY_RELEASE;
+    end++;
+  }
+  return *end == 0;
+}
+
+
+//0, 1, 2 with optional s (combined shift) and optional a and the autofire period, or $hh
+static bool parse_control(const char *token, uint8_t *control)
+{
+  unsigned long period;
+  char *end;
+
+  if(token[0] == '$')
+    return parse_hex_byte(token + 1, control);
+  if( (token[0] < '0') || (token[0] > '2') )
+    return false;
+  *control = DB_CONTROL_FIXED | (uint8_t)(token[0] - '0');
+  token++;
+  if(*token == 's')
+  {
+    *control |= DB_CONTROL_SHIFT;
+    token++;
+  }
+  if(*token == 'a')
+  {
+    if( (token[1] < '0') || (token[1] > '9') )
+      return false;
+    period = strtoul(token + 1, &end, 10);
+    if( *end || (period < 1) || (period > MAX_AUTOFIRE_PERIOD) )
+      return false;
+    *control = (uint8_t)((*control & ~DB_CONTROL_PERIOD) | (period << DB_CONTROL_PERIOD_SHIFT));
+    return true;
+  }
+  return *token == 0;
+}
+
+
+static bool parse_char(const char *token, uint8_t *ch)
+{
+  char *end;
+  unsigned long v;
+
+  if( (token[0] == '0') && (token[1] == 'x') && token[2] )
+  {
+    v = strtoul(token + 2, &end, 16);
+    if(*end || !v || (v > 0xFF))
+      return false;
+    *ch = (uint8_t)v;
+    return true;
+  }
+  if(!token[0] || token[1])
+    return false;
+  *ch = (uint8_t)token[0];
+  return true;
+}
+
+
+static bool parse_header_line(struct layout *lay, char **tokens, int n, uint32_t src_line)
+{
+  uint8_t v;
+  char *end;
+  unsigned long major, minor;
+
+  if(!strcmp(tokens[0], "header") && (n == 1 + DB_NUM_COLS))
+  {
+    for(int i = 0; i < DB_NUM_COLS; i++)
+      if(!parse_hex_byte(tokens[1 + i], &lay->header[i]))
+      {
+        layout_error(lay, src_line, "bad header byte", tokens[1 + i]);
+        return false;
+      }
+    return true;
+  }
+  if(n != 2)
+  {
+    layout_error(lay, src_line, "unknown directive", tokens[0]);
+    return false;
+  }
+  if(!strcmp(tokens[0], "version"))
+  {
+    major = strtoul(tokens[1], &end, 10);
+    if( (*end != '.') || !isdigit((unsigned char)end[1]) )
+    {
+      layout_error(lay, src_line, "bad version", tokens[1]);
+      return false;
+    }
+    minor = strtoul(end + 1, &end, 10);
+    if(*end || (major > 0xFF) || (minor > 0xFF))
+    {
+      layout_error(lay, src_line, "bad version", tokens[1]);
+      return false;
+    }
+    lay->header[0] = (uint8_t)major;
+    lay->header[1] = (uint8_t)minor;
+  }
+  else if(!strcmp(tokens[0], "y_dummy"))
+  {
+    v = (uint8_t)strtoul(tokens[1], &end, 10);
+    if(*end || (v > DB_HEADER_Y_DUMMY))
+    {
+      layout_error(lay, src_line, "bad y_dummy", tokens[1]);
+      return false;
+    }
+    lay->header[3] = (lay->header[3] & ~DB_HEADER_Y_DUMMY) | v;
+  }
+  else if(!strcmp(tokens[0], "numlock") || !strcmp(tokens[0], "xon_xoff"))
+  {
+    v = !strcmp(tokens[0], "numlock") ? DB_HEADER_NUMLOCK : DB_HEADER_XON_XOFF;
+    if(!strcmp(tokens[1], "on"))
+      lay->header[3] |= v;
+    else if(!strcmp(tokens[1], "off"))
+      lay->header[3] &= ~v;
+    else
+    {
+      layout_error(lay, src_line, "expected on or off", tokens[1]);
+      return false;
+    }
+  }
+  else
+  {
+    layout_error(lay, src_line, "unknown directive", tokens[0]);
+    return false;
+  }
+  return true;
+}
+
+
+static bool parse_key_line(struct layout *lay, char **tokens, int n, int colon, uint32_t src_line)
+{
+  struct layout_key *key;
+
+  if(lay->keys_len >= DB_MAX_KEY_LINES)
+  {
+    layout_error(lay, src_line, "too many scan codes", NULL);
+    return false;
+  }
+  key = &lay->keys[lay->keys_len];
+  memset(key, 0, sizeof(*key));
+  memset(key->keys, DB_KEY_NONE, sizeof(key->keys));
+  key->src_line = src_line;
+  if( (colon < 1) || (colon > 3) )
+  {
+    layout_error(lay, src_line, "expected 1 to 3 scan code bytes before :", NULL);
+    return false;
+  }
+  key->code_len = (uint8_t)colon;
+  for(int i = 0; i < colon; i++)
+    if(!parse_hex_byte(tokens[i], &key->code[i]))
+    {
+      layout_error(lay, src_line, "bad scan code byte", tokens[i]);
+      return false;
+    }
+  //The : itself is not on tokens
+  if( (n < colon + 2) || (n > colon + 1 + 4) )
+  {
+    layout_error(lay, src_line, "expected the case type and 1 to 4 MSX keys after :", NULL);
+    return false;
+  }
+  if(!parse_control(tokens[colon], &key->control))
+  {
+    layout_error(lay, src_line, "bad case type", tokens[colon]);
+    return false;
+  }
+  for(int i = colon + 1; i < n; i++)
+    if(!parse_key(tokens[i], &key->keys[i - colon - 1]))
+    {
+      layout_error(lay, src_line, "bad MSX key", tokens[i]);
+      return false;
+    }
+  lay->keys_len++;
+  return true;
+}
+
+
+static bool parse_char_line(struct layout *lay, char **tokens, int n, uint32_t src_line)
+{
+  struct layout_char *ch;
+  int m;
+
+  if(lay->chars_len >= MAX_CHARS)
+  {
+    layout_error(lay, src_line, "too many chars", NULL);
+    return false;
+  }
+  ch = &lay->chars[lay->chars_len];
+  ch->src_line = src_line;
+  ch->modifiers = 0;
+  if( (n < 2) || !parse_char(tokens[0], &ch->ch) )
+  {
+    layout_error(lay, src_line, "expected a char and its MSX key", NULL);
+    return false;
+  }
+  if(!parse_key(tokens[1], &ch->key) || (ch->key == DB_KEY_NONE) || (ch->key & DB_KEY_RELEASE))
+  {
+    layout_error(lay, src_line, "bad MSX key (a press is expected)", tokens[1]);
+    return false;
+  }
+  for(int i = 2; i < n; i++)
+  {
+    for(m = 0; m < 4; m++)
+      if(!strcmp(tokens[i], char_modifier_names[m]))
+        break;
+    if(m == 4)
+    {
+      layout_error(lay, src_line, "unknown modifier", tokens[i]);
+      return false;
+    }
+    ch->modifiers |= (uint8_t)(1 << m);
+  }
+  lay->chars_len++;
+  return true;
+}
+
+
+static bool parse_chord_line(struct layout *lay, char **tokens, int n, int colon, uint32_t src_line)
+{
+  struct layout_chord *chord;
+  uint8_t code;
+  bool e0 = false;
+  unsigned long slot;
+  char *end;
+  int i;
+
+  if(lay->chords_len >= MAX_CHORDS)
+  {
+    layout_error(lay, src_line, "too many chords", NULL);
+    return false;
+  }
+  chord = &lay->chords[lay->chords_len];
+  memset(chord, 0, sizeof(*chord));
+  chord->src_line = src_line;
+  for(i = 0; i < 4; i++)
+    if(!strcmp(tokens[0], chord_kind_names[i]))
+      break;
+  if(i == 4)
+  {
+    layout_error(lay, src_line, "expected chord, sequence, tap or hold", tokens[0]);
+    return false;
+  }
+  chord->kind = (uint8_t)i;
+  if(colon < 2)
+  {
+    layout_error(lay, src_line, "expected 1 to 3 make codes before :", NULL);
+    return false;
+  }
+  for(i = 1; i < colon; i++)
+  {
+    if(!parse_hex_byte(tokens[i], &code))
+    {
+      layout_error(lay, src_line, "bad make code byte", tokens[i]);
+      return false;
+    }
+    if( (code == PS2_EXTENDED_PREFIX) && !e0 )
+    {
+      e0 = true;
+      continue;
+    }
+    if( !code || (code == PS2_BREAK_PREFIX) || (code == PS2_EXTENDED_PREFIX) || (code == PS2_PAUSE_PREFIX) ||
+        (e0 && (code == PS2_FAKE_SHIFT)) )
+    {
+      layout_error(lay, src_line, "not the make code of a key", tokens[i]);
+      return false;
+    }
+    if(chord->n_keys >= DB_CHORD_MAX_KEYS)
+    {
+      layout_error(lay, src_line, "expected 1 to 3 make codes before :", NULL);
+      return false;
+    }
+    if(e0)
+      chord->e0_mask |= (uint8_t)(1 << chord->n_keys);
+    chord->code[chord->n_keys++] = code;
+    e0 = false;
+  }
+  if(e0 || !chord->n_keys)
+  {
+    layout_error(lay, src_line, "E0 is followed by one more byte", NULL);
+    return false;
+  }
+  for(i = DB_CHORD_ACT_RESET; i <= DB_CHORD_ACT_MACRO_REC; i++)
+    if( (colon < n) && !strcmp(tokens[colon], chord_action_names[i]) )
+      break;
+  if( (colon >= n) || (i > DB_CHORD_ACT_MACRO_REC) )
+  {
+    layout_error(lay, src_line, "expected reset, numlock, layout, key, macro or record after :",
+                 colon < n ? tokens[colon] : NULL);
+    return false;
+  }
+  chord->action = (uint8_t)i;
+  if(chord->action == DB_CHORD_ACT_MSX_KEY)
+  {
+    if( (n != colon + 2) || !parse_key(tokens[colon + 1], &chord->arg) || (chord->arg == DB_KEY_NONE) ||
+        (chord->arg & DB_KEY_RELEASE) )
+    {
+      layout_error(lay, src_line, "expected a MSX key (a press) after key", NULL);
+      return false;
+    }
+  }
+  else if( (chord->action == DB_CHORD_ACT_MACRO) || (chord->action == DB_CHORD_ACT_MACRO_REC) )
+  {
+    slot = (colon + 1 < n) ? strtoul(tokens[colon + 1], &end, 10) : 0;
+    if( (colon + 1 >= n) || *end || (slot < 1) || (slot > MAX_MACRO_SLOT) )
+    {
+      layout_error(lay, src_line, "expected a macro slot (1 to 4) after", tokens[colon]);
+      return false;
+    }
+    chord->arg = (uint8_t)slot;
+    if( (chord->action == DB_CHORD_ACT_MACRO_REC) && (n == colon + 3) && !strcmp(tokens[colon + 2], "delays") )
+      chord->arg |= CHORD_REC_DELAYS;
+    else if(n != colon + 2)
+    {
+      layout_error(lay, src_line, "unexpected word after the slot", tokens[colon + 2]);
+      return false;
+    }
+  }
+  else if(n != colon + 1)
+  {
+    layout_error(lay, src_line, "unexpected word after the action", tokens[colon + 1]);
+    return false;
+  }
+  lay->chords_len++;
+  return true;
+}
+
+
+static bool parse_layer_line(struct layout *lay, char **tokens, int n, int colon, uint32_t src_line)
+{
+  struct layout_layer_key *layer_key;
+  int i, first;
+
+  if(lay->layer_keys_len >= MAX_LAYER_KEYS)
+  {
+    layout_error(lay, src_line, "too many layer keys", NULL);
+    return false;
+  }
+  layer_key = &lay->layer_keys[lay->layer_keys_len];
+  memset(layer_key, 0, sizeof(*layer_key));
+  memset(layer_key->keys, DB_KEY_NONE, sizeof(layer_key->keys));
+  layer_key->src_line = src_line;
+  for(i = 0; i < DB_LAYER_SOURCES; i++)
+    if(!strcmp(tokens[0], layer_source_names[i]))
+      break;
+  if(i == DB_LAYER_SOURCES)
+  {
+    layout_error(lay, src_line, "expected ruslat or kana", tokens[0]);
+    return false;
+  }
+  layer_key->source = (uint8_t)i;
+  first = 1;
+  if( (colon > 2) && !strcmp(tokens[1], "E0") )
+  {
+    layer_key->e0 = true;
+    first = 2;
+  }
+  if( (colon != first + 1) || !parse_hex_byte(tokens[first], &layer_key->code) )
+  {
+    layout_error(lay, src_line, "expected one make code (E0 may prefix it) before :", NULL);
+    return false;
+  }
+  if( !layer_key->code || (layer_key->code == PS2_BREAK_PREFIX) || (layer_key->code == PS2_EXTENDED_PREFIX) ||
+      (layer_key->code == PS2_PAUSE_PREFIX) || (layer_key->e0 && (layer_key->code == PS2_FAKE_SHIFT)) )
+  {
+    layout_error(lay, src_line, "not the make code of a key", tokens[first]);
+    return false;
+  }
+  if( (n <= colon) || (n > colon + LAYER_MSX_KEYS) )
+  {
+    layout_error(lay, src_line, "expected 1 or 2 MSX keys after :", NULL);
+    return false;
+  }
+  for(i = colon; i < n; i++)
+    if( !parse_key(tokens[i], &layer_key->keys[i - colon]) || (layer_key->keys[i - colon] == DB_KEY_NONE) ||
+        (layer_key->keys[i - colon] & DB_KEY_RELEASE) )
+    {
+      layout_error(lay, src_line, "bad MSX key (a press is expected)", tokens[i]);
+      return false;
+    }
+  lay->layer_keys_len++;
+  return true;
+}
+
+
+static bool layout_read(struct layout *lay, const char *file)
+{
+  char text[MAX_TEXT_LINE], *tokens[16], *p;
+  uint32_t src_line = 0;
+  int n, colon;
+  enum LAYOUT_SECTION section = SECTION_KEYS;
+  bool ok = true;
+  FILE *in = fopen(file, "r");
+
+  lay->file = file;
+  lay->keys_len = 0;
+  lay->chars_len = 0;
+  lay->chords_len = 0;
+  lay->layer_keys_len = 0;
+  lay->with_layers = false;
+  memset(lay->header, 0xFF, sizeof(lay->header));
+  lay->header[0] = 1;
+  lay->header[1] = 0;
+  if(!in)
+  {
+    perror(file);
+    return false;
+  }
+  while(fgets(text, sizeof(text), in))
+  {
+    src_line++;
+    //Comments start at a # on the beginning of a word
+    for(p = text; *p; p++)
+      if( (*p == '#') && ((p == text) || isspace((unsigned char)p[-1])) )
+      {
+        *p = 0;
+        break;
+      }
+    n = 0;
+    colon = -1;
+    for(p = strtok(text, " \t\r\n"); p && (n < 16); p = strtok(NULL, " \t\r\n"))
+    {
+      if(!strcmp(p, ":") && (colon < 0))
+        colon = n;
+      else
+        tokens[n++] = p;
+    }
+    if(!n)
+      continue;
+    if(!strcmp(tokens[0], "[chars]") && (n == 1))
+      section = SECTION_CHARS;
+    else if(!strcmp(tokens[0], "[chords]") && (n == 1))
+      section = SECTION_CHORDS;
+    else if(!strcmp(tokens[0], "[layers]") && (n == 1))
+    {
+      section = SECTION_LAYERS;
+      lay->with_layers = true;
+    }
+    else if(section == SECTION_CHARS)
+      ok &= parse_char_line(lay, tokens, n, src_line);
+    else if(section == SECTION_CHORDS)
+      ok &= parse_chord_line(lay, tokens, n, colon, src_line);
+    else if(section == SECTION_LAYERS)
+      ok &= parse_layer_line(lay, tokens, n, colon, src_line);
+    else if(colon >= 0)
+      ok &= parse_key_line(lay, tokens, n, colon, src_line);
+    else if(!lay->keys_len)
+      ok &= parse_header_line(lay, tokens, n, src_line);
+    else
+    {
+      layout_error(lay, src_line, "header directive after the scan codes", tokens[0]);
+      ok = false;
+    }
+  }
+  fclose(in);
+  return ok;
+}
+
+
+/*************************************************************************************************/
+/***************************************** Validation ********************************************/
+/*************************************************************************************************/
+static int code_compare(const uint8_t *a, const uint8_t *b)
+{
+  return memcmp(a, b, 3);
+}
+
+
+//As mount_scancode() assembles them
+static bool scan_code_shape_ok(const struct layout_key *key, const char **why)
+{
+  const uint8_t *c = key->code;
+
+  *why = NULL;
+  if(c[0] < PS2_EXTENDED_PREFIX)
+    *why = key->code_len == 1 ? NULL : "a first byte below E0 is a whole scan code";
+  else if(c[0] == PS2_BREAK_PREFIX)
+    *why = key->code_len == 2 ? NULL : "F0 is followed by exactly one byte";
+  else if(c[0] == PS2_EXTENDED_PREFIX)
+  {
+    if(key->code_len == 2)
+      *why = (c[1] == PS2_BREAK_PREFIX) ? "E0 F0 is followed by one more byte" :
+             (c[1] == PS2_FAKE_SHIFT) ? "E0 12 is discarded by the firmware" : NULL;
+    else if(key->code_len == 3)
+      *why = (c[1] != PS2_BREAK_PREFIX) ? "only E0 F0 is followed by two bytes" :
+             (c[2] == PS2_FAKE_SHIFT) ? "E0 F0 12 is discarded by the firmware" : NULL;
+    else
+      *why = "E0 is followed by one or two bytes";
+  }
+  else if(c[0] == PS2_PAUSE_PREFIX)
+    *why = key->code_len == 3 ? NULL : "E1 is followed by exactly two bytes";
+  else
+    *why = "no scan code starts with this byte";
+  return *why == NULL;
+}
+
+
+static bool layout_validate(const struct layout *lay)
+{
+  const char *why;
+  bool ok = true;
+
+  //dbasemgt.c accepts only version 1.0 Databases
+  if( (lay->header[0] != 1) || (lay->header[1] != 0) )
+  {
+    layout_error(lay, 0, "the firmware accepts only Database version 1.0", NULL);
+    ok = false;
+  }
+  for(uint16_t i = 0; i < lay->keys_len; i++)
+  {
+    const struct layout_key *key = &lay->keys[i];
+    if(!scan_code_shape_ok(key, &why))
+    {
+      layout_error(lay, key->src_line, why, NULL);
+      ok = false;
+    }
+    if( (i > 0) && (code_compare(lay->keys[i - 1].code, key->code) >= 0) )
+    {
+      if(!code_compare(lay->keys[i - 1].code, key->code))
+        fprintf(stderr, "%s:%u: scan code already mapped on line %u\n", lay->file, key->src_line,
+                lay->keys[i - 1].src_line);
+      else
+        fprintf(stderr, "%s:%u: out of order: must come before line %u, as convert2msx() searches them in order\n",
+                lay->file, key->src_line, lay->keys[i - 1].src_line);
+      ok = false;
+    }
+  }
+  for(uint16_t i = 0; i < lay->chars_len; i++)
+    for(uint16_t j = 0; j < i; j++)
+      if(lay->chars[i].ch == lay->chars[j].ch)
+      {
+        fprintf(stderr, "%s:%u: char already mapped on line %u\n", lay->file, lay->chars[i].src_line,
+                lay->chars[j].src_line);
+        ok = false;
+      }
+  for(uint16_t i = 0; i < lay->chords_len; i++)
+    for(uint16_t j = 0; j < i; j++)
+    {
+      const struct layout_chord *a = &lay->chords[i], *b = &lay->chords[j];
+      if( (a->kind == b->kind) && (a->n_keys == b->n_keys) && (a->e0_mask == b->e0_mask) &&
+          !memcmp(a->code, b->code, a->n_keys) )
+      {
+        fprintf(stderr, "%s:%u: chord already defined on line %u\n", lay->file, a->src_line, b->src_line);
+        ok = false;
+      }
+    }
+  for(uint16_t i = 0; i < lay->layer_keys_len; i++)
+    for(uint16_t j = 0; j < i; j++)
+    {
+      const struct layout_layer_key *a = &lay->layer_keys[i], *b = &lay->layer_keys[j];
+      //layer.c looks a layer up by the make code byte
+      if( (a->source == b->source) && (a->code == b->code) )
+      {
+        fprintf(stderr, "%s:%u: make code already overridden on this layer on line %u\n", lay->file, a->src_line,
+                b->src_line);
+        ok = false;
+      }
+    }
+  return ok;
+}
+
+
+/*************************************************************************************************/
+/******************************************* Image ***********************************************/
+/*************************************************************************************************/
+static uint16_t ext_lines(uint16_t records, uint8_t record_size)
+{
+  return 1 + (uint16_t)((records * record_size + DB_EXT_PAYLOAD_COLS - 1) / DB_EXT_PAYLOAD_COLS);
+}
+
+
+static void ext_put(uint8_t *image, uint16_t *line, uint8_t type, uint8_t record_size, uint16_t records,
+                    const uint8_t *payload)
+{
+  uint8_t *p = image + *line * DB_NUM_COLS;
+  uint16_t lines = ext_lines(records, record_size);
+  uint32_t size = (uint32_t)records * record_size;
+
+  p[0] = DB_EXT_MARK;
+  p[1] = DB_EXT_TAG;
+  p[2] = type;
+  p[3] = (uint8_t)records;
+  p[4] = record_size;
+  p[5] = (uint8_t)(lines - 1);
+  for(uint32_t i = 0; i < size; i++)
+  {
+    p = image + (*line + 1 + i / DB_EXT_PAYLOAD_COLS) * DB_NUM_COLS;
+    p[0] = DB_EXT_MARK;
+    p[1 + i % DB_EXT_PAYLOAD_COLS] = payload[i];
+  }
+  *line += lines;
+}
+
+
+static bool layout_build(const struct layout *lay, uint8_t *image)
+{
+  uint8_t index[3 * 256], char_map[3 * MAX_CHARS], sorted[MAX_CHARS], chords[CHORD_RECORD_SIZE * MAX_CHORDS];
+  uint8_t layers[LAYER_RECORD_SIZE * MAX_LAYER_KEYS];
+  uint16_t line, index_len = 0, needed;
+
+  memset(image, 0xFF, DATABASE_SIZE);
+  memcpy(image, lay->header, DB_NUM_COLS);
+  for(line = 1; line <= lay->keys_len; line++)
+  {
+    const struct layout_key *key = &lay->keys[line - 1];
+    uint8_t *p = image + line * DB_NUM_COLS;
+    memcpy(p, key->code, 3);
+    p[3] = key->control;
+    memcpy(p + 4, key->keys, 4);
+    if( (line == 1) || (key->code[0] != lay->keys[line - 2].code[0]) )
+    {
+      index[3 * index_len + 0] = key->code[0];
+      index[3 * index_len + 1] = (uint8_t)(line & 0xFF);
+      index[3 * index_len + 2] = (uint8_t)(line >> 8);
+      index_len++;
+    }
+  }
+
+  needed = line;
+  if(with_index)
+    needed += ext_lines(index_len, 3);
+  if(with_char_map && lay->chars_len)
+    needed += ext_lines(lay->chars_len, 3);
+  if(lay->chords_len)
+    needed += ext_lines(lay->chords_len, CHORD_RECORD_SIZE);
+  if(lay->with_layers)
+    needed += ext_lines(lay->layer_keys_len, LAYER_RECORD_SIZE);
+  if(needed > N_DATABASE_REGISTERS - 1)
+  {
+    fprintf(stderr, "%s: needs %u lines, but only %u are available\n", lay->file, needed, N_DATABASE_REGISTERS - 1);
+    return false;
+  }
+  if(with_index)
+    ext_put(image, &line, DB_EXT_LOOKUP_INDEX, 3, index_len, index);
+  if(with_char_map && lay->chars_len)
+  {
+    //Sorted by char
+    for(uint16_t i = 0; i < lay->chars_len; i++)
+      sorted[i] = (uint8_t)i;
+    for(uint16_t i = 1; i < lay->chars_len; i++)
+      for(uint16_t j = i; (j > 0) && (lay->chars[sorted[j - 1]].ch > lay->chars[sorted[j]].ch); j--)
+      {
+        uint8_t t = sorted[j];
+        sorted[j] = sorted[j - 1];
+        sorted[j - 1] = t;
+      }
+    for(uint16_t i = 0; i < lay->chars_len; i++)
+    {
+      char_map[3 * i + 0] = lay->chars[sorted[i]].ch;
+      char_map[3 * i + 1] = lay->chars[sorted[i]].key;
+      char_map[3 * i + 2] = lay->chars[sorted[i]].modifiers;
+    }
+    ext_put(image, &line, DB_EXT_CHAR_MAP, 3, lay->chars_len, char_map);
+  }
+  if(lay->chords_len)
+  {
+    for(uint16_t i = 0; i < lay->chords_len; i++)
+    {
+      const struct layout_chord *chord = &lay->chords[i];
+      uint8_t *r = chords + CHORD_RECORD_SIZE * i;
+      r[0] = (uint8_t)(chord->kind << 4 | chord->n_keys);
+      r[1] = chord->action;
+      r[2] = chord->arg;
+      memset(r + 3, 0, DB_CHORD_MAX_KEYS);
+      memcpy(r + 3, chord->code, chord->n_keys);
+      r[6] = chord->e0_mask;
+    }
+    ext_put(image, &line, DB_EXT_CHORDS, CHORD_RECORD_SIZE, lay->chords_len, chords);
+  }
+  if(lay->with_layers)
+  {
+    for(uint16_t i = 0; i < lay->layer_keys_len; i++)
+    {
+      const struct layout_layer_key *layer_key = &lay->layer_keys[i];
+      uint8_t *r = layers + LAYER_RECORD_SIZE * i;
+      r[0] = (uint8_t)(layer_key->source << 4 | (layer_key->e0 ? DB_LAYER_E0 : 0));
+      r[1] = layer_key->code;
+      memcpy(r + 2, layer_key->keys, LAYER_MSX_KEYS);
+    }
+    ext_put(image, &line, DB_EXT_LAYERS, LAYER_RECORD_SIZE, lay->layer_keys_len, layers);
+  }
+  image_seal(image);
+  if(verbose)
+    fprintf(stderr, "%s: %u scan codes, %u first bytes, %u chars, %u chords, %u layer keys, %u free lines\n",
+            lay->file, lay->keys_len, index_len, lay->chars_len, lay->chords_len, lay->layer_keys_len,
+            N_DATABASE_REGISTERS - 1 - line);
+  return true;
+}
+
+
+//BCC and CheckSum of the first 319 lines, as database_setup() checks them
+static void image_seal(uint8_t *image)
+{
+  uint8_t checksum = 0, bcc = 0;
+
+  for(uint16_t i = 0; i < DATABASE_SIZE - DB_NUM_COLS; i++)
+  {
+    checksum += image[i];
+    bcc ^= image[i];
+  }
+  image[DATABASE_SIZE - 2] = bcc;
+  image[DATABASE_SIZE - 1] = (uint8_t)(0 - checksum);
+}
+
+
+/*************************************************************************************************/
+/****************************************** Outputs **********************************************/
+/*************************************************************************************************/
+static bool write_c(const char *file, const char *layout_file, const uint8_t *image)
+{
+  FILE *out = fopen(file, "w");
+
+  if(!out)
+  {
+    perror(file);
+    return false;
+  }
+  for(size_t i = 0; i < sizeof(c_file_head) / sizeof(c_file_head[0]); i++)
+  {
+    if(strstr(c_file_head[i], "@file"))
+      fprintf(out, c_file_head[i], base_name(file));
+    else if(strstr(c_file_head[i], "%s"))
+      fprintf(out, c_file_head[i], base_name(layout_file));
+    else
+      fputs(c_file_head[i], out);
+    fputc('\n', out);
+  }
+  fputs("{\n", out);
+  for(uint16_t line = 0; line < N_DATABASE_REGISTERS; line++)
+  {
+    const uint8_t *p = image + line * DB_NUM_COLS;
+    fprintf(out, "    {%u, %u, %u, %u, %u, %u, %u, %u}%s\n", p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7],
+            line < N_DATABASE_REGISTERS - 1 ? "," : "");
+  }
+  fputs("};\n", out);
+  if(fclose(out))
+  {
+    perror(file);
+    return false;
+  }
+  return true;
+}
+
+
+static void hex_record(FILE *out, uint8_t len, uint16_t address, uint8_t type, const uint8_t *data)
+{
+  uint8_t sum = (uint8_t)(len + (address >> 8) + (address & 0xFF) + type);
+
+  fprintf(out, ":%02X%04X%02X", len, address, type);
+  for(uint8_t i = 0; i < len; i++)
+  {
+    fprintf(out, "%02X", data[i]);
+    sum += data[i];
+  }
+  fprintf(out, "%02X\r\n", (uint8_t)(0 - sum));
+}
+
+
+static bool write_hex(const char *file, const uint8_t *image)
+{
+  FILE *out = fopen(file, "w");
+  uint32_t address, upper = 0xFFFFFFFF;
+  uint8_t ela[2], len;
+
+  if(!out)
+  {
+    perror(file);
+    return false;
+  }
+  for(uint32_t i = 0; i < DATABASE_SIZE; i += len)
+  {
+    address = hex_address + i;
+    len = (uint8_t)((DATABASE_SIZE - i) < hex_record_len ? DATABASE_SIZE - i : hex_record_len);
+    //A record does not cross a 64K boundary
+    if((address & 0xFFFF) + len > 0x10000)
+      len = (uint8_t)(0x10000 - (address & 0xFFFF));
+    if((address >> 16) != upper)
+    {
+      upper = address >> 16;
+      ela[0] = (uint8_t)(upper >> 8);
+      ela[1] = (uint8_t)upper;
+      hex_record(out, 2, 0, 4, ela);
+    }
+    hex_record(out, len, (uint16_t)address, 0, image + i);
+  }
+  hex_record(out, 0, 0, 1, NULL);
+  if(fclose(out))
+  {
+    perror(file);
+    return false;
+  }
+  return true;
+}
+
+
+/*************************************************************************************************/
+/***************************************** Decompiler ********************************************/
+/*************************************************************************************************/
+//Data records are placed from the lowest address on, as get_intelhex.c does from the first one
+static bool read_hex(const char *file, uint8_t *image)
+{
+  char text[MAX_TEXT_LINE];
+  uint8_t bytes[MAX_TEXT_LINE / 2], sum;
+  uint32_t src_line = 0, upper = 0, address, base = 0xFFFFFFFF;
+  size_t len;
+  bool eof = false;
+  static uint8_t data[0x10000];
+  static bool used[0x10000];
+  FILE *in = fopen(file, "r");
+
+  if(!in)
+  {
+    perror(file);
+    return false;
+  }
+  memset(used, 0, sizeof(used));
+  while(!eof && fgets(text, sizeof(text), in))
+  {
+    src_line++;
+    len = strcspn(text, "\r\n");
+    text[len] = 0;
+    if(!len)
+      continue;
+    if( (text[0] != ':') || (len < 11) || !(len & 1) )
+    {
+      fprintf(stderr, "%s:%u: not an Intel Hex record\n", file, src_line);
+      fclose(in);
+      return false;
+    }
+    sum = 0;
+    for(size_t i = 0; i < (len - 1) / 2; i++)
+    {
+      char pair[3] = { text[1 + 2 * i], text[2 + 2 * i], 0 };
+      if(!parse_hex_byte(pair, &bytes[i]) || !isxdigit((unsigned char)pair[1]))
+      {
+        fprintf(stderr, "%s:%u: not an Intel Hex record\n", file, src_line);
+        fclose(in);
+        return false;
+      }
+      sum += bytes[i];
+    }
+    if( sum || (bytes[0] + 5u != (len - 1) / 2) )
+    {
+      fprintf(stderr, "%s:%u: bad record length or checksum\n", file, src_line);
+      fclose(in);
+      return false;
+    }
+    switch(bytes[3])
+    {
+      case 0:
+        for(uint8_t i = 0; i < bytes[0]; i++)
+        {
+          address = upper + (((uint32_t)bytes[1] << 8) | bytes[2]) + i;
+          if(base == 0xFFFFFFFF)
+            base = address;
+          if( (address < base) || (address - base >= DATABASE_SIZE) )
+          {
+            fprintf(stderr, "%s:%u: data out of the Database\n", file, src_line);
+            fclose(in);
+            return false;
+          }
+          data[address - base] = bytes[4 + i];
+          used[address - base] = true;
+        }
+        break;
+      case 1:
+        eof = true;
+        break;
+      case 2:
+        upper = (((uint32_t)bytes[4] << 8) | bytes[5]) << 4;
+        break;
+      case 4:
+        upper = (((uint32_t)bytes[4] << 8) | bytes[5]) << 16;
+        break;
+      default:
+        break;
+    }
+  }
+  fclose(in);
+  for(uint32_t i = 0; i < DATABASE_SIZE; i++)
+    image[i] = used[i] ? data[i] : 0xFF;
+  return true;
+}
+
+
+static void key_to_text(uint8_t key, char *text)
+{
+  if(key == DB_KEY_NONE)
+    strcpy(text, "--");
+  else
+    sprintf(text, "Y%uX%u%s", key >> 4, key & 0x07, (key & DB_KEY_RELEASE) ? "r" : "");
+}
+
+
+static void decompile_chords(FILE *out, const uint8_t *header)
+{
+  const uint8_t *r;
+  char text[48], key[8];
+  uint8_t kind, n_keys;
+
+  fprintf(out, "\n[chords]\n");
+  for(uint16_t i = 0; i < header[3]; i++)
+  {
+    r = header + (1 + i) * DB_NUM_COLS + 1;
+    kind = r[0] >> 4;
+    n_keys = r[0] & 0x0F;
+    if( (kind > DB_CHORD_HOLD) || !n_keys || (n_keys > DB_CHORD_MAX_KEYS) || !r[1] || (r[1] > DB_CHORD_ACT_MACRO_REC) )
+    {
+      fprintf(out, "# unknown chord record %02X %02X %02X %02X %02X %02X %02X\n", r[0], r[1], r[2], r[3], r[4], r[5], r[6]);
+      continue;
+    }
+    text[0] = 0;
+    for(uint8_t k = 0; k < n_keys; k++)
+      sprintf(text + strlen(text), (r[6] & (1 << k)) ? " E0 %02X" : " %02X", r[3 + k]);
+    fprintf(out, "%-8s%-14s : %s", chord_kind_names[kind], text, chord_action_names[r[1]]);
+    if(r[1] == DB_CHORD_ACT_MSX_KEY)
+    {
+      key_to_text(r[2], key);
+      fprintf(out, " %s", key);
+    }
+    else if(r[1] >= DB_CHORD_ACT_MACRO)
+      fprintf(out, " %u%s", r[2] & (uint8_t)~CHORD_REC_DELAYS, (r[2] & CHORD_REC_DELAYS) ? " delays" : "");
+    fputc('\n', out);
+  }
+}
+
+
+static void decompile_layers(FILE *out, const uint8_t *header)
+{
+  const uint8_t *records = header + DB_NUM_COLS;
+  uint8_t r[LAYER_RECORD_SIZE];
+  char code[8], keys[LAYER_MSX_KEYS][8];
+
+  fprintf(out, "\n[layers]\n");
+  for(uint16_t i = 0; i < header[3]; i++)
+  {
+    for(uint8_t j = 0; j < LAYER_RECORD_SIZE; j++)
+    {
+      uint16_t k = (uint16_t)(LAYER_RECORD_SIZE * i + j);
+      r[j] = records[(k / DB_EXT_PAYLOAD_COLS) * DB_NUM_COLS + 1 + k % DB_EXT_PAYLOAD_COLS];
+    }
+    if( ((r[0] >> 4) >= DB_LAYER_SOURCES) || (r[0] & 0x0F & ~DB_LAYER_E0) || (r[2] == DB_KEY_NONE) )
+    {
+      fprintf(out, "# unknown layer record %02X %02X %02X %02X\n", r[0], r[1], r[2], r[3]);
+      continue;
+    }
+    sprintf(code, (r[0] & DB_LAYER_E0) ? "E0 %02X" : "%02X", r[1]);
+    key_to_text(r[2], keys[0]);
+    key_to_text(r[3], keys[1]);
+    fprintf(out, "%-8s%-6s : %s%s%s\n", layer_source_names[r[0] >> 4], code, keys[0], (r[3] == DB_KEY_NONE) ? "" : " ",
+            (r[3] == DB_KEY_NONE) ? "" : keys[1]);
+  }
+}
+
+
+static bool decompile(const char *hex_file, const char *layout_file)
+{
+  static uint8_t image[DATABASE_SIZE];
+  struct layout_key key;
+  const uint8_t *p;
+  const char *why;
+  char code[16], control[8], keys[4][8];
+  uint16_t line;
+  uint8_t bcc = 0, checksum = 0, period;
+  FILE *out;
+
+  if(!read_hex(hex_file, image))
+    return false;
+  for(uint16_t i = 0; i < DATABASE_SIZE - DB_NUM_COLS; i++)
+  {
+    checksum += image[i];
+    bcc ^= image[i];
+  }
+  if( (image[DATABASE_SIZE - 2] != bcc) || ((uint8_t)(image[DATABASE_SIZE - 1] + checksum) != 0) )
+    fprintf(stderr, "%s: warning: BCC or CheckSum do not match, so the firmware would refuse it\n", hex_file);
+  out = layout_file ? fopen(layout_file, "w") : stdout;
+  if(!out)
+  {
+    perror(layout_file);
+    return false;
+  }
+  fprintf(out, "# Decompiled from %s\n", base_name(hex_file));
+  if( (image[2] == 0xFF) && ((image[3] & DB_HEADER_FIXED) == DB_HEADER_FIXED) &&
+      (image[4] & image[5] & image[6] & image[7]) == 0xFF )
+  {
+    fprintf(out, "version %u.%u\n", image[0], image[1]);
+    fprintf(out, "y_dummy %u\n", image[3] & DB_HEADER_Y_DUMMY);
+    fprintf(out, "numlock %s\n", (image[3] & DB_HEADER_NUMLOCK) ? "on" : "off");
+    fprintf(out, "xon_xoff %s\n", (image[3] & DB_HEADER_XON_XOFF) ? "on" : "off");
+  }
+  else
+    fprintf(out, "header %02X %02X %02X %02X %02X %02X %02X %02X\n",
+            image[0], image[1], image[2], image[3], image[4], image[5], image[6], image[7]);
+  fprintf(out, "\n# PS/2 code : case keys (columns 4 to 7)\n");
+  for(line = 1; line < N_DATABASE_REGISTERS - 1; line++)
+  {
+    p = image + line * DB_NUM_COLS;
+    if(p[0] == DB_EXT_MARK)
+      break;
+    memset(&key, 0, sizeof(key));
+    memcpy(key.code, p, 3);
+    key.code_len = (p[0] < PS2_EXTENDED_PREFIX) ? 1 :
+                   ((p[0] == PS2_PAUSE_PREFIX) || ((p[0] == PS2_EXTENDED_PREFIX) && (p[1] == PS2_BREAK_PREFIX))) ? 3 : 2;
+    if( !scan_code_shape_ok(&key, &why) || ((key.code_len < 3) && p[2]) || ((key.code_len < 2) && p[1]) )
+    {
+      fprintf(stderr, "%s: line %u is not a valid scan code: %02X %02X %02X\n", hex_file, line, p[0], p[1], p[2]);
+      if(layout_file)
+        fclose(out);
+      return false;
+    }
+    code[0] = 0;
+    for(uint8_t i = 0; i < key.code_len; i++)
+      sprintf(code + strlen(code), i ? " %02X" : "%02X", p[i]);
+    period = p[3] >> DB_CONTROL_PERIOD_SHIFT;
+    if((p[3] & DB_CONTROL_FIXED) == DB_CONTROL_FIXED)
+      sprintf(control, "%u%s", p[3] & DB_CONTROL_CASE, (p[3] & DB_CONTROL_SHIFT) ? "s" : "");
+    else if( ((p[3] & ~DB_CONTROL_PERIOD & DB_CONTROL_FIXED) == (DB_CONTROL_FIXED & ~DB_CONTROL_PERIOD)) &&
+             (period >= 1) && (period <= MAX_AUTOFIRE_PERIOD) )
+      sprintf(control, "%u%sa%u", p[3] & DB_CONTROL_CASE, (p[3] & DB_CONTROL_SHIFT) ? "s" : "", period);
+    else
+      sprintf(control, "$%02X", p[3]);
+    for(uint8_t i = 0; i < 4; i++)
+      key_to_text(p[4 + i], keys[i]);
+    fprintf(out, "%-11s : %-4s %-6s %-6s %-6s %s\n", code, control, keys[0], keys[1], keys[2], keys[3]);
+  }
+  //Extension lines: only the char map, the chords and the layers carry layout information
+  for(; line < N_DATABASE_REGISTERS - 1; line++)
+  {
+    p = image + line * DB_NUM_COLS;
+    if( (p[0] != DB_EXT_MARK) || (p[1] != DB_EXT_TAG) )
+      continue;
+    if( (p[2] == DB_EXT_CHAR_MAP) && (p[4] == 3) )
+    {
+      const uint8_t *records = image + (line + 1) * DB_NUM_COLS;
+      fprintf(out, "\n[chars]\n");
+      for(uint16_t i = 0; i < p[3]; i++)
+      {
+        uint8_t r[3];
+        for(uint8_t j = 0; j < 3; j++)
+        {
+          uint16_t k = (uint16_t)(3 * i + j);
+          r[j] = records[(k / DB_EXT_PAYLOAD_COLS) * DB_NUM_COLS + 1 + k % DB_EXT_PAYLOAD_COLS];
+        }
+        key_to_text(r[1], keys[0]);
+        if( (r[0] > ' ') && (r[0] < 0x7F) && (r[0] != '#') )
+          fprintf(out, "%-4c %s", r[0], keys[0]);
+        else
+          fprintf(out, "0x%02X %s", r[0], keys[0]);
+        for(uint8_t m = 0; m < 4; m++)
+          if(r[2] & (1 << m))
+            fprintf(out, " %s", char_modifier_names[m]);
+        fputc('\n', out);
+      }
+    }
+    if( (p[2] == DB_EXT_CHORDS) && (p[4] == CHORD_RECORD_SIZE) )
+      decompile_chords(out, p);
+    if( (p[2] == DB_EXT_LAYERS) && (p[4] == LAYER_RECORD_SIZE) )
+      decompile_layers(out, p);
+    line += p[5];
+  }
+  if(layout_file && fclose(out))
+  {
+    perror(layout_file);
+    return false;
+  }
+  return true;
+}
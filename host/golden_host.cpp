@@ -0,0 +1,400 @@
+/** @addtogroup 15 host_board Host Board and PS/2 Keyboard Models
+ *
+ * @file golden_host.cpp Golden matrix state traces: checks the MSX side of a layout against a script.
+ *
+ * @brief <b>Golden matrix state traces: checks the MSX side of a layout against a script.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Usage: golden-host [-u] [-v] layout.hex script.keys expected.golden
+ * The Intel Hex Database of a layout (as db-compiler makes it) is put on flash before the firmware
+ * boot, then each event of the script is run until the converter is idle again, and the MSX state
+ * is written as a line: the pressed X bits of Y0 to Y7 (x_bits) and the active modifier lines
+ * (C: CTRL, S: SHIFT, R: RUS/LAT). The lines must be equal to the expected ones; -u writes them.
+ * Script, one event per line, # starts a comment:
+ * - PS/2 bytes in hex, typed at once by the keyboard model: "12", "F0 12", "E0 F0 71";
+ * - "ruslat_led 0|1": level the MSX drives on RUSLAT_LED_PIN;
+ * - "wait msec": lets the converter run;
+ * - "console command line": typed on the firmware console, as "console remap 1C : 0 Y2X6".
+ * The firmware keeps its state on globals, so a run checks one layout: the Makefile runs one per
+ * layout in parallel.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/flash.h>
+
+#include "system.h"
+#include "host_board.h"
+#include "host_firmware.h"
+
+#define MAX_TEXT_LINE             256
+#define MAX_EVENT_BYTES           16
+#define MAX_STATE_LINE            (MAX_TEXT_LINE + 64)
+#define MAX_REPORTED_ERRORS       10
+#define EVENT_TIMEOUT_USEC        1000000   //Typing of an event must end before it
+#define EVENT_SETTLE_USEC         200000    //Time given after each event: CASE 2 sequences run on SysTick
+
+extern uint32_t x_bits[16 + 1];                   //Declared on msxmap.cpp
+
+static uint8_t  image[DATABASE_SIZE];
+static bool     verbose;
+
+//Prototype area
+static bool load_database(const char *file);
+static bool run_event(char *word, const char *file, uint32_t src_line, char *state);
+static void matrix_state(const char *label, char *state);
+static uint8_t matrix_pressed(uint8_t y);
+static void console_to_stderr(const uint8_t *data, uint16_t len);
+static void console_discard(const uint8_t *data, uint16_t len);
+static const char *base_name(const char *path);
+
+
+int main(int argc, char *argv[])
+{
+  char text[MAX_TEXT_LINE], state[MAX_STATE_LINE], expected[MAX_STATE_LINE], *word;
+  const char *keys_file, *golden_file;
+  FILE *keys, *golden;
+  uint32_t src_line = 0, golden_line = 0, events = 0, errors = 0;
+  bool update = false, ok = true;
+  int i;
+
+  for(i = 1; i < argc - 3; i++)
+  {
+    if(!strcmp(argv[i], "-u"))
+      update = true;
+    else if(!strcmp(argv[i], "-v"))
+      verbose = true;
+    else
+      break;
+  }
+  if(i != argc - 3)
+  {
+    fprintf(stderr, "Usage: %s [-u] [-v] layout.hex script.keys expected.golden\n"
+                    "-u writes expected.golden instead of checking it, -v sends the firmware console to stderr.\n",
+                    argv[0]);
+    return EXIT_FAILURE;
+  }
+  keys_file = argv[i + 1];
+  golden_file = argv[i + 2];
+  if(!load_database(argv[i]))
+    return EXIT_FAILURE;
+  keys = fopen(keys_file, "r");
+  if(!keys)
+  {
+    perror(keys_file);
+    return EXIT_FAILURE;
+  }
+  golden = fopen(golden_file, update ? "w" : "r");
+  if(!golden)
+  {
+    perror(golden_file);
+    return EXIT_FAILURE;
+  }
+
+  //The Database must be on flash before dbasemgt.c looks for it
+  flash_erase_sector(FLASH_SECTOR3_NUMBER, FLASH_CR_PROGRAM_X8);
+  flash_program(INITIAL_DATABASE, image, DATABASE_SIZE);
+  FLASH_SR = 0;
+  host_uart_tx_hook = verbose ? console_to_stderr : console_discard;
+  if(!host_firmware_boot())
+  {
+    fprintf(stderr, "golden-host: keyboard not detected\n");
+    return EXIT_FAILURE;
+  }
+
+  if(update)
+    fprintf(golden, "# golden-host %s: event, pressed X bits of Y0..Y7, active lines (C: CTRL, S: SHIFT, R: RUS/LAT)\n",
+            base_name(keys_file));
+  while(fgets(text, sizeof(text), keys))
+  {
+    src_line++;
+    *strchrnul(text, '#') = 0;
+    word = strtok(text, " \t\r\n");
+    if(!word)
+      continue;
+    if(!run_event(word, keys_file, src_line, state))
+    {
+      ok = false;
+      break;
+    }
+    events++;
+    if(update)
+    {
+      fprintf(golden, "%s\n", state);
+      continue;
+    }
+    //Comments and blank lines of the expected file are skipped, so it may be annotated
+    do
+    {
+      if(!fgets(expected, sizeof(expected), golden))
+      {
+        expected[0] = 0;
+        break;
+      }
+      golden_line++;
+      expected[strcspn(expected, "\r\n")] = 0;
+    } while( (expected[0] == '#') || (expected[0] == 0) );
+    if(strcmp(expected, state))
+    {
+      ok = false;
+      if(++errors <= MAX_REPORTED_ERRORS)
+        fprintf(stderr, "%s:%u: %s:%u:\n  expected: %s\n  got:      %s\n", golden_file, golden_line, keys_file,
+                src_line, expected[0] ? expected : "(end of file)", state);
+    }
+  }
+  if(ok && !update)
+  {
+    while(fgets(expected, sizeof(expected), golden))
+    {
+      golden_line++;
+      if( (expected[0] != '#') && (expected[strspn(expected, " \t\r\n")] != 0) )
+      {
+        fprintf(stderr, "%s:%u: more states than events of %s\n", golden_file, golden_line, keys_file);
+        ok = false;
+        break;
+      }
+    }
+  }
+  fclose(keys);
+  if(fclose(golden))
+  {
+    perror(golden_file);
+    ok = false;
+  }
+  if(errors > MAX_REPORTED_ERRORS)
+    fprintf(stderr, "golden-host: %u more differences\n", errors - MAX_REPORTED_ERRORS);
+  if(verbose || !ok)
+    fprintf(stderr, "golden-host: %s, %u events, %s\n", base_name(keys_file), events, ok ? "ok" : "FAILED");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+//Only data records inside the Database area are accepted
+static bool load_database(const char *file)
+{
+  FILE *in = fopen(file, "r");
+  char text[MAX_TEXT_LINE];
+  uint8_t bytes[(MAX_TEXT_LINE - 1) / 2], sum;
+  uint32_t src_line = 0, upper = 0, address, loaded = 0;
+  size_t len, n;
+  unsigned int value;
+  bool end = false;
+
+  if(!in)
+  {
+    perror(file);
+    return false;
+  }
+  memset(image, 0xFF, sizeof(image));
+  while(!end && fgets(text, sizeof(text), in))
+  {
+    src_line++;
+    len = strcspn(text, "\r\n");
+    if(!len)
+      continue;
+    sum = 0;
+    for(n = 0; (text[0] == ':') && (2 * n + 3 <= len); n++)
+    {
+      if( !isxdigit((unsigned char)text[1 + 2 * n]) || !isxdigit((unsigned char)text[2 + 2 * n]) ||
+          (sscanf(text + 1 + 2 * n, "%2x", &value) != 1) )
+        break;
+      bytes[n] = (uint8_t)value;
+      sum += bytes[n];
+    }
+    if( (text[0] != ':') || (2 * n + 1 != len) || (n < 5) || (bytes[0] + 5u != n) || sum )
+    {
+      fprintf(stderr, "%s:%u: bad Intel Hex record\n", file, src_line);
+      fclose(in);
+      return false;
+    }
+    switch(bytes[3])
+    {
+      case 0:
+        address = upper + ((uint32_t)bytes[1] << 8) + bytes[2];
+        if( (address < INITIAL_DATABASE) || (address + bytes[0] > INITIAL_DATABASE + (DATABASE_SIZE)) )
+        {
+          fprintf(stderr, "%s:%u: record out of the Database (0x%08X)\n", file, src_line, INITIAL_DATABASE);
+          fclose(in);
+          return false;
+        }
+        memcpy(&image[address - INITIAL_DATABASE], &bytes[4], bytes[0]);
+        loaded += bytes[0];
+        break;
+      case 1:
+        end = true;
+        break;
+      case 4:
+        upper = (((uint32_t)bytes[4] << 8) | bytes[5]) << 16;
+        break;
+      default:
+        break;
+    }
+  }
+  fclose(in);
+  if(loaded != (DATABASE_SIZE))
+  {
+    fprintf(stderr, "%s: %u of %u Database bytes\n", file, loaded, DATABASE_SIZE);
+    return false;
+  }
+  return true;
+}
+
+
+//word is the first token of the line: strtok() goes on with the others
+static bool run_event(char *word, const char *file, uint32_t src_line, char *state)
+{
+  char label[MAX_TEXT_LINE] = "", *end;
+  uint8_t bytes[MAX_EVENT_BYTES];
+  uint16_t len = 0;
+  unsigned long value;
+
+  if(!strcmp(word, "console"))
+  {
+    word = strtok(NULL, "\r\n");
+    if(!word)
+    {
+      fprintf(stderr, "%s:%u: usage: \"console command line\"\n", file, src_line);
+      return false;
+    }
+    host_uart_rx((const uint8_t*)word, (uint16_t)strlen(word));
+    host_uart_rx((const uint8_t*)"\r", 1);
+    host_firmware_run_until(host_time_usec + EVENT_SETTLE_USEC, NULL);
+    matrix_state("console", state);
+    return true;
+  }
+
+  if( !strcmp(word, "ruslat_led") || !strcmp(word, "wait") )
+  {
+    strcpy(label, word);
+    word = strtok(NULL, " \t\r\n");
+    value = word ? strtoul(word, &end, 10) : 0;
+    if( !word || *end || strtok(NULL, " \t\r\n") || (!strcmp(label, "ruslat_led") && (value > 1)) )
+    {
+      fprintf(stderr, "%s:%u: usage: \"ruslat_led 0|1\" or \"wait msec\"\n", file, src_line);
+      return false;
+    }
+    strcat(label, " ");
+    strcat(label, word);
+    if(label[0] == 'r')
+      host_gpio_input(RUSLAT_LED_PORT, RUSLAT_LED_PIN, value != 0);
+    else
+      host_firmware_run_until(host_time_usec + (uint64_t)value * 1000, NULL);
+    matrix_state(label, state);
+    return true;
+  }
+
+  for(; word; word = strtok(NULL, " \t\r\n"))
+  {
+    value = strtoul(word, &end, 16);
+    if( *end || (strlen(word) != 2) || (len >= MAX_EVENT_BYTES) )
+    {
+      fprintf(stderr, "%s:%u: \"%s\": expected PS/2 bytes in hex (up to %u), \"ruslat_led\", \"wait\" or \"console\"\n", file,
+              src_line, word, MAX_EVENT_BYTES);
+      return false;
+    }
+    bytes[len++] = (uint8_t)value;
+    if(label[0])
+      strcat(label, " ");
+    strcat(label, word);
+  }
+  for(char *c = label; *c; c++)
+    *c = (char)toupper((unsigned char)*c);
+  host_ps2_keyboard_type(bytes, len);
+  host_firmware_run_until(host_time_usec + EVENT_TIMEOUT_USEC, host_firmware_keyboard_idle);
+  if(!host_firmware_keyboard_idle())
+  {
+    fprintf(stderr, "%s:%u: \"%s\" was not converted in %u ms\n", file, src_line, label, EVENT_TIMEOUT_USEC / 1000);
+    return false;
+  }
+  host_firmware_run_until(host_time_usec + EVENT_SETTLE_USEC, NULL);
+  matrix_state(label, state);
+  return true;
+}
+
+
+//Y8 to Y10 are not on x_bits: they drive the CTRL, SHIFT and RUS/LAT lines, active low
+static void matrix_state(const char *label, char *state)
+{
+  uint16_t ctrl, shift, ruslat;
+  int len;
+
+  len = sprintf(state, "%-14s", label);
+  for(uint8_t y = 0; y < 8; y++)
+    len += sprintf(state + len, " %02X", matrix_pressed(y));
+  host_gpio_sync(CTRL_PORT);
+  host_gpio_sync(SHIFT_PORT);
+  host_gpio_sync(RUSLAT_PORT);
+  ctrl = host_gpio_output(CTRL_PORT) & CTRL_PIN;
+  shift = host_gpio_output(SHIFT_PORT) & SHIFT_PIN;
+  ruslat = host_gpio_output(RUSLAT_PORT) & RUSLAT_PIN;
+  sprintf(state + len, "  %c%c%c", ctrl ? '-' : 'C', shift ? '-' : 'S', ruslat ? '-' : 'R');
+}
+
+
+//x_bits are GPIO_BSRR images: reset half (high 16 bits) pulls the X pin down, that is, key pressed
+static uint8_t matrix_pressed(uint8_t y)
+{
+  static const uint16_t x_pins[8] = { X0_PIN, X1_PIN, X2_PIN, X3_PIN, X4_PIN, X5_PIN, X6_PIN, X7_PIN };
+  uint8_t pressed = 0;
+
+  for(uint8_t x = 0; x < 8; x++)
+    if(x_bits[y] & ((uint32_t)x_pins[x] << 16))
+      pressed |= (uint8_t)(1 << x);
+  return pressed;
+}
+
+
+static void console_to_stderr(const uint8_t *data, uint16_t len)
+{
+  fwrite(data, 1, len, stderr);
+}
+
+
+static void console_discard(const uint8_t *data, uint16_t len)
+{
+  (void)data;
+  (void)len;
+}
+
+
+static const char *base_name(const char *path)
+{
+  const char *slash = strrchr(path, '/');
+
+  return slash ? slash + 1 : path;
+}
@@ -0,0 +1,396 @@
+/** @addtogroup 15 host_board Host Board and PS/2 Keyboard Models
+ *
+ * @file host_board.c Board wiring and PS/2 keyboard models of the host simulation.
+ *
+ * @brief <b>Board wiring and PS/2 keyboard models of the host simulation.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * It also replaces what the firmware modules not built on host provide to the others: the linker symbols.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include "host_board.h"
+#include "dbasemgt.h"
+
+//PS/2 Set 2 keyboard commands answered by the model
+#define KBD_CMD_SET_LEDS          0xED
+#define KBD_CMD_ECHO              0xEE
+#define KBD_CMD_SCAN_CODE_SET     0xF0
+#define KBD_CMD_READ_ID           0xF2
+#define KBD_CMD_TYPEMATIC         0xF3
+#define KBD_CMD_TYPE3_KEY_FIRST   0xFB
+#define KBD_CMD_TYPE3_KEY_LAST    0xFD
+#define KBD_CMD_RESEND            0xFE
+#define KBD_CMD_RESET             0xFF
+#define KBD_ACK                   0xFA
+#define KBD_BAT_OK                0xAA
+#define KBD_RESEND                0xFE
+#define KBD_QUEUE_SIZE            256     //Power of two
+#define KBD_REPLY_SIZE            4       //Longest answer: Read ID
+
+enum KBD_STATE
+{
+  KBD_OFF,
+  KBD_BAT,
+  KBD_IDLE,
+  KBD_TX,
+  KBD_RX,
+  KBD_RX_ACK,
+};
+
+//Global var area:
+char            _ebss[2 * sizeof(uint32_t)];     //Boot magic words of reset_requested()
+uint8_t         host_ps2_keyboard_leds;
+uint32_t        host_ps2_keyboard_commands;
+void            (*host_ps2_keyboard_sent_hook)(uint8_t data);
+
+static enum KBD_STATE kbd_state;
+static uint8_t  kbd_queue[KBD_QUEUE_SIZE];
+static uint8_t  kbd_queue_get, kbd_queue_put;
+static uint16_t kbd_frame;                      //Bits of the byte in transit, LSB first
+static uint8_t  kbd_bit, kbd_phase;
+static uint8_t  kbd_reply[KBD_REPLY_SIZE];      //Answers to commands go before the typed bytes
+static uint8_t  kbd_reply_get, kbd_reply_put;
+static bool     kbd_sending_reply;
+static uint8_t  kbd_last_sent;
+static uint8_t  kbd_command_with_arg;           //Command waiting its argument, or 0
+static bool     kbd_clock = true, kbd_data = true;
+static bool     kbd_clk_o_released = true;
+static bool     kbd_step_scheduled;
+
+//Prototypes of internal functions
+static void board_gpio_hook(uint32_t gpioport);
+static bool board_pin_output_low(uint32_t gpioport, uint16_t gpio);
+static void kbd_drive(void);
+static void kbd_schedule_step(uint32_t usec);
+static void kbd_step(void);
+static void kbd_put(uint8_t data);
+static void kbd_reply_put_ch(uint8_t data);
+static void kbd_command(uint8_t data);
+static void kbd_bat_done(void);
+
+
+void host_board_setup(void)
+{
+  host_gpio_hook = board_gpio_hook;
+  kbd_drive();
+}
+
+
+void host_ps2_keyboard_type(const uint8_t *bytes, uint16_t len)
+{
+  while(len--)
+    kbd_put(*bytes++);
+  if(kbd_state == KBD_IDLE)
+    kbd_schedule_step(0);
+}
+
+
+bool host_ps2_keyboard_idle(void)
+{
+  return (kbd_state == KBD_IDLE) && (kbd_queue_get == kbd_queue_put) && (kbd_reply_get == kbd_reply_put);
+}
+
+
+//Open drain outputs only pull the line down: configured as output and low
+static bool board_pin_output_low(uint32_t gpioport, uint16_t gpio)
+{
+  uint8_t pin = (uint8_t)__builtin_ctz(gpio);
+  return ( ((GPIO_MODER(gpioport) >> (pin * 2)) & 3) == GPIO_MODE_OUTPUT ) && !(GPIO_ODR(gpioport) & gpio);
+}
+
+
+//PS2_CLK_I sees the keyboard clock and PS2_CLK_O pulling it down. PS2_DATA is an open drain output
+//on firmware side, so the wired AND is done by the shim.
+static void kbd_drive(void)
+{
+  host_gpio_input(PS2_CLK_I_PORT, PS2_CLK_I_PIN, kbd_clock && kbd_clk_o_released);
+  host_gpio_input(PS2_DATA_PORT, PS2_DATA_PIN, kbd_data);
+}
+
+
+static void board_gpio_hook(uint32_t gpioport)
+{
+  bool powered, released;
+
+  if(gpioport == PS2_POWER_CTR_PORT)
+  {
+    powered = (GPIO_ODR(PS2_POWER_CTR_PORT) & PS2_POWER_CTR_PIN) &&
+              !board_pin_output_low(PS2_POWER_CTR_PORT, PS2_POWER_CTR_PIN);
+    if(powered && (kbd_state == KBD_OFF))
+    {
+      kbd_state = KBD_BAT;
+      host_schedule_usec(HOST_PS2_BAT_USEC, kbd_bat_done);
+    }
+    else if(!powered && (kbd_state != KBD_OFF))
+    {
+      kbd_state = KBD_OFF;
+      kbd_command_with_arg = 0;
+      kbd_reply_get = kbd_reply_put = 0;
+      kbd_clock = true;
+      kbd_data = true;
+      kbd_drive();
+    }
+  }
+  if(gpioport == PS2_CLK_O_PORT)
+  {
+    released = !board_pin_output_low(PS2_CLK_O_PORT, PS2_CLK_O_PIN);
+    if(released == kbd_clk_o_released)
+      return;
+    kbd_clk_o_released = released;
+    kbd_drive();
+    if(!released && (kbd_state == KBD_TX) && (kbd_bit < 10))
+    {
+      //Inhibited before the parity bit: the byte is sent again later
+      if(kbd_sending_reply)
+        kbd_reply_get--;
+      else
+      {
+        kbd_queue_get = (kbd_queue_get - 1) & (KBD_QUEUE_SIZE - 1);
+        kbd_queue[kbd_queue_get] = (uint8_t)(kbd_frame >> 1);
+      }
+      kbd_state = KBD_IDLE;
+      kbd_clock = true;
+      kbd_data = true;
+      kbd_drive();
+    }
+    else if(released && (kbd_state == KBD_IDLE || kbd_state == KBD_TX))
+    {
+      host_gpio_sync(PS2_DATA_PORT);
+      if(!(GPIO_IDR(PS2_DATA_PORT) & PS2_DATA_PIN))
+      {
+        //Request to send: the start bit is already on the bus
+        kbd_state = KBD_RX;
+        kbd_bit = 0;
+        kbd_phase = 0;
+        kbd_frame = 0;
+      }
+      kbd_schedule_step(HOST_PS2_HALF_PERIOD_USEC);
+    }
+  }
+}
+
+
+static void kbd_schedule_step(uint32_t usec)
+{
+  if(!kbd_step_scheduled)
+  {
+    kbd_step_scheduled = true;
+    host_schedule_usec(usec, kbd_step);
+  }
+}
+
+
+static void kbd_put(uint8_t data)
+{
+  kbd_queue[kbd_queue_put] = data;
+  kbd_queue_put = (kbd_queue_put + 1) & (KBD_QUEUE_SIZE - 1);
+}
+
+
+static void kbd_reply_put_ch(uint8_t data)
+{
+  if(kbd_reply_get == kbd_reply_put)
+    kbd_reply_get = kbd_reply_put = 0;
+  if(kbd_reply_put < KBD_REPLY_SIZE)
+    kbd_reply[kbd_reply_put++] = data;
+}
+
+
+static void kbd_bat_done(void)
+{
+  if(kbd_state != KBD_BAT)
+    return;
+  kbd_state = KBD_IDLE;
+  kbd_queue_get = kbd_queue_put;  //Nothing typed before the power on survives
+  kbd_put(KBD_BAT_OK);
+  kbd_schedule_step(0);
+}
+
+
+//Keyboard sequencer: one clock edge (or data setup) per step
+static void kbd_step(void)
+{
+  uint8_t data;
+
+  kbd_step_scheduled = false;
+  switch(kbd_state)
+  {
+    case KBD_IDLE:
+      if(!kbd_clk_o_released)
+        return;
+      kbd_sending_reply = kbd_reply_get != kbd_reply_put;
+      if(kbd_sending_reply)
+        data = kbd_reply[kbd_reply_get++];
+      else if(kbd_queue_get != kbd_queue_put)
+      {
+        data = kbd_queue[kbd_queue_get];
+        kbd_queue_get = (kbd_queue_get + 1) & (KBD_QUEUE_SIZE - 1);
+      }
+      else
+        return;
+      kbd_last_sent = data;
+      //Start (0), data LSB first, odd parity and stop (1)
+      kbd_frame = (uint16_t)((data << 1) | ((__builtin_parity(data) ? 0 : 1) << 9) | (1 << 10));
+      kbd_bit = 0;
+      kbd_phase = 0;
+      kbd_state = KBD_TX;
+      kbd_schedule_step(0);
+      break;
+
+    case KBD_TX:
+      if(kbd_phase == 0)
+      { //Data setup while clock is high
+        kbd_data = (kbd_frame >> kbd_bit) & 1;
+        kbd_drive();
+        kbd_phase = 1;
+        kbd_schedule_step(5);
+      }
+      else if(kbd_phase == 1)
+      { //Firmware samples data on falling edge
+        kbd_clock = false;
+        kbd_drive();
+        kbd_phase = 2;
+        kbd_schedule_step(HOST_PS2_HALF_PERIOD_USEC);
+      }
+      else
+      {
+        kbd_clock = true;
+        kbd_drive();
+        kbd_phase = 0;
+        if(++kbd_bit < 11)
+          kbd_schedule_step(HOST_PS2_HALF_PERIOD_USEC - 5);
+        else
+        {
+          kbd_state = KBD_IDLE;
+          kbd_schedule_step(HOST_PS2_BYTE_GAP_USEC);
+          if(!kbd_sending_reply && host_ps2_keyboard_sent_hook)
+            host_ps2_keyboard_sent_hook(kbd_last_sent);
+        }
+      }
+      break;
+
+    case KBD_RX:
+      if(kbd_phase == 0)
+      { //Firmware puts the next bit on falling edge
+        kbd_clock = false;
+        kbd_drive();
+        kbd_phase = 1;
+      }
+      else
+      { //Keyboard samples data on rising edge: 8 data bits, parity and stop
+        kbd_clock = true;
+        kbd_drive();
+        host_gpio_sync(PS2_DATA_PORT);
+        if(GPIO_IDR(PS2_DATA_PORT) & PS2_DATA_PIN)
+          kbd_frame |= (uint16_t)(1 << kbd_bit);
+        kbd_phase = 0;
+        if(++kbd_bit == 10)
+          kbd_state = KBD_RX_ACK;
+      }
+      kbd_schedule_step(HOST_PS2_HALF_PERIOD_USEC);
+      break;
+
+    case KBD_RX_ACK:
+      if(kbd_phase == 0)
+      {
+        kbd_data = false;
+        kbd_clock = false;
+        kbd_drive();
+        kbd_phase = 1;
+        kbd_schedule_step(HOST_PS2_HALF_PERIOD_USEC);
+      }
+      else
+      {
+        kbd_clock = true;
+        kbd_data = true;
+        kbd_drive();
+        kbd_state = KBD_IDLE;
+        data = (uint8_t)kbd_frame;
+        if( ((__builtin_parity(data) ? 0 : 1) != ((kbd_frame >> 8) & 1)) || !(kbd_frame & (1 << 9)) )
+          kbd_reply_put_ch(KBD_RESEND);
+        else
+          kbd_command(data);
+        kbd_schedule_step(HOST_PS2_BYTE_GAP_USEC);
+      }
+      break;
+
+    default:
+      break;
+  } //switch(kbd_state)
+}
+
+
+//Answers a byte received from the firmware
+static void kbd_command(uint8_t data)
+{
+  host_ps2_keyboard_commands++;
+  if(kbd_command_with_arg)
+  {
+    if(kbd_command_with_arg == KBD_CMD_SET_LEDS)
+      host_ps2_keyboard_leds = data;
+    kbd_command_with_arg = 0;
+    kbd_reply_put_ch(KBD_ACK);
+    return;
+  }
+  switch(data)
+  {
+    case KBD_CMD_ECHO:
+      kbd_reply_put_ch(KBD_CMD_ECHO);
+      break;
+    case KBD_CMD_READ_ID:
+      kbd_reply_put_ch(KBD_ACK);
+      kbd_reply_put_ch(0xAB);
+      kbd_reply_put_ch(0x83);
+      break;
+    case KBD_CMD_RESEND:
+      kbd_reply_put_ch(kbd_last_sent);
+      break;
+    case KBD_CMD_RESET:
+      kbd_reply_put_ch(KBD_ACK);
+      kbd_state = KBD_BAT;
+      host_schedule_usec(HOST_PS2_BAT_USEC, kbd_bat_done);
+      break;
+    case KBD_CMD_SET_LEDS:
+    case KBD_CMD_SCAN_CODE_SET:
+    case KBD_CMD_TYPEMATIC:
+      kbd_command_with_arg = data;
+      kbd_reply_put_ch(KBD_ACK);
+      break;
+    default:
+      if((data >= KBD_CMD_TYPE3_KEY_FIRST) && (data <= KBD_CMD_TYPE3_KEY_LAST))
+        kbd_command_with_arg = data;
+      kbd_reply_put_ch(KBD_ACK);
+      break;
+  }
+}
@@ -0,0 +1,96 @@
+/** @defgroup 15 host_board Host Board and PS/2 Keyboard Models
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file host_board.h Board wiring and PS/2 keyboard models of the host simulation.
+ *
+ * @brief <b>Board wiring and PS/2 keyboard models of the host simulation.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * The keyboard follows the firmware pins through host_gpio_hook: it runs its BAT when PS2_POWER_CTR
+ * rises, clocks the bytes queued by host_ps2_keyboard_type() on PS2_CLK_I/PS2_DATA, and receives the
+ * firmware commands (answering them as a PS/2 Set 2 keyboard does). PS2_CLK_O is wired to PS2_CLK_I.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#if !defined HOST_BOARD_H
+#define HOST_BOARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "system.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOST_PS2_HALF_PERIOD_USEC 40      //Half period of the keyboard clock (12.5kHz)
+#define HOST_PS2_BYTE_GAP_USEC    1000    //Between two bytes sent by the keyboard
+#define HOST_PS2_BAT_USEC         300000  //Power on to BAT completion (0xAA)
+
+/** Last argument of Set/Reset LEDs command (0xED) received by the keyboard */
+extern uint8_t host_ps2_keyboard_leds;
+
+/** Quantity of commands (and arguments) received by the keyboard */
+extern uint32_t host_ps2_keyboard_commands;
+
+/** Called when the keyboard ends sending a typed byte (or BAT result), but answers to commands */
+extern void (*host_ps2_keyboard_sent_hook)(uint8_t data);
+
+/**
+ * @brief Wires the board models to the firmware pins. Call it before any firmware setup.
+ *
+ */
+void host_board_setup(void);
+
+/**
+ * @brief Queues bytes (scan codes) to be sent by the keyboard, as soon as the bus is free.
+ *
+ * @param bytes Bytes to be sent.
+ * @param len Number of bytes.
+ */
+void host_ps2_keyboard_type(const uint8_t *bytes, uint16_t len);
+
+/**
+ * @brief Checks if the keyboard has nothing more to send and no frame is running.
+ *
+ * @return true if idle.
+ */
+bool host_ps2_keyboard_idle(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined HOST_BOARD_H
@@ -0,0 +1,266 @@
+/** @addtogroup 15 host_board Host Board and PS/2 Keyboard Models
+ *
+ * @file host_firmware.cpp Boot and main loop of the converter firmware, run on virtual time.
+ *
+ * @brief <b>Boot and main loop of the converter firmware, run on virtual time.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libopencm3/stm32/rcc.h>
+
+#include "system.h"
+#include "sys_timer.h"
+#include "serial.h"
+#include "hr_timer.h"
+#include "ps2handl.h"
+#include "msxmap.h"
+#include "dbasemgt.h"
+#include "console.h"
+#include "boot_trace.h"
+#include "main_events.h"
+#if LATENCY_TRACE == true
+#include "latency.h"
+#endif  //#if LATENCY_TRACE == true
+#if DB_REMAP == true
+#include "remap.h"
+#endif  //#if DB_REMAP == true
+#if CHORDS == true
+#include "chord.h"
+#endif  //#if CHORDS == true
+#if LAYERS == true
+#include "layer.h"
+#endif  //#if LAYERS == true
+#if MACROS == true
+#include "macro.h"
+#endif  //#if MACROS == true
+#if USB_TELEMETRY == true
+#include "telemetry.h"
+#endif  //#if USB_TELEMETRY == true
+#include "host_board.h"
+#include "host_firmware.h"
+
+extern bool     mount_scancode_OK;                //Declared on ps2handl.c
+extern bool     ps2numlockstate;                  //Declared on ps2handl.c
+extern bool     command_running;                  //Declared on ps2handl.c
+extern bool     caps_state, kana_state;           //Declared on ps2handl.c
+extern bool     caps_former, kana_former;         //Declared on ps2handl.c
+extern bool     update_ps2_leds;                  //Declared on msxmap.cpp
+extern bool     compatible_database;              //Declared on dbasemgt.c
+extern uint8_t  scancode[4];                      //Declared on msxmap.cpp
+extern uint32_t formerscancode;                   //Declared on msxmap.cpp
+extern bool     ps2_keyb_replugged;               //Declared on ps2handl.c
+
+void            (*host_firmware_pass_hook)(void);
+
+static enum PS2_DETECT_STATUS ps2_detect_status = PS2_DETECT_RUNNING;
+static bool     ps2_keyb_reinit;
+static bool     boot_complete;
+
+//Prototype area
+static void main_loop_pass(uint32_t events);
+static bool detection_done(void);
+
+
+bool host_firmware_boot(void)
+{
+  host_board_setup();
+  rcc_clock_setup_pll(&rcc_hse_25mhz_3v3[RCC_CLOCK_3V3_84MHZ]);
+  tim_hr_setup(TIM_HR);
+  boot_mark("Clocks and TIM_HR");
+  msxmap object;
+  object.msx_interface_setup();
+  boot_mark("MSX interface live");
+  power_on_ps2_keyboard();
+  boot_mark("PS/2 powered up");
+  general_debug_setup();
+  put_pullups_on_non_used_pins();
+  serial_setup();
+  con_send_string((uint8_t*)"\r\nPS/2 to MSX Keyboard Converter - host simulation\r\n");
+  systick_setup();
+  main_events_setup();
+  ps2_keyb_detect_start();
+  database_setup();
+  boot_mark("Database validated");
+#if DB_REMAP == true
+  remap_setup();
+#endif  //#if DB_REMAP == true
+#if CHORDS == true
+  chord_setup();
+#endif  //#if CHORDS == true
+#if LAYERS == true
+  layer_setup();
+#endif  //#if LAYERS == true
+#if MACROS == true
+  macro_setup();
+#endif  //#if MACROS == true
+#if USB_TELEMETRY == true
+  telemetry_setup();
+#endif  //#if USB_TELEMETRY == true
+  if (!compatible_database)
+  {
+    fprintf(stderr, "\nhost: incompatible default database\n");
+    exit(EXIT_FAILURE);
+  }
+  host_firmware_run_until(host_time_usec + HOST_DETECT_TIMEOUT_USEC, detection_done);
+  if(!boot_complete)
+    return false;
+  //Let the leds update finish
+  host_firmware_run_until(host_time_usec + 100000, NULL);
+  return true;
+}
+
+
+static bool detection_done(void)
+{
+  return boot_complete;
+}
+
+
+bool host_firmware_keyboard_idle(void)
+{
+  return host_ps2_keyboard_idle() && !mount_scancode_OK;
+}
+
+
+void host_firmware_run_until(uint64_t end_usec, bool (*done)(void))
+{
+  while(host_time_usec < end_usec)
+  {
+    if(done && done())
+      return;
+    main_loop_pass(main_event_wait());
+    if(boot_complete && host_firmware_pass_hook)
+      host_firmware_pass_hook();
+  }
+}
+
+
+//The main loop body of ps2-msx-kb-conv.cpp, but the human led test
+static void main_loop_pass(uint32_t events)
+{
+  uint32_t* ptr_scancode = (uint32_t*)scancode;
+
+  if (ps2_detect_status == PS2_DETECT_RUNNING)
+  {
+    if (events & (EVT_PS2 | EVT_SYSTICK))
+      ps2_detect_status = ps2_keyb_detect_poll();
+    if (ps2_detect_status == PS2_DETECT_FAILED)
+    {
+      ps2_keyb_redetect_start(true);
+      ps2_detect_status = PS2_DETECT_RUNNING;
+    }
+    else if (ps2_detect_status == PS2_DETECT_OK && ps2_keyb_reinit)
+    {
+      ps2_keyb_reinit = false;
+      con_send_string((uint8_t*)"Keyboard re-initialized.\r\n");
+      update_ps2_leds = true;
+    }
+    else if (ps2_detect_status == PS2_DETECT_OK)
+    {
+      boot_mark("Boot complete");
+      con_send_string((uint8_t*)"\r\nBoot complete. Be welcome!\r\n");
+      boot_complete = true;
+    }
+  }
+  else if (ps2_keyb_replugged)
+  {
+    con_send_string((uint8_t*)"\r\nKeyboard BAT received: Re-initializing it.\r\n");
+    msxmap object;
+    object.msx_release_all_keys();
+    ps2_keyb_reinit = true;
+    ps2_keyb_redetect_start(false);
+    ps2_detect_status = PS2_DETECT_RUNNING;
+  }
+  else if ((events & (EVT_PS2 | EVT_SYSTICK)) && mount_scancode())
+  {
+#if LATENCY_TRACE == true
+    latency_scancode_mounted(*ptr_scancode);
+#endif  //#if LATENCY_TRACE == true
+    if (*ptr_scancode != formerscancode)
+    {
+      msxmap objeto;
+      objeto.convert2msx();
+    }
+    formerscancode = *ptr_scancode;
+    *ptr_scancode = 0;
+    mount_scancode_OK = false;
+    main_event_set(EVT_PS2);
+  }
+
+#if MACROS == true
+  if(events & (EVT_MACRO | EVT_SYSTICK))
+  {
+    msxmap objeto;
+    objeto.msx_macro_poll();
+  }
+#endif  //#if MACROS == true
+#if AUTOFIRE == true
+  if(events & EVT_AUTOFIRE)
+  {
+    msxmap objeto;
+    objeto.msx_autofire_poll();
+  }
+#endif  //#if AUTOFIRE == true
+#if SHIFT_SEQUENCER == true
+  if(events & EVT_SHIFT_SEQ)
+  {
+    msxmap objeto;
+    objeto.msx_shift_seq_poll();
+  }
+#endif  //#if SHIFT_SEQUENCER == true
+
+  if( !command_running && update_ps2_leds && (ps2_detect_status != PS2_DETECT_RUNNING) )
+  {
+    update_ps2_leds = false;
+    caps_former = caps_state;
+    kana_former = kana_state;
+    ps2_update_leds(ps2numlockstate, caps_state, !kana_state);
+  }
+
+#if LATENCY_TRACE == true
+  latency_poll();
+#endif  //#if LATENCY_TRACE == true
+
+#if USB_TELEMETRY == true
+  if(events & EVT_SYSTICK)
+    telemetry_sample();
+#endif  //#if USB_TELEMETRY == true
+
+  //Not during the boot detection, as on the firmware, where a character asks for the factory reset
+  if( (events & (EVT_CON_RX | EVT_SYSTICK)) && !((ps2_detect_status == PS2_DETECT_RUNNING) && !ps2_keyb_reinit) )
+    console_poll();
+}
@@ -0,0 +1,87 @@
+/** @defgroup 15 host_board Host Board and PS/2 Keyboard Models
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file host_firmware.h Boot and main loop of the converter firmware, run on virtual time.
+ *
+ * @brief <b>Boot and main loop of the converter firmware, run on virtual time.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * The same sequence of ps2-msx-kb-conv.cpp main(), but USB, IWDG and the human led test,
+ * shared by the host programs.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#if !defined HOST_FIRMWARE_H
+#define HOST_FIRMWARE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOST_DETECT_TIMEOUT_USEC  5000000   //Keyboard BAT may last up to 2.5s, and detection is not started before
+
+/** Called after each pass of the main loop, once the boot is complete. */
+extern void (*host_firmware_pass_hook)(void);
+
+/**
+ * @brief Boots the firmware and waits the keyboard detection, as main() does before its loop.
+ * Console output goes to host_uart_tx_hook.
+ *
+ * @return true if boot is complete, false if the keyboard was not detected.
+ */
+bool host_firmware_boot(void);
+
+/**
+ * @brief Runs the firmware main loop until end_usec, or until done() returns true.
+ *
+ * @param end_usec Virtual time to stop.
+ * @param done Stop condition, checked before each pass. May be NULL.
+ */
+void host_firmware_run_until(uint64_t end_usec, bool (*done)(void));
+
+/**
+ * @brief Stop condition: the keyboard model sent everything and the firmware converted it.
+ *
+ * @return true if idle.
+ */
+bool host_firmware_keyboard_idle(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined HOST_FIRMWARE_H
@@ -0,0 +1,630 @@
+/** @addtogroup 15 host_board Host Board and PS/2 Keyboard Models
+ *
+ * @file ihex_fuzz_host.cpp Fuzzing harness of the Database update: Intel Hex reception, validation and programming.
+ *
+ * @brief <b>Fuzzing harness of the Database update: Intel Hex reception, validation and programming.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Usage: ihex-fuzz-host [-n inputs] [-r seed] [-g corpus_dir] [files...]
+ * Each input is typed on the console of the booted firmware while flash_rw() runs, as a user sends an
+ * Intel Hex file: get_intelhex_to_RAM() receives and validates it, flash_program_data() programs it on the
+ * flash sector 3 of the shim, and then database_setup() validates the flash Databases again. The bytes go
+ * through the UART RX DMA, 128 at a time, when the firmware sleeps waiting for them. When there are no
+ * more bytes and the firmware still waits, the input ends (not received).
+ * Before each input, the sector holds from 0 to NUM_DATABASE_IMG Databases (the former ones nulled), so
+ * the free slot search, the nulling of the former Database and the sector erase are all run.
+ * Assertions, any of them is a failure:
+ * - Nothing is programmed out of flash sector 3;
+ * - database_setup() ends with a compatible Database: the default one or a consistent one of the sector;
+ * - A well formed file (every line a valid record, data inside of the Database, an end-of-file record at the
+ *   end) is received, and its image is programmed on the expected slot, unchanged.
+ * Out of bounds accesses are only detected with a sanitizer: build with
+ * CFLAGS=-fsanitize=address CXXFLAGS=-fsanitize=address LDFLAGS=-fsanitize=address.
+ * Modes:
+ * - Files only: each one is run once, and abort() is called on a failure, as AFL expects
+ *   (afl-fuzz -i host/corpus/ihex -o findings -- host/build/ihex-fuzz-host @@);
+ * - -n inputs: random mutations (characters, spans, record length, address and checksum fields) of the
+ *   files, or of the default Database when there are none. Failing inputs are saved as ihex-fuzz-fail-N.hex;
+ * - -g corpus_dir: writes the seed corpus, made of the default Database, and exits;
+ * - Built with LIBFUZZER=1 (make -C host LIBFUZZER=1): LLVMFuzzerTestOneInput() for libFuzzer.
+ * Throughput is reported in records (':' received) per second.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+
+#include <libopencm3/stm32/flash.h>
+
+#include "system.h"
+#include "serial.h"
+#include "dbasemgt.h"
+#include "host_firmware.h"
+
+#define MAX_INPUT_SIZE            65536
+#define MAX_CORPUS                64
+#define MAX_REPORTED_FAILURES     5
+#define FEED_CHUNK                128       //Half of the UART RX DMA buffer
+#define MAX_RECORD_DATA           58        //Longest record accepted by get_intelhex.c: 127 characters
+#define HEX_LINEAR_ADDRESS        0x0800
+#define RESULT_OK                 0         //As dbasemgt.c
+
+extern "C" {
+extern bool     compatible_database;              //Declared on dbasemgt.c
+}
+extern uint8_t  *base_of_database;                //Declared on msxmap.cpp
+extern uint8_t  UNUSED_DATABASE[DB_NUM_COLS];     //Declared on msxmap.cpp
+
+struct fuzz_input
+{
+  uint8_t *data;
+  size_t len;
+};
+
+//Harness state
+static jmp_buf  feed_end;
+static const uint8_t *feed_data;
+static size_t   feed_len, feed_pos;
+static uint64_t records, inputs, received, programmed;
+static uint32_t failures, failures_reported;
+static uint32_t rnd_state = 1;
+static uint8_t  seed_db[DATABASE_SIZE];
+
+//Prototype area
+static void console_discard(const uint8_t *data, uint16_t len);
+static void harness_setup(void);
+static void make_seed_db(uint8_t *image);
+static size_t write_ihex(uint8_t *out, size_t out_size, const uint8_t *image, uint8_t record_len, const char *eol);
+static bool write_corpus(const char *dir);
+static bool read_file(const char *name, struct fuzz_input *in);
+static uint8_t hex_value(uint8_t ch);
+static bool parse_well_formed(const uint8_t *data, size_t len, uint8_t *image);
+static void prefill_flash(uint8_t images);
+static void feed_hook(void);
+static bool receive_input(const uint8_t *data, size_t len, int *result);
+static void fail(const char *what, uint64_t idx);
+static bool run_input(const uint8_t *data, size_t len, uint8_t prefill, uint64_t idx);
+static uint32_t rnd_range(uint32_t min, uint32_t max);
+static size_t mutate(uint8_t *buf, size_t len, const struct fuzz_input *corpus, uint32_t corpus_len);
+static void save_failure(const uint8_t *data, size_t len);
+
+
+#if !defined HOST_LIBFUZZER
+int main(int argc, char *argv[])
+{
+  static struct fuzz_input corpus[MAX_CORPUS];
+  static uint8_t buf[MAX_INPUT_SIZE], seed_file[MAX_INPUT_SIZE];
+  uint64_t n_inputs = 0, i;
+  uint32_t corpus_len = 0, c;
+  const char *corpus_dir = NULL;
+  struct timespec start, end;
+  double elapsed;
+  size_t len;
+  int a;
+
+  for(a = 1; a < argc; a++)
+  {
+    if(!strcmp(argv[a], "-n") && (a + 1 < argc))
+      n_inputs = strtoull(argv[++a], NULL, 0);
+    else if(!strcmp(argv[a], "-r") && (a + 1 < argc))
+      rnd_state = (uint32_t)strtoul(argv[++a], NULL, 0);
+    else if(!strcmp(argv[a], "-g") && (a + 1 < argc))
+      corpus_dir = argv[++a];
+    else if((argv[a][0] != '-') && (corpus_len < MAX_CORPUS))
+    {
+      if(!read_file(argv[a], &corpus[corpus_len++]))
+        return EXIT_FAILURE;
+    }
+    else
+      break;
+  }
+  if( (a < argc) || !rnd_state || (!corpus_dir && !n_inputs && !corpus_len) )
+  {
+    fprintf(stderr, "Usage: %s [-n inputs] [-r seed] [-g corpus_dir] [files...]\n"
+                    "Files only: runs each one once. -n: runs random mutations of the files (or of the default\n"
+                    "Database). -g: writes the seed corpus and exits.\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  make_seed_db(seed_db);
+  if(corpus_dir)
+    return write_corpus(corpus_dir) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  harness_setup();
+  if(!corpus_len)
+  {
+    corpus[0].len = write_ihex(seed_file, sizeof(seed_file), seed_db, 16, "\r\n");
+    corpus[0].data = seed_file;
+    corpus_len = 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if(!n_inputs)
+  {
+    for(c = 0; c < corpus_len; c++)
+      if(!run_input(corpus[c].data, corpus[c].len, (uint8_t)(c % (NUM_DATABASE_IMG + 1)), c))
+        abort();  //AFL takes it as a crash
+  }
+  for(i = 0; i < n_inputs; i++)
+  {
+    c = rnd_range(0, corpus_len - 1);
+    memcpy(buf, corpus[c].data, corpus[c].len);
+    len = mutate(buf, corpus[c].len, corpus, corpus_len);
+    if(!run_input(buf, len, (uint8_t)(i % (NUM_DATABASE_IMG + 1)), i) && (failures_reported <= MAX_REPORTED_FAILURES))
+      save_failure(buf, len);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+  printf("inputs: %llu\n", (unsigned long long)inputs);
+  printf("records: %llu\n", (unsigned long long)records);
+  printf("received: %llu\n", (unsigned long long)received);
+  printf("programmed: %llu\n", (unsigned long long)programmed);
+  printf("inputs_per_s: %.0f\n", (double)inputs / elapsed);
+  printf("records_per_s: %.0f\n", (double)records / elapsed);
+  printf("failures: %u\n", failures);
+  printf("result: %s\n", failures ? "FAIL" : "PASS");
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+#endif  //#if !defined HOST_LIBFUZZER
+
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+  (void)argc;
+  (void)argv;
+  make_seed_db(seed_db);
+  harness_setup();
+  return 0;
+}
+
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  //The Databases already on flash come from the input size, so the run is repeatable
+  if(!run_input(data, size, (uint8_t)(size % (NUM_DATABASE_IMG + 1)), inputs))
+    abort();
+  return 0;
+}
+
+
+static void console_discard(const uint8_t *data, uint16_t len)
+{
+  (void)data;
+  (void)len;
+}
+
+
+static void harness_setup(void)
+{
+  host_uart_tx_hook = console_discard;
+  if(!host_firmware_boot())
+  {
+    fprintf(stderr, "ihex-fuzz-host: keyboard not detected\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+
+//The default Database, with BCC and CheckSum as database_setup() checks them on STM32F401
+static void make_seed_db(uint8_t *image)
+{
+  uint8_t checksum = 0, bcc = 0;
+  uint32_t iter;
+
+  memcpy(image, &DEFAULT_MSX_KEYB_DATABASE_CONVERSION[0][0], DATABASE_SIZE);
+  for(iter = 0; iter < (DATABASE_SIZE - DB_NUM_COLS); iter++)
+  {
+    checksum += image[iter];
+    bcc ^= image[iter];
+  }
+  image[DATABASE_SIZE - 2] = bcc;
+  image[DATABASE_SIZE - 1] = (uint8_t)(0x100 - checksum);
+}
+
+
+//Intel Hex file as the Database Compiler writes it: linear address 0x0800, data from INITIAL_DATABASE on
+static size_t write_ihex(uint8_t *out, size_t out_size, const uint8_t *image, uint8_t record_len, const char *eol)
+{
+  uint16_t address = (uint16_t)(INITIAL_DATABASE & 0xFFFF);
+  uint32_t offset;
+  size_t len = 0;
+  uint8_t n, i, sum;
+  int w;
+
+  w = snprintf((char*)out, out_size, ":02000004%04X%02X%s", HEX_LINEAR_ADDRESS,
+               (uint8_t)(0x100 - (2 + 4 + (HEX_LINEAR_ADDRESS >> 8) + (HEX_LINEAR_ADDRESS & 0xFF))), eol);
+  len += (size_t)w;
+  for(offset = 0; offset < DATABASE_SIZE; offset += n)
+  {
+    n = (uint8_t)(((DATABASE_SIZE - offset) < record_len) ? (DATABASE_SIZE - offset) : record_len);
+    sum = (uint8_t)(n + ((address + offset) >> 8) + (address + offset));
+    w = snprintf((char*)out + len, out_size - len, ":%02X%04X00", n, (uint16_t)(address + offset));
+    len += (size_t)w;
+    for(i = 0; i < n; i++)
+    {
+      sum += image[offset + i];
+      w = snprintf((char*)out + len, out_size - len, "%02X", image[offset + i]);
+      len += (size_t)w;
+    }
+    w = snprintf((char*)out + len, out_size - len, "%02X%s", (uint8_t)(0x100 - sum), eol);
+    len += (size_t)w;
+  }
+  w = snprintf((char*)out + len, out_size - len, ":00000001FF%s", eol);
+  len += (size_t)w;
+  return len;
+}
+
+
+static bool write_corpus(const char *dir)
+{
+  static const struct
+  {
+    const char *name;
+    uint8_t record_len;
+    const char *eol;
+    bool interrupted;                             //Starts with a ^C'ed transfer, then sends it all again
+  } seeds[] = {
+    { "default_16.hex", 16, "\r\n", false },
+    { "default_32_lf.hex", 32, "\n", false },
+    { "default_58.hex", MAX_RECORD_DATA, "\r\n", false },
+    { "interrupted_resent.hex", 16, "\r\n", true },
+  };
+  static uint8_t file[2 * MAX_INPUT_SIZE];
+  char path[1024];
+  size_t len, s;
+  FILE *f;
+
+  for(s = 0; s < sizeof(seeds) / sizeof(seeds[0]); s++)
+  {
+    len = write_ihex(file, sizeof(file), seed_db, seeds[s].record_len, seeds[s].eol);
+    if(seeds[s].interrupted)
+    {
+      memmove(file + (len / 2) + 3, file, len);
+      file[len / 2] = 3;
+      file[len / 2 + 1] = '\r';
+      file[len / 2 + 2] = '\n';
+      len += (len / 2) + 3;
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, seeds[s].name);
+    f = fopen(path, "wb");
+    if(!f || (fwrite(file, 1, len, f) != len) || fclose(f))
+    {
+      perror(path);
+      return false;
+    }
+  }
+  return true;
+}
+
+
+static bool read_file(const char *name, struct fuzz_input *in)
+{
+  FILE *f = strcmp(name, "-") ? fopen(name, "rb") : stdin;
+
+  in->data = (uint8_t*)malloc(MAX_INPUT_SIZE);
+  if(!f || !in->data)
+  {
+    perror(name);
+    return false;
+  }
+  in->len = fread(in->data, 1, MAX_INPUT_SIZE, f);
+  if(f != stdin)
+    fclose(f);
+  return true;
+}
+
+
+static uint8_t hex_value(uint8_t ch)
+{
+  if((ch >= '0') && (ch <= '9'))
+    return (uint8_t)(ch - '0');
+  if((ch >= 'A') && (ch <= 'F'))
+    return (uint8_t)(ch - 'A' + 10);
+  return 0xFF;
+}
+
+
+//Independent reference of a well formed file: only capital hex digits, ':' and CR/LF, every line a valid
+//record of types 0, 1 or 4, data inside of the Database, and the end-of-file record as the last line.
+//Then image gets what must be programmed.
+static bool parse_well_formed(const uint8_t *data, size_t len, uint8_t *image)
+{
+  uint8_t rec[5 + MAX_RECORD_DATA], sum, type, n;
+  size_t pos = 0, start, line_len, i;
+  uint32_t first = 0x10000, address;
+  bool eof = false;
+
+  memset(image, 0xFF, DATABASE_SIZE);
+  while(pos < len)
+  {
+    if((data[pos] == '\r') || (data[pos] == '\n'))
+    {
+      pos++;
+      continue;
+    }
+    if(eof || (data[pos] != ':'))
+      return false;
+    start = ++pos;
+    while((pos < len) && (data[pos] != '\r') && (data[pos] != '\n'))
+      pos++;
+    if(pos == len)
+      return false;                               //A record must end with CR or LF
+    line_len = pos - start;
+    if((line_len < 10) || (line_len & 1) || (line_len / 2 > sizeof(rec)))
+      return false;
+    for(i = 0, sum = 0; i < line_len / 2; i++)
+    {
+      if((hex_value(data[start + 2 * i]) > 15) || (hex_value(data[start + 2 * i + 1]) > 15))
+        return false;
+      rec[i] = (uint8_t)((hex_value(data[start + 2 * i]) << 4) | hex_value(data[start + 2 * i + 1]));
+      sum += rec[i];
+    }
+    n = rec[0];
+    type = rec[3];
+    address = ((uint32_t)rec[1] << 8) | rec[2];
+    if((sum != 0) || (line_len != (size_t)(2 * n + 10)))
+      return false;
+    if(type == 0)
+    {
+      if(first > 0xFFFF)
+        first = address;
+      if((address < first) || ((address - first + n) > DATABASE_SIZE))
+        return false;
+      memcpy(image + (address - first), &rec[4], n);
+    }
+    else if(type == 1)
+      eof = true;
+    else if((type != 4) || (n != 2) || (rec[4] != (HEX_LINEAR_ADDRESS >> 8)))
+      return false;
+  }
+  return eof;
+}
+
+
+//Erases flash sector 3 and programs images Databases from INITIAL_DATABASE down, as flash_program_data() does
+static void prefill_flash(uint8_t images)
+{
+  uint32_t slot;
+  uint8_t i;
+
+  flash_erase_sector(FLASH_SECTOR3_NUMBER, FLASH_CR_PROGRAM_X8);
+  for(i = 0; i < images; i++)
+  {
+    slot = INITIAL_DATABASE - (uint32_t)i * DATABASE_SIZE;
+    flash_program(slot, seed_db, DATABASE_SIZE);
+    if(i > 0)
+      flash_program(slot + DATABASE_SIZE, UNUSED_DATABASE, DB_NUM_COLS);
+  }
+  FLASH_SR = 0;
+}
+
+
+//The firmware sleeps only while waiting for console input: the next bytes are put on the RX line, or the input ends
+static void feed_hook(void)
+{
+  size_t n;
+
+  if(feed_pos >= feed_len)
+    longjmp(feed_end, 1);
+  n = ((feed_len - feed_pos) < FEED_CHUNK) ? (feed_len - feed_pos) : FEED_CHUNK;
+  host_uart_rx(feed_data + feed_pos, (uint16_t)n);
+  feed_pos += n;
+}
+
+
+//Runs flash_rw() with the input on the console. It returns false if the input ends before the file is received.
+static bool receive_input(const uint8_t *data, size_t len, int *result)
+{
+  volatile bool completed = false;
+
+  feed_data = data;
+  feed_len = len;
+  feed_pos = 0;
+  host_wfi_hook = feed_hook;
+  if(!setjmp(feed_end))
+  {
+    *result = flash_rw();
+    completed = true;
+  }
+  host_wfi_hook = NULL;
+  return completed;
+}
+
+
+static void fail(const char *what, uint64_t idx)
+{
+  failures++;
+  if(++failures_reported <= MAX_REPORTED_FAILURES)
+    fprintf(stderr, "ihex-fuzz-host: input %llu: %s\n", (unsigned long long)idx, what);
+}
+
+
+static bool run_input(const uint8_t *data, size_t len, uint8_t prefill, uint64_t idx)
+{
+  static uint8_t expected[DATABASE_SIZE];
+  bool completed;
+  int result = -1;
+  uint32_t failures_before = failures, slot, iter;
+  uint8_t *db, checksum, bcc;
+  bool well_formed;
+  size_t i;
+
+  inputs++;
+  for(i = 0; i < len; i++)
+    if(data[i] == ':')
+      records++;
+  well_formed = parse_well_formed(data, len, expected);
+  prefill_flash(prefill);
+  slot = (prefill < NUM_DATABASE_IMG) ? (INITIAL_DATABASE - (uint32_t)prefill * DATABASE_SIZE) : INITIAL_DATABASE;
+  while(con_available_get_char())
+    con_get_char();
+
+  completed = receive_input(data, len, &result);
+  if(completed)
+  {
+    received++;
+    if(result == RESULT_OK)
+      programmed++;
+  }
+  if(FLASH_SR & FLASH_SR_WRPERR)
+    fail("programming out of flash sector 3", idx);
+
+  if(well_formed)
+  {
+    if(!completed)
+      fail("well formed file not received", idx);
+    else if(result != RESULT_OK)
+      fail("well formed file not programmed", idx);
+    else if(memcmp((const void*)(uintptr_t)slot, expected, DATABASE_SIZE))
+      fail("programmed image differs from the file", idx);
+  }
+
+  database_setup();
+  db = base_of_database;
+  if(!compatible_database)
+    fail("no compatible Database after database_setup()", idx);
+  else if(db != &DEFAULT_MSX_KEYB_DATABASE_CONVERSION[0][0])
+  {
+    if( ((uintptr_t)db < FLASH_SECTOR3_BASE) || ((uintptr_t)db > INITIAL_DATABASE) ||
+        ((INITIAL_DATABASE - (uintptr_t)db) % (DATABASE_SIZE)) )
+      fail("database_setup() selected a Database out of the flash slots", idx);
+    else
+    {
+      for(iter = 0, checksum = 0, bcc = 0; iter < (DATABASE_SIZE - DB_NUM_COLS); iter++)
+      {
+        checksum += db[iter];
+        bcc ^= db[iter];
+      }
+      if( (uint8_t)(db[DATABASE_SIZE - 1] + checksum) || (db[DATABASE_SIZE - 2] != bcc) || (db[0] != 1) || db[1] )
+        fail("database_setup() selected an inconsistent Database", idx);
+    }
+  }
+  return failures == failures_before;
+}
+
+
+//xorshift32: repeatable from the seed
+static uint32_t rnd_range(uint32_t min, uint32_t max)
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return min + (rnd_state % (max - min + 1));
+}
+
+
+//Record aware mutations: the field edits fix the record checksum, so the record goes past it
+static size_t mutate(uint8_t *buf, size_t len, const struct fuzz_input *corpus, uint32_t corpus_len)
+{
+  static const char alphabet[] = "0123456789ABCDEF:\r\n\3";
+  static const char hex[] = "0123456789ABCDEF";
+  uint32_t m, count = rnd_range(1, 4);
+  size_t pos, span, rec, end, i;
+  const struct fuzz_input *other;
+  uint8_t value, sum;
+
+  for(m = 0; m < count; m++)
+  {
+    pos = len ? rnd_range(0, (uint32_t)(len - 1)) : 0;
+    switch(rnd_range(0, 6))
+    {
+      case 0:   //One character
+        if(len)
+          buf[pos] = (rnd_range(0, 3) == 0) ? (uint8_t)rnd_range(0, 255) : (uint8_t)alphabet[rnd_range(0, sizeof(alphabet) - 2)];
+        break;
+      case 1:   //Delete a span
+        span = rnd_range(1, 64);
+        if(pos + span > len)
+          span = len - pos;
+        memmove(buf + pos, buf + pos + span, len - pos - span);
+        len -= span;
+        break;
+      case 2:   //Duplicate a span somewhere else
+        span = rnd_range(1, 256);
+        if(pos + span > len)
+          span = len - pos;
+        end = len ? rnd_range(0, (uint32_t)len) : 0;
+        if(len + span > MAX_INPUT_SIZE)
+          break;
+        memmove(buf + end + span, buf + end, len - end);
+        memmove(buf + end, buf + ((pos >= end) ? pos + span : pos), span);
+        len += span;
+        break;
+      case 3:   //Splice the tail of another input
+        other = &corpus[rnd_range(0, corpus_len - 1)];
+        end = other->len ? rnd_range(0, (uint32_t)(other->len - 1)) : 0;
+        if(pos + (other->len - end) <= MAX_INPUT_SIZE)
+        {
+          memcpy(buf + pos, other->data + end, other->len - end);
+          len = pos + (other->len - end);
+        }
+        break;
+      default:  //Record length, address high, address low or type field, with its checksum fixed
+        for(rec = pos; (rec > 0) && (buf[rec] != ':'); rec--);
+        if((buf[rec] != ':') || (rec + 11 > len))
+          break;
+        value = (uint8_t)rnd_range(0, 255);
+        i = rec + 1 + 2 * rnd_range(0, 3);
+        buf[i] = (uint8_t)hex[value >> 4];
+        buf[i + 1] = (uint8_t)hex[value & 0x0F];
+        for(end = rec + 1; (end < len) && (hex_value(buf[end]) < 16); end++);
+        if((end - rec - 1 < 10) || ((end - rec - 1) & 1))
+          break;
+        for(i = rec + 1, sum = 0; i < end - 2; i += 2)
+          sum += (uint8_t)((hex_value(buf[i]) << 4) | hex_value(buf[i + 1]));
+        sum = (uint8_t)(0x100 - sum);
+        buf[end - 2] = (uint8_t)hex[sum >> 4];
+        buf[end - 1] = (uint8_t)hex[sum & 0x0F];
+        break;
+    }
+  }
+  return len;
+}
+
+
+static void save_failure(const uint8_t *data, size_t len)
+{
+  char name[64];
+  FILE *f;
+
+  snprintf(name, sizeof(name), "ihex-fuzz-fail-%u.hex", failures_reported);
+  f = fopen(name, "wb");
+  if(f)
+  {
+    fwrite(data, 1, len, f);
+    fclose(f);
+  }
+}
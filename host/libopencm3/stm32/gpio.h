@@ -0,0 +1 @@
+#include "opencm3_host.h"
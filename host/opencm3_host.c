@@ -0,0 +1,1360 @@
+/** @addtogroup 14 host Host Simulation Shim
+ *
+ * @file opencm3_host.c libopencm3 register level shim to run the firmware modules on a workstation.
+ *
+ * @brief <b>libopencm3 register level shim to run the firmware modules on a workstation.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "opencm3_host.h"
+
+//Peripheral register blocks. A static pool keeps their addresses under 4GB (linked with -no-pie),
+//as the firmware stores &USART_DR() and buffer addresses on 32 bits DMA registers.
+#define MMIO_BLOCK_SIZE           0x400
+#define MMIO_BLOCKS               32
+static uint32_t mmio_block_base[MMIO_BLOCKS];
+static volatile uint32_t mmio_pool[MMIO_BLOCKS][MMIO_BLOCK_SIZE / sizeof(uint32_t)];
+static uint8_t mmio_blocks_used, mmio_last_block;
+
+#define NVIC_HOST_SLOTS           (NVIC_IRQ_COUNT + 1)  //Last slot is SysTick
+#define IRQ_THREAD_PRIORITY       0x100
+
+#define DMA_SxPAR(port, n)        MMIO32((port) + 0x18 + (0x18 * (n)))
+#define DMA_SxM0AR(port, n)       MMIO32((port) + 0x1C + (0x18 * (n)))
+#define DMA_SxCR_DIR_MASK         (3 << 6)
+#define DMA_SxCR_MINC             (1 << 10)
+#define DMA_SxCR_PINC             (1 << 9)
+#define DMA_SxCR_CIRC             (1 << 8)
+#define DMA_SxCR_TCIE             (1 << 4)
+#define DMA_SxCR_HTIE             (1 << 3)
+#define DMA_SxCR_CHSEL_MASK       (7 << 25)
+#define DMA_SxCR_PL_MASK          (3 << 16)
+#define DMA_SxCR_MSIZE_MASK       (3 << 13)
+#define DMA_SxCR_PSIZE_MASK       (3 << 11)
+#define USART_CR3(u)              MMIO32((u) + 0x14)
+#define USART_CR3_DMAT            (1 << 7)
+#define USART_CR3_DMAR            (1 << 6)
+#define USART_CR1_UE              (1 << 13)
+#define GPIO_PUPDR(port)          MMIO32((port) + 0x0C)
+#define TIM_CR1_CKD_MASK          (3 << 8)
+#define TIM_CR1_CMS_MASK          (3 << 5)
+#define TIM_CR1_DIR_DOWN          (1 << 4)
+#define STK_CSR_ENABLE            (1 << 0)
+#define STK_CSR_TICKINT           (1 << 1)
+
+uint64_t host_time_usec;
+uint32_t rcc_ahb_frequency = 16000000, rcc_apb1_frequency = 16000000, rcc_apb2_frequency = 16000000;
+const struct rcc_clock_scale rcc_hse_25mhz_3v3[RCC_CLOCK_3V3_END] = {
+  { 84000000, 42000000, 84000000 },   //RCC_CLOCK_3V3_84MHZ
+};
+
+static void host_uart_tx_stdout(const uint8_t *data, uint16_t len);
+static void host_reset_exit(void);
+void (*host_uart_tx_hook)(const uint8_t *data, uint16_t len) = host_uart_tx_stdout;
+void (*host_reset_hook)(void) = host_reset_exit;
+void (*host_gpio_hook)(uint32_t gpioport);
+void (*host_wfi_hook)(void);
+
+//NVIC & PRIMASK
+static bool irq_enabled[NVIC_HOST_SLOTS], irq_pending[NVIC_HOST_SLOTS];
+static uint8_t irq_priority[NVIC_HOST_SLOTS];
+static uint16_t irq_running_priority = IRQ_THREAD_PRIORITY;
+static bool primask;
+static uint8_t basepri;                         //Interrupts of this priority and lower are held, as NVIC does
+static uint32_t irq_wakeups;                    //Enabled interrupts raised: these end a WFI
+
+//GPIO external levels (default pulled up), and former IDR to detect EXTI edges
+#define GPIO_PORTS                3
+static const uint32_t gpio_ports[GPIO_PORTS] = { GPIOA, GPIOB, GPIOC };
+static uint16_t gpio_ext_level[GPIO_PORTS] = { 0xFFFF, 0xFFFF, 0xFFFF };
+static uint16_t gpio_former_idr[GPIO_PORTS] = { 0xFFFF, 0xFFFF, 0xFFFF };
+static uint16_t gpio_former_odr[GPIO_PORTS];
+//Configuration and levels of the last sync: when none changed and nothing was written, IDR is the same
+static uint32_t gpio_former_moder[GPIO_PORTS], gpio_former_otyper[GPIO_PORTS];
+static uint16_t gpio_former_ext[GPIO_PORTS];
+static bool gpio_synced[GPIO_PORTS];
+
+//EXTI
+static uint16_t exti_imr, exti_rtsr, exti_ftsr, exti_pr;
+static uint32_t exti_source[16] = { GPIOA, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA,
+                                    GPIOA, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA };
+
+//SysTick
+static uint32_t systick_reload;
+static uint8_t systick_csr;
+static uint64_t systick_next_usec;
+
+//Board model callbacks
+#define HOST_SCHEDULE_SLOTS       16
+static struct
+{
+  uint64_t when;
+  void (*callback)(void);
+} host_schedule[HOST_SCHEDULE_SLOTS];
+
+//DMA: interrupt flags (LISR/HISR) and programmed number of data to reload circular streams
+static const int8_t dma_irq[2][8] = {
+  { NVIC_DMA1_STREAM0_IRQ, 12, 13, 14, 15, NVIC_DMA1_STREAM5_IRQ, NVIC_DMA1_STREAM6_IRQ, NVIC_DMA1_STREAM7_IRQ },
+  { NVIC_DMA2_STREAM0_IRQ, NVIC_DMA2_STREAM1_IRQ, NVIC_DMA2_STREAM2_IRQ, 59, 60,
+    NVIC_DMA2_STREAM5_IRQ, NVIC_DMA2_STREAM6_IRQ, NVIC_DMA2_STREAM7_IRQ } };
+static uint32_t dma_flags[2][8];
+static uint16_t dma_size[2][8];
+
+//Prototypes of internal functions
+static int irq_slot(int irqn);
+static void irq_dispatch(void);
+static void irq_vector(int slot);
+static uint16_t irq_exti_lines(int slot);
+static int gpio_index(uint32_t gpioport);
+static void gpio_sync_all(void);
+static void exti_raise(uint16_t lines);
+static int dma_index(uint32_t dma);
+static void dma_transfer_mem_to_usart(uint32_t dma, uint8_t stream);
+static uint64_t systick_period_usec(void);
+static uint8_t *flash_address(uint32_t address, uint32_t len);
+static void timer_set_counter_now(void);
+static bool host_schedule_run_due(void);
+static void host_run(uint64_t target, bool until_wakeup);
+
+
+//Default (weak) ISR's. The firmware modules linked override the ones they handle.
+void __attribute__((weak)) sys_tick_handler(void) {}
+void __attribute__((weak)) tim2_isr(void) {}
+void __attribute__((weak)) exti0_isr(void) {}
+void __attribute__((weak)) exti1_isr(void) {}
+void __attribute__((weak)) exti2_isr(void) {}
+void __attribute__((weak)) exti3_isr(void) {}
+void __attribute__((weak)) exti4_isr(void) {}
+void __attribute__((weak)) exti9_5_isr(void) {}
+void __attribute__((weak)) exti15_10_isr(void) {}
+void __attribute__((weak)) usart1_isr(void) {}
+void __attribute__((weak)) usart2_isr(void) {}
+void __attribute__((weak)) dma1_stream5_isr(void) {}
+void __attribute__((weak)) dma1_stream6_isr(void) {}
+void __attribute__((weak)) dma2_stream1_isr(void) {}
+void __attribute__((weak)) dma2_stream2_isr(void) {}
+void __attribute__((weak)) dma2_stream6_isr(void) {}
+void __attribute__((weak)) dma2_stream7_isr(void) {}
+void __attribute__((weak)) otg_fs_isr(void) {}
+
+
+/*************************************************************************************************/
+/*************************************** Registers ***********************************************/
+/*************************************************************************************************/
+volatile uint32_t *host_mmio32(uint32_t address)
+{
+  uint32_t base = address & ~(uint32_t)(MMIO_BLOCK_SIZE - 1);
+  uint8_t i;
+
+  if((mmio_blocks_used != 0) && (mmio_block_base[mmio_last_block] == base))
+    return &mmio_pool[mmio_last_block][(address - base) / sizeof(uint32_t)];
+  for(i = 0; i < mmio_blocks_used; i++)
+    if(mmio_block_base[i] == base)
+    {
+      mmio_last_block = i;
+      return &mmio_pool[i][(address - base) / sizeof(uint32_t)];
+    }
+  if(mmio_blocks_used >= MMIO_BLOCKS)
+  {
+    fprintf(stderr, "host: no room to map register 0x%08X\n", (unsigned)address);
+    exit(EXIT_FAILURE);
+  }
+  mmio_block_base[mmio_blocks_used] = base;
+  mmio_last_block = mmio_blocks_used;
+  return &mmio_pool[mmio_blocks_used++][(address - base) / sizeof(uint32_t)];
+}
+
+
+/*************************************************************************************************/
+/***************************************** NVIC **************************************************/
+/*************************************************************************************************/
+static int irq_slot(int irqn)
+{
+  irqn = (int8_t)irqn;  //nvic_xxx(NVIC_SYSTICK_IRQ) arrives as uint8_t 0xFF
+  return (irqn < 0) ? NVIC_IRQ_COUNT : irqn;
+}
+
+
+static void irq_vector(int slot)
+{
+  switch(slot)
+  {
+    case NVIC_EXTI0_IRQ:        exti0_isr();        break;
+    case NVIC_EXTI1_IRQ:        exti1_isr();        break;
+    case NVIC_EXTI2_IRQ:        exti2_isr();        break;
+    case NVIC_EXTI3_IRQ:        exti3_isr();        break;
+    case NVIC_EXTI4_IRQ:        exti4_isr();        break;
+    case NVIC_DMA1_STREAM5_IRQ: dma1_stream5_isr(); break;
+    case NVIC_DMA1_STREAM6_IRQ: dma1_stream6_isr(); break;
+    case NVIC_EXTI9_5_IRQ:      exti9_5_isr();      break;
+    case NVIC_TIM2_IRQ:         tim2_isr();         break;
+    case NVIC_USART1_IRQ:       usart1_isr();       break;
+    case NVIC_USART2_IRQ:       usart2_isr();       break;
+    case NVIC_EXTI15_10_IRQ:    exti15_10_isr();    break;
+    case NVIC_DMA2_STREAM1_IRQ: dma2_stream1_isr(); break;
+    case NVIC_DMA2_STREAM2_IRQ: dma2_stream2_isr(); break;
+    case NVIC_OTG_FS_IRQ:       otg_fs_isr();       break;
+    case NVIC_DMA2_STREAM6_IRQ: dma2_stream6_isr(); break;
+    case NVIC_DMA2_STREAM7_IRQ: dma2_stream7_isr(); break;
+    case NVIC_IRQ_COUNT:        sys_tick_handler(); break;
+    default:                                        break;
+  }
+}
+
+
+//EXTI lines of a shared IRQ, or 0
+static uint16_t irq_exti_lines(int slot)
+{
+  switch(slot)
+  {
+    case NVIC_EXTI0_IRQ:        return EXTI0;
+    case NVIC_EXTI1_IRQ:        return EXTI1;
+    case NVIC_EXTI2_IRQ:        return EXTI2;
+    case NVIC_EXTI3_IRQ:        return EXTI3;
+    case NVIC_EXTI4_IRQ:        return EXTI4;
+    case NVIC_EXTI9_5_IRQ:      return EXTI5 | EXTI6 | EXTI7 | EXTI8 | EXTI9;
+    case NVIC_EXTI15_10_IRQ:    return EXTI10 | EXTI11 | EXTI12 | EXTI13 | EXTI14 | EXTI15;
+    default:                    return 0;
+  }
+}
+
+
+//Runs the pending and enabled interrupts that preempt the running priority, most urgent first.
+//Same priority is served by the lowest number, as NVIC does.
+static void irq_dispatch(void)
+{
+  int slot, best;
+  uint16_t former_priority;
+
+  while(!primask)
+  {
+    best = -1;
+    for(slot = 0; slot < NVIC_HOST_SLOTS; slot++)
+      if(irq_pending[slot] && irq_enabled[slot] && (irq_priority[slot] < irq_running_priority) &&
+        (!basepri || (irq_priority[slot] < basepri)) &&
+        ((best < 0) || (irq_priority[slot] < irq_priority[best])))
+        best = slot;
+    if(best < 0)
+      return;
+    irq_pending[best] = false;
+    former_priority = irq_running_priority;
+    irq_running_priority = irq_priority[best];
+    irq_vector(best);
+    gpio_sync_all();
+    irq_running_priority = former_priority;
+    //A line left pending (as the PS/2 clock, when exti15_10_isr() serves Y6 or Y7) enters it again
+    if(exti_pr & irq_exti_lines(best))
+      irq_pending[best] = true;
+  }
+}
+
+
+void host_irq_raise(int irqn)
+{
+  int slot = irq_slot(irqn);
+
+  irq_pending[slot] = true;
+  if(irq_enabled[slot])
+    irq_wakeups++;
+  irq_dispatch();
+}
+
+
+void nvic_enable_irq(uint8_t irqn)
+{
+  irq_enabled[irq_slot(irqn)] = true;
+  irq_dispatch();
+}
+
+
+void nvic_disable_irq(uint8_t irqn)
+{
+  irq_enabled[irq_slot(irqn)] = false;
+}
+
+
+void nvic_set_priority(uint8_t irqn, uint8_t priority)
+{
+  irq_priority[irq_slot(irqn)] = priority;
+}
+
+
+uint32_t cm_mask_interrupts(uint32_t mask)
+{
+  uint32_t former = primask;
+  primask = (mask != 0);
+  irq_dispatch();
+  return former;
+}
+
+
+void cm_enable_interrupts(void)
+{
+  primask = false;
+  irq_dispatch();
+}
+
+
+void cm_disable_interrupts(void)
+{
+  primask = true;
+}
+
+
+//As MSR BASEPRI_MAX: only a more urgent (lower, not 0) priority is written
+uint32_t host_basepri_raise(uint32_t priority)
+{
+  uint32_t former = basepri;
+
+  if(priority && (!basepri || (priority < basepri)))
+    basepri = (uint8_t)priority;
+  return former;
+}
+
+
+void host_basepri_set(uint32_t priority)
+{
+  basepri = (uint8_t)priority;
+  irq_dispatch();
+}
+
+
+void scb_reset_system(void)
+{
+  host_reset_hook();
+}
+
+
+static void host_reset_exit(void)
+{
+  fflush(stdout);
+  fprintf(stderr, "host: scb_reset_system() at %llu us\n", (unsigned long long)host_time_usec);
+  exit(EXIT_FAILURE);
+}
+
+
+/*************************************************************************************************/
+/************************************* Time: SysTick & TIM2 **************************************/
+/*************************************************************************************************/
+void systick_set_reload(uint32_t value)
+{
+  systick_reload = value;
+}
+
+
+void systick_set_clocksource(uint8_t clocksource)
+{
+  systick_csr = (systick_csr & ~STK_CSR_CLKSOURCE_AHB) | (clocksource & STK_CSR_CLKSOURCE_AHB);
+}
+
+
+void systick_counter_enable(void)
+{
+  systick_csr |= STK_CSR_ENABLE;
+  systick_next_usec = host_time_usec + systick_period_usec();
+}
+
+
+void systick_interrupt_enable(void)
+{
+  systick_csr |= STK_CSR_TICKINT;
+  irq_enabled[irq_slot(NVIC_SYSTICK_IRQ)] = true;
+}
+
+
+void systick_interrupt_disable(void)
+{
+  systick_csr &= ~STK_CSR_TICKINT;
+  irq_enabled[irq_slot(NVIC_SYSTICK_IRQ)] = false;
+}
+
+
+void systick_clear(void)
+{
+  systick_next_usec = host_time_usec + systick_period_usec();
+}
+
+
+static uint64_t systick_period_usec(void)
+{
+  uint64_t clock = (systick_csr & STK_CSR_CLKSOURCE_AHB) ? rcc_ahb_frequency : (rcc_ahb_frequency / 8);
+  uint64_t period = ((uint64_t)systick_reload + 1) * 1000000 / clock;
+  return period ? period : 1;
+}
+
+
+bool dwt_enable_cycle_counter(void)
+{
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+  return true;
+}
+
+
+uint32_t dwt_read_cycle_counter(void)
+{
+  return DWT_CYCCNT;
+}
+
+
+//Counters are plain registers, so they are refreshed each time the virtual time changes.
+//TIM2 counts at 1MHz, as TIM_HR is programmed for, independently of PSC.
+static void timer_set_counter_now(void)
+{
+  if(TIM_CR1(TIM2) & TIM_CR1_CEN)
+    TIM_CNT(TIM2) = (uint32_t)host_time_usec;
+  if(DWT_CTRL & DWT_CTRL_CYCCNTENA)
+    DWT_CYCCNT = (uint32_t)(host_time_usec * (rcc_ahb_frequency / 1000000));
+}
+
+
+void host_schedule_usec(uint32_t usec, void (*callback)(void))
+{
+  uint8_t i;
+
+  for(i = 0; i < HOST_SCHEDULE_SLOTS; i++)
+    if(host_schedule[i].callback == NULL)
+    {
+      host_schedule[i].when = host_time_usec + usec;
+      host_schedule[i].callback = callback;
+      return;
+    }
+  fprintf(stderr, "host: no room to schedule a callback\n");
+  exit(EXIT_FAILURE);
+}
+
+
+void host_unschedule(void (*callback)(void))
+{
+  uint8_t i;
+
+  for(i = 0; i < HOST_SCHEDULE_SLOTS; i++)
+    if(host_schedule[i].callback == callback)
+      host_schedule[i].callback = NULL;
+}
+
+
+//Runs the earliest scheduled callback already due. Returns false when there is none.
+static bool host_schedule_run_due(void)
+{
+  uint8_t i, due = HOST_SCHEDULE_SLOTS;
+  void (*callback)(void);
+
+  for(i = 0; i < HOST_SCHEDULE_SLOTS; i++)
+    if( host_schedule[i].callback && (host_schedule[i].when <= host_time_usec) &&
+        ((due == HOST_SCHEDULE_SLOTS) || (host_schedule[i].when < host_schedule[due].when)) )
+      due = i;
+  if(due == HOST_SCHEDULE_SLOTS)
+    return false;
+  callback = host_schedule[due].callback;
+  host_schedule[due].callback = NULL;   //Slot is free before the call, so callback may schedule again
+  callback();
+  return true;
+}
+
+
+void host_run_usec(uint32_t usec)
+{
+  host_run(host_time_usec + usec, false);
+}
+
+
+//Advances to target, or up to the first enabled interrupt raised when until_wakeup is true
+static void host_run(uint64_t target, bool until_wakeup)
+{
+  uint64_t next;
+  uint32_t cnt, delta, wakeups = irq_wakeups;
+  bool cc2_due, update_due;
+  uint8_t i;
+
+  do
+  {
+    //Software generated compare events (EGR) are served first
+    if(TIM_EGR(TIM2) & (TIM_EGR_CC2G | TIM_EGR_CC1G | TIM_EGR_UG))
+    {
+      if(TIM_EGR(TIM2) & TIM_EGR_CC2G)
+        TIM_SR(TIM2) |= TIM_SR_CC2IF;
+      if(TIM_EGR(TIM2) & TIM_EGR_CC1G)
+        TIM_SR(TIM2) |= TIM_SR_CC1IF;
+      TIM_EGR(TIM2) = 0;
+      if(TIM_SR(TIM2) & TIM_DIER(TIM2) & (TIM_SR_CC2IF | TIM_SR_CC1IF))
+        host_irq_raise(NVIC_TIM2_IRQ);
+    }
+
+    //Finds the next instant something happens
+    next = target;
+    cc2_due = false;
+    update_due = false;
+    if((systick_csr & STK_CSR_ENABLE) && (systick_next_usec < next))
+      next = systick_next_usec;
+    for(i = 0; i < HOST_SCHEDULE_SLOTS; i++)
+      if(host_schedule[i].callback && (host_schedule[i].when < next))
+        next = (host_schedule[i].when > host_time_usec) ? host_schedule[i].when : host_time_usec;
+    if(TIM_CR1(TIM2) & TIM_CR1_CEN)
+    {
+      cnt = (uint32_t)host_time_usec;
+      delta = TIM_CCR2(TIM2) - cnt;
+      if((TIM_DIER(TIM2) & TIM_DIER_CC2IE) && delta && (host_time_usec + delta <= next))
+      {
+        next = host_time_usec + delta;
+        cc2_due = true;
+      }
+      if((host_time_usec | 0xFFFFFFFFULL) + 1 <= next)
+      {
+        if((host_time_usec | 0xFFFFFFFFULL) + 1 < next)
+          cc2_due = false;
+        next = (host_time_usec | 0xFFFFFFFFULL) + 1;
+        update_due = true;
+      }
+    }
+
+    host_time_usec = next;
+    timer_set_counter_now();
+
+    if(update_due)
+      TIM_SR(TIM2) |= TIM_SR_UIF;
+    if(cc2_due && (TIM_CCR2(TIM2) == (uint32_t)host_time_usec))
+      TIM_SR(TIM2) |= TIM_SR_CC2IF;
+    if((update_due && (TIM_DIER(TIM2) & TIM_DIER_UIE)) || (cc2_due && (TIM_DIER(TIM2) & TIM_DIER_CC2IE)))
+      host_irq_raise(NVIC_TIM2_IRQ);
+    if((systick_csr & STK_CSR_ENABLE) && (systick_next_usec <= host_time_usec))
+    {
+      systick_next_usec += systick_period_usec();
+      if(systick_csr & STK_CSR_TICKINT)
+        host_irq_raise(NVIC_SYSTICK_IRQ);
+    }
+    while(host_schedule_run_due());
+  } while( ((host_time_usec < target) && !(until_wakeup && (irq_wakeups != wakeups))) ||
+           (TIM_EGR(TIM2) & (TIM_EGR_CC2G | TIM_EGR_CC1G | TIM_EGR_UG)) );
+}
+
+
+void host_spin(void)
+{
+  host_run_usec(1);
+}
+
+
+//A WFI with nothing to wake it up would never end: HOST_WFI_MAX_USEC bounds it
+void host_asm(const char *instruction)
+{
+  if(!strcmp(instruction, "wfi"))
+  {
+    if(host_wfi_hook)
+      host_wfi_hook();
+    host_run(host_time_usec + HOST_WFI_MAX_USEC, true);
+  }
+  else
+    host_spin();
+}
+
+
+void timer_set_mode(uint32_t timer_peripheral, uint32_t clock_div, uint32_t alignment, uint32_t direction)
+{
+  //As libopencm3 does, alignment is just ORed, so TIM_CR1_CEN there starts the counter
+  TIM_CR1(timer_peripheral) = (TIM_CR1(timer_peripheral) & ~(TIM_CR1_CKD_MASK | TIM_CR1_CMS_MASK | TIM_CR1_DIR_DOWN)) |
+                              clock_div | alignment | direction;
+  timer_set_counter_now();
+}
+
+
+void timer_set_prescaler(uint32_t timer_peripheral, uint32_t value)
+{
+  TIM_PSC(timer_peripheral) = value;
+}
+
+
+void timer_set_period(uint32_t timer_peripheral, uint32_t period)
+{
+  TIM_ARR(timer_peripheral) = period;
+}
+
+
+void timer_enable_preload(uint32_t timer_peripheral)
+{
+  TIM_CR1(timer_peripheral) |= TIM_CR1_ARPE;
+}
+
+
+void timer_enable_counter(uint32_t timer_peripheral)
+{
+  TIM_CR1(timer_peripheral) |= TIM_CR1_CEN;
+  timer_set_counter_now();
+}
+
+
+void timer_enable_irq(uint32_t timer_peripheral, uint32_t irq)
+{
+  TIM_DIER(timer_peripheral) |= irq;
+}
+
+
+void timer_disable_irq(uint32_t timer_peripheral, uint32_t irq)
+{
+  TIM_DIER(timer_peripheral) &= ~irq;
+}
+
+
+bool timer_get_flag(uint32_t timer_peripheral, uint32_t flag)
+{
+  return (TIM_SR(timer_peripheral) & flag) != 0;
+}
+
+
+void timer_clear_flag(uint32_t timer_peripheral, uint32_t flag)
+{
+  TIM_SR(timer_peripheral) &= ~flag;
+}
+
+
+void iwdg_set_period_ms(uint32_t period)
+{
+  (void)period;
+}
+
+
+void iwdg_start(void) {}
+
+
+void iwdg_reset(void) {}
+
+
+/*************************************************************************************************/
+/****************************************** RCC **************************************************/
+/*************************************************************************************************/
+void rcc_clock_setup_pll(const struct rcc_clock_scale *clock)
+{
+  rcc_ahb_frequency = clock->ahb_frequency;
+  rcc_apb1_frequency = clock->apb1_frequency;
+  rcc_apb2_frequency = clock->apb2_frequency;
+}
+
+
+void rcc_periph_clock_enable(enum rcc_periph_clken clken)
+{
+  (void)clken;
+}
+
+
+void rcc_periph_clock_disable(enum rcc_periph_clken clken)
+{
+  (void)clken;
+}
+
+
+void rcc_periph_reset_pulse(enum rcc_periph_rst rst)
+{
+  uint32_t i;
+
+  if(rst == RST_TIM2)
+    for(i = 0; i < MMIO_BLOCK_SIZE; i += sizeof(uint32_t))
+      MMIO32(TIM2 + i) = 0;
+}
+
+
+/*************************************************************************************************/
+/***************************************** GPIO & EXTI *******************************************/
+/*************************************************************************************************/
+static int gpio_index(uint32_t gpioport)
+{
+  int i;
+
+  for(i = 0; i < GPIO_PORTS; i++)
+    if(gpio_ports[i] == gpioport)
+      return i;
+  fprintf(stderr, "host: unknown GPIO port 0x%08X\n", (unsigned)gpioport);
+  exit(EXIT_FAILURE);
+}
+
+
+void host_gpio_sync(uint32_t gpioport)
+{
+  int port = gpio_index(gpioport);
+  uint32_t bsrr = GPIO_BSRR(gpioport), moder = GPIO_MODER(gpioport), otyper = GPIO_OTYPER(gpioport);
+  uint16_t odr, idr = 0, out_pp = 0, out_od = 0, changed, edges = 0;
+  uint8_t pin;
+
+  if( !bsrr && gpio_synced[port] && ((uint16_t)GPIO_ODR(gpioport) == gpio_former_odr[port]) &&
+      (moder == gpio_former_moder[port]) && (otyper == gpio_former_otyper[port]) &&
+      (gpio_ext_level[port] == gpio_former_ext[port]) )
+    return;
+  //Set has priority over reset, when both are written
+  GPIO_BSRR(gpioport) = 0;
+  odr = (uint16_t)((GPIO_ODR(gpioport) & ~(bsrr >> 16)) | (bsrr & 0xFFFF));
+  GPIO_ODR(gpioport) = odr;
+  if(odr != gpio_former_odr[port])
+  {
+    gpio_former_odr[port] = odr;
+    if(host_gpio_hook)
+    {
+      host_gpio_hook(gpioport);
+      odr = (uint16_t)GPIO_ODR(gpioport);
+    }
+  }
+
+  for(pin = 0; pin < 16; pin++)
+    if( ((moder >> (pin * 2)) & 3) == GPIO_MODE_OUTPUT )
+    {
+      if(otyper & (1 << pin))
+        out_od |= 1 << pin;
+      else
+        out_pp |= 1 << pin;
+    }
+  //Open drain outputs and inputs are a wired AND with the external level
+  idr = (odr & out_pp) | (odr & gpio_ext_level[port] & out_od) |
+        (gpio_ext_level[port] & (uint16_t)~(out_pp | out_od));
+  GPIO_IDR(gpioport) = idr;
+  gpio_former_moder[port] = moder;
+  gpio_former_otyper[port] = otyper;
+  gpio_former_ext[port] = gpio_ext_level[port];
+  gpio_synced[port] = true;
+
+  changed = idr ^ gpio_former_idr[port];
+  gpio_former_idr[port] = idr;
+  for(pin = 0; pin < 16; pin++)
+    if( (changed & (1 << pin)) && (exti_source[pin] == gpioport) &&
+        (((idr & (1 << pin)) ? exti_rtsr : exti_ftsr) & (1 << pin)) )
+      edges |= 1 << pin;
+  if(edges)
+    exti_raise(edges);
+}
+
+
+static void gpio_sync_all(void)
+{
+  int i;
+
+  for(i = 0; i < GPIO_PORTS; i++)
+    host_gpio_sync(gpio_ports[i]);
+}
+
+
+void host_gpio_input(uint32_t gpioport, uint16_t gpios, bool level)
+{
+  int port = gpio_index(gpioport);
+
+  if(level)
+    gpio_ext_level[port] |= gpios;
+  else
+    gpio_ext_level[port] &= ~gpios;
+  host_gpio_sync(gpioport);
+}
+
+
+void host_gpio_input_levels(uint32_t gpioport, uint16_t gpios, uint16_t levels)
+{
+  int port = gpio_index(gpioport);
+
+  gpio_ext_level[port] = (uint16_t)((gpio_ext_level[port] & ~gpios) | (levels & gpios));
+  host_gpio_sync(gpioport);
+}
+
+
+uint16_t host_gpio_output(uint32_t gpioport)
+{
+  host_gpio_sync(gpioport);
+  return (uint16_t)GPIO_ODR(gpioport);
+}
+
+
+void gpio_set(uint32_t gpioport, uint16_t gpios)
+{
+  GPIO_BSRR(gpioport) |= gpios;
+  host_gpio_sync(gpioport);
+}
+
+
+void gpio_clear(uint32_t gpioport, uint16_t gpios)
+{
+  GPIO_BSRR(gpioport) |= (uint32_t)gpios << 16;
+  host_gpio_sync(gpioport);
+}
+
+
+uint16_t gpio_get(uint32_t gpioport, uint16_t gpios)
+{
+  host_gpio_sync(gpioport);
+  return (uint16_t)(GPIO_IDR(gpioport) & gpios);
+}
+
+
+void gpio_toggle(uint32_t gpioport, uint16_t gpios)
+{
+  host_gpio_sync(gpioport);
+  GPIO_ODR(gpioport) ^= gpios;
+  host_gpio_sync(gpioport);
+}
+
+
+uint16_t gpio_port_read(uint32_t gpioport)
+{
+  host_gpio_sync(gpioport);
+  return (uint16_t)GPIO_IDR(gpioport);
+}
+
+
+void gpio_port_write(uint32_t gpioport, uint16_t data)
+{
+  host_gpio_sync(gpioport);
+  GPIO_ODR(gpioport) = data;
+  host_gpio_sync(gpioport);
+}
+
+
+void gpio_port_config_lock(uint32_t gpioport, uint16_t gpios)
+{
+  (void)gpioport;
+  (void)gpios;
+}
+
+
+void gpio_mode_setup(uint32_t gpioport, uint8_t mode, uint8_t pull_up_down, uint16_t gpios)
+{
+  uint8_t pin;
+
+  for(pin = 0; pin < 16; pin++)
+    if(gpios & (1 << pin))
+    {
+      GPIO_MODER(gpioport) = (GPIO_MODER(gpioport) & ~(3U << (pin * 2))) | ((uint32_t)mode << (pin * 2));
+      GPIO_PUPDR(gpioport) = (GPIO_PUPDR(gpioport) & ~(3U << (pin * 2))) | ((uint32_t)pull_up_down << (pin * 2));
+    }
+  host_gpio_sync(gpioport);
+}
+
+
+void gpio_set_output_options(uint32_t gpioport, uint8_t otype, uint8_t speed, uint16_t gpios)
+{
+  (void)speed;
+  if(otype == GPIO_OTYPE_OD)
+    GPIO_OTYPER(gpioport) |= gpios;
+  else
+    GPIO_OTYPER(gpioport) &= ~(uint32_t)gpios;
+  host_gpio_sync(gpioport);
+}
+
+
+void gpio_set_af(uint32_t gpioport, uint8_t alt_func_num, uint16_t gpios)
+{
+  (void)gpioport;
+  (void)alt_func_num;
+  (void)gpios;
+}
+
+
+//Sets pending lines, and raises their shared IRQ's
+static void exti_raise(uint16_t lines)
+{
+  lines &= exti_imr;
+  exti_pr |= lines;
+  if(lines & EXTI0)
+    host_irq_raise(NVIC_EXTI0_IRQ);
+  if(lines & EXTI1)
+    host_irq_raise(NVIC_EXTI1_IRQ);
+  if(lines & EXTI2)
+    host_irq_raise(NVIC_EXTI2_IRQ);
+  if(lines & EXTI3)
+    host_irq_raise(NVIC_EXTI3_IRQ);
+  if(lines & EXTI4)
+    host_irq_raise(NVIC_EXTI4_IRQ);
+  if(lines & (EXTI5 | EXTI6 | EXTI7 | EXTI8 | EXTI9))
+    host_irq_raise(NVIC_EXTI9_5_IRQ);
+  if(lines & (EXTI10 | EXTI11 | EXTI12 | EXTI13 | EXTI14 | EXTI15))
+    host_irq_raise(NVIC_EXTI15_10_IRQ);
+}
+
+
+void exti_set_trigger(uint32_t extis, enum exti_trigger_type trig)
+{
+  exti_rtsr = (trig == EXTI_TRIGGER_FALLING) ? (exti_rtsr & ~extis) : (exti_rtsr | extis);
+  exti_ftsr = (trig == EXTI_TRIGGER_RISING) ? (exti_ftsr & ~extis) : (exti_ftsr | extis);
+}
+
+
+void exti_enable_request(uint32_t extis)
+{
+  exti_imr |= extis;
+}
+
+
+void exti_disable_request(uint32_t extis)
+{
+  exti_imr &= ~extis;
+}
+
+
+void exti_reset_request(uint32_t extis)
+{
+  exti_pr &= ~extis;
+}
+
+
+void exti_select_source(uint32_t exti, uint32_t gpioport)
+{
+  uint8_t line;
+
+  for(line = 0; line < 16; line++)
+    if(exti & (1 << line))
+      exti_source[line] = gpioport;
+}
+
+
+uint32_t exti_get_flag_status(uint32_t exti)
+{
+  return exti_pr & exti;
+}
+
+
+/*************************************************************************************************/
+/*************************************** USART & DMA *********************************************/
+/*************************************************************************************************/
+static void host_uart_tx_stdout(const uint8_t *data, uint16_t len)
+{
+  fwrite(data, 1, len, stdout);
+}
+
+
+void usart_set_baudrate(uint32_t usart, uint32_t baud)
+{
+  (void)usart;
+  (void)baud;
+}
+
+
+void usart_set_databits(uint32_t usart, uint32_t bits)
+{
+  (void)usart;
+  (void)bits;
+}
+
+
+void usart_set_stopbits(uint32_t usart, uint32_t stopbits)
+{
+  (void)usart;
+  (void)stopbits;
+}
+
+
+void usart_set_parity(uint32_t usart, uint32_t parity)
+{
+  (void)usart;
+  (void)parity;
+}
+
+
+void usart_set_mode(uint32_t usart, uint32_t mode)
+{
+  (void)usart;
+  (void)mode;
+}
+
+
+void usart_set_flow_control(uint32_t usart, uint32_t flowcontrol)
+{
+  (void)usart;
+  (void)flowcontrol;
+}
+
+
+void usart_enable(uint32_t usart)
+{
+  USART_CR1(usart) |= USART_CR1_UE;
+  USART_SR(usart) |= USART_SR_TXE;
+}
+
+
+void usart_disable(uint32_t usart)
+{
+  USART_CR1(usart) &= ~USART_CR1_UE;
+}
+
+
+void usart_enable_rx_dma(uint32_t usart)
+{
+  USART_CR3(usart) |= USART_CR3_DMAR;
+}
+
+
+void usart_enable_tx_dma(uint32_t usart)
+{
+  USART_CR3(usart) |= USART_CR3_DMAT;
+}
+
+
+void usart_disable_tx_dma(uint32_t usart)
+{
+  USART_CR3(usart) &= ~USART_CR3_DMAT;
+}
+
+
+void usart_enable_idle_interrupt(uint32_t usart)
+{
+  USART_CR1(usart) |= USART_CR1_IDLEIE;
+}
+
+
+void usart_disable_rx_interrupt(uint32_t usart)
+{
+  USART_CR1(usart) &= ~USART_CR1_RXNEIE;
+}
+
+
+void usart_disable_tx_complete_interrupt(uint32_t usart)
+{
+  (void)usart;
+}
+
+
+void usart_send_blocking(uint32_t usart, uint16_t data)
+{
+  uint8_t ch = (uint8_t)data;
+  (void)usart;
+  host_uart_tx_hook(&ch, 1);
+}
+
+
+//Bytes arrive through the enabled peripheral to memory stream reading USART_DR, as the firmware
+//programs it, or on USART_DR itself (RXNE) when there is no such stream.
+void host_uart_rx(const uint8_t *data, uint16_t len)
+{
+  static const uint32_t usarts[] = { USART1, USART2 };
+  static const int8_t usart_irq[] = { NVIC_USART1_IRQ, NVIC_USART2_IRQ };
+  uint32_t dma, usart;
+  uint8_t d, s, u, *mem;
+  uint16_t i, ndtr;
+  bool dma_found;
+
+  for(u = 0; u < sizeof(usarts) / sizeof(usarts[0]); u++)
+  {
+    usart = usarts[u];
+    if(!(USART_CR1(usart) & USART_CR1_UE))
+      continue;
+    dma_found = false;
+    for(d = 0; d < 2; d++)
+      for(s = 0; s < 8; s++)
+      {
+        dma = d ? DMA2 : DMA1;
+        if( !(DMA_SCR(dma, s) & DMA_SxCR_EN) ||
+            ((DMA_SCR(dma, s) & DMA_SxCR_DIR_MASK) != DMA_SxCR_DIR_PERIPHERAL_TO_MEM) ||
+            (DMA_SxPAR(dma, s) != (uint32_t)(uintptr_t)&USART_DR(usart)) || !(USART_CR3(usart) & USART_CR3_DMAR) )
+          continue;
+        dma_found = true;
+        for(i = 0; i < len; i++)
+        {
+          ndtr = (uint16_t)DMA_SNDTR(dma, s);
+          mem = (uint8_t*)(uintptr_t)DMA_SxM0AR(dma, s);
+          mem[dma_size[d][s] - ndtr] = data[i];
+          DMA_SNDTR(dma, s) = --ndtr;
+          if(ndtr == dma_size[d][s] / 2)
+          {
+            dma_flags[d][s] |= DMA_HTIF;
+            if(DMA_SCR(dma, s) & DMA_SxCR_HTIE)
+              host_irq_raise(dma_irq[d][s]);
+          }
+          if(!ndtr)
+          {
+            dma_flags[d][s] |= DMA_TCIF;
+            if(DMA_SCR(dma, s) & DMA_SxCR_CIRC)
+              DMA_SNDTR(dma, s) = dma_size[d][s];
+            else
+              DMA_SCR(dma, s) &= ~DMA_SxCR_EN;
+            if(DMA_SCR(dma, s) & DMA_SxCR_TCIE)
+              host_irq_raise(dma_irq[d][s]);
+          }
+        }
+      }
+    if(!dma_found)
+      for(i = 0; i < len; i++)
+      {
+        USART_DR(usart) = data[i];
+        USART_SR(usart) |= USART_SR_RXNE;
+        if(USART_CR1(usart) & USART_CR1_RXNEIE)
+          host_irq_raise(usart_irq[u]);
+        USART_SR(usart) &= ~USART_SR_RXNE;
+      }
+    //Line idle after the burst. Firmware clears it reading SR and DR, which has no effect here.
+    USART_SR(usart) |= USART_SR_IDLE;
+    if(USART_CR1(usart) & USART_CR1_IDLEIE)
+      host_irq_raise(usart_irq[u]);
+    USART_SR(usart) &= ~USART_SR_IDLE;
+  }
+}
+
+
+static int dma_index(uint32_t dma)
+{
+  return (dma == DMA2) ? 1 : 0;
+}
+
+
+//A memory to peripheral stream is drained at once, and completes as soon it is enabled.
+static void dma_transfer_mem_to_usart(uint32_t dma, uint8_t stream)
+{
+  int d = dma_index(dma);
+  uint16_t ndtr = (uint16_t)DMA_SNDTR(dma, stream);
+
+  if(ndtr)
+    host_uart_tx_hook((const uint8_t*)(uintptr_t)DMA_SxM0AR(dma, stream), ndtr);
+  DMA_SNDTR(dma, stream) = 0;
+  dma_flags[d][stream] |= DMA_TCIF;
+  if(DMA_SCR(dma, stream) & DMA_SxCR_TCIE)
+    host_irq_raise(dma_irq[d][stream]);
+}
+
+
+void dma_stream_reset(uint32_t dma, uint8_t stream)
+{
+  DMA_SCR(dma, stream) = 0;
+  DMA_SNDTR(dma, stream) = 0;
+  DMA_SxPAR(dma, stream) = 0;
+  DMA_SxM0AR(dma, stream) = 0;
+  dma_flags[dma_index(dma)][stream] = 0;
+  dma_size[dma_index(dma)][stream] = 0;
+}
+
+
+void dma_clear_interrupt_flags(uint32_t dma, uint8_t stream, uint32_t interrupts)
+{
+  dma_flags[dma_index(dma)][stream] &= ~interrupts;
+}
+
+
+bool dma_get_interrupt_flag(uint32_t dma, uint8_t stream, uint32_t interrupt)
+{
+  return (dma_flags[dma_index(dma)][stream] & interrupt) != 0;
+}
+
+
+void dma_set_transfer_mode(uint32_t dma, uint8_t stream, uint32_t direction)
+{
+  DMA_SCR(dma, stream) = (DMA_SCR(dma, stream) & ~DMA_SxCR_DIR_MASK) | direction;
+}
+
+
+void dma_set_priority(uint32_t dma, uint8_t stream, uint32_t prio)
+{
+  DMA_SCR(dma, stream) = (DMA_SCR(dma, stream) & ~DMA_SxCR_PL_MASK) | prio;
+}
+
+
+void dma_set_memory_size(uint32_t dma, uint8_t stream, uint32_t mem_size)
+{
+  DMA_SCR(dma, stream) = (DMA_SCR(dma, stream) & ~DMA_SxCR_MSIZE_MASK) | mem_size;
+}
+
+
+void dma_set_peripheral_size(uint32_t dma, uint8_t stream, uint32_t peripheral_size)
+{
+  DMA_SCR(dma, stream) = (DMA_SCR(dma, stream) & ~DMA_SxCR_PSIZE_MASK) | peripheral_size;
+}
+
+
+void dma_enable_memory_increment_mode(uint32_t dma, uint8_t stream)
+{
+  DMA_SCR(dma, stream) |= DMA_SxCR_MINC;
+}
+
+
+void dma_disable_peripheral_increment_mode(uint32_t dma, uint8_t stream)
+{
+  DMA_SCR(dma, stream) &= ~DMA_SxCR_PINC;
+}
+
+
+void dma_enable_circular_mode(uint32_t dma, uint8_t stream)
+{
+  DMA_SCR(dma, stream) |= DMA_SxCR_CIRC;
+}
+
+
+void dma_enable_direct_mode(uint32_t dma, uint8_t stream)
+{
+  (void)dma;
+  (void)stream;
+}
+
+
+void dma_set_dma_flow_control(uint32_t dma, uint8_t stream)
+{
+  (void)dma;
+  (void)stream;
+}
+
+
+void dma_enable_transfer_complete_interrupt(uint32_t dma, uint8_t stream)
+{
+  DMA_SCR(dma, stream) |= DMA_SxCR_TCIE;
+}
+
+
+void dma_enable_half_transfer_interrupt(uint32_t dma, uint8_t stream)
+{
+  DMA_SCR(dma, stream) |= DMA_SxCR_HTIE;
+}
+
+
+void dma_enable_stream(uint32_t dma, uint8_t stream)
+{
+  DMA_SCR(dma, stream) |= DMA_SxCR_EN;
+  if((DMA_SCR(dma, stream) & DMA_SxCR_DIR_MASK) == DMA_SxCR_DIR_MEM_TO_PERIPHERAL)
+    dma_transfer_mem_to_usart(dma, stream);
+}
+
+
+void dma_disable_stream(uint32_t dma, uint8_t stream)
+{
+  DMA_SCR(dma, stream) &= ~DMA_SxCR_EN;
+}
+
+
+void dma_set_peripheral_address(uint32_t dma, uint8_t stream, uint32_t address)
+{
+  DMA_SxPAR(dma, stream) = address;
+}
+
+
+void dma_set_memory_address(uint32_t dma, uint8_t stream, uint32_t address)
+{
+  DMA_SxM0AR(dma, stream) = address;
+}
+
+
+uint16_t dma_get_number_of_data(uint32_t dma, uint8_t stream)
+{
+  return (uint16_t)DMA_SNDTR(dma, stream);
+}
+
+
+void dma_set_number_of_data(uint32_t dma, uint8_t stream, uint16_t number)
+{
+  DMA_SNDTR(dma, stream) = number;
+  dma_size[dma_index(dma)][stream] = number;
+}
+
+
+void dma_channel_select(uint32_t dma, uint8_t stream, uint32_t channel)
+{
+  DMA_SCR(dma, stream) = (DMA_SCR(dma, stream) & ~DMA_SxCR_CHSEL_MASK) | channel;
+}
+
+
+/*************************************************************************************************/
+/***************************************** Flash *************************************************/
+/*************************************************************************************************/
+//Only sector 3 (the Databases) is mapped, on its target address, as the firmware reads it through plain pointers.
+//As a NOR flash, erase sets all its bits and programming only clears bits. FLASH_KEYR is not modeled, so the
+//lock bit is kept for the firmware checks, but it does not refuse programming.
+static void flash_map_sector3(void) __attribute__((constructor));
+static void flash_map_sector3(void)
+{
+  void *sector3 = mmap((void*)(uintptr_t)HOST_FLASH_SECTOR3_BASE, HOST_FLASH_SECTOR3_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+  if(sector3 != (void*)(uintptr_t)HOST_FLASH_SECTOR3_BASE)
+  {
+    fprintf(stderr, "host: flash sector 3 can not be mapped at 0x%08X\n", (unsigned)HOST_FLASH_SECTOR3_BASE);
+    exit(EXIT_FAILURE);
+  }
+  memset(sector3, 0xFF, HOST_FLASH_SECTOR3_SIZE);
+}
+
+
+//Flash address to host pointer, or NULL (and WRPERR, as the other sectors hold the firmware itself)
+static uint8_t *flash_address(uint32_t address, uint32_t len)
+{
+  if( (address < HOST_FLASH_SECTOR3_BASE) || (len > HOST_FLASH_SECTOR3_SIZE) ||
+      ((address - HOST_FLASH_SECTOR3_BASE) > (HOST_FLASH_SECTOR3_SIZE - len)) )
+  {
+    FLASH_SR |= FLASH_SR_WRPERR;
+    return NULL;
+  }
+  return (uint8_t*)(uintptr_t)address;
+}
+
+
+void flash_unlock(void)
+{
+  FLASH_CR &= ~FLASH_CR_LOCK;
+}
+
+
+void flash_lock(void)
+{
+  FLASH_CR |= FLASH_CR_LOCK;
+}
+
+
+void flash_wait_for_last_operation(void)
+{
+  FLASH_SR &= ~FLASH_SR_BSY;
+}
+
+
+void flash_erase_sector(uint8_t sector, uint32_t program_size)
+{
+  (void)program_size;
+  if(sector == 3)
+    memset((void*)(uintptr_t)HOST_FLASH_SECTOR3_BASE, 0xFF, HOST_FLASH_SECTOR3_SIZE);
+  else
+    FLASH_SR |= FLASH_SR_WRPERR;
+  FLASH_SR |= FLASH_SR_EOP;
+}
+
+
+void flash_program_byte(uint32_t address, uint8_t data)
+{
+  flash_program(address, &data, 1);
+}
+
+
+void flash_program_word(uint32_t address, uint32_t data)
+{
+  uint8_t bytes[4] = { (uint8_t)data, (uint8_t)(data >> 8), (uint8_t)(data >> 16), (uint8_t)(data >> 24) };
+
+  flash_program(address, bytes, 4);
+}
+
+
+void flash_program(uint32_t address, const uint8_t *data, uint32_t len)
+{
+  uint8_t *dest = flash_address(address, len);
+  uint32_t i;
+
+  if(dest)
+    for(i = 0; i < len; i++)
+      dest[i] &= data[i];
+  FLASH_SR |= FLASH_SR_EOP;
+}
@@ -0,0 +1,548 @@
+/** @defgroup 14 host Host Simulation Shim
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file opencm3_host.h libopencm3 register level shim to run the firmware modules on a workstation.
+ *
+ * @brief <b>libopencm3 register level shim to run the firmware modules on a workstation.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Only the STM32F401 subset used by this project is declared. Every libopencm3 header under
+ * host/libopencm3 includes this one, so the firmware sources are compiled unchanged.
+ * - Peripheral registers (MMIO32) are plain host memory, so GPIO ports are memory: writes to
+ * GPIO_BSRR are applied to ODR/IDR by host_gpio_sync(), which is also called after each ISR;
+ * - EXTI, TIM2, DMA, USART and SysTick are modeled as ISR hooks, called by host_gpio_input(),
+ * host_run_usec() and host_uart_rx(). NVIC enables and cm_disable_interrupts() hold them pending;
+ * - Time is virtual: TIM2 counts 1MHz of host_time_usec and SysTick fires sys_tick_handler()
+ * at its programmed rate, so systicks advances with host_run_usec() only.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#if !defined OPENCM3_HOST_H
+#define OPENCM3_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STM32F4
+
+/* Memory mapped registers are kept on host memory blocks, indexed by the target address */
+volatile uint32_t *host_mmio32(uint32_t address);
+#define MMIO32(addr)              (*host_mmio32((uint32_t)(addr)))
+
+/* cm3/common */
+#define BIT0 (1<<0)
+uint32_t cm_mask_interrupts(uint32_t mask);
+void cm_enable_interrupts(void);
+void cm_disable_interrupts(void);
+/* BASEPRI: the firmware writes it with MRS/MSR on target. 0 masks nothing */
+uint32_t host_basepri_raise(uint32_t priority);
+void host_basepri_set(uint32_t priority);
+
+/* cm3/nvic.h */
+#define NVIC_EXTI0_IRQ            6
+#define NVIC_EXTI1_IRQ            7
+#define NVIC_EXTI2_IRQ            8
+#define NVIC_EXTI3_IRQ            9
+#define NVIC_EXTI4_IRQ            10
+#define NVIC_DMA1_STREAM0_IRQ     11
+#define NVIC_DMA1_STREAM5_IRQ     16
+#define NVIC_DMA1_STREAM6_IRQ     17
+#define NVIC_EXTI9_5_IRQ          23
+#define NVIC_TIM2_IRQ             28
+#define NVIC_USART1_IRQ           37
+#define NVIC_USART2_IRQ           38
+#define NVIC_EXTI15_10_IRQ        40
+#define NVIC_DMA1_STREAM7_IRQ     47
+#define NVIC_DMA2_STREAM0_IRQ     56
+#define NVIC_DMA2_STREAM1_IRQ     57
+#define NVIC_DMA2_STREAM2_IRQ     58
+#define NVIC_OTG_FS_IRQ           67
+#define NVIC_DMA2_STREAM5_IRQ     68
+#define NVIC_DMA2_STREAM6_IRQ     69
+#define NVIC_DMA2_STREAM7_IRQ     70
+#define NVIC_SYSTICK_IRQ          (-1)
+#define NVIC_IRQ_COUNT            96
+void nvic_enable_irq(uint8_t irqn);
+void nvic_disable_irq(uint8_t irqn);
+void nvic_set_priority(uint8_t irqn, uint8_t priority);
+
+/* cm3/scb.h */
+#define SCB_BASE                  0xE000ED00U
+#define SCB_SHCSR                 MMIO32(SCB_BASE + 0x24)
+void scb_reset_system(void);
+
+/* cm3/systick.h */
+#define STK_CSR_CLKSOURCE_AHB     (1 << 2)
+void systick_set_reload(uint32_t value);
+void systick_set_clocksource(uint8_t clocksource);
+void systick_counter_enable(void);
+void systick_interrupt_enable(void);
+void systick_interrupt_disable(void);
+void systick_clear(void);
+
+/* cm3/dwt.h */
+#define DWT_BASE                  0xE0001000U
+#define DWT_CTRL                  MMIO32(DWT_BASE + 0x00)
+#define DWT_CYCCNT                MMIO32(DWT_BASE + 0x04)
+#define DWT_CTRL_CYCCNTENA        (1 << 0)
+bool dwt_enable_cycle_counter(void);
+uint32_t dwt_read_cycle_counter(void);
+
+/* stm32/rcc.h */
+#define RCC_BASE                  0x40023800U
+#define RCC_CSR                   MMIO32(RCC_BASE + 0x74)
+#define RCC_CSR_LPWRRSTF          (1 << 31)
+#define RCC_CSR_WWDGRSTF          (1 << 30)
+#define RCC_CSR_IWDGRSTF          (1 << 29)
+#define RCC_CSR_SFTRSTF           (1 << 28)
+#define RCC_CSR_PORRSTF           (1 << 27)
+#define RCC_CSR_PINRSTF           (1 << 26)
+#define RCC_CSR_RMVF              (1 << 24)
+enum rcc_periph_clken { RCC_GPIOA, RCC_GPIOB, RCC_GPIOC, RCC_TIM2, RCC_USART1, RCC_USART2, RCC_DMA1,
+  RCC_DMA2, RCC_OTGFS, RCC_CRC, RCC_AFIO };
+enum rcc_periph_rst { RST_TIM2 };
+enum rcc_clock_3v3 { RCC_CLOCK_3V3_84MHZ, RCC_CLOCK_3V3_END };
+struct rcc_clock_scale { uint32_t ahb_frequency, apb1_frequency, apb2_frequency; };
+extern const struct rcc_clock_scale rcc_hse_25mhz_3v3[RCC_CLOCK_3V3_END];
+extern uint32_t rcc_ahb_frequency, rcc_apb1_frequency, rcc_apb2_frequency;
+void rcc_clock_setup_pll(const struct rcc_clock_scale *clock);
+void rcc_periph_clock_enable(enum rcc_periph_clken clken);
+void rcc_periph_clock_disable(enum rcc_periph_clken clken);
+void rcc_periph_reset_pulse(enum rcc_periph_rst rst);
+
+/* stm32/gpio.h */
+#define GPIOA                     0x40020000U
+#define GPIOB                     0x40020400U
+#define GPIOC                     0x40020800U
+#define GPIO0  (1 << 0)
+#define GPIO1  (1 << 1)
+#define GPIO2  (1 << 2)
+#define GPIO3  (1 << 3)
+#define GPIO4  (1 << 4)
+#define GPIO5  (1 << 5)
+#define GPIO6  (1 << 6)
+#define GPIO7  (1 << 7)
+#define GPIO8  (1 << 8)
+#define GPIO9  (1 << 9)
+#define GPIO10 (1 << 10)
+#define GPIO11 (1 << 11)
+#define GPIO12 (1 << 12)
+#define GPIO13 (1 << 13)
+#define GPIO14 (1 << 14)
+#define GPIO15 (1 << 15)
+#define GPIO_MODER(port)          MMIO32((port) + 0x00)
+#define GPIO_OTYPER(port)         MMIO32((port) + 0x04)
+#define GPIO_IDR(port)            MMIO32((port) + 0x10)
+#define GPIO_ODR(port)            MMIO32((port) + 0x14)
+#define GPIO_BSRR(port)           MMIO32((port) + 0x18)
+#define GPIOA_BSRR                GPIO_BSRR(GPIOA)
+#define GPIOB_BSRR                GPIO_BSRR(GPIOB)
+#define GPIO_MODE_INPUT           0x0
+#define GPIO_MODE_OUTPUT          0x1
+#define GPIO_MODE_AF              0x2
+#define GPIO_MODE_ANALOG          0x3
+#define GPIO_PUPD_NONE            0x0
+#define GPIO_PUPD_PULLUP          0x1
+#define GPIO_PUPD_PULLDOWN        0x2
+#define GPIO_OTYPE_PP             0x0
+#define GPIO_OTYPE_OD             0x1
+#define GPIO_OSPEED_2MHZ          0x0
+#define GPIO_OSPEED_25MHZ         0x1
+#define GPIO_OSPEED_50MHZ         0x2
+#define GPIO_OSPEED_100MHZ        0x3
+#define GPIO_AF1                  0x1
+#define GPIO_AF3                  0x3
+#define GPIO_AF7                  0x7
+#define GPIO_AF10                 0xa
+void gpio_set(uint32_t gpioport, uint16_t gpios);
+void gpio_clear(uint32_t gpioport, uint16_t gpios);
+uint16_t gpio_get(uint32_t gpioport, uint16_t gpios);
+void gpio_toggle(uint32_t gpioport, uint16_t gpios);
+uint16_t gpio_port_read(uint32_t gpioport);
+void gpio_port_write(uint32_t gpioport, uint16_t data);
+void gpio_port_config_lock(uint32_t gpioport, uint16_t gpios);
+void gpio_mode_setup(uint32_t gpioport, uint8_t mode, uint8_t pull_up_down, uint16_t gpios);
+void gpio_set_output_options(uint32_t gpioport, uint8_t otype, uint8_t speed, uint16_t gpios);
+void gpio_set_af(uint32_t gpioport, uint8_t alt_func_num, uint16_t gpios);
+
+/* stm32/exti.h */
+#define EXTI0  (1 << 0)
+#define EXTI1  (1 << 1)
+#define EXTI2  (1 << 2)
+#define EXTI3  (1 << 3)
+#define EXTI4  (1 << 4)
+#define EXTI5  (1 << 5)
+#define EXTI6  (1 << 6)
+#define EXTI7  (1 << 7)
+#define EXTI8  (1 << 8)
+#define EXTI9  (1 << 9)
+#define EXTI10 (1 << 10)
+#define EXTI11 (1 << 11)
+#define EXTI12 (1 << 12)
+#define EXTI13 (1 << 13)
+#define EXTI14 (1 << 14)
+#define EXTI15 (1 << 15)
+enum exti_trigger_type { EXTI_TRIGGER_RISING, EXTI_TRIGGER_FALLING, EXTI_TRIGGER_BOTH };
+void exti_set_trigger(uint32_t extis, enum exti_trigger_type trig);
+void exti_enable_request(uint32_t extis);
+void exti_disable_request(uint32_t extis);
+void exti_reset_request(uint32_t extis);
+void exti_select_source(uint32_t exti, uint32_t gpioport);
+uint32_t exti_get_flag_status(uint32_t exti);
+
+/* stm32/timer.h */
+#define TIM2                      0x40000000U
+#define TIM3                      0x40000400U
+#define TIM4                      0x40000800U
+#define TIM5                      0x40000C00U
+#define TIM_CR1(t)                MMIO32((t) + 0x00)
+#define TIM_CR2(t)                MMIO32((t) + 0x04)
+#define TIM_DIER(t)               MMIO32((t) + 0x0C)
+#define TIM_SR(t)                 MMIO32((t) + 0x10)
+#define TIM_EGR(t)                MMIO32((t) + 0x14)
+#define TIM_CCMR1(t)              MMIO32((t) + 0x18)
+#define TIM_CCER(t)               MMIO32((t) + 0x20)
+#define TIM_CNT(t)                MMIO32((t) + 0x24)
+#define TIM_PSC(t)                MMIO32((t) + 0x28)
+#define TIM_ARR(t)                MMIO32((t) + 0x2C)
+#define TIM_CCR1(t)               MMIO32((t) + 0x34)
+#define TIM_CCR2(t)               MMIO32((t) + 0x38)
+#define TIM_CCR3(t)               MMIO32((t) + 0x3C)
+#define TIM_CCR4(t)               MMIO32((t) + 0x40)
+#define TIM_CR1_CKD_CK_INT        (0x0 << 8)
+#define TIM_CR1_ARPE              (1 << 7)
+#define TIM_CR1_DIR_UP            (0 << 4)
+#define TIM_CR1_OPM               (1 << 3)
+#define TIM_CR1_URS               (1 << 2)
+#define TIM_CR1_CEN               (1 << 0)
+#define TIM_CR2_TI1S              (1 << 7)
+#define TIM_DIER_CC4IE            (1 << 4)
+#define TIM_DIER_CC3IE            (1 << 3)
+#define TIM_DIER_CC2IE            (1 << 2)
+#define TIM_DIER_CC1IE            (1 << 1)
+#define TIM_DIER_UIE              (1 << 0)
+#define TIM_SR_CC1OF              (1 << 9)
+#define TIM_SR_CC4IF              (1 << 4)
+#define TIM_SR_CC3IF              (1 << 3)
+#define TIM_SR_CC2IF              (1 << 2)
+#define TIM_SR_CC1IF              (1 << 1)
+#define TIM_SR_UIF                (1 << 0)
+#define TIM_EGR_CC2G              (1 << 2)
+#define TIM_EGR_CC1G              (1 << 1)
+#define TIM_EGR_UG                (1 << 0)
+#define TIM_CCMR1_CC1S_IN_TI1     (0x1 << 0)
+#define TIM_CCMR1_IC1F_OFF        (0x0 << 4)
+#define TIM_CCER_CC1P             (1 << 1)
+#define TIM_CCER_CC1E             (1 << 0)
+void timer_set_mode(uint32_t timer_peripheral, uint32_t clock_div, uint32_t alignment, uint32_t direction);
+void timer_set_prescaler(uint32_t timer_peripheral, uint32_t value);
+void timer_set_period(uint32_t timer_peripheral, uint32_t period);
+void timer_enable_preload(uint32_t timer_peripheral);
+void timer_enable_counter(uint32_t timer_peripheral);
+void timer_enable_irq(uint32_t timer_peripheral, uint32_t irq);
+void timer_disable_irq(uint32_t timer_peripheral, uint32_t irq);
+bool timer_get_flag(uint32_t timer_peripheral, uint32_t flag);
+void timer_clear_flag(uint32_t timer_peripheral, uint32_t flag);
+
+/* stm32/iwdg.h */
+void iwdg_set_period_ms(uint32_t period);
+void iwdg_start(void);
+void iwdg_reset(void);
+
+/* stm32/usart.h */
+#define USART1                    0x40011000U
+#define USART2                    0x40004400U
+#define USART6                    0x40011400U
+#define USART_SR(u)               MMIO32((u) + 0x00)
+#define USART_DR(u)               MMIO32((u) + 0x04)
+#define USART_CR1(u)              MMIO32((u) + 0x0C)
+#define USART_SR_TXE              (1 << 7)
+#define USART_SR_RXNE             (1 << 5)
+#define USART_SR_IDLE             (1 << 4)
+#define USART_CR1_RXNEIE          (1 << 5)
+#define USART_CR1_IDLEIE          (1 << 4)
+#define USART_STOPBITS_1          0
+#define USART_STOPBITS_2          2
+#define USART_STOPBITS_1_5        3
+#define USART_PARITY_NONE         0
+#define USART_PARITY_EVEN         1
+#define USART_PARITY_ODD          2
+#define USART_MODE_TX_RX          3
+#define USART_FLOWCONTROL_NONE    0
+void usart_set_baudrate(uint32_t usart, uint32_t baud);
+void usart_set_databits(uint32_t usart, uint32_t bits);
+void usart_set_stopbits(uint32_t usart, uint32_t stopbits);
+void usart_set_parity(uint32_t usart, uint32_t parity);
+void usart_set_mode(uint32_t usart, uint32_t mode);
+void usart_set_flow_control(uint32_t usart, uint32_t flowcontrol);
+void usart_enable(uint32_t usart);
+void usart_disable(uint32_t usart);
+void usart_enable_rx_dma(uint32_t usart);
+void usart_enable_tx_dma(uint32_t usart);
+void usart_disable_tx_dma(uint32_t usart);
+void usart_enable_idle_interrupt(uint32_t usart);
+void usart_disable_rx_interrupt(uint32_t usart);
+void usart_disable_tx_complete_interrupt(uint32_t usart);
+void usart_send_blocking(uint32_t usart, uint16_t data);
+
+/* stm32/dma.h */
+#define DMA1                      0x40026000U
+#define DMA2                      0x40026400U
+#define DMA_STREAM0 0
+#define DMA_STREAM1 1
+#define DMA_STREAM2 2
+#define DMA_STREAM3 3
+#define DMA_STREAM4 4
+#define DMA_STREAM5 5
+#define DMA_STREAM6 6
+#define DMA_STREAM7 7
+#define DMA_SCR(port, n)          MMIO32((port) + 0x10 + (0x18 * (n)))
+#define DMA_SNDTR(port, n)        MMIO32((port) + 0x14 + (0x18 * (n)))
+#define DMA_SxCR_EN               (1 << 0)
+#define DMA_SxCR_CHSEL_4          (4 << 25)
+#define DMA_SxCR_CHSEL_6          (6 << 25)
+#define DMA_SxCR_DIR_PERIPHERAL_TO_MEM (0 << 6)
+#define DMA_SxCR_DIR_MEM_TO_PERIPHERAL (1 << 6)
+#define DMA_SxCR_MSIZE_8BIT       (0 << 13)
+#define DMA_SxCR_PSIZE_8BIT       (0 << 11)
+#define DMA_SxCR_PL_HIGH          (2 << 16)
+#define DMA_FEIF                  (1 << 0)
+#define DMA_DMEIF                 (1 << 2)
+#define DMA_TEIF                  (1 << 3)
+#define DMA_HTIF                  (1 << 4)
+#define DMA_TCIF                  (1 << 5)
+void dma_stream_reset(uint32_t dma, uint8_t stream);
+void dma_clear_interrupt_flags(uint32_t dma, uint8_t stream, uint32_t interrupts);
+bool dma_get_interrupt_flag(uint32_t dma, uint8_t stream, uint32_t interrupt);
+void dma_set_transfer_mode(uint32_t dma, uint8_t stream, uint32_t direction);
+void dma_set_priority(uint32_t dma, uint8_t stream, uint32_t prio);
+void dma_set_memory_size(uint32_t dma, uint8_t stream, uint32_t mem_size);
+void dma_set_peripheral_size(uint32_t dma, uint8_t stream, uint32_t peripheral_size);
+void dma_enable_memory_increment_mode(uint32_t dma, uint8_t stream);
+void dma_disable_peripheral_increment_mode(uint32_t dma, uint8_t stream);
+void dma_enable_circular_mode(uint32_t dma, uint8_t stream);
+void dma_enable_direct_mode(uint32_t dma, uint8_t stream);
+void dma_set_dma_flow_control(uint32_t dma, uint8_t stream);
+void dma_enable_transfer_complete_interrupt(uint32_t dma, uint8_t stream);
+void dma_enable_half_transfer_interrupt(uint32_t dma, uint8_t stream);
+void dma_enable_stream(uint32_t dma, uint8_t stream);
+void dma_disable_stream(uint32_t dma, uint8_t stream);
+void dma_set_peripheral_address(uint32_t dma, uint8_t stream, uint32_t address);
+void dma_set_memory_address(uint32_t dma, uint8_t stream, uint32_t address);
+uint16_t dma_get_number_of_data(uint32_t dma, uint8_t stream);
+void dma_set_number_of_data(uint32_t dma, uint8_t stream, uint16_t number);
+void dma_channel_select(uint32_t dma, uint8_t stream, uint32_t channel);
+
+/* stm32/flash.h */
+#define FLASH_MEM_INTERFACE_BASE  0x40023C00U
+#define FLASH_KEYR                MMIO32(FLASH_MEM_INTERFACE_BASE + 0x04)
+#define FLASH_SR                  MMIO32(FLASH_MEM_INTERFACE_BASE + 0x0C)
+#define FLASH_CR                  MMIO32(FLASH_MEM_INTERFACE_BASE + 0x10)
+#define FLASH_SR_BSY              (1 << 16)
+#define FLASH_SR_PGSERR           (1 << 7)
+#define FLASH_SR_PGPERR           (1 << 6)
+#define FLASH_SR_PGAERR           (1 << 5)
+#define FLASH_SR_WRPERR           (1 << 4)
+#define FLASH_SR_OPERR            (1 << 1)
+#define FLASH_SR_EOP              (1 << 0)
+#define FLASH_CR_LOCK             (1 << 31)
+#define FLASH_CR_PROGRAM_X8       0
+#define HOST_FLASH_SECTOR3_BASE   0x0800C000U //The only sector mapped on host: where the Databases are
+#define HOST_FLASH_SECTOR3_SIZE   0x4000U
+void flash_unlock(void);
+void flash_lock(void);
+void flash_wait_for_last_operation(void);
+void flash_erase_sector(uint8_t sector, uint32_t program_size);
+void flash_program_byte(uint32_t address, uint8_t data);
+void flash_program_word(uint32_t address, uint32_t data);
+void flash_program(uint32_t address, const uint8_t *data, uint32_t len);
+
+/* usb/usbd.h & usb/cdc.h (only the types used by common headers) */
+#define USB_REQ_TYPE_IN           0x80
+#define USB_OTG_FS_BASE           0x50000000U
+#define OTG_DSTS                  0x808
+typedef struct _usbd_device usbd_device;
+struct usb_cdc_line_coding
+{
+  uint32_t dwDTERate;
+  uint8_t bCharFormat;
+  uint8_t bParityType;
+  uint8_t bDataBits;
+} __attribute__((packed));
+#define USB_CDC_1_STOP_BITS       0
+#define USB_CDC_1_5_STOP_BITS     1
+#define USB_CDC_2_STOP_BITS       2
+#define USB_CDC_NO_PARITY         0
+#define USB_CDC_ODD_PARITY        1
+#define USB_CDC_EVEN_PARITY       2
+
+/* cm3/vector.h & stm32/f4/nvic.h: ISR's prototypes */
+void sys_tick_handler(void);
+void tim2_isr(void);
+void exti3_isr(void);
+void exti4_isr(void);
+void exti9_5_isr(void);
+void exti15_10_isr(void);
+void usart1_isr(void);
+void usart2_isr(void);
+void exti0_isr(void);
+void exti1_isr(void);
+void exti2_isr(void);
+void dma1_stream5_isr(void);
+void dma1_stream6_isr(void);
+void dma2_stream1_isr(void);
+void dma2_stream2_isr(void);
+void dma2_stream6_isr(void);
+void dma2_stream7_isr(void);
+void otg_fs_isr(void);
+
+/* stm32/dbgmcu.h */
+#define DBGMCU_BASE               0xE0042000U
+
+/* Host side hooks: virtual time, interrupts and pins, used by the simulators (opencm3_host.c) */
+/** Virtual time since host start, in micro seconds */
+extern uint64_t host_time_usec;
+
+/** Called with the bytes the firmware transmits through USART DMA. Default writes them to stdout */
+extern void (*host_uart_tx_hook)(const uint8_t *data, uint16_t len);
+
+/** Called by scb_reset_system(). Default reports it and exits */
+extern void (*host_reset_hook)(void);
+
+/** Called when output levels (GPIO_ODR) of a port change, to let board models follow the firmware pins */
+extern void (*host_gpio_hook)(uint32_t gpioport);
+
+/** Called by the firmware WFI before it sleeps: it is waiting an interrupt, as new input */
+extern void (*host_wfi_hook)(void);
+
+/**
+ * @brief Schedules a board model callback, run outside of ISR context when the virtual time reaches it.
+ *
+ * @param usec Micro seconds from now (0 runs it on the next time step).
+ * @param callback Function to be called.
+ */
+void host_schedule_usec(uint32_t usec, void (*callback)(void));
+
+/**
+ * @brief Cancels the scheduled calls of a callback.
+ *
+ * @param callback Function passed to host_schedule_usec().
+ */
+void host_unschedule(void (*callback)(void));
+
+/**
+ * @brief Advances the virtual time, running the SysTick and TIM2 (compare, overflow) ISR's and the scheduled
+ * callbacks on their instants.
+ *
+ * @param usec Micro seconds to advance.
+ */
+void host_run_usec(uint32_t usec);
+
+/**
+ * @brief Drives external levels on input pins (and on open drain outputs, as a wired AND). Edges on pins
+ * with EXTI request enabled run the related ISR.
+ *
+ * @param gpioport GPIO port (GPIOA...).
+ * @param gpios Pins to be driven.
+ * @param level Level driven on them.
+ */
+void host_gpio_input(uint32_t gpioport, uint16_t gpios, bool level);
+
+/**
+ * @brief As host_gpio_input(), but each pin gets its own level, all at once (single sync and ISR run).
+ *
+ * @param gpioport GPIO port (GPIOA...).
+ * @param gpios Pins to be driven.
+ * @param levels Levels driven on them (bits out of gpios are ignored).
+ */
+void host_gpio_input_levels(uint32_t gpioport, uint16_t gpios, uint16_t levels);
+
+/**
+ * @brief Applies the pending GPIO_BSRR writes to ODR, and computes IDR from ODR and the external levels.
+ *
+ * @param gpioport GPIO port (GPIOA...).
+ */
+void host_gpio_sync(uint32_t gpioport);
+
+/**
+ * @brief Output levels of a port, after host_gpio_sync().
+ *
+ * @param gpioport GPIO port (GPIOA...).
+ * @return GPIO_ODR of this port.
+ */
+uint16_t host_gpio_output(uint32_t gpioport);
+
+/**
+ * @brief Puts bytes on the RX line of USARTs, as received by its circular RX DMA stream, then signals line idle.
+ *
+ * @param data Bytes received.
+ * @param len Number of bytes.
+ */
+void host_uart_rx(const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Busy wait step. Firmware busy waits are `while(cond) __asm("nop");`, so on host each "nop"
+ * advances the virtual time by 1 micro second, to let the ISR's change their conditions.
+ */
+void host_spin(void);
+
+/**
+ * @brief Inline assembly of the firmware: "wfi" advances the virtual time straight to the next
+ * enabled interrupt (at most HOST_WFI_MAX_USEC), any other instruction is a host_spin().
+ *
+ * @param instruction Assembly text, as written on __asm().
+ */
+void host_asm(const char *instruction);
+#define HOST_WFI_MAX_USEC         1000000
+#if !defined __cplusplus                //C++ standard headers declare symbols with __asm
+#define __asm(x)                  host_asm(x)
+#endif
+
+/**
+ * @brief Sets an interrupt as pending, and runs it if it is enabled and not masked.
+ *
+ * @param irqn NVIC_xxx_IRQ number, or NVIC_SYSTICK_IRQ.
+ */
+void host_irq_raise(int irqn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined OPENCM3_HOST_H
@@ -0,0 +1,266 @@
+/** @addtogroup 16 ppi_scan Virtual PPI Scanner
+ *
+ * @file ppi_scan.c Cycle timed model of the MSX keyboard scan: PPI port C (Y) writes and port B (X) reads.
+ *
+ * @brief <b>Cycle timed model of the MSX keyboard scan: PPI port C (Y) writes and port B (X) reads.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdlib.h>
+
+#include <libopencm3/stm32/gpio.h>
+
+#include "system.h"
+#include "ppi_scan.h"
+
+#define Y_LINES                   (Y0_PIN | Y1_PIN | Y2_PIN | Y3_PIN | Y4_PIN | Y5_PIN | Y6_PIN | Y7_PIN)
+
+static const uint16_t y_pins[8] = { Y0_PIN, Y1_PIN, Y2_PIN, Y3_PIN, Y4_PIN, Y5_PIN, Y6_PIN, Y7_PIN };
+static const uint16_t x_pins[8] = { X0_PIN, X1_PIN, X2_PIN, X3_PIN, X4_PIN, X5_PIN, X6_PIN, X7_PIN };
+
+static struct ppi_scan_config scan;
+static void     (*scan_read_callback)(const struct ppi_scan_read *read);
+static void     (*board_gpio_hook)(uint32_t gpioport);
+static bool     scan_hooked, scan_read_open;
+static struct ppi_scan_read scan_read;
+static bool     sampled_before_write;
+static uint8_t  scan_idx;
+static uint64_t scan_frame_usec;                //Start of the running frame
+static uint64_t x_response_usec;                //First change of X pins after the Y write
+static uint8_t  x_former;
+
+//Prototypes of internal functions
+static void scan_gpio_hook(uint32_t gpioport);
+static uint8_t x_pressed_now(void);
+static uint8_t lines_pressed_now(void);
+static void scan_close_read(void);
+static void scan_write(void);
+static void scan_sample(void);
+
+
+void ppi_scan_pattern_sequential(struct ppi_scan_config *config, uint8_t columns)
+{
+  uint8_t i;
+
+  if(columns > PPI_SCAN_MAX_PATTERN)
+    columns = PPI_SCAN_MAX_PATTERN;
+  for(i = 0; i < columns; i++)
+    config->pattern[i] = i;
+  config->pattern_len = columns;
+}
+
+
+bool ppi_scan_pattern_parse(struct ppi_scan_config *config, const char *text)
+{
+  char *end;
+  unsigned long column;
+
+  config->pattern_len = 0;
+  while(*text)
+  {
+    if(config->pattern_len == PPI_SCAN_MAX_PATTERN)
+      return false;
+    if((*text == 'A') || (*text == 'a'))
+    {
+      config->pattern[config->pattern_len++] = PPI_SCAN_ALL_COLUMNS;
+      text++;
+    }
+    else
+    {
+      column = strtoul(text, &end, 10);
+      if((end == text) || (column > 15))
+        return false;
+      config->pattern[config->pattern_len++] = (uint8_t)column;
+      text = end;
+    }
+    if(*text == ',')
+      text++;
+    else if(*text)
+      return false;
+  }
+  return config->pattern_len != 0;
+}
+
+
+void ppi_scan_start(const struct ppi_scan_config *config, void (*read_callback)(const struct ppi_scan_read *read))
+{
+  ppi_scan_stop();
+  scan = *config;
+  scan_read_callback = read_callback;
+  if(!scan_hooked)
+  {
+    board_gpio_hook = host_gpio_hook;
+    host_gpio_hook = scan_gpio_hook;
+    scan_hooked = true;
+  }
+  x_former = x_pressed_now();
+  scan_idx = 0;
+  scan_frame_usec = host_time_usec + 1;
+  host_schedule_usec(1, scan_write);
+}
+
+
+void ppi_scan_stop(void)
+{
+  host_unschedule(scan_write);
+  host_unschedule(scan_sample);
+  scan_close_read();
+  host_gpio_input_levels(Y0_PORT, Y_LINES, Y_LINES);
+}
+
+
+//Keeps the time of the last change on X pins, then the board models get the change
+static void scan_gpio_hook(uint32_t gpioport)
+{
+  uint8_t x_pressed;
+
+  if(gpioport == X_PORT)
+  {
+    x_pressed = x_pressed_now();
+    if(x_pressed != x_former)
+    {
+      x_former = x_pressed;
+      if(scan_read_open && (x_response_usec == UINT64_MAX))
+        x_response_usec = host_time_usec;
+    }
+  }
+  if(board_gpio_hook)
+    board_gpio_hook(gpioport);
+}
+
+
+//X pins pulled down are pressed keys. ODR is already synced when called from the hook.
+static uint8_t x_pressed_now(void)
+{
+  uint16_t odr = (uint16_t)GPIO_ODR(X_PORT);
+  uint8_t x, pressed = 0;
+
+  for(x = 0; x < 8; x++)
+    if(!(odr & x_pins[x]))
+      pressed |= (uint8_t)(1 << x);
+  return pressed;
+}
+
+
+//CTRL, SHIFT and RUS/LAT are lines of their own, pulled down when pressed
+static uint8_t lines_pressed_now(void)
+{
+  uint8_t pressed = 0;
+
+  if(!(GPIO_ODR(CTRL_PORT) & CTRL_PIN))
+    pressed |= PPI_SCAN_LINE_CTRL;
+  if(!(GPIO_ODR(SHIFT_PORT) & SHIFT_PIN))
+    pressed |= PPI_SCAN_LINE_SHIFT;
+  if(!(GPIO_ODR(RUSLAT_PORT) & RUSLAT_PIN))
+    pressed |= PPI_SCAN_LINE_RUSLAT;
+  return pressed;
+}
+
+
+//The response is the first X change after the Y write, up to a column pitch (later ones are typed keys).
+//Host ISRs take no time, so isr_usec is added.
+static void scan_close_read(void)
+{
+  if(!scan_read_open)
+    return;
+  scan_read_open = false;
+  scan_read.responded = x_response_usec < scan_read.y_write_usec + scan.column_pitch_usec;
+  if(scan_read.responded)
+  {
+    scan_read.late = (x_response_usec > scan_read.sample_usec) || sampled_before_write;
+    scan_read.margin_usec = (int32_t)scan.read_delay_usec -
+                            (int32_t)(x_response_usec - scan_read.y_write_usec + scan.isr_usec);
+  }
+  else
+  {
+    scan_read.late = false;
+    scan_read.margin_usec = 0;
+  }
+  if(scan_read_callback)
+    scan_read_callback(&scan_read);
+}
+
+
+static void scan_write(void)
+{
+  uint8_t column = scan.pattern[scan_idx];
+  uint16_t levels;
+  uint64_t frame_period = 1000000 / scan.frame_hz;
+
+  scan_close_read();
+  scan_read.column = column;
+  sampled_before_write = scan.read_delay_usec < scan.isr_usec;
+  if(sampled_before_write)
+  {
+    scan_read.x_pressed = x_pressed_now();
+    scan_read.lines = lines_pressed_now();
+    scan_read.sample_usec = host_time_usec;
+  }
+  if(column == PPI_SCAN_ALL_COLUMNS)
+    levels = 0;
+  else if(column < 8)
+    levels = (uint16_t)(Y_LINES & ~y_pins[column]);
+  else
+    levels = Y_LINES;
+  scan_read.y_write_usec = host_time_usec;
+  x_response_usec = UINT64_MAX;
+  scan_read_open = true;
+  host_gpio_input_levels(Y0_PORT, Y_LINES, levels);
+  if(!sampled_before_write)
+    host_schedule_usec(scan.read_delay_usec - scan.isr_usec, scan_sample);
+
+  //Next column of this frame, or the first one of the next frame
+  if(++scan_idx < scan.pattern_len)
+    host_schedule_usec(scan.column_pitch_usec, scan_write);
+  else
+  {
+    scan_idx = 0;
+    scan_frame_usec += frame_period;
+    if(scan_frame_usec < host_time_usec + scan.column_pitch_usec)
+      scan_frame_usec = host_time_usec + scan.column_pitch_usec;  //Pattern longer than a frame
+    host_schedule_usec((uint32_t)(scan_frame_usec - host_time_usec), scan_write);
+  }
+}
+
+
+static void scan_sample(void)
+{
+  host_gpio_sync(X_PORT);
+  host_gpio_sync(CTRL_PORT);
+  host_gpio_sync(SHIFT_PORT);
+  host_gpio_sync(RUSLAT_PORT);
+  scan_read.x_pressed = x_pressed_now();
+  scan_read.lines = lines_pressed_now();
+  scan_read.sample_usec = host_time_usec;
+}
@@ -0,0 +1,123 @@
+/** @defgroup 16 ppi_scan Virtual PPI Scanner
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file ppi_scan.h Cycle timed model of the MSX keyboard scan: PPI port C (Y) writes and port B (X) reads.
+ *
+ * @brief <b>Cycle timed model of the MSX keyboard scan: PPI port C (Y) writes and port B (X) reads.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Each frame (frame_hz per second) writes the columns of the pattern, column_pitch_usec apart.
+ * This board receives the columns as 8 active low lines (Y0 to Y7), decoded by bit_recode[]:
+ * a column from 0 to 7 pulls down its line, a column from 8 up leaves all of them high (not wired
+ * here) and PPI_SCAN_ALL_COLUMNS pulls all of them down (the "any key pressed" probe).
+ * X is sampled read_delay_usec after each Y write. Host ISRs run in no time, so isr_usec
+ * (the target exti9_5_isr() duration) is taken from the read delay: X is sampled on
+ * (read_delay_usec - isr_usec), and a delay shorter than that reads the former column image.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#if !defined PPI_SCAN_H
+#define PPI_SCAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PPI_SCAN_MAX_PATTERN      64
+#define PPI_SCAN_ALL_COLUMNS      0xFF      //Pattern entry: all Y lines low
+#define PPI_SCAN_LINE_CTRL        (1 << 0)  //ppi_scan_read lines
+#define PPI_SCAN_LINE_SHIFT       (1 << 1)
+#define PPI_SCAN_LINE_RUSLAT      (1 << 2)
+
+struct ppi_scan_config
+{
+  uint16_t frame_hz;                        //Scans per second (MSX BIOS: 60 or 50)
+  uint16_t column_pitch_usec;               //From one Y write to the next one, on the same frame
+  uint16_t read_delay_usec;                 //From Y write to X read
+  uint16_t isr_usec;                        //Time the converter takes to update X after a Y change
+  uint8_t  pattern_len;
+  uint8_t  pattern[PPI_SCAN_MAX_PATTERN];   //Columns, in the order they are written
+};
+
+struct ppi_scan_read
+{
+  uint64_t y_write_usec;                    //When Y was written
+  uint64_t sample_usec;                     //When X was sampled (y_write_usec + read_delay_usec - isr_usec)
+  int32_t  margin_usec;                     //read_delay_usec - response time. Valid if responded
+  uint8_t  column;
+  uint8_t  x_pressed;                       //Bit n set: Xn low (key pressed)
+  uint8_t  lines;                           //PPI_SCAN_LINE_xxx low (pressed), sampled with X
+  bool     responded;                       //X pins changed up to a column pitch after the Y write
+  bool     late;                            //They changed after the sample
+};
+
+/**
+ * @brief Sets a sequential pattern: columns 0 to (columns - 1).
+ *
+ * @param config Scanner configuration.
+ * @param columns Quantity of columns (MSX1 9, MSX2 11).
+ */
+void ppi_scan_pattern_sequential(struct ppi_scan_config *config, uint8_t columns);
+
+/**
+ * @brief Parses a custom pattern, as "8,8,0,4,A": column numbers (decimal) and A for all columns.
+ *
+ * @param config Scanner configuration.
+ * @param text Pattern.
+ * @return false if it is not valid.
+ */
+bool ppi_scan_pattern_parse(struct ppi_scan_config *config, const char *text);
+
+/**
+ * @brief Starts scanning on the next virtual micro second.
+ *
+ * @param config Scanner configuration. It is copied.
+ * @param read_callback Receives each X read, when the next Y write (or ppi_scan_stop()) closes it.
+ */
+void ppi_scan_start(const struct ppi_scan_config *config, void (*read_callback)(const struct ppi_scan_read *read));
+
+/**
+ * @brief Stops scanning, closing the last read. Y lines are left high.
+ *
+ */
+void ppi_scan_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined PPI_SCAN_H
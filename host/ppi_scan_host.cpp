@@ -0,0 +1,936 @@
+/** @addtogroup 16 ppi_scan Virtual PPI Scanner
+ *
+ * @file ppi_scan_host.cpp Key miss rate and response margin of the converter, under a virtual MSX keyboard scan.
+ *
+ * @brief <b>Key miss rate and response margin of the converter, under a virtual MSX keyboard scan.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Usage: ppi-scan-host [-k keystrokes] [-n columns | -s pattern] [-f frame_hz] [-p column_pitch_us]
+ *                      [-d read_delay_us] [-l isr_us] [-b budget_us] [-h hold_min_ms:hold_max_ms]
+ *                      [-g gap_min_ms:gap_max_ms] [-r seed] [-m | -a period | -c] [-t file] [-v]
+ * First, each single byte make code is typed alone and kept if the converter maps it to one X bit
+ * of one Y column from 0 to 7. Then random keys of that set are typed one at a time, with random
+ * hold and gap times, while ppi_scan.c scans the matrix. Each X read is judged against the keys
+ * the keyboard model has sent, where "sent" is the end of the make (or break) code on PS/2:
+ * - missed press: reads of the key column while it is held (from sent make + budget up to sent break)
+ * and none of them saw it pressed;
+ * - late release: a read of the key column saw it pressed after sent break + budget;
+ * - phantom key: a read saw pressed an X bit that no key can explain;
+ * - unscanned: the key was released before any read of its column (not a converter fault).
+ * Results are given per 10000 keystrokes, plus the response margin of the Y change ISR.
+ * With -m, the keystrokes are taps of a macro (macro.c) instead, a quarter of them repeating the
+ * former key, played at the pace of the scan. Each read is judged as the MSX BIOS does: a key
+ * pressed on a read of its column, but not on the former one, is typed. The typed keys must be the
+ * macro ones, in order: a missing one is dropped, any other is wrong.
+ * With -a, the first calibrated key is remapped on console as an autofire key of that period
+ * (autofire.c), and held until it gave keystrokes pulses. Each press and
+ * each release must last exactly period reads of its column, so the BIOS types every pulse.
+ * With -c, PS/2 Shift is held, and the keys typed are the ones the converter maps to one X bit with
+ * MSX SHIFT released (CASE 2 shift substitutions of the Database). Each read is judged as with -m:
+ * the typed keys must be the ones sent, in order, and the SHIFT line must be released on the read
+ * that types each of them.
+ * With -t, the records of telemetry.c are started before the run, and the ring is sent to file
+ * as the telemetry endpoint would: up to TELEMETRY_FRAME_PACKETS packets of 64 bytes per 1ms USB
+ * frame (a full speed bulk endpoint alone on the bus). host/telemetry-reader decodes and checks it.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libopencm3/stm32/gpio.h>
+
+#include "system.h"
+#include "host_board.h"
+#include "host_firmware.h"
+#include "ppi_scan.h"
+#include "macro.h"
+#include "autofire.h"
+#include "telemetry.h"
+
+#define PS2_BREAK_PREFIX          0xF0
+#define PS2_NUM_LOCK              0x77      //Toggles the keypad mapping: not typed
+#define CALIBRATION_SETTLE_USEC   200000
+#define MAX_KEYS                  128
+#define MACRO_REPEAT_ONE_IN       4         //Taps of the former key, the hardest to tell apart
+#define PS2_LEFT_SHIFT            0x12
+#define TELEMETRY_PACKET_SIZE     64
+#define TELEMETRY_FRAME_PACKETS   19        //Bulk packets of 64 bytes on a full speed frame
+#define TELEMETRY_FRAME_USEC      1000
+
+extern uint32_t x_bits[16 + 1];                   //Declared on msxmap.cpp
+
+struct scan_key
+{
+  uint8_t code;                                   //PS/2 Set 2 make code
+  uint8_t column;
+  uint8_t x_mask;
+};
+
+enum KEYSTROKE_STATE
+{
+  KS_IDLE,
+  KS_MAKING,
+  KS_HELD,
+  KS_BREAKING,
+  KS_RELEASED,
+};
+
+struct keystroke
+{
+  enum KEYSTROKE_STATE state;
+  const struct scan_key *key;
+  uint64_t make_usec, break_usec;                 //When the keyboard ended sending them
+  uint32_t held_reads, seen_reads;
+  bool     late_release;
+};
+
+static const uint16_t x_pins[8] = { X0_PIN, X1_PIN, X2_PIN, X3_PIN, X4_PIN, X5_PIN, X6_PIN, X7_PIN };
+static struct scan_key keys[MAX_KEYS];
+static uint8_t  keys_len;
+static struct keystroke ks_cur, ks_prev;
+static uint32_t keystrokes_wanted, keystrokes_typed, keystrokes_done;
+static uint32_t budget_usec = 2000;
+static uint32_t hold_min_ms = 20, hold_max_ms = 150, gap_min_ms = 20, gap_max_ms = 100;
+static uint32_t rnd_state = 1;
+static bool     verbose;
+static uint8_t  *macro_taps;
+static uint32_t macro_typed, macro_wrong;
+static uint8_t  bios_former[8];                   //Pressed X bits of the former read of each column
+static uint8_t  autofire_period_wanted;
+static const struct scan_key *autofire_key;
+static bool     autofire_holding, autofire_pressed;
+static uint32_t autofire_pulses, autofire_run, autofire_wrong_runs, autofire_runs;
+static struct scan_key shifted_keys[MAX_KEYS];
+static uint8_t  shifted_keys_len;
+static const struct scan_key *shifted_cur;
+static uint8_t  *shifted_taps;                    //Y << 3 | X of each key sent
+static uint32_t shifted_sent, shifted_typed, shifted_wrong, shifted_with_shift;
+static bool     shifted_breaking;
+static FILE     *telemetry_file;
+static uint32_t telemetry_bytes;
+
+//Results
+static uint32_t missed_presses, late_releases, phantom_keys, unscanned;
+static uint8_t  phantom_former[16 + 1];           //Per column (16 is all columns), a phantom lasts until released
+static uint64_t reads, responses, late_responses;
+static int64_t  margin_sum;
+static int32_t  margin_min = INT32_MAX;
+
+//Prototype area
+static void console_discard(const uint8_t *data, uint16_t len);
+static bool parse_range(const char *text, uint32_t *min, uint32_t *max);
+static uint32_t rnd_range(uint32_t min, uint32_t max);
+static uint8_t x_bits_pressed(uint8_t column);
+static void calibrate(void);
+static void type_make(void);
+static void type_break(void);
+static void keyboard_sent(uint8_t data);
+static void keystroke_close(struct keystroke *ks);
+static uint8_t keystroke_judge(struct keystroke *ks, const struct ppi_scan_read *read, uint8_t *late_mask);
+static void scan_read_done(const struct ppi_scan_read *read);
+static bool all_keystrokes_done(void);
+static void report(const char *name, uint32_t count);
+static int  run_macro(const struct ppi_scan_config *config);
+static void macro_read_done(const struct ppi_scan_read *read);
+static bool macro_done(void);
+static int  run_autofire(const struct ppi_scan_config *config);
+static void autofire_read_done(const struct ppi_scan_read *read);
+static bool autofire_done(void);
+static bool shift_line_pressed(void);
+static void calibrate_shifted(void);
+static int  run_shifted(const struct ppi_scan_config *config);
+static void shifted_make(void);
+static void shifted_break(void);
+static void shifted_keyboard_sent(uint8_t data);
+static void shifted_read_done(const struct ppi_scan_read *read);
+static bool shifted_done(void);
+static bool telemetry_capture_open(const char *path);
+static void telemetry_frame(void);
+static int  telemetry_capture_close(int result);
+
+
+int main(int argc, char *argv[])
+{
+  struct ppi_scan_config config;
+  uint8_t columns = 11;
+  const char *pattern = NULL, *telemetry_path = NULL;
+  bool macro = false, shifted = false;
+  int i;
+
+  config.frame_hz = 60;
+  config.column_pitch_usec = 17;                  //MSX BIOS KEYINT loop, Z80 at 3.58MHz
+  config.read_delay_usec = 3;                     //OUT (0AAh),A then IN A,(0A9h)
+  config.isr_usec = 1;                            //exti9_5_isr() on STM32F401 at 84MHz
+  keystrokes_wanted = 10000;
+
+  for(i = 1; i < argc; i++)
+  {
+    if(!strcmp(argv[i], "-v"))
+      verbose = true;
+    else if(!strcmp(argv[i], "-m"))
+      macro = true;
+    else if(!strcmp(argv[i], "-c"))
+      shifted = true;
+    else if(i + 1 >= argc)
+      break;
+    else if(!strcmp(argv[i], "-k"))
+      keystrokes_wanted = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-n"))
+      columns = (uint8_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-s"))
+      pattern = argv[++i];
+    else if(!strcmp(argv[i], "-f"))
+      config.frame_hz = (uint16_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-p"))
+      config.column_pitch_usec = (uint16_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-d"))
+      config.read_delay_usec = (uint16_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-l"))
+      config.isr_usec = (uint16_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-b"))
+      budget_usec = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-h"))
+    {
+      if(!parse_range(argv[++i], &hold_min_ms, &hold_max_ms))
+        break;
+    }
+    else if(!strcmp(argv[i], "-g"))
+    {
+      if(!parse_range(argv[++i], &gap_min_ms, &gap_max_ms))
+        break;
+    }
+    else if(!strcmp(argv[i], "-r"))
+      rnd_state = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-a"))
+      autofire_period_wanted = (uint8_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-t"))
+      telemetry_path = argv[++i];
+    else
+      break;
+  }
+  if(pattern)
+  {
+    if(!ppi_scan_pattern_parse(&config, pattern))
+      i = 0;
+  }
+  else
+    ppi_scan_pattern_sequential(&config, columns);
+  if( (i < argc) || !config.frame_hz || !config.pattern_len || !keystrokes_wanted || !rnd_state ||
+      (config.read_delay_usec >= config.column_pitch_usec) || (gap_min_ms * 1000 < budget_usec) ||
+      ((macro + shifted + (autofire_period_wanted != 0)) > 1) || (autofire_period_wanted > AUTOFIRE_MAX_PERIOD) )
+  {
+    fprintf(stderr, "Usage: %s [-k keystrokes] [-n columns | -s pattern] [-f frame_hz] [-p column_pitch_us]\n"
+                    "\t[-d read_delay_us] [-l isr_us] [-b budget_us] [-h hold_min_ms:hold_max_ms]\n"
+                    "\t[-g gap_min_ms:gap_max_ms] [-r seed] [-m | -a period | -c] [-t file] [-v]\n"
+                    "Pattern: columns separated by commas, A for all (as 8,8,0,A). Read delay must be\n"
+                    "shorter than column pitch, and minimum gap not shorter than budget. Autofire\n"
+                    "period is 1 to %u reads.\n", argv[0], AUTOFIRE_MAX_PERIOD);
+    return EXIT_FAILURE;
+  }
+
+  host_uart_tx_hook = console_discard;
+  if(!host_firmware_boot())
+  {
+    fprintf(stderr, "ppi-scan-host: keyboard not detected\n");
+    return EXIT_FAILURE;
+  }
+  calibrate();
+  if(!keys_len)
+  {
+    fprintf(stderr, "ppi-scan-host: no key of the database maps to one X bit of columns 0 to 7\n");
+    return EXIT_FAILURE;
+  }
+  if(telemetry_path && !telemetry_capture_open(telemetry_path))
+    return EXIT_FAILURE;
+  if(macro)
+    return telemetry_capture_close(run_macro(&config));
+  if(autofire_period_wanted)
+    return telemetry_capture_close(run_autofire(&config));
+  if(shifted)
+    return telemetry_capture_close(run_shifted(&config));
+
+  host_ps2_keyboard_sent_hook = keyboard_sent;
+  ppi_scan_start(&config, scan_read_done);
+  host_schedule_usec(1000, type_make);
+  host_firmware_run_until(UINT64_MAX, all_keystrokes_done);
+  ppi_scan_stop();
+
+  printf("keys: %u (calibrated)\n", keys_len);
+  printf("keystrokes: %u\n", keystrokes_done);
+  printf("virtual_time_s: %.1f\n", host_time_usec / 1e6);
+  report("missed_presses", missed_presses);
+  report("late_releases", late_releases);
+  report("phantom_keys", phantom_keys);
+  report("unscanned", unscanned);
+  printf("x_reads: %llu\n", (unsigned long long)reads);
+  printf("responses: %llu\n", (unsigned long long)responses);
+  printf("late_responses: %llu\n", (unsigned long long)late_responses);
+  if(responses)
+  {
+    printf("margin_min_us: %d\n", margin_min);
+    printf("margin_mean_us: %.2f\n", (double)margin_sum / (double)responses);
+  }
+  return telemetry_capture_close((missed_presses || late_releases || phantom_keys) ? 2 : EXIT_SUCCESS);
+}
+
+
+static void console_discard(const uint8_t *data, uint16_t len)
+{
+  (void)data;
+  (void)len;
+}
+
+
+static bool parse_range(const char *text, uint32_t *min, uint32_t *max)
+{
+  char *end;
+
+  *min = (uint32_t)strtoul(text, &end, 0);
+  if(*end != ':')
+    return false;
+  *max = (uint32_t)strtoul(end + 1, &end, 0);
+  return !*end && (*min <= *max);
+}
+
+
+//xorshift32: the same sequence for a seed on any host
+static uint32_t rnd_range(uint32_t min, uint32_t max)
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return min + rnd_state % (max - min + 1);
+}
+
+
+//x_bits are GPIO_BSRR images: reset half (high 16 bits) pulls the X pin down, that is, key pressed
+static uint8_t x_bits_pressed(uint8_t column)
+{
+  uint8_t x, pressed = 0;
+
+  for(x = 0; x < 8; x++)
+    if(x_bits[column] & ((uint32_t)x_pins[x] << 16))
+      pressed |= (uint8_t)(1 << x);
+  return pressed;
+}
+
+
+//Keeps the make codes the converter maps to a single X bit of columns 0 to 7, released by the break code
+static void calibrate(void)
+{
+  uint8_t code, column, found_column = 0, found_mask = 0, pressed, columns_pressed;
+  uint8_t typed[2];
+  bool released;
+
+  for(code = 0x01; code < 0x84; code++)
+  {
+    if(keys_len == MAX_KEYS)
+      break;
+    if(code == PS2_NUM_LOCK)
+      continue;
+    typed[0] = code;
+    host_ps2_keyboard_type(typed, 1);
+    host_firmware_run_until(host_time_usec + CALIBRATION_SETTLE_USEC, NULL);
+    columns_pressed = 0;
+    for(column = 0; column < 8; column++)
+    {
+      pressed = x_bits_pressed(column);
+      if(pressed)
+      {
+        columns_pressed++;
+        found_column = column;
+        found_mask = pressed;
+      }
+    }
+    typed[0] = PS2_BREAK_PREFIX;
+    typed[1] = code;
+    host_ps2_keyboard_type(typed, 2);
+    host_firmware_run_until(host_time_usec + CALIBRATION_SETTLE_USEC, NULL);
+    released = true;
+    for(column = 0; column < 16; column++)
+      if(x_bits_pressed(column))
+        released = false;
+    if(!released)
+    {
+      //Leave no key pressed for the next one
+      fprintf(stderr, "ppi-scan-host: 0x%02X does not release its MSX key\n", code);
+      exit(EXIT_FAILURE);
+    }
+    if((columns_pressed == 1) && !(found_mask & (found_mask - 1)))
+    {
+      keys[keys_len].code = code;
+      keys[keys_len].column = found_column;
+      keys[keys_len].x_mask = found_mask;
+      keys_len++;
+    }
+  }
+}
+
+
+//The former keystroke is closed when the current one is replaced
+static void type_make(void)
+{
+  if(ks_cur.state != KS_IDLE)
+  {
+    keystroke_close(&ks_prev);
+    ks_prev = ks_cur;
+  }
+  if(keystrokes_typed == keystrokes_wanted)
+  {
+    ks_cur.state = KS_IDLE;
+    keystroke_close(&ks_prev);
+    return;
+  }
+  keystrokes_typed++;
+  memset(&ks_cur, 0, sizeof(ks_cur));
+  ks_cur.key = &keys[rnd_range(0, keys_len - 1u)];
+  ks_cur.state = KS_MAKING;
+  host_ps2_keyboard_type(&ks_cur.key->code, 1);
+}
+
+
+static void type_break(void)
+{
+  uint8_t typed[2] = { PS2_BREAK_PREFIX, ks_cur.key->code };
+
+  ks_cur.state = KS_BREAKING;
+  host_ps2_keyboard_type(typed, 2);
+}
+
+
+static void keyboard_sent(uint8_t data)
+{
+  if((ks_cur.state == KS_MAKING) && (data == ks_cur.key->code))
+  {
+    ks_cur.make_usec = host_time_usec;
+    ks_cur.state = KS_HELD;
+    host_schedule_usec(rnd_range(hold_min_ms, hold_max_ms) * 1000, type_break);
+  }
+  else if((ks_cur.state == KS_BREAKING) && (data == ks_cur.key->code))
+  {
+    ks_cur.break_usec = host_time_usec;
+    ks_cur.state = KS_RELEASED;
+    host_schedule_usec(rnd_range(gap_min_ms, gap_max_ms) * 1000, type_make);
+  }
+}
+
+
+static void keystroke_close(struct keystroke *ks)
+{
+  if(ks->state != KS_RELEASED)
+    return;
+  ks->state = KS_IDLE;
+  keystrokes_done++;
+  if(!ks->held_reads)
+    unscanned++;
+  else if(!ks->seen_reads)
+  {
+    missed_presses++;
+    if(verbose)
+      printf("%10llu missed 0x%02X Y%u\n", (unsigned long long)ks->make_usec, ks->key->code, ks->key->column);
+  }
+  if(ks->late_release)
+    late_releases++;
+}
+
+
+//Returns the X bits this keystroke explains on the read. The ones pressed too late go to late_mask.
+static uint8_t keystroke_judge(struct keystroke *ks, const struct ppi_scan_read *read, uint8_t *late_mask)
+{
+  uint64_t t = read->sample_usec;
+
+  if( (ks->state < KS_HELD) || (t < ks->make_usec) ||
+      ((read->column != ks->key->column) && (read->column != PPI_SCAN_ALL_COLUMNS)) )
+    return 0;
+  if((ks->state != KS_RELEASED) || (t < ks->break_usec))
+  {
+    if((t >= ks->make_usec + budget_usec) && (read->column == ks->key->column))
+    {
+      ks->held_reads++;
+      if(read->x_pressed & ks->key->x_mask)
+        ks->seen_reads++;
+    }
+    return ks->key->x_mask;
+  }
+  if(t < ks->break_usec + budget_usec)
+    return ks->key->x_mask;
+  if(read->x_pressed & ks->key->x_mask)
+  {
+    if(verbose && !ks->late_release)
+      printf("%10llu late release 0x%02X Y%u\n", (unsigned long long)t, ks->key->code, ks->key->column);
+    ks->late_release = true;
+    *late_mask |= ks->key->x_mask;
+  }
+  return 0;
+}
+
+
+static void scan_read_done(const struct ppi_scan_read *read)
+{
+  uint8_t explained, late_mask = 0, phantom, column;
+
+  reads++;
+  if(read->responded)
+  {
+    responses++;
+    margin_sum += read->margin_usec;
+    if(read->margin_usec < margin_min)
+      margin_min = read->margin_usec;
+    if(read->late)
+      late_responses++;
+  }
+  explained = keystroke_judge(&ks_cur, read, &late_mask);
+  //The former keystroke is judged until the current one is held (it may be the same key)
+  if((ks_cur.state < KS_HELD) || (read->sample_usec < ks_cur.make_usec))
+    explained |= keystroke_judge(&ks_prev, read, &late_mask);
+  phantom = read->x_pressed & (uint8_t)~(explained | late_mask);
+  column = (read->column == PPI_SCAN_ALL_COLUMNS) ? 16 : read->column;
+  if(phantom & ~phantom_former[column])
+  {
+    phantom_keys += (uint32_t)__builtin_popcount(phantom & ~phantom_former[column]);
+    if(verbose)
+      printf("%10llu phantom Y%u 0x%02X\n", (unsigned long long)read->sample_usec, column, phantom);
+  }
+  phantom_former[column] = phantom;
+}
+
+
+static bool all_keystrokes_done(void)
+{
+  return (keystrokes_typed == keystrokes_wanted) && (ks_cur.state == KS_IDLE);
+}
+
+
+static void report(const char *name, uint32_t count)
+{
+  printf("%s: %u (%.2f per 10000 keystrokes)\n", name, count,
+         keystrokes_done ? (double)count * 10000.0 / keystrokes_done : 0.0);
+}
+
+
+//Taps of random calibrated keys, played as one macro while the scanner runs
+static int run_macro(const struct ppi_scan_config *config)
+{
+  const struct scan_key *key = NULL;
+  uint64_t start_usec;
+  double seconds;
+  uint8_t column;
+  bool released = true;
+
+  macro_taps = (uint8_t*)malloc(keystrokes_wanted);
+  if(!macro_taps || (keystrokes_wanted > UINT16_MAX))
+  {
+    fprintf(stderr, "ppi-scan-host: a macro has up to %u keys\n", UINT16_MAX);
+    return EXIT_FAILURE;
+  }
+  for(uint32_t k = 0; k < keystrokes_wanted; k++)
+  {
+    if(!key || (rnd_range(1, MACRO_REPEAT_ONE_IN) != 1))
+      key = &keys[rnd_range(0, keys_len - 1u)];
+    macro_taps[k] = (uint8_t)(MACRO_TAP + ((key->column << 3) | __builtin_ctz(key->x_mask)));
+  }
+  ppi_scan_start(config, macro_read_done);
+  start_usec = host_time_usec;
+  if(!macro_play(macro_taps, (uint16_t)keystrokes_wanted))
+  {
+    fprintf(stderr, "ppi-scan-host: the macro was refused\n");
+    return EXIT_FAILURE;
+  }
+  host_firmware_run_until(UINT64_MAX, macro_done);
+  seconds = (double)(host_time_usec - start_usec) / 1e6;
+  ppi_scan_stop();
+  for(column = 0; column < 16; column++)
+    if(x_bits_pressed(column))
+      released = false;
+
+  printf("keys: %u (calibrated)\n", keys_len);
+  printf("macro_keys: %u\n", keystrokes_wanted);
+  printf("typed: %u\n", macro_typed);
+  printf("dropped: %u\n", keystrokes_wanted - macro_typed);
+  printf("wrong: %u\n", macro_wrong);
+  printf("left_pressed: %s\n", released ? "no" : "yes");
+  printf("x_reads: %llu\n", (unsigned long long)reads);
+  printf("virtual_time_s: %.1f\n", seconds);
+  printf("keys_per_s: %.1f\n", seconds > 0 ? macro_typed / seconds : 0.0);
+  free(macro_taps);
+  return ((macro_typed != keystrokes_wanted) || macro_wrong || !released) ? 2 : EXIT_SUCCESS;
+}
+
+
+static void macro_read_done(const struct ppi_scan_read *read)
+{
+  uint8_t typed, expected, x;
+
+  reads++;
+  if(read->column > 7)
+    return;
+  typed = read->x_pressed & (uint8_t)~bios_former[read->column];
+  bios_former[read->column] = read->x_pressed;
+  for(x = 0; x < 8; x++)
+  {
+    if(!(typed & (1 << x)))
+      continue;
+    expected = (macro_typed < keystrokes_wanted) ? (uint8_t)(macro_taps[macro_typed] - MACRO_TAP) : 0xFF;
+    if(expected == ((read->column << 3) | x))
+      macro_typed++;
+    else
+    {
+      macro_wrong++;
+      if(verbose)
+        printf("%10llu wrong Y%uX%u, key %u is Y%uX%u\n", (unsigned long long)read->sample_usec, read->column, x,
+               macro_typed, expected >> 3, expected & 7);
+    }
+  }
+}
+
+
+static bool macro_done(void)
+{
+  return !macro_playing();
+}
+
+
+//The first calibrated key, remapped as an autofire key and held until it gave the pulses wanted
+static int run_autofire(const struct ppi_scan_config *config)
+{
+  char command[48];
+  uint8_t typed[2], column;
+  uint64_t start_usec;
+  double seconds;
+  bool released = true;
+
+  autofire_key = &keys[0];
+  snprintf(command, sizeof(command), "remap %02X : 0a%u Y%uX%u\r", autofire_key->code, autofire_period_wanted,
+           autofire_key->column, __builtin_ctz(autofire_key->x_mask));
+  host_uart_rx((const uint8_t*)command, (uint16_t)strlen(command));
+  host_firmware_run_until(host_time_usec + CALIBRATION_SETTLE_USEC, NULL);
+  ppi_scan_start(config, autofire_read_done);
+  start_usec = host_time_usec;
+  autofire_holding = true;
+  host_ps2_keyboard_type(&autofire_key->code, 1);
+  host_firmware_run_until(UINT64_MAX, autofire_done);
+  seconds = (double)(host_time_usec - start_usec) / 1e6;
+  autofire_holding = false;
+  typed[0] = PS2_BREAK_PREFIX;
+  typed[1] = autofire_key->code;
+  host_ps2_keyboard_type(typed, 2);
+  host_firmware_run_until(host_time_usec + CALIBRATION_SETTLE_USEC, NULL);
+  ppi_scan_stop();
+  for(column = 0; column < 16; column++)
+    if(x_bits_pressed(column))
+      released = false;
+
+  printf("key: 0x%02X (Y%uX%u)\n", autofire_key->code, autofire_key->column, __builtin_ctz(autofire_key->x_mask));
+  printf("period_reads: %u\n", autofire_period_wanted);
+  printf("pulses: %u\n", autofire_pulses);
+  printf("phases: %u\n", autofire_runs);
+  printf("wrong_phases: %u\n", autofire_wrong_runs);
+  printf("left_pressed: %s\n", released ? "no" : "yes");
+  printf("x_reads: %llu\n", (unsigned long long)reads);
+  printf("virtual_time_s: %.1f\n", seconds);
+  printf("pulses_per_s: %.1f\n", seconds > 0 ? autofire_pulses / seconds : 0.0);
+  return ((autofire_pulses < keystrokes_wanted) || autofire_wrong_runs || !released) ? 2 : EXIT_SUCCESS;
+}
+
+
+//Each phase (pressed or released reads in a row) but the last one must last the period
+static void autofire_read_done(const struct ppi_scan_read *read)
+{
+  bool pressed;
+
+  reads++;
+  if(!autofire_holding || (read->column != autofire_key->column))
+    return;
+  pressed = (read->x_pressed & autofire_key->x_mask) != 0;
+  if(!autofire_run)
+  {
+    //Nothing is judged until the first press is seen
+    if(!pressed)
+      return;
+    autofire_pressed = true;
+  }
+  else if(pressed != autofire_pressed)
+  {
+    autofire_runs++;
+    if(autofire_run != autofire_period_wanted)
+    {
+      autofire_wrong_runs++;
+      if(verbose)
+        printf("%10llu phase of %u reads\n", (unsigned long long)read->sample_usec, autofire_run);
+    }
+    autofire_pressed = pressed;
+    autofire_run = 0;
+  }
+  if(pressed && !autofire_run)
+    autofire_pulses++;
+  autofire_run++;
+}
+
+
+static bool autofire_done(void)
+{
+  return autofire_pulses >= keystrokes_wanted;
+}
+
+
+static bool shift_line_pressed(void)
+{
+  return !(GPIO_ODR(SHIFT_PORT) & SHIFT_PIN);
+}
+
+
+//With Shift held, keeps the make codes the converter maps to a single X bit of columns 0 to 7 with MSX SHIFT released
+static void calibrate_shifted(void)
+{
+  uint8_t typed[2], column, columns_pressed, found_column = 0, found_mask = 0, pressed;
+  bool shift_released;
+
+  typed[0] = PS2_LEFT_SHIFT;
+  host_ps2_keyboard_type(typed, 1);
+  host_firmware_run_until(host_time_usec + CALIBRATION_SETTLE_USEC, NULL);
+  for(uint8_t n = 0; n < keys_len; n++)
+  {
+    if(shifted_keys_len == MAX_KEYS)
+      break;
+    typed[0] = keys[n].code;
+    host_ps2_keyboard_type(typed, 1);
+    host_firmware_run_until(host_time_usec + CALIBRATION_SETTLE_USEC, NULL);
+    shift_released = !shift_line_pressed();
+    columns_pressed = 0;
+    for(column = 0; column < 8; column++)
+    {
+      pressed = x_bits_pressed(column);
+      if(pressed)
+      {
+        columns_pressed++;
+        found_column = column;
+        found_mask = pressed;
+      }
+    }
+    typed[0] = PS2_BREAK_PREFIX;
+    typed[1] = keys[n].code;
+    host_ps2_keyboard_type(typed, 2);
+    host_firmware_run_until(host_time_usec + CALIBRATION_SETTLE_USEC, NULL);
+    if(shift_released && (columns_pressed == 1) && !(found_mask & (found_mask - 1)))
+    {
+      shifted_keys[shifted_keys_len].code = keys[n].code;
+      shifted_keys[shifted_keys_len].column = found_column;
+      shifted_keys[shifted_keys_len].x_mask = found_mask;
+      shifted_keys_len++;
+    }
+  }
+}
+
+
+//Random shift substitutions typed with Shift held, while the scanner runs
+static int run_shifted(const struct ppi_scan_config *config)
+{
+  uint8_t typed[2], column;
+  uint64_t start_usec;
+  double seconds;
+  bool released = true;
+
+  calibrate_shifted();
+  if(!shifted_keys_len)
+  {
+    fprintf(stderr, "ppi-scan-host: no key of the database releases MSX SHIFT with Shift held\n");
+    return EXIT_FAILURE;
+  }
+  shifted_taps = (uint8_t*)malloc(keystrokes_wanted);
+  if(!shifted_taps)
+    return EXIT_FAILURE;
+  host_ps2_keyboard_sent_hook = shifted_keyboard_sent;
+  ppi_scan_start(config, shifted_read_done);
+  start_usec = host_time_usec;
+  host_schedule_usec(1000, shifted_make);
+  host_firmware_run_until(UINT64_MAX, shifted_done);
+  //The last keys are still on their way to the matrix
+  host_firmware_run_until(host_time_usec + CALIBRATION_SETTLE_USEC, NULL);
+  seconds = (double)(host_time_usec - start_usec) / 1e6;
+  host_ps2_keyboard_sent_hook = NULL;
+  typed[0] = PS2_BREAK_PREFIX;
+  typed[1] = PS2_LEFT_SHIFT;
+  host_ps2_keyboard_type(typed, 2);
+  host_firmware_run_until(host_time_usec + CALIBRATION_SETTLE_USEC, NULL);
+  ppi_scan_stop();
+  for(column = 0; column < 16; column++)
+    if(x_bits_pressed(column))
+      released = false;
+  if(shift_line_pressed())
+    released = false;
+
+  printf("keys: %u (calibrated with Shift held)\n", shifted_keys_len);
+  printf("keystrokes: %u\n", shifted_sent);
+  printf("typed: %u\n", shifted_typed);
+  printf("dropped: %u\n", shifted_sent - shifted_typed);
+  printf("wrong: %u\n", shifted_wrong);
+  printf("typed_with_shift: %u\n", shifted_with_shift);
+  printf("left_pressed: %s\n", released ? "no" : "yes");
+  printf("x_reads: %llu\n", (unsigned long long)reads);
+  printf("virtual_time_s: %.1f\n", seconds);
+  printf("keys_per_s: %.1f\n", seconds > 0 ? shifted_typed / seconds : 0.0);
+  free(shifted_taps);
+  return ((shifted_typed != shifted_sent) || shifted_wrong || shifted_with_shift || !released) ? 2 : EXIT_SUCCESS;
+}
+
+
+static void shifted_make(void)
+{
+  if(shifted_sent == keystrokes_wanted)
+  {
+    shifted_cur = NULL;
+    return;
+  }
+  shifted_cur = &shifted_keys[rnd_range(0, shifted_keys_len - 1u)];
+  shifted_taps[shifted_sent++] = (uint8_t)((shifted_cur->column << 3) | __builtin_ctz(shifted_cur->x_mask));
+  shifted_breaking = false;
+  host_ps2_keyboard_type(&shifted_cur->code, 1);
+}
+
+
+static void shifted_break(void)
+{
+  uint8_t typed[2] = { PS2_BREAK_PREFIX, shifted_cur->code };
+
+  shifted_breaking = true;
+  host_ps2_keyboard_type(typed, 2);
+}
+
+
+static void shifted_keyboard_sent(uint8_t data)
+{
+  if(!shifted_cur || (data != shifted_cur->code))
+    return;
+  if(!shifted_breaking)
+    host_schedule_usec(rnd_range(hold_min_ms, hold_max_ms) * 1000, shifted_break);
+  else
+    host_schedule_usec(rnd_range(gap_min_ms, gap_max_ms) * 1000, shifted_make);
+}
+
+
+//As macro_read_done(), and the key must not be typed with MSX SHIFT pressed
+static void shifted_read_done(const struct ppi_scan_read *read)
+{
+  uint8_t typed, expected, x;
+
+  reads++;
+  if(read->column > 7)
+    return;
+  typed = read->x_pressed & (uint8_t)~bios_former[read->column];
+  bios_former[read->column] = read->x_pressed;
+  for(x = 0; x < 8; x++)
+  {
+    if(!(typed & (1 << x)))
+      continue;
+    expected = (shifted_typed < shifted_sent) ? shifted_taps[shifted_typed] : 0xFF;
+    if(expected != ((read->column << 3) | x))
+    {
+      shifted_wrong++;
+      if(verbose)
+        printf("%10llu wrong Y%uX%u, key %u is Y%uX%u\n", (unsigned long long)read->sample_usec, read->column, x,
+               shifted_typed, expected >> 3, expected & 7);
+      continue;
+    }
+    shifted_typed++;
+    if(read->lines & PPI_SCAN_LINE_SHIFT)
+    {
+      shifted_with_shift++;
+      if(verbose)
+        printf("%10llu Y%uX%u typed with SHIFT\n", (unsigned long long)read->sample_usec, read->column, x);
+    }
+  }
+}
+
+
+static bool shifted_done(void)
+{
+  return (shifted_sent == keystrokes_wanted) && !shifted_cur;
+}
+
+
+static bool telemetry_capture_open(const char *path)
+{
+  telemetry_file = fopen(path, "wb");
+  if(!telemetry_file)
+  {
+    perror(path);
+    return false;
+  }
+  telemetry_start();
+  host_schedule_usec(TELEMETRY_FRAME_USEC, telemetry_frame);
+  return true;
+}
+
+
+//One USB frame of the telemetry endpoint: packets of the ring, as ring_span_onto_ep() of cdcacm.c
+static void telemetry_frame(void)
+{
+  uint16_t packets, len;
+
+  for(packets = 0; packets < TELEMETRY_FRAME_PACKETS; packets++)
+  {
+    len = QTTY_CHAR_IN(telemetry_ring);
+    if(!len)
+      break;
+    if(len > TELEMETRY_PACKET_SIZE)
+      len = TELEMETRY_PACKET_SIZE;
+    if(len > TELEMETRY_RING_SIZE - telemetry_ring.get_ptr)
+      len = (uint16_t)(TELEMETRY_RING_SIZE - telemetry_ring.get_ptr);
+    fwrite(&telemetry_ring.data[telemetry_ring.get_ptr], 1, len, telemetry_file);
+    telemetry_bytes += len;
+    telemetry_ring.get_ptr = (telemetry_ring.get_ptr + len) & telemetry_ring.bufSzMask;
+  }
+  host_schedule_usec(TELEMETRY_FRAME_USEC, telemetry_frame);
+}
+
+
+//Stops the records and sends the ones left, then passes the run result on
+static int telemetry_capture_close(int result)
+{
+  if(!telemetry_file)
+    return result;
+  telemetry_stop();
+  host_unschedule(telemetry_frame);
+  while(QTTY_CHAR_IN(telemetry_ring))
+    telemetry_frame();
+  host_unschedule(telemetry_frame);
+  if(fclose(telemetry_file))
+  {
+    perror("ppi-scan-host: telemetry");
+    return EXIT_FAILURE;
+  }
+  printf("telemetry_bytes: %u\n", telemetry_bytes);
+  return result;
+}
@@ -0,0 +1,546 @@
+/** @addtogroup 15 host_board Host Board and PS/2 Keyboard Models
+ *
+ * @file ps2_fuzz_host.cpp Bit level PS/2 waveform generator and fuzzer of ps2_clock_update().
+ *
+ * @brief <b>Bit level PS/2 waveform generator and fuzzer of ps2_clock_update().</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Usage: ps2-fuzz-host [-n frames] [-w workers] [-f min_hz:max_hz] [-j jitter_us] [-g gap_us]
+ *                      [-e impaired_per_mil] [-k kinds] [-m max_loss_ppm] [-r seed]
+ * Synthesizes keyboard frames on a synthetic time line and calls ps2_clock_update() on each
+ * falling clock edge, as the TIM_HR capture ISR does: time_between_ps2clk and systicks follow
+ * the synthetic time. Each frame has its own clock frequency (min_hz to max_hz) and jitter.
+ * A fraction of the frames are impaired, by one of these kinds (letters of -k):
+ * - g: glitch, an extra falling edge 1 to 8us after a bit edge;
+ * - p: parity error;
+ * - s: stop bit error;
+ * - t: truncated frame (keyboard inhibited, it sends the byte again);
+ * - c: host inhibit collision, ps2_send_command() in the middle of a frame. The keyboard checks
+ *   the command bits, ACKs them, sends 0xFA and the aborted byte again;
+ * - l: data line stuck low for longer than the 0.2s watchdog of acctimeps2data0 (about 2600 edges,
+ *   so it is not on the default kinds: gpstc).
+ * Every clean frame must be delivered to ps2_recv_buffer, unchanged, and ps2int_state must be back
+ * to PS2INT_RECEIVE after it. Workers are forked processes (the firmware state is global), one per
+ * CPU core by default, with seeds seed, seed + 1... Exit status is 1 when an assertion fails:
+ * command bits, state recovery, corrupted clean byte, or clean byte loss over max_loss_ppm.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+
+#include "system.h"
+#include "hr_timer.h"
+#include "serial.h"
+#include "ps2handl.h"
+#include "sys_timer.h"
+
+#define DEFAULT_FRAMES            10000000
+#define MAX_WORKERS               256
+#define MAX_REPORTED_FAILURES     5
+#define COMMAND_SENT              0xF4      //Enable: no argument
+#define COMMAND_START_USEC        140       //send_start_bit_now() to send_start_bit3()
+#define KB_ACK                    0xFA
+#define STUCK_LOW_USEC            210000    //Over the 0.2s watchdog
+#define ARG_NO_ARG                0xFF      //As ps2handl.c
+
+extern "C" {
+extern volatile uint16_t ps2int_state;            //Declared on ps2handl.c
+extern volatile uint8_t  ps2int_RX_bit_idx;       //Declared on ps2handl.c
+extern volatile bool     command_running;         //Declared on ps2handl.c
+extern volatile uint8_t  ps2_recv_buffer[PS2_RECV_BUFFER_SIZE]; //Declared on ps2handl.c
+extern volatile uint64_t time_between_ps2clk;     //Declared on hr_timer.c
+void init_ps2_recv_buffer(void);                  //Declared on ps2handl.c
+bool available_ps2_byte(void);                    //Declared on ps2handl.c
+uint8_t get_ps2_byte(volatile uint8_t *buff);     //Declared on ps2handl.c
+void ps2_send_command(uint8_t cmd, uint8_t argm); //Declared on ps2handl.c
+}
+extern volatile uint32_t systicks;                //Declared on sys_timer.cpp
+
+enum IMPAIRMENT
+{
+  IMP_NONE,
+  IMP_GLITCH,
+  IMP_PARITY,
+  IMP_STOP,
+  IMP_TRUNCATE,
+  IMP_COLLISION,
+  IMP_STUCK_LOW,
+  IMP_COUNT,
+};
+
+static const char imp_letters[IMP_COUNT + 1] = "-gpstcl";
+static const char *imp_names[IMP_COUNT] = { "clean", "glitch", "parity", "stop", "truncate", "collision", "stuck_low" };
+
+struct fuzz_results
+{
+  uint64_t frames[IMP_COUNT];
+  uint64_t delivered;                             //Clean bytes delivered unchanged
+  uint64_t lost;                                  //Clean bytes not delivered
+  uint64_t recovery_failures;                     //Lost right after an impaired frame
+  uint64_t corrupted;                             //Clean frame delivered another byte
+  uint64_t spurious;                              //Impaired frame delivered a byte not sent
+  uint64_t tx_errors;                             //Command bits the keyboard received wrong
+  uint64_t state_errors;                          //ps2int_state not back to PS2INT_RECEIVE
+};
+
+static uint32_t freq_min_hz = 10000, freq_max_hz = 16700;
+static uint32_t jitter_usec = 2, gap_usec = 200, impaired_permil = 100;
+static uint32_t max_loss_ppm;
+static uint8_t  kinds[IMP_COUNT];
+static uint8_t  kinds_len;
+
+//Worker state
+static uint32_t rnd_state;
+static uint64_t t_usec, last_edge_usec;           //Synthetic time line
+static uint32_t half_usec;                        //Half period of the running frame
+static struct fuzz_results res;
+static uint32_t failures_reported;
+static uint64_t frame_idx;
+static uint32_t worker_seed;
+static enum IMPAIRMENT former_imp;                //Of the frame before, for the failure reports
+
+//Prototype area
+static void console_discard(const uint8_t *data, uint16_t len);
+static bool parse_kinds(const char *text);
+static uint32_t rnd_range(uint32_t min, uint32_t max);
+static void fail(const char *what, enum IMPAIRMENT imp, uint8_t byte);
+static void edge(uint32_t dt, bool data);
+static uint32_t bit_dt(void);
+static uint16_t frame_bits(uint8_t byte);
+static void send_frame(uint8_t byte, enum IMPAIRMENT imp);
+static void send_partial_frame(uint8_t byte, uint8_t edges);
+static void receive_command(uint8_t expected);
+static void stuck_low(void);
+static void check_delivery(uint8_t byte, enum IMPAIRMENT imp);
+static void worker(uint64_t frames, struct fuzz_results *out);
+
+
+int main(int argc, char *argv[])
+{
+  uint64_t frames = DEFAULT_FRAMES, per_worker, total_frames = 0, clean;
+  long workers = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t seed = 1;
+  int pipes[MAX_WORKERS][2];
+  struct fuzz_results sum, part;
+  struct timespec start, end;
+  double elapsed;
+  bool failed;
+  char *sep;
+  int i, k, status;
+  long w;
+
+  parse_kinds("gpstc");
+  for(i = 1; i < argc; i++)
+  {
+    if(i + 1 >= argc)
+      break;
+    else if(!strcmp(argv[i], "-n"))
+      frames = strtoull(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-w"))
+      workers = strtol(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-f"))
+    {
+      freq_min_hz = (uint32_t)strtoul(argv[++i], &sep, 0);
+      if(*sep != ':')
+        break;
+      freq_max_hz = (uint32_t)strtoul(sep + 1, NULL, 0);
+    }
+    else if(!strcmp(argv[i], "-j"))
+      jitter_usec = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-g"))
+      gap_usec = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-e"))
+      impaired_permil = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-k"))
+    {
+      if(!parse_kinds(argv[++i]))
+        break;
+    }
+    else if(!strcmp(argv[i], "-m"))
+      max_loss_ppm = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-r"))
+      seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else
+      break;
+  }
+  if( (i < argc) || !frames || (workers < 1) || (workers > MAX_WORKERS) || !seed ||
+      (freq_min_hz < 1000) || (freq_min_hz > freq_max_hz) || (freq_max_hz > 50000) || (impaired_permil > 1000) ||
+      (jitter_usec * 2 >= 500000 / freq_max_hz) )
+  {
+    fprintf(stderr, "Usage: %s [-n frames] [-w workers] [-f min_hz:max_hz] [-j jitter_us] [-g gap_us]\n"
+                    "\t[-e impaired_per_mil] [-k kinds] [-m max_loss_ppm] [-r seed]\n"
+                    "Kinds: g glitch, p parity, s stop, t truncate, c collision, l stuck low (default gpstc).\n"
+                    "Jitter must be shorter than a quarter of the clock period.\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  //Firmware parts used by the PS/2 state machine, set up once and inherited by the workers
+  host_uart_tx_hook = console_discard;
+  rcc_clock_setup_pll(&rcc_hse_25mhz_3v3[RCC_CLOCK_3V3_84MHZ]);
+  tim_hr_setup(TIM_HR);
+  serial_setup();
+  init_ps2_recv_buffer();
+  ps2int_state = PS2INT_RECEIVE;
+  ps2int_RX_bit_idx = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  per_worker = (frames + (uint64_t)workers - 1) / (uint64_t)workers;
+  for(w = 0; w < workers; w++)
+  {
+    if(pipe(pipes[w]))
+    {
+      perror("ps2-fuzz-host: pipe");
+      return EXIT_FAILURE;
+    }
+    switch(fork())
+    {
+      case -1:
+        perror("ps2-fuzz-host: fork");
+        return EXIT_FAILURE;
+      case 0:
+        close(pipes[w][0]);
+        worker_seed = seed + (uint32_t)w;
+        worker(per_worker, &part);
+        if(write(pipes[w][1], &part, sizeof(part)) != (ssize_t)sizeof(part))
+          _exit(EXIT_FAILURE);
+        _exit(EXIT_SUCCESS);
+      default:
+        close(pipes[w][1]);
+        break;
+    }
+  }
+
+  memset(&sum, 0, sizeof(sum));
+  failed = false;
+  for(w = 0; w < workers; w++)
+  {
+    if(read(pipes[w][0], &part, sizeof(part)) != (ssize_t)sizeof(part))
+    {
+      fprintf(stderr, "ps2-fuzz-host: worker %ld gave no results\n", w);
+      failed = true;
+      continue;
+    }
+    close(pipes[w][0]);
+    for(k = 0; k < IMP_COUNT; k++)
+      sum.frames[k] += part.frames[k];
+    sum.delivered += part.delivered;
+    sum.lost += part.lost;
+    sum.recovery_failures += part.recovery_failures;
+    sum.corrupted += part.corrupted;
+    sum.spurious += part.spurious;
+    sum.tx_errors += part.tx_errors;
+    sum.state_errors += part.state_errors;
+  }
+  while(wait(&status) > 0)
+    if(!WIFEXITED(status) || WEXITSTATUS(status))
+      failed = true;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+  for(k = 0; k < IMP_COUNT; k++)
+  {
+    total_frames += sum.frames[k];
+    printf("frames_%s: %llu\n", imp_names[k], (unsigned long long)sum.frames[k]);
+  }
+  clean = sum.delivered + sum.lost + sum.corrupted;
+  printf("frames: %llu\n", (unsigned long long)total_frames);
+  printf("workers: %ld\n", workers);
+  printf("frames_per_s: %.0f\n", total_frames / elapsed);
+  printf("clean_delivered: %llu\n", (unsigned long long)sum.delivered);
+  printf("clean_lost: %llu (%.3f ppm)\n", (unsigned long long)sum.lost, clean ? sum.lost * 1e6 / clean : 0.0);
+  printf("recovery_failures: %llu\n", (unsigned long long)sum.recovery_failures);
+  printf("clean_corrupted: %llu\n", (unsigned long long)sum.corrupted);
+  printf("impaired_spurious: %llu\n", (unsigned long long)sum.spurious);
+  printf("tx_errors: %llu\n", (unsigned long long)sum.tx_errors);
+  printf("state_errors: %llu\n", (unsigned long long)sum.state_errors);
+
+  if( sum.corrupted || sum.tx_errors || sum.state_errors ||
+      (clean && (sum.lost * 1000000 > (uint64_t)max_loss_ppm * clean)) )
+    failed = true;
+  printf("result: %s\n", failed ? "FAIL" : "PASS");
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+static void console_discard(const uint8_t *data, uint16_t len)
+{
+  (void)data;
+  (void)len;
+}
+
+
+static bool parse_kinds(const char *text)
+{
+  const char *letter;
+
+  kinds_len = 0;
+  for(; *text; text++)
+  {
+    letter = strchr(imp_letters + 1, *text);
+    if(!letter || (kinds_len == IMP_COUNT))
+      return false;
+    kinds[kinds_len++] = (uint8_t)(letter - imp_letters);
+  }
+  return true;
+}
+
+
+//xorshift32: the same sequence for a seed on any host
+static uint32_t rnd_range(uint32_t min, uint32_t max)
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return min + rnd_state % (max - min + 1);
+}
+
+
+static void fail(const char *what, enum IMPAIRMENT imp, uint8_t byte)
+{
+  if(failures_reported++ < MAX_REPORTED_FAILURES)
+    fprintf(stderr, "seed %u frame %llu (%s after %s, 0x%02X): %s, ps2int_state 0x%04X, RX bit %u\n", worker_seed,
+            (unsigned long long)frame_idx, imp_names[imp], imp_names[former_imp], byte, what, ps2int_state,
+            ps2int_RX_bit_idx);
+}
+
+
+//A falling edge of PS/2 clock, dt micro seconds after the former one, as the TIM_HR capture ISR sees it
+static void edge(uint32_t dt, bool data)
+{
+  t_usec += dt;
+  time_between_ps2clk = t_usec - last_edge_usec;
+  last_edge_usec = t_usec;
+  systicks = (uint32_t)(t_usec * FREQ_INT_SYSTICK / 1000000);
+  ps2_clock_update(data);
+}
+
+
+static uint32_t bit_dt(void)
+{
+  return 2 * half_usec + rnd_range(0, 2 * jitter_usec) - jitter_usec;
+}
+
+
+//Start (0), data LSB first, odd parity and stop (1)
+static uint16_t frame_bits(uint8_t byte)
+{
+  return (uint16_t)((byte << 1) | ((__builtin_parity(byte) ? 0 : 1) << 9) | (1 << 10));
+}
+
+
+static void send_frame(uint8_t byte, enum IMPAIRMENT imp)
+{
+  uint16_t bits = frame_bits(byte);
+  uint8_t bit, glitch_bit = 0xFF;
+  uint32_t dt, glitch_dt;
+
+  if(imp == IMP_PARITY)
+    bits ^= 1 << 9;
+  else if(imp == IMP_STOP)
+    bits &= (uint16_t)~(1 << 10);
+  else if(imp == IMP_GLITCH)
+    glitch_bit = (uint8_t)rnd_range(0, 9);
+  for(bit = 0; bit < 11; bit++)
+  {
+    dt = (bit == 0) ? gap_usec + 2 * half_usec : bit_dt();
+    edge(dt, (bits >> bit) & 1);
+    if(bit == glitch_bit)
+    {
+      glitch_dt = rnd_range(1, 8);
+      edge(glitch_dt, rnd_range(0, 1));
+      t_usec -= glitch_dt;                        //The next bit edge keeps its place
+    }
+  }
+}
+
+
+//Sends the first edges of a frame only
+static void send_partial_frame(uint8_t byte, uint8_t edges)
+{
+  uint16_t bits = frame_bits(byte);
+  uint8_t bit;
+
+  for(bit = 0; bit < edges; bit++)
+    edge((bit == 0) ? gap_usec + 2 * half_usec : bit_dt(), (bits >> bit) & 1);
+}
+
+
+//Keyboard side of a command: clocks it in, sampling data after each falling edge, and ACKs on the 11th
+static void receive_command(uint8_t expected)
+{
+  uint16_t bits = frame_bits(expected), received = 0;
+  uint8_t bit;
+  bool data;
+
+  if(ps2int_state != PS2INT_SEND_COMMAND)
+  {
+    res.state_errors++;
+    fail("command not started", IMP_COLLISION, expected);
+    return;
+  }
+  //The start bit is already on the bus
+  host_gpio_sync(PS2_DATA_PORT);
+  data = (GPIO_ODR(PS2_DATA_PORT) & PS2_DATA_PIN) != 0;
+  received |= (uint16_t)data;
+  for(bit = 1; bit < 11; bit++)
+  {
+    edge(bit == 1 ? 2 * half_usec : bit_dt(), data);
+    host_gpio_sync(PS2_DATA_PORT);
+    data = (GPIO_ODR(PS2_DATA_PORT) & PS2_DATA_PIN) != 0;
+    received |= (uint16_t)(data << bit);
+  }
+  if(received != bits)
+  {
+    res.tx_errors++;
+    fail("keyboard received a wrong command frame", IMP_COLLISION, expected);
+  }
+  edge(bit_dt(), false);                          //ACK bit
+}
+
+
+//Data line low for longer than the watchdog, while the clock keeps running
+static void stuck_low(void)
+{
+  uint64_t end = t_usec + STUCK_LOW_USEC;
+
+  while(t_usec < end)
+    edge(bit_dt(), false);
+}
+
+
+//A clean frame must deliver its byte, and only it. An impaired one may deliver nothing, or the byte sent.
+static void check_delivery(uint8_t byte, enum IMPAIRMENT imp)
+{
+  uint8_t received;
+  bool got = false;
+
+  while(available_ps2_byte())
+  {
+    received = get_ps2_byte(ps2_recv_buffer);
+    if(imp == IMP_NONE)
+    {
+      if(got || (received != byte))
+      {
+        res.corrupted++;
+        fail("clean frame delivered another byte", imp, received);
+      }
+      got = true;
+    }
+    else if(received != byte)
+      res.spurious++;
+  }
+  if(imp == IMP_NONE)
+  {
+    if(got)
+      res.delivered++;
+    else
+    {
+      res.lost++;
+      if(former_imp != IMP_NONE)
+        res.recovery_failures++;
+      fail("clean frame lost", imp, byte);
+    }
+    if(ps2int_state != PS2INT_RECEIVE)
+    {
+      res.state_errors++;
+      fail("not back to receive", imp, byte);
+    }
+  }
+}
+
+
+static void worker(uint64_t frames, struct fuzz_results *out)
+{
+  enum IMPAIRMENT imp, sent;
+  uint8_t byte;
+
+  rnd_state = worker_seed;
+  memset(&res, 0, sizeof(res));
+  former_imp = IMP_NONE;
+  for(frame_idx = 0; frame_idx < frames; frame_idx++)
+  {
+    half_usec = 500000 / rnd_range(freq_min_hz, freq_max_hz);
+    byte = (uint8_t)rnd_range(0, 255);
+    imp = IMP_NONE;
+    if(kinds_len && (rnd_range(0, 999) < impaired_permil))
+      imp = (enum IMPAIRMENT)kinds[rnd_range(0, kinds_len - 1u)];
+    res.frames[imp]++;
+
+    //Truncate, collision and stuck low are followed by the clean frame the keyboard had to send
+    sent = imp;
+    switch(imp)
+    {
+      case IMP_TRUNCATE:
+        send_partial_frame(byte, (uint8_t)rnd_range(1, 10));
+        sent = IMP_NONE;
+        break;
+      case IMP_COLLISION:
+        send_partial_frame(byte, (uint8_t)rnd_range(1, 10));
+        ps2_send_command(COMMAND_SENT, ARG_NO_ARG);
+        host_run_usec(COMMAND_START_USEC);
+        t_usec += COMMAND_START_USEC;
+        receive_command(COMMAND_SENT);
+        send_frame(KB_ACK, IMP_NONE);
+        if(available_ps2_byte() || (ps2int_state != PS2INT_RECEIVE) || command_running)
+        {
+          res.state_errors++;
+          fail("ACK not taken as the command answer", imp, KB_ACK);
+        }
+        sent = IMP_NONE;
+        break;
+      case IMP_STUCK_LOW:
+        stuck_low();
+        sent = IMP_NONE;
+        break;
+      default:
+        break;
+    }
+    if(sent != imp)
+    {
+      check_delivery(byte, imp);
+      former_imp = imp;
+    }
+    send_frame(byte, sent);
+    check_delivery(byte, sent);
+    former_imp = sent;
+  }
+  *out = res;
+}
@@ -0,0 +1,334 @@
+/** @addtogroup 18 ps2trace PS/2 Byte Stream Recorder
+ *
+ * @file ps2_replay_host.cpp Replays recorded PS/2 byte streams through the host build of the converter.
+ *
+ * @brief <b>Replays recorded PS/2 byte streams through the host build of the converter.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Usage: ps2-replay-host [-s speed] [-g max_gap_msec] [-m] [-v] trace
+ * The trace is the binary of ps2_trace.h, or a console log with the Intel Hex records of
+ * "ps2rec dump". It is replayed by ps2_trace_play(), as "ps2rec play" does on target, on virtual
+ * time: -s divides the original times, and -g clips the idle gaps, so a whole day of typing runs in
+ * seconds. -m prints the MSX matrix changes (as ps2msx-host), -v the firmware console on stderr.
+ * At the end, the MSX keys left pressed are reported: a stuck key shows up there.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include <libopencm3/stm32/gpio.h>
+
+#include "system.h"
+#include "ps2_trace.h"
+#include "host_board.h"
+#include "host_firmware.h"
+
+#define MAX_TEXT_LINE             1024
+#define REPLAY_TAIL_USEC          500000    //Time given to the converter after the last byte
+
+extern uint32_t x_bits[16 + 1];                   //Declared on msxmap.cpp
+
+static uint8_t  *trace;                           //Whole binary trace
+static uint32_t trace_size, trace_entries, trace_next;
+static uint32_t max_gap_usec;
+static bool     print_matrix;
+static uint8_t  pressed_former[16];
+
+//Prototype area
+static bool load_trace(const char *file);
+static bool load_intel_hex(FILE *in, const char *file);
+static bool trace_put(uint32_t address, uint8_t data);
+static bool file_source(uint32_t *entry);
+static bool replay_done(void);
+static void console_to_stderr(const uint8_t *data, uint16_t len);
+static void console_discard(const uint8_t *data, uint16_t len);
+static uint8_t matrix_pressed(uint8_t y);
+static void report_matrix(void);
+
+
+int main(int argc, char *argv[])
+{
+  uint32_t speed = 1, lost;
+  bool verbose = false;
+  struct timespec t0, t1;
+  uint64_t start_usec;
+  double elapsed;
+  int i;
+
+  for(i = 1; i < argc - 1; i++)
+  {
+    if(!strcmp(argv[i], "-m"))
+      print_matrix = true;
+    else if(!strcmp(argv[i], "-v"))
+      verbose = true;
+    else if(!strcmp(argv[i], "-s") && (i + 2 < argc))
+      speed = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-g") && (i + 2 < argc))
+      max_gap_usec = (uint32_t)strtoul(argv[++i], NULL, 0) * 1000;
+    else
+      break;
+  }
+  if( (i != argc - 1) || !speed || (speed > PS2_TRACE_MAX_SPEED) )
+  {
+    fprintf(stderr, "Usage: %s [-s speed 1-%u] [-g max_gap_msec] [-m] [-v] trace\n"
+                    "trace: binary trace or console log with the Intel Hex records of \"ps2rec dump\".\n",
+                    argv[0], PS2_TRACE_MAX_SPEED);
+    return EXIT_FAILURE;
+  }
+  if(!load_trace(argv[i]))
+    return EXIT_FAILURE;
+  lost = trace[12] | (trace[13] << 8) | (trace[14] << 16) | ((uint32_t)trace[15] << 24);
+  if(lost)
+    fprintf(stderr, "ps2-replay-host: %u older entries were overwritten on target: the replay starts in the middle\n", lost);
+
+  host_uart_tx_hook = verbose ? console_to_stderr : console_discard;
+  if(!host_firmware_boot())
+  {
+    fprintf(stderr, "ps2-replay-host: keyboard not detected\n");
+    return EXIT_FAILURE;
+  }
+  for(i = 0; i < 16; i++)
+    pressed_former[i] = matrix_pressed((uint8_t)i);
+  host_firmware_pass_hook = report_matrix;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  start_usec = host_time_usec;
+  if(!ps2_trace_play(file_source, (uint16_t)speed))
+  {
+    fprintf(stderr, "ps2-replay-host: empty trace\n");
+    return EXIT_FAILURE;
+  }
+  while(!replay_done())
+    host_firmware_run_until(host_time_usec + 1000000, replay_done);
+  host_firmware_run_until(host_time_usec + REPLAY_TAIL_USEC, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  elapsed = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+  fflush(stdout);
+  fprintf(stderr, "ps2-replay-host: %u bytes, %.3f s of virtual time in %.3f s\n", trace_entries,
+          (double)(host_time_usec - start_usec) / 1e6, elapsed);
+  for(i = 0; i < 16; i++)
+    if(matrix_pressed((uint8_t)i))
+      fprintf(stderr, "ps2-replay-host: left pressed Y%u 0x%02X\n", i, matrix_pressed((uint8_t)i));
+  return EXIT_SUCCESS;
+}
+
+
+static bool load_trace(const char *file)
+{
+  FILE *in = fopen(file, "rb");
+  uint8_t magic[4];
+  bool ok;
+
+  if(!in)
+  {
+    perror(file);
+    return false;
+  }
+  if( (fread(magic, 1, 4, in) == 4) && !memcmp(magic, "PS2T", 4) )
+  {
+    fseek(in, 0, SEEK_END);
+    trace_size = (uint32_t)ftell(in);
+    fseek(in, 0, SEEK_SET);
+    trace = (uint8_t*)malloc(trace_size);
+    ok = trace && (fread(trace, 1, trace_size, in) == trace_size);
+  }
+  else
+  {
+    rewind(in);
+    ok = load_intel_hex(in, file);
+  }
+  fclose(in);
+  if(!ok)
+    return false;
+  if( (trace_size < PS2_TRACE_HEADER_SIZE) || memcmp(trace, "PS2T", 4) || (trace[4] != PS2_TRACE_VERSION) )
+  {
+    fprintf(stderr, "%s: not a version %u PS/2 trace\n", file, PS2_TRACE_VERSION);
+    return false;
+  }
+  trace_entries = trace[8] | (trace[9] << 8) | (trace[10] << 16) | ((uint32_t)trace[11] << 24);
+  if(trace_entries > (trace_size - PS2_TRACE_HEADER_SIZE) / 4)
+  {
+    fprintf(stderr, "%s: truncated trace (%u of %u entries)\n", file, (trace_size - PS2_TRACE_HEADER_SIZE) / 4,
+            trace_entries);
+    return false;
+  }
+  return true;
+}
+
+
+//Intel Hex records may be preceded by anything on the line (terminal log): the record starts on the last ':'
+static bool load_intel_hex(FILE *in, const char *file)
+{
+  char text[MAX_TEXT_LINE], *rec;
+  uint8_t bytes[(MAX_TEXT_LINE - 1) / 2], sum;
+  uint32_t src_line = 0, upper = 0;
+  size_t len, n;
+  unsigned int value;
+
+  while(fgets(text, sizeof(text), in))
+  {
+    src_line++;
+    rec = strrchr(text, ':');
+    if(!rec)
+      continue;
+    len = strcspn(rec + 1, "\r\n");
+    if( (len < 10) || (len & 1) )
+      continue;
+    sum = 0;
+    for(n = 0; n < len / 2; n++)
+    {
+      if( !isxdigit((unsigned char)rec[1 + 2 * n]) || !isxdigit((unsigned char)rec[2 + 2 * n]) ||
+          (sscanf(rec + 1 + 2 * n, "%2x", &value) != 1) )
+        break;
+      bytes[n] = (uint8_t)value;
+      sum += bytes[n];
+    }
+    if( (n != len / 2) || (bytes[0] + 5u != n) )
+      continue;
+    if(sum)
+    {
+      fprintf(stderr, "%s:%u: Intel Hex checksum error\n", file, src_line);
+      return false;
+    }
+    if(bytes[3] == 0)
+    {
+      for(uint8_t i = 0; i < bytes[0]; i++)
+        if(!trace_put(upper + ((uint32_t)bytes[1] << 8) + bytes[2] + i, bytes[4 + i]))
+          return false;
+    }
+    else if(bytes[3] == 1)
+      return true;
+    else if(bytes[3] == 4)
+      upper = (((uint32_t)bytes[4] << 8) | bytes[5]) << 16;
+  }
+  if(!trace_size)
+    fprintf(stderr, "%s: no Intel Hex records\n", file);
+  return trace_size != 0;
+}
+
+
+static bool trace_put(uint32_t address, uint8_t data)
+{
+  static uint32_t allocated;
+
+  if(address >= allocated)
+  {
+    uint32_t size = allocated ? allocated : 65536;
+    while(size <= address)
+      size *= 2;
+    trace = (uint8_t*)realloc(trace, size);
+    if(!trace)
+    {
+      fprintf(stderr, "ps2-replay-host: out of memory\n");
+      return false;
+    }
+    memset(trace + allocated, 0, size - allocated);
+    allocated = size;
+  }
+  trace[address] = data;
+  if(address >= trace_size)
+    trace_size = address + 1;
+  return true;
+}
+
+
+//Called from the TIM_HR callback of the replay
+static bool file_source(uint32_t *entry)
+{
+  const uint8_t *p;
+  uint32_t delta;
+
+  if(trace_next >= trace_entries)
+    return false;
+  p = trace + PS2_TRACE_HEADER_SIZE + 4 * trace_next++;
+  *entry = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  delta = PS2_TRACE_DELTA(*entry);
+  if(max_gap_usec && (delta > max_gap_usec))
+    *entry = PS2_TRACE_ENTRY(max_gap_usec, PS2_TRACE_DATA(*entry));
+  return true;
+}
+
+
+static bool replay_done(void)
+{
+  return !ps2_trace_playing() && host_firmware_keyboard_idle();
+}
+
+
+static void console_to_stderr(const uint8_t *data, uint16_t len)
+{
+  fwrite(data, 1, len, stderr);
+}
+
+
+static void console_discard(const uint8_t *data, uint16_t len)
+{
+  (void)data;
+  (void)len;
+}
+
+
+//x_bits are GPIO_BSRR images: reset half (high 16 bits) pulls the X pin down, that is, key pressed
+static uint8_t matrix_pressed(uint8_t y)
+{
+  static const uint16_t x_pins[8] = { X0_PIN, X1_PIN, X2_PIN, X3_PIN, X4_PIN, X5_PIN, X6_PIN, X7_PIN };
+  uint8_t pressed = 0;
+
+  for(uint8_t x = 0; x < 8; x++)
+    if(x_bits[y] & ((uint32_t)x_pins[x] << 16))
+      pressed |= (uint8_t)(1 << x);
+  return pressed;
+}
+
+
+static void report_matrix(void)
+{
+  uint8_t y, pressed;
+
+  if(!print_matrix)
+    return;
+  for(y = 0; y < 16; y++)
+  {
+    pressed = matrix_pressed(y);
+    if(pressed != pressed_former[y])
+    {
+      printf("%12llu Y%u 0x%02X\n", (unsigned long long)host_time_usec, y, pressed);
+      pressed_former[y] = pressed;
+    }
+  }
+}
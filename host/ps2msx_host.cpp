@@ -0,0 +1,137 @@
+/** @addtogroup 15 host_board Host Board and PS/2 Keyboard Models
+ *
+ * @file ps2msx_host.cpp Host runner: boots the converter logic, types scan codes and reports the MSX matrix.
+ *
+ * @brief <b>Host runner: boots the converter logic, types scan codes and reports the MSX matrix.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Usage: ps2msx-host [-t msec] [-c console_text] [scan code bytes in hex...]
+ * The firmware boot and main loop of ps2-msx-kb-conv.cpp run on virtual time (host_firmware.cpp).
+ * After the keyboard is detected, the bytes are typed by the keyboard model, and each change on the pressed keys of
+ * x_bits (the columns the MSX reads) is written to stdout as "time_us Y column X_pressed_mask".
+ * Console output of the firmware goes to stderr.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libopencm3/stm32/gpio.h>
+
+#include "system.h"
+#include "host_board.h"
+#include "host_firmware.h"
+
+#define MAX_TYPED_BYTES           256
+
+extern uint32_t x_bits[16 + 1];                   //Declared on msxmap.cpp
+
+static uint8_t  pressed_former[16];
+
+//Prototype area
+static void console_to_stderr(const uint8_t *data, uint16_t len);
+static void report_matrix(void);
+
+
+int main(int argc, char *argv[])
+{
+  uint8_t typed[MAX_TYPED_BYTES];
+  uint16_t typed_len = 0;
+  uint32_t run_msec = 1000;
+  const char *console_text = NULL;
+  int i;
+
+  for(i = 1; i < argc; i++)
+  {
+    if(!strcmp(argv[i], "-t") && (i + 1 < argc))
+      run_msec = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-c") && (i + 1 < argc))
+      console_text = argv[++i];
+    else if((argv[i][0] != '-') && (typed_len < MAX_TYPED_BYTES))
+      typed[typed_len++] = (uint8_t)strtoul(argv[i], NULL, 16);
+    else
+    {
+      fprintf(stderr, "Usage: %s [-t msec] [-c console_text] [scan code bytes in hex...]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  host_uart_tx_hook = console_to_stderr;
+  if(!host_firmware_boot())
+  {
+    fprintf(stderr, "\nps2msx-host: keyboard not detected\n");
+    return EXIT_FAILURE;
+  }
+  for(i = 0; i < 16; i++)
+    pressed_former[i] = 0;
+  host_firmware_pass_hook = report_matrix;
+
+  if(console_text)
+  {
+    host_uart_rx((const uint8_t*)console_text, (uint16_t)strlen(console_text));
+    host_uart_rx((const uint8_t*)"\r", 1);
+  }
+  host_ps2_keyboard_type(typed, typed_len);
+  host_firmware_run_until(host_time_usec + 10000000, host_firmware_keyboard_idle);
+  host_firmware_run_until(host_time_usec + (uint64_t)run_msec * 1000, NULL);
+  fflush(stdout);
+  return EXIT_SUCCESS;
+}
+
+
+static void console_to_stderr(const uint8_t *data, uint16_t len)
+{
+  fwrite(data, 1, len, stderr);
+}
+
+
+//x_bits are GPIO_BSRR images: reset half (high 16 bits) pulls the X pin down, that is, key pressed
+static void report_matrix(void)
+{
+  static const uint16_t x_pins[8] = { X0_PIN, X1_PIN, X2_PIN, X3_PIN, X4_PIN, X5_PIN, X6_PIN, X7_PIN };
+  uint8_t y, x, pressed;
+
+  for(y = 0; y < 16; y++)
+  {
+    pressed = 0;
+    for(x = 0; x < 8; x++)
+      if(x_bits[y] & ((uint32_t)x_pins[x] << 16))
+        pressed |= (uint8_t)(1 << x);
+    if(pressed != pressed_former[y])
+    {
+      printf("%10llu Y%u 0x%02X\n", (unsigned long long)host_time_usec, y, pressed);
+      pressed_former[y] = pressed;
+    }
+  }
+}
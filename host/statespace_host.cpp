@@ -0,0 +1,1072 @@
+/** @addtogroup 15 host_board Host Board and PS/2 Keyboard Models
+ *
+ * @file statespace_host.cpp Exhaustive state space checker of the PS/2 to MSX mapping of a Database.
+ *
+ * @brief <b>Exhaustive state space checker of the PS/2 to MSX mapping of a Database.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Usage: statespace-host [-d depth] [-h max_held] [-w workers] [-k keys] [-r reports] layout.hex
+ * The firmware boots once with the Database of layout.hex (as db-compiler makes it), then every
+ * sequence of up to depth events is run through convert2msx(), as the main loop does with a mounted
+ * scan code. The events are:
+ * - make of each key not held (up to max_held at once) and break of each held one. The keys are
+ *   those of the Database, plus the ones convert2msx() handles before it (Alt, NumLock, Windows);
+ *   -k restricts them to a list of make codes, as "12,1C,E0 75";
+ * - "tick": msxqueuekeys() takes one MSX key of the dispatch queue, as SysTick does;
+ * - "ruslat_led 0|1": the MSX changes the RUS/LAT LED line.
+ * The mapping depends on shiftstate, ps2numlockstate, the RUS/LAT LED, the chord state (CtrlAltDel
+ * without CHORDS), the dispatch queue, the make/break pairings and the pressed set, all of them saved
+ * and restored around each branch, so the search covers every (modifier state, event) pair reachable
+ * within depth. Chords that reset the MCU, switch the Database or record or play a macro (checked by
+ * ppi-scan-host -m) are not followed: those paths are pruned.
+ * The keys of the chord table are searched as well. Each time all keys are released, the queue is drained and every X line
+ * of Y0 to Y7 and the CTRL, SHIFT and RUS/LAT lines must be released: otherwise the path is a stuck
+ * key. Paths are written as golden-host script lines, separated by commas.
+ * Workers are forked processes (the firmware state is global), one per CPU core by default. The
+ * first depths are split as tasks on a deque per worker, on shared memory: a worker runs its own
+ * tasks depth first, and when it has none, steals the oldest (largest) task of another one.
+ * Exit status is 1 when a stuck key is found.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/flash.h>
+
+#include "system.h"
+#include "msxmap.h"
+#include "host_board.h"
+#include "host_firmware.h"
+
+#define DEFAULT_DEPTH             4
+#define DEFAULT_MAX_HELD          2
+#define DEFAULT_REPORTS           20
+#define MAX_DEPTH                 12
+#define MAX_KEYS                  256
+#define MAX_EVENTS                (2 * MAX_KEYS + 3)
+#define MAX_WORKERS               256
+#define MAX_TEXT_LINE             256
+#define SPLIT_DEPTH               2         //Paths up to it are tasks; the worker searches the deeper ones
+#define DEQUE_SIZE                2048      //Tasks per worker. Must be a power of 2
+#define MAX_FINDINGS              4096
+#define FINDINGS_HASH_SIZE        8192      //Per worker. Must be a power of 2
+#define DISPATCH_QUEUE_SIZE       16        //As msxmap.cpp
+#if CHORDS == true
+#define N_MOD_STATES              16        //shiftstate, ps2numlockstate, RUS/LAT LED and a chord fired by the event
+#else
+#define N_MOD_STATES              24        //shiftstate, ps2numlockstate, RUS/LAT LED and CtrlAltDel 0 to 2
+#endif  //#if CHORDS == true
+#define PS2_BREAK_CODE            0xF0
+#define PS2_EXTENDED_CODE         0xE0
+#define PS2_PAUSE_CODE            0xE1
+#define PS2_UNUSED_LINE           0xFF      //Free and extension lines of the Database
+#if CHORDS != true
+#define PS2_NUMPAD_DEL            0x71      //Third key of CtrlAltDel
+#define CTRL_ALT_DEL_ARMED        2         //CtrlAltDel state waiting the Del
+#endif  //#if CHORDS != true
+
+enum EVENT_KIND
+{
+  EV_MAKE,
+  EV_BREAK,
+  EV_TICK,
+  EV_LED,
+};
+
+struct event
+{
+  uint8_t kind;
+  uint8_t key;                                    //Index on keys[] (EV_MAKE and EV_BREAK), or LED level
+};
+
+struct key
+{
+  uint8_t len;
+  uint8_t code[2];                                //Make code: one byte, or E0 and one byte
+};
+
+//Firmware state the mapping depends on
+struct fw_state
+{
+  uint32_t x_bits[16 + 1];
+  bool     ctrl, shift, ruslat;                   //Output levels of the modifier lines
+  bool     shiftstate, numlock, led;
+#if CHORDS == true
+  struct chord_state chords;
+#else
+  uint8_t  ctrl_alt_del;
+#endif  //#if CHORDS == true
+  uint16_t queue_put, queue_get;
+  uint8_t  queue[DISPATCH_QUEUE_SIZE];
+#if MSX_PAIRING == true
+  struct msx_pairing pairings[MSX_PAIRING_SLOTS];
+#endif  //#if MSX_PAIRING == true
+#if MSX_NKRO == true
+  uint8_t  pressed[MSX_NKRO_COLUMNS], refs[MSX_NKRO_COLUMNS][8], modifier_pressed[MSX_NKRO_COLUMNS];
+  uint16_t last_make;
+#endif  //#if MSX_NKRO == true
+};
+
+struct task
+{
+  uint8_t  len;
+  uint16_t path[MAX_DEPTH];
+};
+
+struct deque
+{
+  volatile uint32_t lock;
+  uint32_t top, bottom;                           //Thieves take from top, the owner pushes and pops at bottom
+  struct task tasks[DEQUE_SIZE];
+};
+
+struct finding
+{
+  uint8_t  len;
+  uint16_t path[MAX_DEPTH];
+  uint8_t  pressed[8];                            //X lines left pressed of Y0 to Y7
+  uint8_t  lines;                                 //Modifier lines left active: 1 CTRL, 2 SHIFT, 4 RUS/LAT
+};
+
+struct worker_stats
+{
+  uint64_t states, tasks, steals, resets, stuck;
+};
+
+//On memory shared by the workers
+struct search
+{
+  volatile uint32_t pending;                      //Tasks queued or running
+  volatile uint32_t findings_len;
+  uint8_t coverage[(N_MOD_STATES * MAX_EVENTS + 7) / 8];
+  struct finding findings[MAX_FINDINGS];
+  struct worker_stats stats[MAX_WORKERS];
+  struct deque deques[1];                         //One per worker
+};
+
+extern "C" {
+extern volatile bool ps2numlockstate;             //Declared on ps2handl.c
+}
+extern uint32_t x_bits[16 + 1];                   //Declared on msxmap.cpp
+extern volatile uint8_t scancode[4];              //Declared on msxmap.cpp
+extern volatile bool shiftstate;                  //Declared on msxmap.cpp
+#if CHORDS == true
+extern struct chord_state chord_state;            //Declared on chord.c
+extern struct chord chord_table[CHORD_SLOTS];     //Declared on chord.c
+extern uint8_t chord_count;                       //Declared on chord.c
+#else
+extern uint8_t CtrlAltDel;                        //Declared on msxmap.cpp
+#endif  //#if CHORDS == true
+extern uint32_t ALL_X_SET;                        //Declared on msxmap.cpp
+extern uint8_t dispatch_keys_queue_buffer[DISPATCH_QUEUE_SIZE]; //Declared on msxmap.cpp
+extern struct sring dispatch_keys_queue;          //Declared on msxmap.cpp
+#if MSX_PAIRING == true
+extern struct msx_pairing msx_pairings[MSX_PAIRING_SLOTS];  //Declared on msxmap.cpp
+#endif  //#if MSX_PAIRING == true
+#if MSX_NKRO == true
+extern uint8_t msx_pressed[MSX_NKRO_COLUMNS];     //Declared on msxmap.cpp
+extern uint8_t msx_key_refs[MSX_NKRO_COLUMNS][8]; //Declared on msxmap.cpp
+extern uint8_t msx_modifier_pressed[MSX_NKRO_COLUMNS]; //Declared on msxmap.cpp
+extern uint16_t msx_nkro_last_make;               //Declared on msxmap.cpp
+#endif  //#if MSX_NKRO == true
+
+static uint8_t  image[DATABASE_SIZE];
+static struct key keys[MAX_KEYS];
+static uint16_t n_keys;
+static struct event events[MAX_EVENTS];
+static uint16_t n_events;
+static uint8_t  max_depth = DEFAULT_DEPTH, max_held = DEFAULT_MAX_HELD;
+static struct search *search;
+static long     n_workers;
+
+//Worker state
+static long     self;
+static struct worker_stats *stats;
+static struct fw_state root;
+static bool     held[MAX_KEYS];
+static uint8_t  held_count;
+static uint16_t path[MAX_DEPTH];
+static uint64_t findings_hash[FINDINGS_HASH_SIZE];
+
+//Prototype area
+static bool load_database(const char *file);
+static bool parse_keys(const char *text);
+static bool add_key(uint8_t len, uint8_t code0, uint8_t code1);
+static void database_keys(void);
+static void console_discard(const uint8_t *data, uint16_t len);
+static void save_state(struct fw_state *state);
+static void restore_state(const struct fw_state *state);
+static bool allowed(uint16_t ev);
+static void apply(uint16_t ev);
+static void undo_held(uint16_t ev);
+#if CHORDS == true
+static const struct chord* fired_chord(uint16_t ev);
+#endif  //#if CHORDS == true
+static bool resets_mcu(uint16_t ev);
+static void visit(uint8_t depth);
+static void check_released(uint8_t depth);
+static void record_finding(uint8_t depth, const uint8_t *pressed, uint8_t lines);
+static void dfs(uint8_t depth);
+static bool push_task(const uint16_t *task_path, uint8_t len);
+static bool pop_task(struct task *t);
+static bool steal_task(struct task *t);
+static void run_task(const struct task *t);
+static void worker(void);
+static void lock(volatile uint32_t *l);
+static void unlock(volatile uint32_t *l);
+static void event_name(uint16_t ev, char *text);
+static void print_path(const uint16_t *p, uint8_t len);
+static void report(uint32_t reports);
+
+
+int main(int argc, char *argv[])
+{
+  uint64_t states = 0, tasks = 0, steals = 0, resets = 0, stuck = 0;
+  uint32_t reports = DEFAULT_REPORTS, pairs = 0, reachable;
+  const char *key_list = NULL;
+  struct timespec start, end;
+  double elapsed;
+  size_t search_size;
+  bool failed = false;
+  int i, status;
+  long w;
+
+  n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+  for(i = 1; i < argc - 1; i++)
+  {
+    if(!strcmp(argv[i], "-d"))
+      max_depth = (uint8_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-h"))
+      max_held = (uint8_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-w"))
+      n_workers = strtol(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-k"))
+      key_list = argv[++i];
+    else if(!strcmp(argv[i], "-r"))
+      reports = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else
+      break;
+  }
+  if( (i != argc - 1) || !max_depth || (max_depth > MAX_DEPTH) || !max_held || (n_workers < 1) ||
+      (n_workers > MAX_WORKERS) )
+  {
+    fprintf(stderr, "Usage: %s [-d depth 1-%u] [-h max_held] [-w workers] [-k keys] [-r reports] layout.hex\n"
+                    "keys: make codes to be searched, as \"12,1C,E0 75\" (default: all of the Database).\n",
+                    argv[0], MAX_DEPTH);
+    return EXIT_FAILURE;
+  }
+  if(!load_database(argv[i]))
+    return EXIT_FAILURE;
+  //Boots once: the workers inherit the booted firmware, and the keys include its chord table
+  flash_erase_sector(FLASH_SECTOR3_NUMBER, FLASH_CR_PROGRAM_X8);
+  flash_program(INITIAL_DATABASE, image, DATABASE_SIZE);
+  FLASH_SR = 0;
+  host_uart_tx_hook = console_discard;
+  if(!host_firmware_boot())
+  {
+    fprintf(stderr, "statespace-host: keyboard not detected\n");
+    return EXIT_FAILURE;
+  }
+  if(key_list)
+  {
+    if(!parse_keys(key_list))
+      return EXIT_FAILURE;
+  }
+  else
+    database_keys();
+  for(uint16_t k = 0; k < n_keys; k++)
+  {
+    events[n_events].kind = EV_MAKE;
+    events[n_events++].key = (uint8_t)k;
+    events[n_events].kind = EV_BREAK;
+    events[n_events++].key = (uint8_t)k;
+  }
+  events[n_events++].kind = EV_TICK;
+  events[n_events].kind = EV_LED;
+  events[n_events++].key = 0;
+  events[n_events].kind = EV_LED;
+  events[n_events++].key = 1;
+
+  save_state(&root);
+
+  search_size = sizeof(struct search) + (size_t)(n_workers - 1) * sizeof(struct deque);
+  search = (struct search*)mmap(NULL, search_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if(search == MAP_FAILED)
+  {
+    perror("statespace-host: mmap");
+    return EXIT_FAILURE;
+  }
+  //The root task (empty path) starts on the first worker
+  search->pending = 1;
+  search->deques[0].bottom = 1;
+
+  fflush(stdout);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(w = 0; w < n_workers; w++)
+  {
+    switch(fork())
+    {
+      case -1:
+        perror("statespace-host: fork");
+        return EXIT_FAILURE;
+      case 0:
+        self = w;
+        worker();
+        _exit(EXIT_SUCCESS);
+      default:
+        break;
+    }
+  }
+  while(wait(&status) > 0)
+    if(!WIFEXITED(status) || WEXITSTATUS(status))
+      failed = true;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+  for(w = 0; w < n_workers; w++)
+  {
+    states += search->stats[w].states;
+    tasks += search->stats[w].tasks;
+    steals += search->stats[w].steals;
+    resets += search->stats[w].resets;
+    stuck += search->stats[w].stuck;
+  }
+  for(uint32_t p = 0; p < N_MOD_STATES * n_events; p++)
+    if(search->coverage[p / 8] & (1 << (p % 8)))
+      pairs++;
+  reachable = N_MOD_STATES * n_events;
+
+  printf("keys: %u\n", n_keys);
+  printf("events: %u\n", n_events);
+  printf("depth: %u\n", max_depth);
+  printf("max_held: %u\n", max_held);
+  printf("workers: %ld\n", n_workers);
+  printf("states: %llu\n", (unsigned long long)states);
+  printf("states_per_s: %.0f\n", states / elapsed);
+  printf("elapsed_s: %.3f\n", elapsed);
+  printf("tasks: %llu\n", (unsigned long long)tasks);
+  printf("steals: %llu\n", (unsigned long long)steals);
+  printf("reset_paths_pruned: %llu\n", (unsigned long long)resets);
+  printf("pairs_reached: %u of %u (modifier states x events)\n", pairs, reachable);
+  printf("stuck_paths: %llu\n", (unsigned long long)stuck);
+  report(reports);
+  if(stuck)
+    failed = true;
+  printf("result: %s\n", failed ? "FAIL" : "PASS");
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+//Only data records inside the Database area are accepted
+static bool load_database(const char *file)
+{
+  FILE *in = fopen(file, "r");
+  char text[MAX_TEXT_LINE];
+  uint8_t bytes[(MAX_TEXT_LINE - 1) / 2], sum;
+  uint32_t src_line = 0, upper = 0, address, loaded = 0;
+  size_t len, n;
+  unsigned int value;
+  bool end = false;
+
+  if(!in)
+  {
+    perror(file);
+    return false;
+  }
+  memset(image, 0xFF, sizeof(image));
+  while(!end && fgets(text, sizeof(text), in))
+  {
+    src_line++;
+    len = strcspn(text, "\r\n");
+    if(!len)
+      continue;
+    sum = 0;
+    for(n = 0; (text[0] == ':') && (2 * n + 3 <= len); n++)
+    {
+      if( !isxdigit((unsigned char)text[1 + 2 * n]) || !isxdigit((unsigned char)text[2 + 2 * n]) ||
+          (sscanf(text + 1 + 2 * n, "%2x", &value) != 1) )
+        break;
+      bytes[n] = (uint8_t)value;
+      sum += bytes[n];
+    }
+    if( (text[0] != ':') || (2 * n + 1 != len) || (n < 5) || (bytes[0] + 5u != n) || sum )
+    {
+      fprintf(stderr, "%s:%u: bad Intel Hex record\n", file, src_line);
+      fclose(in);
+      return false;
+    }
+    switch(bytes[3])
+    {
+      case 0:
+        address = upper + ((uint32_t)bytes[1] << 8) + bytes[2];
+        if( (address < INITIAL_DATABASE) || (address + bytes[0] > INITIAL_DATABASE + (DATABASE_SIZE)) )
+        {
+          fprintf(stderr, "%s:%u: record out of the Database (0x%08X)\n", file, src_line, INITIAL_DATABASE);
+          fclose(in);
+          return false;
+        }
+        memcpy(&image[address - INITIAL_DATABASE], &bytes[4], bytes[0]);
+        loaded += bytes[0];
+        break;
+      case 1:
+        end = true;
+        break;
+      case 4:
+        upper = (((uint32_t)bytes[4] << 8) | bytes[5]) << 16;
+        break;
+      default:
+        break;
+    }
+  }
+  fclose(in);
+  if(loaded != (DATABASE_SIZE))
+  {
+    fprintf(stderr, "%s: %u of %u Database bytes\n", file, loaded, DATABASE_SIZE);
+    return false;
+  }
+  return true;
+}
+
+
+//Comma separated make codes: "12,1C,E0 75"
+static bool parse_keys(const char *text)
+{
+  unsigned int code[2];
+  char item[16];
+  size_t len;
+  int n;
+
+  while(*text)
+  {
+    len = strcspn(text, ",");
+    if(len >= sizeof(item))
+      len = sizeof(item) - 1;
+    memcpy(item, text, len);
+    item[len] = 0;
+    text += strcspn(text, ",");
+    if(*text)
+      text++;
+    n = sscanf(item, "%2x %2x", &code[0], &code[1]);
+    if( (n < 1) || (code[0] == PS2_BREAK_CODE) || ((n == 2) && (code[0] != PS2_EXTENDED_CODE)) ||
+        ((n == 1) && (code[0] == PS2_EXTENDED_CODE)) )
+    {
+      fprintf(stderr, "statespace-host: \"%s\" is not a make code (\"1C\" or \"E0 75\")\n", item);
+      return false;
+    }
+    if(!add_key((uint8_t)n, (uint8_t)code[0], (uint8_t)code[1]))
+      return false;
+  }
+  return n_keys != 0;
+}
+
+
+static bool add_key(uint8_t len, uint8_t code0, uint8_t code1)
+{
+  for(uint16_t k = 0; k < n_keys; k++)
+    if( (keys[k].len == len) && (keys[k].code[0] == code0) && ((len == 1) || (keys[k].code[1] == code1)) )
+      return true;
+  if(n_keys >= MAX_KEYS)
+  {
+    fprintf(stderr, "statespace-host: more than %u keys\n", MAX_KEYS);
+    return false;
+  }
+  keys[n_keys].len = len;
+  keys[n_keys].code[0] = code0;
+  keys[n_keys++].code[1] = (len == 2) ? code1 : 0;
+  return true;
+}
+
+
+//Make codes of the Database lines (breaks and Pause are not keys of their own), and the keys
+//convert2msx() tests before the Database search
+static void database_keys(void)
+{
+  const uint8_t *line;
+
+  for(uint16_t l = 1; l < N_DATABASE_REGISTERS - 1; l++)
+  {
+    line = &image[l * DB_NUM_COLS];
+    if( (line[0] == PS2_UNUSED_LINE) || (line[0] == PS2_BREAK_CODE) || (line[0] == PS2_PAUSE_CODE) )
+      continue;
+    if(line[0] == PS2_EXTENDED_CODE)
+    {
+      if(line[1] != PS2_BREAK_CODE)
+        add_key(2, line[0], line[1]);
+    }
+    else
+      add_key(1, line[0], 0);
+  }
+  add_key(1, 0x11, 0);                            //Left Alt (CODE, CtrlAltDel)
+  add_key(1, 0x77, 0);                            //NumLock
+  add_key(2, PS2_EXTENDED_CODE, 0x11);            //Right Alt
+  add_key(2, PS2_EXTENDED_CODE, 0x1F);            //Left Windows (GRAPH)
+  add_key(2, PS2_EXTENDED_CODE, 0x27);            //Right Windows (GRAPH)
+#if CHORDS == true
+  for(uint8_t i = 0; i < chord_count; i++)
+    for(uint8_t k = 0; k < chord_table[i].n_keys; k++)
+    {
+      uint16_t key = chord_table[i].keys[k];
+      if(key & CHORD_KEY_E0)
+        add_key(2, PS2_EXTENDED_CODE, (uint8_t)key);
+      else
+        add_key(1, (uint8_t)key, 0);
+    }
+#endif  //#if CHORDS == true
+}
+
+
+static void console_discard(const uint8_t *data, uint16_t len)
+{
+  (void)data;
+  (void)len;
+}
+
+
+static void save_state(struct fw_state *state)
+{
+  memcpy(state->x_bits, x_bits, sizeof(state->x_bits));
+  state->ctrl = (GPIO_ODR(CTRL_PORT) & CTRL_PIN) != 0;
+  state->shift = (GPIO_ODR(SHIFT_PORT) & SHIFT_PIN) != 0;
+  state->ruslat = (GPIO_ODR(RUSLAT_PORT) & RUSLAT_PIN) != 0;
+  state->shiftstate = shiftstate;
+  state->numlock = ps2numlockstate;
+  state->led = (GPIO_IDR(RUSLAT_LED_PORT) & RUSLAT_LED_PIN) != 0;
+#if CHORDS == true
+  state->chords = chord_state;
+#else
+  state->ctrl_alt_del = CtrlAltDel;
+#endif  //#if CHORDS == true
+  state->queue_put = dispatch_keys_queue.put_ptr;
+  state->queue_get = dispatch_keys_queue.get_ptr;
+  memcpy(state->queue, dispatch_keys_queue_buffer, sizeof(state->queue));
+#if MSX_PAIRING == true
+  memcpy(state->pairings, msx_pairings, sizeof(state->pairings));
+#endif  //#if MSX_PAIRING == true
+#if MSX_NKRO == true
+  memcpy(state->pressed, msx_pressed, sizeof(state->pressed));
+  memcpy(state->refs, msx_key_refs, sizeof(state->refs));
+  memcpy(state->modifier_pressed, msx_modifier_pressed, sizeof(state->modifier_pressed));
+  state->last_make = msx_nkro_last_make;
+#endif  //#if MSX_NKRO == true
+}
+
+
+//GPIO writes are the costly part: only the lines that changed are written
+static void restore_state(const struct fw_state *state)
+{
+  memcpy(x_bits, state->x_bits, sizeof(state->x_bits));
+  if(((GPIO_ODR(CTRL_PORT) & CTRL_PIN) != 0) != state->ctrl)
+    state->ctrl ? gpio_set(CTRL_PORT, CTRL_PIN) : gpio_clear(CTRL_PORT, CTRL_PIN);
+  if(((GPIO_ODR(SHIFT_PORT) & SHIFT_PIN) != 0) != state->shift)
+    state->shift ? gpio_set(SHIFT_PORT, SHIFT_PIN) : gpio_clear(SHIFT_PORT, SHIFT_PIN);
+  if(((GPIO_ODR(RUSLAT_PORT) & RUSLAT_PIN) != 0) != state->ruslat)
+    state->ruslat ? gpio_set(RUSLAT_PORT, RUSLAT_PIN) : gpio_clear(RUSLAT_PORT, RUSLAT_PIN);
+  shiftstate = state->shiftstate;
+  ps2numlockstate = state->numlock;
+  if(((GPIO_IDR(RUSLAT_LED_PORT) & RUSLAT_LED_PIN) != 0) != state->led)
+    host_gpio_input(RUSLAT_LED_PORT, RUSLAT_LED_PIN, state->led);
+#if CHORDS == true
+  chord_state = state->chords;
+#else
+  CtrlAltDel = state->ctrl_alt_del;
+#endif  //#if CHORDS == true
+  dispatch_keys_queue.put_ptr = state->queue_put;
+  dispatch_keys_queue.get_ptr = state->queue_get;
+  memcpy(dispatch_keys_queue_buffer, state->queue, sizeof(state->queue));
+#if MSX_PAIRING == true
+  memcpy(msx_pairings, state->pairings, sizeof(state->pairings));
+#endif  //#if MSX_PAIRING == true
+#if MSX_NKRO == true
+  memcpy(msx_pressed, state->pressed, sizeof(state->pressed));
+  memcpy(msx_key_refs, state->refs, sizeof(state->refs));
+  memcpy(msx_modifier_pressed, state->modifier_pressed, sizeof(state->modifier_pressed));
+  msx_nkro_last_make = state->last_make;
+#endif  //#if MSX_NKRO == true
+}
+
+
+static bool allowed(uint16_t ev)
+{
+  const struct event *e = &events[ev];
+
+  switch(e->kind)
+  {
+    case EV_MAKE:
+      return !held[e->key] && (held_count < max_held);
+    case EV_BREAK:
+      return held[e->key];
+    case EV_TICK:
+      return dispatch_keys_queue.put_ptr != dispatch_keys_queue.get_ptr;
+    default:
+      return ((GPIO_IDR(RUSLAT_LED_PORT) & RUSLAT_LED_PIN) != 0) != (e->key != 0);
+  }
+}
+
+
+//As the main loop with a mounted scan code, SysTick, or the MSX
+static void apply(uint16_t ev)
+{
+  const struct event *e = &events[ev];
+  const struct key *k = &keys[e->key];
+  uint32_t mod = (uint32_t)shiftstate | ((uint32_t)ps2numlockstate << 1) |
+                 (((GPIO_IDR(RUSLAT_LED_PORT) & RUSLAT_LED_PIN) != 0) << 2);
+#if CHORDS == true
+  uint32_t pair = (mod + 8 * (fired_chord(ev) != NULL)) * n_events + ev;
+#else
+  uint32_t pair = (mod + 8 * CtrlAltDel) * n_events + ev;
+#endif  //#if CHORDS == true
+  msxmap object;
+
+  __atomic_fetch_or(&search->coverage[pair / 8], (uint8_t)(1 << (pair % 8)), __ATOMIC_RELAXED);
+  switch(e->kind)
+  {
+    case EV_MAKE:
+    case EV_BREAK:
+      scancode[0] = 0;
+      scancode[1] = scancode[2] = scancode[3] = 0;
+      if(k->len == 2)
+        scancode[++scancode[0]] = PS2_EXTENDED_CODE;
+      if(e->kind == EV_BREAK)
+        scancode[++scancode[0]] = PS2_BREAK_CODE;
+      scancode[++scancode[0]] = k->code[k->len - 1];
+      held[e->key] = (e->kind == EV_MAKE);
+      held_count += (e->kind == EV_MAKE) ? 1 : -1;
+      object.convert2msx();
+      break;
+    case EV_TICK:
+      object.msxqueuekeys();
+      break;
+    default:
+      host_gpio_input(RUSLAT_LED_PORT, RUSLAT_LED_PIN, e->key != 0);
+      break;
+  }
+}
+
+
+static void undo_held(uint16_t ev)
+{
+  const struct event *e = &events[ev];
+
+  if(e->kind == EV_MAKE)
+  {
+    held[e->key] = false;
+    held_count--;
+  }
+  else if(e->kind == EV_BREAK)
+  {
+    held[e->key] = true;
+    held_count++;
+  }
+}
+
+
+#if CHORDS == true
+//Chord the event fires, or NULL
+static const struct chord* fired_chord(uint16_t ev)
+{
+  const struct event *e = &events[ev];
+  const struct key *k = &keys[e->key];
+
+  if( (e->kind != EV_MAKE) && (e->kind != EV_BREAK) )
+    return NULL;
+  return chord_match((k->len == 2) ? (CHORD_KEY_E0 | k->code[1]) : k->code[0], e->kind == EV_BREAK);
+}
+
+
+static bool resets_mcu(uint16_t ev)
+{
+  const struct chord *c = fired_chord(ev);
+
+  return c && ((c->action == DB_CHORD_ACT_RESET) || (c->action == DB_CHORD_ACT_LAYOUT) ||
+               (c->action == DB_CHORD_ACT_MACRO) || (c->action == DB_CHORD_ACT_MACRO_REC));
+}
+#else
+static bool resets_mcu(uint16_t ev)
+{
+  const struct event *e = &events[ev];
+
+  return (CtrlAltDel == CTRL_ALT_DEL_ARMED) && (e->kind == EV_MAKE) && (keys[e->key].len == 1) &&
+         (keys[e->key].code[0] == PS2_NUMPAD_DEL);
+}
+#endif  //#if CHORDS == true
+
+
+static void visit(uint8_t depth)
+{
+  stats->states++;
+  if(!held_count)
+    check_released(depth);
+}
+
+
+//All keys released: after the queue is drained, the MSX must see no key
+static void check_released(uint8_t depth)
+{
+  static const uint16_t x_pins[8] = { X0_PIN, X1_PIN, X2_PIN, X3_PIN, X4_PIN, X5_PIN, X6_PIN, X7_PIN };
+  struct fw_state saved;
+  uint8_t pressed[8], lines = 0;
+  bool stuck = false;
+  msxmap object;
+
+  save_state(&saved);
+  while(object.available_msx_disp_keys_queue_buffer())
+    object.msxqueuekeys();
+  for(uint8_t y = 0; y < 8; y++)
+  {
+    pressed[y] = 0;
+    if(x_bits[y] == ALL_X_SET)
+      continue;
+    for(uint8_t x = 0; x < 8; x++)
+      if(x_bits[y] & ((uint32_t)x_pins[x] << 16))
+        pressed[y] |= (uint8_t)(1 << x);
+    stuck |= pressed[y] != 0;
+  }
+  if(!(GPIO_ODR(CTRL_PORT) & CTRL_PIN))
+    lines |= 1;
+  if(!(GPIO_ODR(SHIFT_PORT) & SHIFT_PIN))
+    lines |= 2;
+  if(!(GPIO_ODR(RUSLAT_PORT) & RUSLAT_PIN))
+    lines |= 4;
+  if(stuck || lines)
+  {
+    stats->stuck++;
+    record_finding(depth, pressed, lines);
+  }
+  restore_state(&saved);
+}
+
+
+//A finding is new for the stuck lines and the set of keys of the path: the first path of each is kept
+static void record_finding(uint8_t depth, const uint8_t *pressed, uint8_t lines)
+{
+  uint64_t hash = 1469598103934665603ULL;         //FNV-1a
+  uint32_t slot, idx;
+  struct finding *f;
+  bool used[MAX_KEYS];
+
+  memset(used, 0, sizeof(used));
+  for(uint8_t i = 0; i < depth; i++)
+    if(events[path[i]].kind == EV_MAKE)
+      used[events[path[i]].key] = true;
+  for(uint16_t k = 0; k < n_keys; k++)
+    if(used[k])
+      hash = (hash ^ k) * 1099511628211ULL;
+  for(uint8_t y = 0; y < 8; y++)
+    hash = (hash ^ pressed[y]) * 1099511628211ULL;
+  hash = (hash ^ lines) * 1099511628211ULL;
+  if(!hash)
+    hash = 1;
+  for(slot = (uint32_t)hash & (FINDINGS_HASH_SIZE - 1); findings_hash[slot]; slot = (slot + 1) & (FINDINGS_HASH_SIZE - 1))
+    if(findings_hash[slot] == hash)
+      return;
+  findings_hash[slot] = hash;
+  idx = __atomic_fetch_add(&search->findings_len, 1, __ATOMIC_RELAXED);
+  if(idx >= MAX_FINDINGS)
+    return;
+  f = &search->findings[idx];
+  f->len = depth;
+  memcpy(f->path, path, depth * sizeof(path[0]));
+  memcpy(f->pressed, pressed, sizeof(f->pressed));
+  f->lines = lines;
+}
+
+
+static void dfs(uint8_t depth)
+{
+  struct fw_state saved;
+
+  save_state(&saved);
+  for(uint16_t ev = 0; ev < n_events; ev++)
+  {
+    if(!allowed(ev))
+      continue;
+    if(resets_mcu(ev))
+    {
+      stats->resets++;
+      continue;
+    }
+    path[depth] = ev;
+    apply(ev);
+    visit(depth + 1);
+    if(depth + 1 < max_depth)
+      dfs(depth + 1);
+    restore_state(&saved);
+    undo_held(ev);
+  }
+}
+
+
+static bool push_task(const uint16_t *task_path, uint8_t len)
+{
+  struct deque *d = &search->deques[self];
+  struct task *t;
+  bool ok = false;
+
+  __atomic_add_fetch(&search->pending, 1, __ATOMIC_SEQ_CST);
+  lock(&d->lock);
+  if(d->bottom - d->top < DEQUE_SIZE)
+  {
+    t = &d->tasks[d->bottom & (DEQUE_SIZE - 1)];
+    t->len = len;
+    memcpy(t->path, task_path, len * sizeof(task_path[0]));
+    d->bottom++;
+    ok = true;
+  }
+  unlock(&d->lock);
+  if(!ok)
+    __atomic_sub_fetch(&search->pending, 1, __ATOMIC_SEQ_CST);
+  return ok;
+}
+
+
+//Newest task of the own deque: depth first, as the tasks the worker pushed last are the deepest
+static bool pop_task(struct task *t)
+{
+  struct deque *d = &search->deques[self];
+  bool ok = false;
+
+  lock(&d->lock);
+  if(d->bottom != d->top)
+  {
+    d->bottom--;
+    *t = d->tasks[d->bottom & (DEQUE_SIZE - 1)];
+    ok = true;
+  }
+  unlock(&d->lock);
+  return ok;
+}
+
+
+//Oldest task of another worker: it is the shallowest, so the largest subtree
+static bool steal_task(struct task *t)
+{
+  struct deque *d;
+  bool ok = false;
+
+  for(long i = 1; !ok && (i < n_workers); i++)
+  {
+    d = &search->deques[(self + i) % n_workers];
+    if(__atomic_load_n(&d->bottom, __ATOMIC_RELAXED) == __atomic_load_n(&d->top, __ATOMIC_RELAXED))
+      continue;
+    lock(&d->lock);
+    if(d->bottom != d->top)
+    {
+      *t = d->tasks[d->top & (DEQUE_SIZE - 1)];
+      d->top++;
+      ok = true;
+    }
+    unlock(&d->lock);
+  }
+  if(ok)
+    stats->steals++;
+  return ok;
+}
+
+
+//Replays the path of the task from the booted state; its children are tasks too, up to SPLIT_DEPTH
+static void run_task(const struct task *t)
+{
+  struct fw_state saved;
+
+  stats->tasks++;
+  restore_state(&root);
+  memset(held, 0, sizeof(held));
+  held_count = 0;
+  for(uint8_t i = 0; i < t->len; i++)
+  {
+    path[i] = t->path[i];
+    apply(path[i]);
+  }
+  if(t->len)
+    visit(t->len);
+  if(t->len >= max_depth)
+    return;
+  if(t->len >= SPLIT_DEPTH)
+  {
+    dfs(t->len);
+    return;
+  }
+  //Pushed on reverse order, so they are popped on the order dfs() searches
+  save_state(&saved);
+  for(uint16_t ev = n_events; ev-- > 0; )
+  {
+    if(!allowed(ev))
+      continue;
+    if(resets_mcu(ev))
+    {
+      stats->resets++;
+      continue;
+    }
+    path[t->len] = ev;
+    if(push_task(path, t->len + 1))
+      continue;
+    //Deque full: this child is searched here
+    apply(ev);
+    visit(t->len + 1);
+    if(t->len + 1 < max_depth)
+      dfs(t->len + 1);
+    restore_state(&saved);
+    undo_held(ev);
+  }
+}
+
+
+static void worker(void)
+{
+  struct task t;
+
+  stats = &search->stats[self];
+  for(;;)
+  {
+    if(pop_task(&t) || steal_task(&t))
+    {
+      run_task(&t);
+      __atomic_sub_fetch(&search->pending, 1, __ATOMIC_SEQ_CST);
+      continue;
+    }
+    if(!__atomic_load_n(&search->pending, __ATOMIC_SEQ_CST))
+      return;
+    sched_yield();
+  }
+}
+
+
+static void lock(volatile uint32_t *l)
+{
+  while(__atomic_exchange_n(l, 1, __ATOMIC_ACQUIRE))
+    while(__atomic_load_n(l, __ATOMIC_RELAXED))
+      sched_yield();
+}
+
+
+static void unlock(volatile uint32_t *l)
+{
+  __atomic_store_n(l, 0, __ATOMIC_RELEASE);
+}
+
+
+//As golden-host script lines
+static void event_name(uint16_t ev, char *text)
+{
+  const struct event *e = &events[ev];
+  const struct key *k = &keys[e->key];
+
+  switch(e->kind)
+  {
+    case EV_MAKE:
+    case EV_BREAK:
+      text[0] = 0;
+      if(k->len == 2)
+        strcat(text, "E0 ");
+      if(e->kind == EV_BREAK)
+        strcat(text, "F0 ");
+      sprintf(text + strlen(text), "%02X", k->code[k->len - 1]);
+      break;
+    case EV_TICK:
+      strcpy(text, "tick");
+      break;
+    default:
+      sprintf(text, "ruslat_led %u", e->key);
+      break;
+  }
+}
+
+
+static void print_path(const uint16_t *p, uint8_t len)
+{
+  char text[16];
+
+  for(uint8_t i = 0; i < len; i++)
+  {
+    event_name(p[i], text);
+    printf("%s%s", i ? ", " : "", text);
+  }
+}
+
+
+//Findings are grouped by the lines left stuck, with the shortest path of each group
+static void report(uint32_t reports)
+{
+  uint32_t n = search->findings_len, shown = 0, count;
+  const struct finding *f, *g, *best;
+  bool *done;
+
+  if(n > MAX_FINDINGS)
+  {
+    printf("stuck_findings_dropped: %u\n", n - MAX_FINDINGS);
+    n = MAX_FINDINGS;
+  }
+  done = (bool*)calloc(n ? n : 1, sizeof(bool));
+  for(uint32_t i = 0; (i < n) && (shown < reports); i++)
+  {
+    if(done[i])
+      continue;
+    f = &search->findings[i];
+    best = f;
+    count = 0;
+    for(uint32_t j = i; j < n; j++)
+    {
+      g = &search->findings[j];
+      if( done[j] || memcmp(g->pressed, f->pressed, sizeof(f->pressed)) || (g->lines != f->lines) )
+        continue;
+      done[j] = true;
+      count++;
+      if(g->len < best->len)
+        best = g;
+    }
+    printf("stuck:");
+    for(uint8_t y = 0; y < 8; y++)
+      if(f->pressed[y])
+        printf(" Y%u 0x%02X", y, f->pressed[y]);
+    if(f->lines & 1)
+      printf(" CTRL");
+    if(f->lines & 2)
+      printf(" SHIFT");
+    if(f->lines & 4)
+      printf(" RUS/LAT");
+    printf(" (%u key sets), e.g. ", count);
+    print_path(best->path, best->len);
+    printf("\n");
+    shown++;
+  }
+  free(done);
+}
@@ -0,0 +1,449 @@
+/** @addtogroup 22 telemetry USB Telemetry
+ *
+ * @file telemetry_reader.cpp Reads the telemetry records of the converter from USB (Linux usbfs), and decodes them.
+ *
+ * @brief <b>Reads the telemetry records of the converter from USB (Linux usbfs), and decodes them.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Usage: telemetry-reader [-w file] [-s seconds] [-q] [-c [-p ps2_bytes] [-m matrix_records]]
+ *        telemetry-reader -f file [-q] [-c [-p ps2_bytes] [-m matrix_records]]
+ * With no -f, the converter is found by USB_VID:USB_PID on /sys/bus/usb/devices, its INTF_TELEMETRY
+ * interface is claimed on /dev/bus/usb and TELEMETRY_REQ_START is sent to it. Then EP_TELEMETRY_IN
+ * is read until Ctrl-C (or -s seconds), and TELEMETRY_REQ_STOP is sent. No libusb is needed, but
+ * the user must be allowed to open the device file (a udev rule, or root).
+ * - -w: also saves the raw records to file, to be decoded later with -f;
+ * - -f: decodes a saved file (or the one of ppi-scan-host -t) instead;
+ * - -q: no line per record, only the totals;
+ * - -c: checks the stream, exit code 2 if it fails: it starts with a START record, all types are
+ *   known, the times do not go back, nothing was dropped, and the MSX scan was seen (SCAN records
+ *   with column reads). -p and -m are the minimum PS/2 bytes and matrix records.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/usbdevice_fs.h>
+
+#include "system.h"
+#include "telemetry.h"
+
+#if USB_TELEMETRY != true
+#error "telemetry-reader needs USB_TELEMETRY on system.h"
+#endif
+
+#define USB_SYSFS_DEVICES         "/sys/bus/usb/devices"
+#define USB_VENDOR_INTERFACE_OUT  0x41      //bmRequestType: host to device, vendor, interface
+#define USB_TIMEOUT_MS            1000
+#define BULK_READ_SIZE            4096      //Many packets per transfer
+
+struct telemetry_totals
+{
+  uint32_t records, ps2_received, ps2_sent, matrix, scans, scan_reads, queues, dropped;
+  uint32_t unknown, time_back;
+  uint8_t  systick_hz;
+  bool     started, first_not_start;
+  uint32_t former_time;
+};
+
+static struct telemetry_totals totals;
+static bool quiet;
+static FILE *raw_file;
+static volatile sig_atomic_t interrupted;
+static uint8_t pending[TELEMETRY_RECORD_SIZE];
+static uint8_t pending_len;
+
+//Prototype area
+static void on_sigint(int sig);
+static bool read_sysfs(const char *dir, const char *name, const char *format, unsigned *value);
+static int  open_converter(void);
+static bool vendor_request(int fd, uint8_t request);
+static int  read_usb(double seconds);
+static int  read_file(const char *path);
+static void feed(const uint8_t *data, size_t len);
+static void decode(const uint8_t *rec);
+
+
+int main(int argc, char *argv[])
+{
+  const char *file = NULL, *raw = NULL;
+  double seconds = 0;
+  bool check = false;
+  uint32_t min_ps2 = 0, min_matrix = 0;
+  bool failed = false;
+  int i, result;
+
+  for(i = 1; i < argc; i++)
+  {
+    if(!strcmp(argv[i], "-c"))
+      check = true;
+    else if(!strcmp(argv[i], "-q"))
+      quiet = true;
+    else if(i + 1 >= argc)
+      break;
+    else if(!strcmp(argv[i], "-f"))
+      file = argv[++i];
+    else if(!strcmp(argv[i], "-w"))
+      raw = argv[++i];
+    else if(!strcmp(argv[i], "-s"))
+      seconds = strtod(argv[++i], NULL);
+    else if(!strcmp(argv[i], "-p"))
+      min_ps2 = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-m"))
+      min_matrix = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else
+      break;
+  }
+  if((i < argc) || (file && raw) || (seconds < 0))
+  {
+    fprintf(stderr, "Usage: %s [-w file] [-s seconds] [-q] [-c [-p ps2_bytes] [-m matrix_records]]\n"
+                    "       %s -f file [-q] [-c [-p ps2_bytes] [-m matrix_records]]\n"
+                    "With no -f, reads the converter %04x:%04x on USB until Ctrl-C (or -s seconds).\n",
+                    argv[0], argv[0], USB_VID, USB_PID);
+    return EXIT_FAILURE;
+  }
+
+  if(raw)
+  {
+    raw_file = fopen(raw, "wb");
+    if(!raw_file)
+    {
+      perror(raw);
+      return EXIT_FAILURE;
+    }
+  }
+  result = file ? read_file(file) : read_usb(seconds);
+  if(raw_file && fclose(raw_file))
+  {
+    perror(raw);
+    result = EXIT_FAILURE;
+  }
+  if(result != EXIT_SUCCESS)
+    return result;
+
+  printf("records: %u\n", totals.records);
+  printf("ps2_received: %u\n", totals.ps2_received);
+  printf("ps2_sent: %u\n", totals.ps2_sent);
+  printf("matrix: %u\n", totals.matrix);
+  printf("scans: %u\n", totals.scans);
+  printf("scan_reads: %u\n", totals.scan_reads);
+  printf("dropped: %u\n", totals.dropped);
+  if(!check)
+    return EXIT_SUCCESS;
+
+  if(!totals.started || totals.first_not_start)
+  {
+    printf("check: the stream does not start with a START record\n");
+    failed = true;
+  }
+  if(totals.unknown)
+  {
+    printf("check: %u records of unknown type\n", totals.unknown);
+    failed = true;
+  }
+  if(totals.time_back)
+  {
+    printf("check: time went back %u times\n", totals.time_back);
+    failed = true;
+  }
+  if(totals.dropped)
+  {
+    printf("check: %u records dropped\n", totals.dropped);
+    failed = true;
+  }
+  if(!totals.scans || !totals.scan_reads)
+  {
+    printf("check: no MSX column read on SCAN records\n");
+    failed = true;
+  }
+  if(pending_len)
+  {
+    printf("check: %u bytes of a cut record at the end\n", pending_len);
+    failed = true;
+  }
+  if(totals.ps2_received + totals.ps2_sent < min_ps2)
+  {
+    printf("check: %u PS/2 bytes, %u expected at least\n", totals.ps2_received + totals.ps2_sent, min_ps2);
+    failed = true;
+  }
+  if(totals.matrix < min_matrix)
+  {
+    printf("check: %u matrix records, %u expected at least\n", totals.matrix, min_matrix);
+    failed = true;
+  }
+  printf("check: %s\n", failed ? "failed" : "ok");
+  return failed ? 2 : EXIT_SUCCESS;
+}
+
+
+static void on_sigint(int sig)
+{
+  (void)sig;
+  interrupted = 1;
+}
+
+
+//idVendor and idProduct are hex, busnum and devnum decimal
+static bool read_sysfs(const char *dir, const char *name, const char *format, unsigned *value)
+{
+  char path[512];
+  FILE *f;
+  bool ok;
+
+  snprintf(path, sizeof(path), USB_SYSFS_DEVICES "/%s/%s", dir, name);
+  f = fopen(path, "r");
+  if(!f)
+    return false;
+  ok = fscanf(f, format, value) == 1;
+  fclose(f);
+  return ok;
+}
+
+
+//Opens the first converter found and claims its telemetry interface
+static int open_converter(void)
+{
+  DIR *devices;
+  struct dirent *entry;
+  unsigned vid, pid, busnum = 0, devnum = 0;
+  char path[64];
+  int fd, intf = INTF_TELEMETRY;
+  bool found = false;
+
+  devices = opendir(USB_SYSFS_DEVICES);
+  if(!devices)
+  {
+    perror(USB_SYSFS_DEVICES);
+    return -1;
+  }
+  while(!found && (entry = readdir(devices)) != NULL)
+    found = read_sysfs(entry->d_name, "idVendor", "%x", &vid) && (vid == USB_VID) &&
+            read_sysfs(entry->d_name, "idProduct", "%x", &pid) && (pid == USB_PID) &&
+            read_sysfs(entry->d_name, "busnum", "%u", &busnum) &&
+            read_sysfs(entry->d_name, "devnum", "%u", &devnum);
+  closedir(devices);
+  if(!found)
+  {
+    fprintf(stderr, "telemetry-reader: no converter %04x:%04x on USB\n", USB_VID, USB_PID);
+    return -1;
+  }
+
+  snprintf(path, sizeof(path), "/dev/bus/usb/%03u/%03u", busnum, devnum);
+  fd = open(path, O_RDWR);
+  if(fd < 0)
+  {
+    perror(path);
+    return -1;
+  }
+  if(ioctl(fd, USBDEVFS_CLAIMINTERFACE, &intf) < 0)
+  {
+    perror("telemetry-reader: claim interface");
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+
+static bool vendor_request(int fd, uint8_t request)
+{
+  struct usbdevfs_ctrltransfer ctrl;
+
+  memset(&ctrl, 0, sizeof(ctrl));
+  ctrl.bRequestType = USB_VENDOR_INTERFACE_OUT;
+  ctrl.bRequest = request;
+  ctrl.wIndex = INTF_TELEMETRY;
+  ctrl.timeout = USB_TIMEOUT_MS;
+  if(ioctl(fd, USBDEVFS_CONTROL, &ctrl) < 0)
+  {
+    perror("telemetry-reader: vendor request");
+    return false;
+  }
+  return true;
+}
+
+
+static int read_usb(double seconds)
+{
+  struct usbdevfs_bulktransfer bulk;
+  static uint8_t buffer[BULK_READ_SIZE];
+  struct timespec start, now;
+  int fd, len, intf = INTF_TELEMETRY;
+
+  fd = open_converter();
+  if(fd < 0)
+    return EXIT_FAILURE;
+  if(!vendor_request(fd, TELEMETRY_REQ_START))
+  {
+    close(fd);
+    return EXIT_FAILURE;
+  }
+  signal(SIGINT, on_sigint);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while(!interrupted)
+  {
+    memset(&bulk, 0, sizeof(bulk));
+    bulk.ep = EP_TELEMETRY_IN;
+    bulk.len = sizeof(buffer);
+    bulk.timeout = USB_TIMEOUT_MS;
+    bulk.data = buffer;
+    len = ioctl(fd, USBDEVFS_BULK, &bulk);
+    if(len < 0)
+    {
+      if((errno != ETIMEDOUT) && (errno != EINTR))
+      {
+        perror("telemetry-reader: bulk read");
+        break;
+      }
+    }
+    else
+      feed(buffer, (size_t)len);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if( (seconds > 0) &&
+        ((double)(now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9 >= seconds) )
+      break;
+  }
+  vendor_request(fd, TELEMETRY_REQ_STOP);
+  ioctl(fd, USBDEVFS_RELEASEINTERFACE, &intf);
+  close(fd);
+  return EXIT_SUCCESS;
+}
+
+
+static int read_file(const char *path)
+{
+  uint8_t buffer[BULK_READ_SIZE];
+  size_t len;
+  FILE *f;
+
+  f = fopen(path, "rb");
+  if(!f)
+  {
+    perror(path);
+    return EXIT_FAILURE;
+  }
+  while((len = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    feed(buffer, len);
+  fclose(f);
+  return EXIT_SUCCESS;
+}
+
+
+//Cuts the stream in records: a transfer may end on any byte
+static void feed(const uint8_t *data, size_t len)
+{
+  if(raw_file)
+    fwrite(data, 1, len, raw_file);
+  while(len--)
+  {
+    pending[pending_len++] = *data++;
+    if(pending_len == TELEMETRY_RECORD_SIZE)
+    {
+      decode(pending);
+      pending_len = 0;
+    }
+  }
+}
+
+
+static void decode(const uint8_t *rec)
+{
+  uint32_t time = rec[4] | ((uint32_t)rec[5] << 8) | ((uint32_t)rec[6] << 16) | ((uint32_t)rec[7] << 24);
+  uint32_t payload = rec[1] | ((uint32_t)rec[2] << 8) | ((uint32_t)rec[3] << 16);
+  static const char *const lines[] = { "CTRL", "SHIFT", "RUS/LAT" };
+
+  if(!totals.records && (rec[0] != TELEMETRY_REC_START))
+    totals.first_not_start = true;
+  //TIM_HR wraps after 71 minutes: times are compared modulo 2^32
+  if(totals.records && ((int32_t)(time - totals.former_time) < 0))
+    totals.time_back++;
+  totals.former_time = time;
+  totals.records++;
+  if(!quiet)
+    printf("%10u ", time);
+
+  switch(rec[0])
+  {
+  case TELEMETRY_REC_START:
+    totals.started = true;
+    totals.systick_hz = rec[2];
+    if(!quiet)
+      printf("start version %u, SysTick %uHz\n", rec[1], rec[2]);
+    break;
+  case TELEMETRY_REC_PS2:
+    if(rec[2] == TELEMETRY_PS2_SENT)
+      totals.ps2_sent++;
+    else
+      totals.ps2_received++;
+    if(!quiet)
+      printf("ps2 %s %02X\n", rec[2] == TELEMETRY_PS2_SENT ? "tx" : "rx", rec[1]);
+    break;
+  case TELEMETRY_REC_MATRIX:
+    totals.matrix++;
+    if(quiet)
+      break;
+    if(rec[1] > 7 && rec[1] < 11)
+      printf("matrix %s %s\n", lines[rec[1] - 8], rec[3] ? "release" : "press");
+    else
+      printf("matrix Y%uX%u %s\n", rec[1], rec[2], rec[3] ? "release" : "press");
+    break;
+  case TELEMETRY_REC_SCAN:
+    totals.scans++;
+    totals.scan_reads += payload & 0xFFFF;
+    if(!quiet)
+      printf("scan %u reads (%u/s)\n", payload & 0xFFFF, (payload & 0xFFFF) * totals.systick_hz);
+    break;
+  case TELEMETRY_REC_QUEUE:
+    totals.queues++;
+    if(!quiet)
+      printf("queue keys %u, ps2 %u, telemetry %u\n", rec[1], rec[2], rec[3]);
+    break;
+  case TELEMETRY_REC_DROPPED:
+    totals.dropped += payload;
+    if(!quiet)
+      printf("dropped %u records\n", payload);
+    break;
+  default:
+    totals.unknown++;
+    if(!quiet)
+      printf("unknown %02X %02X %02X %02X\n", rec[0], rec[1], rec[2], rec[3]);
+  }
+}
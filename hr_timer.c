@@ -46,10 +46,22 @@ volatile uint16_t state_overflow_tim2;
 volatile uint64_t TIM2_Update_Cnt;                //Overflow of time_between_ps2clk
 volatile uint64_t time_between_ps2clk ;
 volatile uint64_t acctimeps2data0;
+volatile uint32_t last_ps2clk_capture;            //Counter value of the last PS/2 clock capture
+
+//Deadline list. Each slot is free when callback == NULL
+struct hr_timer_slot
+{
+  uint32_t deadline;
+  hr_timer_callback callback;
+  uint8_t next;
+};
+volatile struct hr_timer_slot hr_timer_slots[HR_TIMER_SLOTS];
+volatile uint8_t hr_timer_head;                   //Index of the earliest deadline
 
 //Local Prototypes
 void time_capture(void);
-void (*next_routine) (void);
+void hr_timer_arm_head(void);
+void hr_timer_dispatch(void);
 
 
 void tim_hr_setup(uint32_t timer_peripheral)
@@ -93,6 +105,16 @@ void tim_hr_setup(uint32_t timer_peripheral)
   // Enable preload.
   timer_enable_preload(timer_peripheral);
 
+  //Only counter overflow generates UIF. The counter is never cleared anymore: it is shared by the
+  //PS/2 clock capture (CC1) and the deadline list (CC2).
+  TIM_CR1(timer_peripheral) |= TIM_CR1_URS;
+
+  //Deadline list starts empty. CC2 is an output compare in frozen mode (only CC2IF is used),
+  //which is the reset condition of TIMx_CCMR1 bits 15:8.
+  for(uint8_t i = 0; i < HR_TIMER_SLOTS; i++)
+    hr_timer_slots[i].callback = NULL;
+  hr_timer_head = HR_TIMER_NONE;
+
   /*
   TIM2_Update_Cnt = 0;
   time_between_ps2clk = 0;
@@ -136,61 +158,126 @@ void tim_hr_setup(uint32_t timer_peripheral)
 }
 
 
-//void delay_usec(uint16_t usec, int16_t next_state)
-void delay_usec(uint32_t timer_peripheral, uint16_t usec, void next_step (void))
+uint32_t hr_timer_now(void)
 {
-  //Here we init TIM2 to a single shot,
-  //and have an interrupt at the counting overflow
+  return TIM_CNT(TIM_HR);
+}
 
-  // Counter disable
-  TIM_CR1(timer_peripheral) &= ~TIM_CR1_CEN;
 
-  //Disable capture from the counter into the capture register by setting the CC1E bit in the TIMx_CCER register.
-  //Bit 0 CC1E: Capture/Compare 1 configured as input:
-  //This bit determines if a capture of the counter value can actually be done into the input 
-  //capture/compare register 1 (TIMx_CCR1) or not.
-  //0: Capture disabled.
-  //1: Capture enabled.
-  TIM_CCER(timer_peripheral) &= ~TIM_CCER_CC1E;
-
-  // Bit 2 URS: Update request source
-  // This bit is set and cleared by software to select the UEV event sources.
-  // 0: Any of the following events generate an update interrupt or DMA request if enabled.
-  // These events can be:
-  // – Counter overflow/underflow
-  // – Setting the UG bit
-  // – Update generation through the slave mode controller
-  // 1: Only counter overflow/underflow generates an update interrupt or DMA request if enabled.  
-  TIM_CR1(timer_peripheral) |= TIM_CR1_URS;
+uint8_t hr_timer_start(uint32_t usec, hr_timer_callback callback)
+{
+  uint8_t idx, prev, iter;
+
+  //TIM_HR ISR is the only other user of the list, so masking it is enough
+  nvic_disable_irq(NVIC_TIM_HR_IRQ);
+  for(idx = 0; idx < HR_TIMER_SLOTS; idx++)
+    if(hr_timer_slots[idx].callback == NULL)
+      break;
+  if(idx == HR_TIMER_SLOTS)
+  {
+    nvic_enable_irq(NVIC_TIM_HR_IRQ);
+    return HR_TIMER_NONE;
+  }
+  hr_timer_slots[idx].deadline = TIM_CNT(TIM_HR) + usec;
+  hr_timer_slots[idx].callback = callback;
+  //Insert it sorted. Comparisons are done on signed differences to survive the counter wrap around.
+  //Equal deadlines keep the order they were started.
+  prev = HR_TIMER_NONE;
+  iter = hr_timer_head;
+  while( (iter != HR_TIMER_NONE) &&
+         ((int32_t)(hr_timer_slots[idx].deadline - hr_timer_slots[iter].deadline) >= 0) )
+  {
+    prev = iter;
+    iter = hr_timer_slots[iter].next;
+  }
+  hr_timer_slots[idx].next = iter;
+  if(prev == HR_TIMER_NONE)
+  {
+    hr_timer_head = idx;
+    hr_timer_arm_head();
+  }
+  else
+    hr_timer_slots[prev].next = idx;
+  nvic_enable_irq(NVIC_TIM_HR_IRQ);
+  return idx;
+}
 
-  //Now clear timer through set UG:
-  //Generate a UEV (UG bit in the TIMx_EGR register)
-  //Bit 0 UG: Update generation
-  //This bit can be set by software, it is automatically cleared by hardware.
-  //0: No action
-  //1: Re-initialize the counter and generates an update of the registers. Note that the prescaler
-  //counter is cleared too (anyway the prescaler ratio is not affected). The counter is cleared if
-  //the center-aligned mode is selected or if DIR=0 (upcounting), else it takes the auto-reload
-  //value (TIMx_ARR) if DIR=1 (downcounting).
-  TIM_EGR(timer_peripheral) |= TIM_EGR_UG;
-  // Clear timer Update Interrupt Flag after set UG (Update Generation)
-  //timer_clear_flag(TIM2, TIM_SR_UIF);
-  TIM_SR(timer_peripheral) &= ~TIM_SR_UIF;
-
-  //timer_set_period(TIM2, 0xFFFFFFFF-usec-1);
-  TIM_CNT(timer_peripheral) = 0xFFFFFFFF + 1 - usec;
-
-  next_routine = next_step;
-
-  //Enables OPM (One Pulse Mode)
-  TIM_CR1(timer_peripheral) |= TIM_CR1_OPM;
-
-  // Counter enable
-  //timer_enable_counter(TIM2);
-  TIM_CR1(timer_peripheral) |= TIM_CR1_CEN;
 
-  //timer_enable_irq(TIM2, TIM_DIER_UIE);
-  TIM_DIER(timer_peripheral) |= TIM_DIER_UIE;
+bool hr_timer_cancel(uint8_t handle)
+{
+  uint8_t prev, iter;
+  bool found = false;
+
+  if(handle >= HR_TIMER_SLOTS)
+    return false;
+  nvic_disable_irq(NVIC_TIM_HR_IRQ);
+  prev = HR_TIMER_NONE;
+  iter = hr_timer_head;
+  while(iter != HR_TIMER_NONE)
+  {
+    if(iter == handle)
+    {
+      if(prev == HR_TIMER_NONE)
+      {
+        hr_timer_head = hr_timer_slots[iter].next;
+        hr_timer_arm_head();
+      }
+      else
+        hr_timer_slots[prev].next = hr_timer_slots[iter].next;
+      hr_timer_slots[iter].callback = NULL;
+      found = true;
+      break;
+    }
+    prev = iter;
+    iter = hr_timer_slots[iter].next;
+  }
+  nvic_enable_irq(NVIC_TIM_HR_IRQ);
+  return found;
+}
+
+
+//Loads the earliest deadline on CC2. Must be called with TIM_HR interrupt masked or from its ISR.
+void hr_timer_arm_head(void)
+{
+  if(hr_timer_head == HR_TIMER_NONE)
+  {
+    timer_disable_irq(TIM_HR, TIM_DIER_CC2IE);
+    return;
+  }
+  TIM_CCR2(TIM_HR) = hr_timer_slots[hr_timer_head].deadline;
+  timer_clear_flag(TIM_HR, TIM_SR_CC2IF);
+  timer_enable_irq(TIM_HR, TIM_DIER_CC2IE);
+  //If the deadline was already reached while it was being programmed, the compare match is lost,
+  //so force it by software.
+  if((int32_t)(hr_timer_slots[hr_timer_head].deadline - TIM_CNT(TIM_HR)) <= 0)
+    TIM_EGR(TIM_HR) |= TIM_EGR_CC2G;
+}
+
+
+//Called from TIM_HR ISR on CC2IF: runs all expired callbacks, earliest first.
+void hr_timer_dispatch(void)
+{
+  uint8_t idx;
+  hr_timer_callback callback;
+
+  timer_clear_flag(TIM_HR, TIM_SR_CC2IF);
+  while( (hr_timer_head != HR_TIMER_NONE) &&
+         ((int32_t)(hr_timer_slots[hr_timer_head].deadline - TIM_CNT(TIM_HR)) <= 0) )
+  {
+    idx = hr_timer_head;
+    callback = hr_timer_slots[idx].callback;
+    hr_timer_head = hr_timer_slots[idx].next;
+    hr_timer_slots[idx].callback = NULL;  //Slot is free before the call, so callback may restart it
+    callback();
+  }
+  hr_timer_arm_head();
+}
+
+
+void delay_usec(uint32_t timer_peripheral, uint16_t usec, void next_step (void))
+{
+  (void)timer_peripheral;
+  hr_timer_start(usec, next_step);
 }
 
 
@@ -201,10 +288,9 @@ void prepares_capture(uint32_t timer_peripheral)
 
   // Dummy read the Input Capture value (to clear CC1IF flag)
   TIM_CCR1(timer_peripheral);
-  //Clear TIM2 Capture compare interrupt pending bit
-  //timer_clear_flag(timer_peripheral, TIM_SR_CC1IF);             //if the above dummy read didn`t do the task
-  //timer_clear_flag(timer_peripheral, TIM_SR_CC1OF);
-  TIM_SR(timer_peripheral) &= ~(TIM_SR_CC1IF | TIM_SR_CC1OF);         //if the above dummy read didn`t do the task
+  //Clear TIM2 Capture compare interrupt pending bit, if the above dummy read didn`t do the task.
+  //A plain write, as the flags are cleared by 0: a read-modify-write would lose a CC2IF raised meanwhile
+  timer_clear_flag(timer_peripheral, TIM_SR_CC1IF | TIM_SR_CC1OF);
 
   //. Select the active input: TIMx_CCR1 must be linked to the TI1 input, so write the CC1S
   //bits to 01 in the TIMx_CCMR1 register. As soon as CC1S becomes different from 00,
@@ -246,19 +332,11 @@ void prepares_capture(uint32_t timer_peripheral)
   //0: Capture disabled.
   //1: Capture enabled.
   TIM_CCER(timer_peripheral) |= TIM_CCER_CC1E;
-  timer_set_period(timer_peripheral, 0xFFFFFFFF);
-  //Disables OPM (One Pulse Mode)
-  TIM_CR1(timer_peripheral) &= ~TIM_CR1_OPM;
-  //Setup counters
+  //Setup counters. Time between PS/2 clocks is now measured from here.
   time_between_ps2clk = 0;
   acctimeps2data0 = 0;
   TIM2_Update_Cnt = 0;
-  //Now points UIF (overflow int) to "normal" state: TIME_CAPTURE
-  //state_overflow_tim2 = TIME_CAPTURE;
-  next_routine = time_capture;
-
-  //Clear TIM2_CR1_URS;
-  TIM_CR1(timer_peripheral) &= ~TIM_CR1_URS;
+  last_ps2clk_capture = TIM_CNT(timer_peripheral);
 
   //Counter enable
   //timer_enable_counter(timer_peripheral);
@@ -290,12 +368,17 @@ void tim2_isr(void)
 
     // Clear timer Update Interrupt Flag
     timer_clear_flag(TIM2, TIM_SR_UIF);
-    next_routine();
+    time_capture();
 
     //Debug & performance measurement
     //gpio_set(TIM2UIF_PORT, TIM2UIF_PIN); //Signs end of interruption
   } //if (timer_get_flag(TIM2, TIM_SR_UIF))
-  else if (timer_get_flag(TIM2, TIM_SR_CC1IF))
+  if (timer_get_flag(TIM2, TIM_SR_CC2IF) && (TIM_DIER(TIM2) & TIM_DIER_CC2IE))
+  {
+    //Deadline list
+    hr_timer_dispatch();
+  }
+  if (timer_get_flag(TIM2, TIM_SR_CC1IF) && (TIM_DIER(TIM2) & TIM_DIER_CC1IE))
   {
     //When an input capture occurs:
     //. The TIMx_CCR1 register gets the value of the counter on the active transition.
@@ -312,18 +395,13 @@ void tim2_isr(void)
     //Debug & performance measurement
     //gpio_clear(TIM2UIF_PORT, TIM2CC1_PIN); //Signs start of interruption
 
-    // Clear TIM2 Capture compare interrupt pending bit
-    //timer_clear_flag(TIM2, TIM_SR_CC1OF |  TIM_SR_CC1IF);
-    TIM_SR(TIM2) &= ~(TIM_SR_CC1IF | TIM_SR_CC1OF);
-    // Get the Input Capture value
-    time_between_ps2clk = TIM2_Update_Cnt << 32 | TIM_CCR1(TIM2);
-    //Clear Counter2 (Reset both CNT & PSC plus )
-    TIM_CR1(TIM2) |= TIM_CR1_URS; 
-    TIM_EGR(TIM2) |= TIM_EGR_UG;
-    TIM_SR(TIM2) &= ~TIM_SR_UIF;
-    //Clear TIM2_CR1_URS;
-    TIM_CR1(TIM2) &= ~TIM_CR1_URS;
-
+    // Clear TIM2 Capture compare interrupt pending bit, with no read-modify-write (CC2 deadlines)
+    timer_clear_flag(TIM2, TIM_SR_CC1IF | TIM_SR_CC1OF);
+    // Get the Input Capture value. The counter is free running, so time is the difference
+    // to the previous capture, plus the overflows in between.
+    uint32_t capture = TIM_CCR1(TIM2);
+    time_between_ps2clk = (TIM2_Update_Cnt << 32) + (uint64_t)capture - (uint64_t)last_ps2clk_capture;
+    last_ps2clk_capture = capture;
     TIM2_Update_Cnt = 0;
 
     //This is the ISR of PS/2 clock pin. It jumps to ps2_clock_update.
@@ -67,10 +67,50 @@ extern "C" {
  */
 void tim_hr_setup(uint32_t timer_peripheral);
 
+/** Multiplexed microsecond deadlines.
+ *
+ * TIM_HR is a free running 32 bits counter at 1MHz. All pending deadlines are kept in a
+ * list sorted by expiration time, and only the head of the list is loaded on the Capture/Compare2
+ * register, so CC1 stays free to capture PS/2 clock all the time.
+ * Callbacks run inside TIM_HR ISR (IRQ_PRI_TIM_HR), so they must be short and must not block.
+ * hr_timer_start() and hr_timer_cancel() must not be called from ISR's with priority higher than
+ * IRQ_PRI_TIM_HR (MSX Y scan ISR's).
+@{*/
+#define HR_TIMER_SLOTS            8           //Max number of simultaneous deadlines
+#define HR_TIMER_NONE             0xFF        //Invalid handle / end of list
+/**@}*/
+
+typedef void (*hr_timer_callback)(void);
+
+/**
+ * @brief Returns the current value of the free running 1MHz counter.
+ *
+ * @return uint32_t Time stamp in microseconds. It wraps around each 71.6 minutes.
+ */
+uint32_t hr_timer_now(void);
+
+/**
+ * @brief Schedules a callback to be called after some microseconds.
+ *
+ * @param usec delay (in microseconds), up to 2^31-1.
+ * @param callback pointer of the desired function to be called after time is up.
+ * @return uint8_t handle of the deadline, or HR_TIMER_NONE if there is no free slot.
+ */
+uint8_t hr_timer_start(uint32_t usec, hr_timer_callback callback);
+
+/**
+ * @brief Cancels a pending deadline.
+ *
+ * @param handle Value returned by hr_timer_start().
+ * @return true if the deadline was still pending and it was removed.
+ */
+bool hr_timer_cancel(uint8_t handle);
+
 /**
  * @brief Inserts a delay with a resolution of a microsecond and call the desired function.
  *
- * @param timer_peripheral Timer to be used.
+ * It is now a wrapper of hr_timer_start(). The capture of PS/2 clock is not disturbed.
+ * @param timer_peripheral Timer to be used. Only TIM_HR is supported.
  * @param qusec delay (in microseconds).
  * @param next_step pointer of the desired function to be called after time is up.
  */
@@ -0,0 +1,283 @@
+/** @addtogroup 11 latency Key Latency Tracer
+ *
+ * @file latency.c End-to-end key latency tracer.
+ *
+ * @brief <b>End-to-end key latency tracer, from PS/2 stop bit to MSX column read.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Only one key event is traced at a time. If a new scan code is concluded before the former
+ * one was read by MSX (no MSX scan, or a key not present on Database), the former one is
+ * counted as unfinished and discarded.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include "latency.h"
+#include "ps2handl.h"
+#include "console.h"
+
+
+enum LATENCY_STATE{
+  LAT_IDLE =                      0,
+  LAT_WAIT_X_BITS,
+  LAT_WAIT_Y_SCAN,
+  LAT_DONE,
+};
+
+struct latency_stats
+{
+  uint32_t count, min, max;
+  uint64_t sum;
+  uint32_t hist[LATENCY_HIST_BUCKETS];
+};
+
+const char *const latency_stage_names[LAT_NUM_STAGES] =
+{
+  "PS/2 ring ",
+  "mount     ",
+  "convert   ",
+  "Y scan    ",
+  "total     ",
+};
+
+
+//Global vars
+volatile uint8_t latency_wait_y = LATENCY_NO_Y;
+volatile uint8_t latency_state;
+volatile uint32_t latency_stop_time[PS2_RECV_BUFFER_SIZE];
+volatile uint32_t latency_last_stop, latency_last_pulled;
+volatile struct latency_record latency_current;
+struct latency_record latency_ring[LATENCY_RING_SIZE];
+uint8_t latency_ring_put;
+struct latency_stats latency_stats[LAT_NUM_STAGES];
+uint32_t latency_unfinished;
+
+
+//Local prototypes
+void latency_reset(void);
+void latency_stats_add(struct latency_stats *stats, uint32_t value);
+void latency_send_column(uint32_t value, uint8_t width);
+
+
+void latency_byte_stop(uint8_t ring_idx)
+{
+  latency_stop_time[ring_idx] = hr_timer_now();
+}
+
+
+void latency_byte_pulled(uint8_t ring_idx)
+{
+  //The byte that concludes the scan code is the last one fetched
+  latency_last_stop = latency_stop_time[ring_idx];
+  latency_last_pulled = hr_timer_now();
+}
+
+
+void latency_scancode_mounted(uint32_t scan_code)
+{
+  uint32_t now = hr_timer_now();
+
+  //Stops Y ISR's before to change the record
+  latency_wait_y = LATENCY_NO_Y;
+  if(latency_state == LAT_DONE)
+    latency_poll();
+  else if(latency_state != LAT_IDLE)
+    latency_unfinished++;
+  latency_current.scan_code = scan_code;
+  latency_current.t_stop = latency_last_stop;
+  latency_current.t_pulled = latency_last_pulled;
+  latency_current.t_mounted = now;
+  latency_state = LAT_WAIT_X_BITS;
+}
+
+
+void latency_x_bits_updated(uint8_t y)
+{
+  if(latency_state != LAT_WAIT_X_BITS)
+    return;
+  latency_current.t_x_bits = hr_timer_now();
+  latency_current.y = y;
+  if(y > 7)
+  {
+    //CTRL, SHIFT and RUSLAT are directly driven pins: MSX sees them right now
+    latency_current.t_served = latency_current.t_x_bits;
+    latency_state = LAT_DONE;
+  }
+  else
+  {
+    latency_state = LAT_WAIT_Y_SCAN;
+    latency_wait_y = y;
+  }
+}
+
+
+void latency_y_served(void)
+{
+  latency_wait_y = LATENCY_NO_Y;
+  latency_current.t_served = hr_timer_now();
+  latency_state = LAT_DONE;
+}
+
+
+void latency_poll(void)
+{
+  if(latency_state != LAT_DONE)
+    return;
+  struct latency_record *rec = &latency_ring[latency_ring_put];
+  rec->scan_code = latency_current.scan_code;
+  rec->t_stop = latency_current.t_stop;
+  rec->t_pulled = latency_current.t_pulled;
+  rec->t_mounted = latency_current.t_mounted;
+  rec->t_x_bits = latency_current.t_x_bits;
+  rec->t_served = latency_current.t_served;
+  rec->y = latency_current.y;
+  latency_ring_put = (latency_ring_put + 1) & (LATENCY_RING_SIZE - 1);
+  latency_state = LAT_IDLE;
+
+  latency_stats_add(&latency_stats[LAT_STAGE_RING], rec->t_pulled - rec->t_stop);
+  latency_stats_add(&latency_stats[LAT_STAGE_MOUNT], rec->t_mounted - rec->t_pulled);
+  latency_stats_add(&latency_stats[LAT_STAGE_CONVERT], rec->t_x_bits - rec->t_mounted);
+  latency_stats_add(&latency_stats[LAT_STAGE_Y_SCAN], rec->t_served - rec->t_x_bits);
+  latency_stats_add(&latency_stats[LAT_STAGE_TOTAL], rec->t_served - rec->t_stop);
+}
+
+
+void latency_stats_add(struct latency_stats *stats, uint32_t value)
+{
+  uint8_t bucket = (value == 0) ? 0 : (31 - __builtin_clz(value));
+
+  if( (stats->count == 0) || (value < stats->min) )
+    stats->min = value;
+  if(value > stats->max)
+    stats->max = value;
+  stats->sum += value;
+  stats->count++;
+  stats->hist[bucket]++;
+}
+
+
+void latency_reset(void)
+{
+  latency_wait_y = LATENCY_NO_Y;
+  latency_state = LAT_IDLE;
+  latency_unfinished = 0;
+  latency_ring_put = 0;
+  for(uint8_t i = 0; i < LATENCY_RING_SIZE; i++)
+    latency_ring[i].scan_code = 0;
+  for(uint8_t i = 0; i < LAT_NUM_STAGES; i++)
+  {
+    latency_stats[i].count = 0;
+    latency_stats[i].min = 0;
+    latency_stats[i].max = 0;
+    latency_stats[i].sum = 0;
+    for(uint8_t j = 0; j < LATENCY_HIST_BUCKETS; j++)
+      latency_stats[i].hist[j] = 0;
+  }
+}
+
+
+//Right aligned decimal column
+void latency_send_column(uint32_t value, uint8_t width)
+{
+  uint8_t mountstring[16];
+  uint8_t len;
+
+  conv_uint32_to_dec(value, mountstring);
+  for(len = strlen((const char*)mountstring); len < width; len++)
+    con_send_string((uint8_t*)" ");
+  con_send_string(mountstring);
+}
+
+
+void latency_console_cmd(uint8_t *args)
+{
+  uint8_t *word = console_next_word(&args);
+  uint8_t mountstring[16];
+
+  if(strcmp((const char*)word, "reset") == 0)
+  {
+    latency_reset();
+    con_send_string((uint8_t*)"Latency statistics cleared.\r\n");
+    return;
+  }
+  if(strcmp((const char*)word, "dump") == 0)
+  {
+    con_send_string((uint8_t*)"Scan code   Y   ring  mount convert Y scan  total (us)\r\n");
+    for(uint8_t i = 0; i < LATENCY_RING_SIZE; i++)
+    {
+      struct latency_record *rec = &latency_ring[(latency_ring_put + i) & (LATENCY_RING_SIZE - 1)];
+      if(rec->scan_code == 0)
+        continue;
+      conv_uint32_to_8a_hex(rec->scan_code, mountstring);
+      con_send_string(mountstring);
+      latency_send_column(rec->y, 4);
+      latency_send_column(rec->t_pulled - rec->t_stop, 7);
+      latency_send_column(rec->t_mounted - rec->t_pulled, 7);
+      latency_send_column(rec->t_x_bits - rec->t_mounted, 8);
+      latency_send_column(rec->t_served - rec->t_x_bits, 7);
+      latency_send_column(rec->t_served - rec->t_stop, 7);
+      con_send_string((uint8_t*)"\r\n");
+    }
+    return;
+  }
+
+  con_send_string((uint8_t*)"Stage         count      min      avg   p99<=      max (us)\r\n");
+  for(uint8_t i = 0; i < LAT_NUM_STAGES; i++)
+  {
+    struct latency_stats *stats = &latency_stats[i];
+    con_send_string((uint8_t*)latency_stage_names[i]);
+    latency_send_column(stats->count, 9);
+    if(stats->count == 0)
+    {
+      con_send_string((uint8_t*)"\r\n");
+      continue;
+    }
+    latency_send_column(stats->min, 9);
+    latency_send_column((uint32_t)(stats->sum / stats->count), 9);
+    //p99 is the upper limit of the bucket where 99% of the events are reached
+    uint32_t target = stats->count - stats->count / 100, acc = 0;
+    uint8_t bucket;
+    for(bucket = 0; bucket < (LATENCY_HIST_BUCKETS - 1); bucket++)
+    {
+      acc += stats->hist[bucket];
+      if(acc >= target)
+        break;
+    }
+    latency_send_column((bucket >= 31) ? 0xFFFFFFFF : ((2UL << bucket) - 1), 8);
+    latency_send_column(stats->max, 9);
+    con_send_string((uint8_t*)"\r\n");
+  }
+  con_send_string((uint8_t*)"Unfinished (not read by MSX or not mapped): ");
+  conv_uint32_to_dec(latency_unfinished, mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)"\r\n");
+}
@@ -0,0 +1,148 @@
+/** @defgroup 11 latency Key Latency Tracer
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file latency.h End-to-end key latency tracer.
+ *
+ * @brief <b>End-to-end key latency tracer, from PS/2 stop bit to MSX column read. Header file of latency.c.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Each key event is timestamped with the 1MHz TIM_HR counter on all stages of the path:
+ * ps2_clock_receive() stop bit => ps2_recv_buffer => mount_scancode() => convert2msx() =>
+ * compute_x_bits_and_check_interrupt_stuck() => first MSX Y scan serving the new x_bits.
+ * Completed events are put on a small ring of records and accumulated on per stage histograms,
+ * which are shown by the console command "lat".
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined LATENCY_H
+#define LATENCY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "system.h"
+#include "hr_timer.h"
+#include "serial.h"
+
+
+/** Latency tracer sizes
+@{*/
+#define LATENCY_RING_SIZE         16          //Last events records. Must be a power of 2
+#define LATENCY_HIST_BUCKETS      32          //log2 buckets: bucket n counts from 2^n to 2^(n+1)-1 us
+#define LATENCY_NO_Y              0xFF        //latency_wait_y value when no Y scan is being waited
+/**@}*/
+
+/**
+ * Timestamps of a key event, on the 1MHz TIM_HR counter.
+ */
+struct latency_record
+{
+  uint32_t scan_code;
+  uint32_t t_stop, t_pulled, t_mounted, t_x_bits, t_served;
+  uint8_t y;
+};
+
+/**  Stages of the key path.
+ *
+ * @enum LATENCY_STAGE Each one is the time between two consecutive timestamps of a key event.*/
+enum LATENCY_STAGE{
+  LAT_STAGE_RING =                0,          //PS/2 stop bit => byte fetched from ps2_recv_buffer
+  LAT_STAGE_MOUNT,                            //byte fetched => mount_scancode() concluded
+  LAT_STAGE_CONVERT,                          //mount_scancode() concluded => x_bits updated
+  LAT_STAGE_Y_SCAN,                           //x_bits updated => MSX read this Y
+  LAT_STAGE_TOTAL,                            //PS/2 stop bit => MSX read this Y
+  LAT_NUM_STAGES,
+};
+
+/**
+ * @brief Y being waited by the tracer. Tested by the Y scan ISR's, that must call latency_y_served() on match.
+ */
+extern volatile uint8_t latency_wait_y;
+
+/**
+ * @brief Timestamps a PS/2 byte stop bit. Called from ps2_clock_receive().
+ *
+ * @param ring_idx Position of the byte on ps2_recv_buffer.
+ */
+void latency_byte_stop(uint8_t ring_idx);
+
+/**
+ * @brief Timestamps the fetch of a PS/2 byte from ps2_recv_buffer. Called from get_ps2_byte().
+ *
+ * @param ring_idx Position of the byte on ps2_recv_buffer.
+ */
+void latency_byte_pulled(uint8_t ring_idx);
+
+/**
+ * @brief Starts a new event record. Called when mount_scancode() concludes a scan code.
+ *
+ * @param scan_code Assembled scancode[4] as an uint32_t.
+ */
+void latency_scancode_mounted(uint32_t scan_code);
+
+/**
+ * @brief Timestamps the first x_bits update after a scan code. Called from compute_x_bits_and_check_interrupt_stuck().
+ *
+ * @param y Column updated.
+ */
+void latency_x_bits_updated(uint8_t y);
+
+/**
+ * @brief Timestamps the first MSX read of the waited Y. Called from Y scan ISR's.
+ */
+void latency_y_served(void);
+
+/**
+ * @brief Accumulates the concluded event on histograms. To be called from main loop.
+ */
+void latency_poll(void);
+
+/**
+ * @brief Console command "lat": prints min/avg/p99/max per stage. "lat reset" clears, "lat dump" prints the last records.
+ *
+ * @param args Rest of the command line.
+ */
+void latency_console_cmd(uint8_t *args);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined LATENCY_H
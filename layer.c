@@ -0,0 +1,197 @@
+/** @addtogroup 23 layer Alternate Layers
+ *
+ * @file layer.c Alternate layers of the Database, selected by the RUS/LAT and Kana LEDs.
+ *
+ * @brief <b>Alternate layers of the Database, selected by the RUS/LAT and Kana LEDs.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * The records of DB_EXT_LAYERS are packed on the payload bytes: {DB_LAYER_xxx << 4 | DB_LAYER_E0,
+ * make code byte, MSX key 0, MSX key 1 or 0xFF}. Records out of the format, and a second key of the
+ * same make code byte on a layer, are skipped.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#include <string.h>
+
+#include "layer.h"
+
+
+#define LAYER_KEY_RELEASE         0x08
+#define LAYER_KEY_NONE            0xFF
+#define LAYER_SOURCE_SHIFT        4
+#define LAYER_COL_CONTROL         3           //Columns of a Database line
+#define LAYER_COL_KEYS            4
+
+
+//Global vars
+uint8_t layer_lines[LAYER_SLOTS][2][DB_NUM_COLS]; //Make and break lines of each key
+uint8_t layer_slot[DB_LAYER_SOURCES][256];        //Slot plus 1 of each make code byte, or 0
+uint8_t layer_count;
+uint8_t layer_sources;                            //Bit n: DB_LAYER_xxx n has keys
+const uint8_t *layer_of_state[LAYER_STATES];
+extern uint8_t *base_of_database;                 //Declared on msxmap.cpp
+extern uint8_t y_dummy;                           //Declared on msxmap.cpp
+extern bool caps_state, kana_state;               //Declared on ps2handl.c
+
+//When the Database has no DB_EXT_LAYERS lines: what msx_dispatch() used to force with RUS/LAT on
+const uint8_t LAYER_DEFAULTS[][LAYER_RECORD_SIZE] =
+{
+  { DB_LAYER_RUSLAT << LAYER_SOURCE_SHIFT, 0x4C, 0x66, LAYER_KEY_NONE },
+  { DB_LAYER_RUSLAT << LAYER_SOURCE_SHIFT, 0x52, 0x74, LAYER_KEY_NONE },
+  { DB_LAYER_RUSLAT << LAYER_SOURCE_SHIFT, 0x41, 0x42, LAYER_KEY_NONE },
+  { DB_LAYER_RUSLAT << LAYER_SOURCE_SHIFT, 0x49, 0x40, LAYER_KEY_NONE },
+};
+
+
+//Local prototypes
+const uint8_t* layer_find_ext(uint8_t type);
+void layer_add(const uint8_t *record);
+
+
+//Header line of an extension of the Database, or NULL
+const uint8_t* layer_find_ext(uint8_t type)
+{
+  const uint8_t *p;
+
+  for(uint16_t line = 1; line < N_DATABASE_REGISTERS - 1; line++)
+  {
+    p = base_of_database + line * DB_NUM_COLS;
+    if( (p[0] != DB_EXT_MARK) || (p[1] != DB_EXT_TAG) )
+      continue;
+    if(p[2] == type)
+      return p;
+    line += p[5];
+  }
+  return NULL;
+}
+
+
+void layer_add(const uint8_t *record)
+{
+  uint8_t source = record[0] >> LAYER_SOURCE_SHIFT, code = record[1], *make, *brk;
+  bool e0 = (record[0] & DB_LAYER_E0) != 0;
+
+  if( (layer_count >= LAYER_SLOTS) || (source >= DB_LAYER_SOURCES) || (record[0] & 0x0F & ~DB_LAYER_E0) ||
+      !code || (code >= 0xE0) || layer_slot[source][code] )
+    return;
+  for(uint8_t k = 0; k < LAYER_MSX_KEYS; k++)
+    if( (record[2 + k] != LAYER_KEY_NONE) && (record[2 + k] & LAYER_KEY_RELEASE) )
+      return;
+  if(record[2] == LAYER_KEY_NONE)
+    return;
+  //Lines coded as mount_scancode() assembles the make and the break
+  make = layer_lines[layer_count][0];
+  brk = layer_lines[layer_count][1];
+  make[0] = e0 ? 0xE0 : code;
+  make[1] = e0 ? code : 0;
+  make[2] = 0;
+  brk[0] = e0 ? 0xE0 : 0xF0;
+  brk[1] = e0 ? 0xF0 : code;
+  brk[2] = e0 ? code : 0;
+  make[LAYER_COL_CONTROL] = brk[LAYER_COL_CONTROL] = LAYER_CONTROL;
+  for(uint8_t k = 0; k < DB_NUM_COLS - LAYER_COL_KEYS; k++)
+  {
+    uint8_t key = (k < LAYER_MSX_KEYS) ? record[2 + k] : LAYER_KEY_NONE;
+    if(key == LAYER_KEY_NONE)
+      make[LAYER_COL_KEYS + k] = brk[LAYER_COL_KEYS + k] = (uint8_t)((y_dummy << 4) | 0x0F);
+    else
+    {
+      make[LAYER_COL_KEYS + k] = key;
+      brk[LAYER_COL_KEYS + k] = key | LAYER_KEY_RELEASE;
+    }
+  }
+  layer_slot[source][code] = ++layer_count;
+  layer_sources |= (uint8_t)(1 << source);
+}
+
+
+void layer_setup(void)
+{
+  const uint8_t *p, *records;
+  uint8_t r[LAYER_RECORD_SIZE];
+
+  memset(layer_slot, 0, sizeof(layer_slot));
+  layer_count = 0;
+  layer_sources = 0;
+  p = layer_find_ext(DB_EXT_LAYERS);
+  if(p && (p[4] == LAYER_RECORD_SIZE))
+  {
+    records = p + DB_NUM_COLS;
+    for(uint8_t i = 0; i < p[3]; i++)
+    {
+      for(uint8_t j = 0; j < LAYER_RECORD_SIZE; j++)
+      {
+        uint16_t k = (uint16_t)(LAYER_RECORD_SIZE * i + j);
+        r[j] = records[(k / DB_EXT_PAYLOAD_COLS) * DB_NUM_COLS + 1 + k % DB_EXT_PAYLOAD_COLS];
+      }
+      layer_add(r);
+    }
+  }
+  else
+    for(uint8_t i = 0; i < sizeof(LAYER_DEFAULTS) / sizeof(LAYER_DEFAULTS[0]); i++)
+      layer_add(LAYER_DEFAULTS[i]);
+  //The first source lit, with keys, wins
+  for(uint8_t state = 0; state < LAYER_STATES; state++)
+  {
+    layer_of_state[state] = NULL;
+    for(uint8_t source = 0; source < DB_LAYER_SOURCES; source++)
+      if(state & layer_sources & (1 << source))
+      {
+        layer_of_state[state] = layer_slot[source];
+        break;
+      }
+  }
+}
+
+
+const uint8_t* layer_lookup(const volatile uint8_t *scancode)
+{
+  const uint8_t *table = layer_of_state[(caps_state ? 1 << DB_LAYER_RUSLAT : 0) | (!kana_state ? 1 << DB_LAYER_KANA : 0)];
+  const uint8_t *line;
+  uint8_t len = scancode[0], slot;
+  bool release;
+
+  if( !table || !len || (len > 3) )
+    return NULL;
+  slot = table[scancode[len]];
+  if(!slot)
+    return NULL;
+  release = (len >= 2) && (scancode[len - 1] == 0xF0);
+  line = layer_lines[slot - 1][release ? 1 : 0];
+  //The whole scan code: E0 prefixed or not, as its record
+  for(uint8_t i = 0; i < 3; i++)
+    if(line[i] != ((i < len) ? scancode[1 + i] : 0))
+      return NULL;
+  return line;
+}
@@ -0,0 +1,99 @@
+/** @defgroup 23 layer Alternate Layers
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file layer.h Alternate layers of the Database, selected by the RUS/LAT and Kana LEDs.
+ *
+ * @brief <b>Alternate layers of the Database, selected by the RUS/LAT and Kana LEDs. Header file of layer.c.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * A layer overrides keys of the Database while its LED is lit: RUS/LAT (caps_state high) or Kana
+ * (kana_state low, as the Kana LED is active low), as sampled by mount_scancode(). The keys are loaded from the DB_EXT_LAYERS extension
+ * lines of the Database (host/db-compiler "[layers]" section), or from a built-in RUS/LAT table
+ * (the keys msx_dispatch() used to force) when the Database has none.
+ *
+ * Each key gets a make and a break Database line on RAM, built on setup. An event costs one load of
+ * the table of the LED state and one load of its make code byte slot: no Database search, and nothing
+ * at all while no LED selects a layer. When both LEDs are lit, the RUS/LAT layer is the one used.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined LAYER_H
+#define LAYER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "system.h"
+
+
+/** Layer sizes and coding
+@{*/
+#define LAYER_SLOTS               16          //Keys of all layers
+#define LAYER_RECORD_SIZE         4
+#define LAYER_MSX_KEYS            2           //Columns 4 and 5 of its lines
+#define LAYER_STATES              (1 << DB_LAYER_SOURCES)   //LED states: bit n is DB_LAYER_xxx n
+#define LAYER_CONTROL             0xF4        //Case 0, no combined shift, no autofire
+/**@}*/
+
+/**
+ * @brief Table of the LED state: slot plus 1 of each make code byte, or 0. NULL if no layer is selected.
+ */
+extern const uint8_t *layer_of_state[LAYER_STATES];
+
+/**
+ * @brief Loads the layers of the Database on base_of_database, or the built-in ones, and builds their lines.
+ *
+ * To be called after database_setup(), and each time base_of_database or its y_dummy changes.
+ */
+void layer_setup(void);
+
+/**
+ * @brief Database line of a layer selected by the LEDs, for a mounted scan code.
+ *
+ * @param scancode Mounted scan code: scancode[0] is the quantity of bytes.
+ * @return The line (make or break of the key), as msx_dispatch() takes it, or NULL.
+ */
+const uint8_t* layer_lookup(const volatile uint8_t *scancode);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined LAYER_H
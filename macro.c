@@ -0,0 +1,532 @@
+/** @addtogroup 21 macro Macro Recorder
+ *
+ * @file macro.c MSX key macros: recorded from the matrix updates, played at the pace of the MSX scan.
+ *
+ * @brief <b>MSX key macros: recorded from the matrix updates, played at the pace of the MSX scan.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#include <string.h>
+
+#include "macro.h"
+#include "console.h"
+#include "dbasemgt.h"
+#include "main_events.h"
+
+
+#define MACRO_NO_SLOT             0
+#define MACRO_REC_GAP_MAX         (4 * MACRO_DELAY_MAX) //Longer gaps are recorded as 2s
+#define MACRO_HEX_PER_LINE        16
+
+
+//Global vars
+uint8_t macro_slots[MACRO_SLOTS][MACRO_SIZE];
+uint8_t macro_len[MACRO_SLOTS];
+bool macro_changed[MACRO_SLOTS];                  //Since it was loaded or saved
+volatile uint8_t macro_unread;
+uint8_t macro_rec_slot = MACRO_NO_SLOT;
+bool macro_rec_delays;
+uint32_t macro_rec_systicks;                      //Of the last key recorded
+uint8_t macro_rec_pressed[MACRO_MAX_Y + 1];       //Keys pressed since the recording start: X bits, bit 0 for Y8 to Y10
+const uint8_t *macro_play_pos, *macro_play_end;   //macro_play_pos is NULL when not playing
+uint8_t macro_play_pressed[MACRO_MAX_Y + 1];
+uint8_t macro_tap_release;                        //Release of the tap being played, or MACRO_NONE
+uint32_t macro_step_systicks;                     //Of the last key played, or of the end of the last delay
+uint8_t macro_delay;                              //SysTicks to wait before the next byte
+extern uint32_t systicks;                         //Declared on sys_timer.cpp
+
+
+//Local prototypes
+uint8_t macro_key_bit(uint8_t key);
+bool macro_rec_put(uint8_t code);
+bool macro_rec_gap(void);
+bool macro_parse_slot(uint8_t *word, uint8_t *slot);
+void macro_list(void);
+#if MCU == STM32F401
+uint32_t macro_store_check(const uint8_t *record, bool *valid);
+void macro_store_found(const uint8_t *record, void *ctx);
+void macro_save(void);
+bool macro_load(void);
+#endif  //#if MCU == STM32F401
+
+
+#if MCU == STM32F401
+const flash_log_t macro_store = {MACRO_STORE_ADDR, MACRO_STORE_SIZE, MACRO_STORE_TAG0, MACRO_STORE_TAG1, macro_store_check};
+#endif  //#if MCU == STM32F401
+
+
+//Bit of the key on macro_rec_pressed[] and macro_play_pressed[] of its Y
+uint8_t macro_key_bit(uint8_t key)
+{
+  return ((key >> 4) < 8) ? (uint8_t)(1 << (key & 0x07)) : 1;
+}
+
+
+void macro_setup(void)
+{
+  memset(macro_len, 0, sizeof(macro_len));
+  memset(macro_changed, 0, sizeof(macro_changed));
+  macro_stop();
+#if MCU == STM32F401
+  macro_load();
+#endif  //#if MCU == STM32F401
+}
+
+
+bool macro_rec_put(uint8_t code)
+{
+  uint8_t s = macro_rec_slot - 1;
+
+  if(macro_len[s] >= MACRO_SIZE)
+  {
+    con_send_string((uint8_t*)"Macro is full: recording stopped.\r\n");
+    macro_record_stop();
+    return false;
+  }
+  macro_slots[s][macro_len[s]++] = code;
+  return true;
+}
+
+
+//Records the time since the last key. Returns false if the macro got full
+bool macro_rec_gap(void)
+{
+  uint32_t gap = systicks - macro_rec_systicks;
+
+  macro_rec_systicks = systicks;
+  if(!macro_rec_delays || !macro_len[macro_rec_slot - 1])
+    return true;
+  if(gap > MACRO_REC_GAP_MAX)
+    gap = MACRO_REC_GAP_MAX;
+  while(gap)
+  {
+    uint8_t d = (gap > MACRO_DELAY_MAX) ? MACRO_DELAY_MAX : (uint8_t)gap;
+    if(!macro_rec_put((uint8_t)(MACRO_DELAY + d - 1)))
+      return false;
+    gap -= d;
+  }
+  return true;
+}
+
+
+void macro_record_start(uint8_t slot, bool delays)
+{
+  uint8_t text[12];
+
+  if(macro_play_pos)
+  {
+    con_send_string((uint8_t*)"A macro is playing: not recording.\r\n");
+    return;
+  }
+  macro_rec_slot = slot;
+  macro_rec_delays = delays;
+  macro_rec_systicks = systicks;
+  macro_len[slot - 1] = 0;
+  macro_changed[slot - 1] = true;
+  memset(macro_rec_pressed, 0, sizeof(macro_rec_pressed));
+  con_send_string((uint8_t*)"Recording macro ");
+  conv_uint32_to_dec(slot, text);
+  con_send_string(text);
+  con_send_string((uint8_t*)".\r\n");
+}
+
+
+void macro_record_stop(void)
+{
+  uint8_t s, code, text[12];
+
+  if(macro_rec_slot == MACRO_NO_SLOT)
+    return;
+  s = macro_rec_slot - 1;
+  macro_rec_slot = MACRO_NO_SLOT;
+  //The last presses are the modifiers held to stop it: the player releases what is left pressed anyway
+  while(macro_len[s])
+  {
+    code = macro_slots[s][macro_len[s] - 1];
+    if( (code < MACRO_TAP) && (code & MACRO_KEY_RELEASE) )
+      break;
+    if( (code >= MACRO_TAP) && (code < MACRO_DELAY) )
+      break;
+    macro_len[s]--;
+  }
+  con_send_string((uint8_t*)"Macro ");
+  conv_uint32_to_dec(s + 1, text);
+  con_send_string(text);
+  con_send_string((uint8_t*)": ");
+  conv_uint32_to_dec(macro_len[s], text);
+  con_send_string(text);
+  con_send_string((uint8_t*)" bytes.\r\n");
+}
+
+
+uint8_t macro_recording(void)
+{
+  return macro_rec_slot;
+}
+
+
+void macro_record_key(uint8_t key)
+{
+  uint8_t y = key >> 4, bit, s, *last;
+
+  if( (macro_rec_slot == MACRO_NO_SLOT) || macro_play_pos || (y > MACRO_MAX_Y) )
+    return;
+  bit = macro_key_bit(key);
+  if(key & MACRO_KEY_RELEASE)
+  {
+    //Keys pressed before the recording are left out
+    if(!(macro_rec_pressed[y] & bit))
+      return;
+    macro_rec_pressed[y] &= (uint8_t)~bit;
+  }
+  else
+  {
+    //Typematic repeats, or a second PS/2 key holding it
+    if(macro_rec_pressed[y] & bit)
+      return;
+    macro_rec_pressed[y] |= bit;
+  }
+  s = macro_rec_slot - 1;
+  if(!macro_rec_gap())
+    return;
+  //A release right after its press makes a tap
+  if( (key & MACRO_KEY_RELEASE) && (y < 8) && macro_len[s] )
+  {
+    last = &macro_slots[s][macro_len[s] - 1];
+    if(*last == (key & (uint8_t)~MACRO_KEY_RELEASE))
+    {
+      *last = (uint8_t)(MACRO_TAP + ((y << 3) | (key & 0x07)));
+      return;
+    }
+  }
+  macro_rec_put(key);
+}
+
+
+bool macro_play(const uint8_t *macro, uint16_t len)
+{
+  if(macro_rec_slot != MACRO_NO_SLOT)
+    return false;
+  //The keys a former macro left pressed are released at the end of this one
+  macro_play_pos = macro;
+  macro_play_end = macro + len;
+  macro_tap_release = MACRO_NONE;
+  macro_delay = 0;
+  macro_step_systicks = systicks;
+  main_event_set(EVT_MACRO);
+  return true;
+}
+
+
+void macro_play_slot(uint8_t slot)
+{
+  if(!macro_play(macro_slots[slot - 1], macro_len[slot - 1]))
+    con_send_string((uint8_t*)"Recording a macro: not playing.\r\n");
+}
+
+
+void macro_stop(void)
+{
+  macro_rec_slot = MACRO_NO_SLOT;
+  macro_play_pos = NULL;
+  macro_unread = 0;
+  memset(macro_play_pressed, 0, sizeof(macro_play_pressed));
+}
+
+
+bool macro_playing(void)
+{
+  return macro_play_pos != NULL;
+}
+
+
+uint8_t macro_next(void)
+{
+  uint8_t code, y, bit;
+
+  if(!macro_play_pos)
+    return MACRO_NONE;
+  if(macro_unread)
+  {
+    //MSX is not scanning: go on at SysTick pace
+    if(systicks - macro_step_systicks < MACRO_SCAN_TIMEOUT_SYSTICKS)
+      return MACRO_NONE;
+    macro_unread = 0;
+  }
+  if(macro_tap_release != MACRO_NONE)
+  {
+    code = macro_tap_release;
+    macro_tap_release = MACRO_NONE;
+    macro_play_pressed[code >> 4] &= (uint8_t)~macro_key_bit(code);
+    return code;
+  }
+  if(macro_delay)
+  {
+    if(systicks - macro_step_systicks < macro_delay)
+      return MACRO_NONE;
+    macro_delay = 0;
+  }
+  while(macro_play_pos < macro_play_end)
+  {
+    code = *macro_play_pos++;
+    if(code >= MACRO_DELAY)
+    {
+      if(code == MACRO_NONE)
+        continue;
+      macro_delay = (uint8_t)(code - MACRO_DELAY + 1);
+      macro_step_systicks = systicks;
+      return MACRO_NONE;
+    }
+    if(code >= MACRO_TAP)
+    {
+      code -= MACRO_TAP;
+      code = (uint8_t)(((code >> 3) << 4) | (code & 0x07));
+      macro_tap_release = code | MACRO_KEY_RELEASE;
+    }
+    y = code >> 4;
+    if(y > MACRO_MAX_Y)
+      continue;
+    bit = macro_key_bit(code);
+    if(code & MACRO_KEY_RELEASE)
+      macro_play_pressed[y] &= (uint8_t)~bit;
+    else
+      macro_play_pressed[y] |= bit;
+    return code;
+  }
+  //End: release the keys left pressed, one at a time
+  for(y = 0; y <= MACRO_MAX_Y; y++)
+  {
+    if(!macro_play_pressed[y])
+      continue;
+    bit = macro_play_pressed[y] & (uint8_t)-macro_play_pressed[y];
+    macro_play_pressed[y] &= (uint8_t)~bit;
+    return (uint8_t)((y << 4) | MACRO_KEY_RELEASE | ((y < 8) ? __builtin_ctz(bit) : 0));
+  }
+  macro_play_pos = NULL;
+  return MACRO_NONE;
+}
+
+
+void macro_played(void)
+{
+  macro_step_systicks = systicks;
+  macro_unread = MACRO_ALL_COLUMNS;
+}
+
+
+void macro_y_served(uint8_t y)
+{
+  if(y > 7)
+    return;
+  macro_unread &= (uint8_t)~(1 << y);
+  if(!macro_unread)
+    main_event_set(EVT_MACRO);
+}
+
+
+bool macro_parse_slot(uint8_t *word, uint8_t *slot)
+{
+  uint32_t value;
+
+  if( !console_word_to_uint32(word, &value) || (value < 1) || (value > MACRO_SLOTS) )
+  {
+    con_send_string((uint8_t*)"Slot must be 1 to 4.\r\n");
+    return false;
+  }
+  *slot = (uint8_t)value;
+  return true;
+}
+
+
+void macro_list(void)
+{
+  uint8_t text[3 * MACRO_HEX_PER_LINE + 3];
+
+  for(uint8_t s = 0; s < MACRO_SLOTS; s++)
+  {
+    conv_uint32_to_dec(s + 1, text);
+    con_send_string(text);
+    con_send_string((uint8_t*)": ");
+    conv_uint32_to_dec(macro_len[s], text);
+    con_send_string(text);
+    con_send_string((uint8_t*)" bytes");
+    if(macro_rec_slot == s + 1)
+      con_send_string((uint8_t*)", recording");
+    else if(macro_changed[s])
+      con_send_string((uint8_t*)", not saved");
+    con_send_string((uint8_t*)"\r\n");
+    for(uint8_t i = 0; i < macro_len[s]; i += MACRO_HEX_PER_LINE)
+    {
+      uint8_t *pos = text;
+      for(uint8_t c = i; (c < macro_len[s]) && (c < i + MACRO_HEX_PER_LINE); c++)
+      {
+        *pos++ = ' ';
+        conv_uint8_to_2a_hex(macro_slots[s][c], pos);
+        pos += 2;
+      }
+      *pos++ = '\r';
+      *pos++ = '\n';
+      *pos = 0;
+      con_send_string(text);
+    }
+  }
+}
+
+
+#if MCU == STM32F401
+uint32_t macro_store_check(const uint8_t *record, bool *valid)
+{
+  uint8_t sum = record[2] + record[3] + record[4];
+
+  if(record[3] > MACRO_SIZE)
+    return 0;
+  for(uint8_t i = 0; i < record[3]; i++)
+    sum += record[DB_NUM_COLS + i];
+  *valid = (sum == 0) && (record[2] >= 1) && (record[2] <= MACRO_SLOTS);
+  return DB_NUM_COLS + (((uint32_t)record[3] + DB_NUM_COLS - 1) & ~(uint32_t)(DB_NUM_COLS - 1));
+}
+
+
+//ctx is the array of the last record of each slot
+void macro_store_found(const uint8_t *record, void *ctx)
+{
+  ((const uint8_t**)ctx)[record[2] - 1] = record;
+}
+
+
+bool macro_load(void)
+{
+  const uint8_t *last[MACRO_SLOTS] = {NULL};
+  bool found = false;
+
+  flash_log_scan(&macro_store, macro_store_found, last);
+  for(uint8_t s = 0; s < MACRO_SLOTS; s++)
+  {
+    if(!last[s])
+      continue;
+    macro_len[s] = last[s][3];
+    memcpy(macro_slots[s], last[s] + DB_NUM_COLS, macro_len[s]);
+    macro_changed[s] = false;
+    found = true;
+  }
+  return found;
+}
+
+
+void macro_save(void)
+{
+  uint8_t header[DB_NUM_COLS], sum;
+
+  for(uint8_t s = 0; s < MACRO_SLOTS; s++)
+  {
+    if(!macro_changed[s] || (macro_rec_slot == s + 1))
+      continue;
+    sum = (uint8_t)(s + 1) + macro_len[s];
+    for(uint8_t i = 0; i < macro_len[s]; i++)
+      sum += macro_slots[s][i];
+    memset(header, 0xFF, sizeof(header));
+    header[0] = MACRO_STORE_TAG0;
+    header[1] = MACRO_STORE_TAG1;
+    header[2] = (uint8_t)(s + 1);
+    header[3] = macro_len[s];
+    header[4] = (uint8_t)(0 - sum);
+    switch(flash_log_append(&macro_store, header, macro_slots[s], macro_len[s]))
+    {
+    case FLASH_LOG_OK:
+      break;
+    case FLASH_LOG_FULL:
+      con_send_string((uint8_t*)"Macro store is full: it is erased with the sector, on the next Database update.\r\n");
+      return;
+    default:
+      con_send_string((uint8_t*)"Flash write error.\r\n");
+      return;
+    }
+    macro_changed[s] = false;
+  }
+  con_send_string((uint8_t*)"Macros saved.\r\n");
+}
+#endif  //#if MCU == STM32F401
+
+
+void macro_console_cmd(uint8_t *args)
+{
+  uint8_t *word = console_next_word(&args);
+  uint8_t slot;
+
+  if(!*word)
+  {
+    macro_list();
+    return;
+  }
+  if(strcmp((const char*)word, "stop") == 0)
+  {
+    macro_record_stop();
+    return;
+  }
+  if( (strcmp((const char*)word, "save") == 0) || (strcmp((const char*)word, "load") == 0) )
+  {
+#if MCU == STM32F401
+    if(macro_rec_slot != MACRO_NO_SLOT)
+      con_send_string((uint8_t*)"Recording a macro: stop it first.\r\n");
+    else if(word[0] == 's')
+      macro_save();
+    else if(!macro_load())
+      con_send_string((uint8_t*)"No macros saved.\r\n");
+#else   //#if MCU == STM32F401
+    con_send_string((uint8_t*)"No flash room for macros on this MCU: they last until power off.\r\n");
+#endif  //#if MCU == STM32F401
+    return;
+  }
+  if( (strcmp((const char*)word, "rec") != 0) && (strcmp((const char*)word, "play") != 0) &&
+      (strcmp((const char*)word, "clear") != 0) )
+  {
+    con_send_string((uint8_t*)"Usage: macro [rec n [delays]|stop|play n|clear n|save|load]\r\n");
+    return;
+  }
+  if(!macro_parse_slot(console_next_word(&args), &slot))
+    return;
+  if(word[0] == 'r')
+  {
+    macro_record_stop();
+    macro_record_start(slot, strcmp((const char*)console_next_word(&args), "delays") == 0);
+  }
+  else if(word[0] == 'p')
+    macro_play_slot(slot);
+  else if(macro_rec_slot != slot)
+  {
+    macro_len[slot - 1] = 0;
+    macro_changed[slot - 1] = true;
+  }
+}
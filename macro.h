@@ -0,0 +1,190 @@
+/** @defgroup 21 macro Macro Recorder
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file macro.h MSX key macros: recorded from the matrix updates, played at the pace of the MSX scan.
+ *
+ * @brief <b>MSX key macros: recorded from the matrix updates, played at the pace of the MSX scan. Header file of macro.c.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * A macro is a byte string: MSX keys coded as the Database (Y on bits 7-4, release on bit 3, X on
+ * bits 2-0, Y from 0 to MACRO_MAX_Y), MACRO_TAP + (Y << 3 | X) for a press and release of a key of
+ * Y0 to Y7, and MACRO_DELAY + n for a wait of n + 1 SysTicks. Recording keeps the MSX keys changed
+ * on compute_x_bits_and_check_interrupt_stuck(), with the delays between them if asked.
+ *
+ * The player does not follow the SysTick queue: after each key, the Y scan ISR's clear the columns
+ * MSX read on macro_unread, and the next key goes when the whole matrix (Y0 to Y7) was read once.
+ * So each press and each release is seen by one complete MSX scan (a tap takes two), and a key is
+ * never seen with a modifier state of the former one. If MSX stops scanning, the player goes on
+ * after MACRO_SCAN_TIMEOUT_SYSTICKS. The keys a macro leaves pressed are released at its end.
+ *
+ * On STM32F401, "macro save" appends the changed slots as records on MACRO_STORE_ADDR, and the
+ * last record of each slot is loaded on boot:
+ * - Header line: 'M', 'C', slot, length, checksum (slot plus length plus all bytes plus it sum 0), 0xFF x 3;
+ * - The macro bytes, padded with 0xFF to a multiple of 8.
+ * The room is erased with the sector, when a Database update finds no free image place.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined MACRO_H
+#define MACRO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "system.h"
+
+
+/** Macro sizes and coding
+@{*/
+#define MACRO_SLOTS               4           //Numbered 1 to MACRO_SLOTS on console and chords
+#define MACRO_SIZE                120         //Bytes of a slot: with its header, a store record takes 16 lines at most
+#define MACRO_MAX_Y               10          //Y8 to Y10 are the CTRL, SHIFT and RUS/LAT lines
+#define MACRO_KEY_RELEASE         0x08
+#define MACRO_TAP                 0xB0        //Up to 0xEF: press and release of Y0X0 to Y7X7
+#define MACRO_DELAY               0xF0        //Up to 0xFE: 1 to 15 SysTicks
+#define MACRO_DELAY_MAX           15
+#define MACRO_NONE                0xFF        //macro_next(): nothing to dispatch now. Erased flash on a macro
+#define MACRO_ALL_COLUMNS         0xFF        //macro_unread after a key: Y0 to Y7
+#define MACRO_SCAN_TIMEOUT_SYSTICKS 4         //As MAX_TIME_OF_IDLE_KEYSCAN_SYSTICKS of msxmap.cpp
+#define MACRO_REC_DELAYS          0x80        //Argument of DB_CHORD_ACT_MACRO_REC: keep the delays between keys
+#define MACRO_STORE_TAG0          'M'
+#define MACRO_STORE_TAG1          'C'
+/**@}*/
+
+/**
+ * @brief Columns not read by MSX since the last key played. When it is not zero, the Y scan ISR's call
+ * macro_y_served() (through msx_y_served() of msxmap.cpp).
+ */
+extern volatile uint8_t macro_unread;
+
+/**
+ * @brief Clears the slots and, on STM32F401, loads the last records saved on flash.
+ */
+void macro_setup(void);
+
+/**
+ * @brief Starts recording a slot, that is cleared. Refused while a macro is played.
+ *
+ * @param slot 1 to MACRO_SLOTS.
+ * @param delays Keep the delays between keys. Otherwise, the macro is played as fast as MSX scans.
+ */
+void macro_record_start(uint8_t slot, bool delays);
+
+/**
+ * @brief Stops recording. The last presses (as the modifiers of the chord that stops it) are dropped.
+ */
+void macro_record_stop(void);
+
+/**
+ * @brief Slot being recorded.
+ *
+ * @return 1 to MACRO_SLOTS, or 0 if not recording.
+ */
+uint8_t macro_recording(void);
+
+/**
+ * @brief Records a MSX key update. Called from compute_x_bits_and_check_interrupt_stuck().
+ *
+ * @param key MSX key coded as the Database: Y on bits 7-4, release on bit 3, X on bits 2-0.
+ */
+void macro_record_key(uint8_t key);
+
+/**
+ * @brief Starts playing a macro. Refused while recording.
+ *
+ * @param macro The macro bytes. They must last until its end.
+ * @param len Quantity of bytes.
+ * @return false if refused.
+ */
+bool macro_play(const uint8_t *macro, uint16_t len);
+
+/**
+ * @brief Starts playing a slot, as macro_play().
+ *
+ * @param slot 1 to MACRO_SLOTS.
+ */
+void macro_play_slot(uint8_t slot);
+
+/**
+ * @brief Stops recording and playing, when all MSX keys are released.
+ */
+void macro_stop(void);
+
+/**
+ * @brief Tells if a macro is being played.
+ *
+ * @return true until its last key was read by MSX.
+ */
+bool macro_playing(void);
+
+/**
+ * @brief Next MSX key of the macro being played, once MSX read the former one. To be called from main loop, on
+ * EVT_MACRO and EVT_SYSTICK, until it returns MACRO_NONE.
+ *
+ * @return The MSX key, as macro_record_key(), or MACRO_NONE.
+ */
+uint8_t macro_next(void);
+
+/**
+ * @brief Starts waiting the MSX reads of a key returned by macro_next(), after it was put on x_bits.
+ */
+void macro_played(void);
+
+/**
+ * @brief Clears a column read by MSX from macro_unread, and wakes up the main loop when all were read. Called from
+ * the Y scan ISR's.
+ *
+ * @param y Column read (16 is all columns).
+ */
+void macro_y_served(uint8_t y);
+
+/**
+ * @brief Console command "macro": lists the slots; "rec n [delays]", "stop", "play n", "clear n", "save" (on flash)
+ * or "load" (from flash).
+ *
+ * @param args Rest of the command line.
+ */
+void macro_console_cmd(uint8_t *args);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined MACRO_H
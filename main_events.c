@@ -0,0 +1,141 @@
+/** @addtogroup 13 main_events Main Loop Events
+ *
+ * @file main_events.c Wake up events of the main loop.
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+#include "main_events.h"
+#include "console.h"
+
+
+const char *const main_event_names[EVT_NUM_SOURCES] =
+{
+  "PS/2   ",
+  "con RX ",
+  "USB    ",
+  "systick",
+  "leds   ",
+  "macro  ",
+  "turbo  ",
+  "shift  ",
+};
+
+
+//Global vars
+volatile uint32_t main_events;
+uint32_t main_event_counts[EVT_NUM_SOURCES];
+uint32_t main_event_wakeups, main_event_wakeups_empty;
+uint64_t main_event_sleep_cycles;
+uint32_t main_event_systicks_start;
+extern uint32_t systicks;                         //Declared on sys_timer.cpp
+
+
+void main_events_setup(void)
+{
+  dwt_enable_cycle_counter();
+  main_event_systicks_start = systicks;
+}
+
+
+void main_event_set(uint32_t events)
+{
+  //LDREX/STREX: ISR's of different priorities may raise events at the same time
+  __atomic_fetch_or(&main_events, events, __ATOMIC_RELAXED);
+}
+
+
+uint32_t main_event_wait(void)
+{
+  uint32_t events, start;
+
+  for(;;)
+  {
+    //With interrupts masked, an event raised after the test still wakes WFI up, and its ISR runs
+    //just after cm_enable_interrupts().
+    cm_disable_interrupts();
+    if(!main_events)
+    {
+      start = dwt_read_cycle_counter();
+      __asm("wfi");
+      main_event_sleep_cycles += dwt_read_cycle_counter() - start;
+      main_event_wakeups++;
+    }
+    cm_enable_interrupts();
+    events = __atomic_exchange_n(&main_events, 0, __ATOMIC_RELAXED);
+    if(events)
+      break;
+    main_event_wakeups_empty++;   //Waken up by an ISR without event to the main loop (MSX Y scan)
+  }
+  for(uint8_t i = 0; i < EVT_NUM_SOURCES; i++)
+    if(events & (1 << i))
+      main_event_counts[i]++;
+  return events;
+}
+
+
+void main_events_console_cmd(uint8_t *args)
+{
+  uint8_t *word = console_next_word(&args);
+  uint8_t mountstring[16];
+  uint64_t total_cycles;
+
+  if(strcmp((const char*)word, "reset") == 0)
+  {
+    cm_disable_interrupts();
+    main_event_sleep_cycles = 0;
+    main_event_wakeups = 0;
+    main_event_wakeups_empty = 0;
+    for(uint8_t i = 0; i < EVT_NUM_SOURCES; i++)
+      main_event_counts[i] = 0;
+    main_event_systicks_start = systicks;
+    cm_enable_interrupts();
+    con_send_string((uint8_t*)"Idle statistics cleared.\r\n");
+    return;
+  }
+
+  total_cycles = (uint64_t)(systicks - main_event_systicks_start) * (rcc_ahb_frequency / FREQ_INT_SYSTICK);
+  con_send_string((uint8_t*)"Sleeping: ");
+  conv_uint32_to_dec(total_cycles ? (uint32_t)((main_event_sleep_cycles * 1000) / total_cycles) : 0, mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)" per mil of ");
+  conv_uint32_to_dec(systicks - main_event_systicks_start, mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)" ticks\r\nWake ups: ");
+  conv_uint32_to_dec(main_event_wakeups, mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)" (");
+  conv_uint32_to_dec(main_event_wakeups_empty, mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)" without event)\r\n");
+  for(uint8_t i = 0; i < EVT_NUM_SOURCES; i++)
+  {
+    con_send_string((uint8_t*)"  ");
+    con_send_string((uint8_t*)main_event_names[i]);
+    con_send_string((uint8_t*)" ");
+    conv_uint32_to_dec(main_event_counts[i], mountstring);
+    con_send_string(mountstring);
+    con_send_string((uint8_t*)"\r\n");
+  }
+}
@@ -0,0 +1,108 @@
+/** @defgroup 13 main_events Main Loop Events
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file main_events.h Wake up events of the main loop.
+ *
+ * @brief <b>Wake up events of the main loop. Header file of main_events.c.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * The ISR's raise event flags, and the main loop sleeps (WFI) while there is none pending, so it
+ * does not compete for the bus with the MSX Y scan ISR's. The sleep time is measured with the DWT
+ * cycle counter and shown by the console command "idle".
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined MAIN_EVENTS_H
+#define MAIN_EVENTS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+
+#include "system.h"
+#include "serial.h"
+
+
+/** Main loop wake up sources
+@{*/
+#define EVT_PS2                   (1 << 0)    //PS/2 frame received (byte or command answer)
+#define EVT_CON_RX                (1 << 1)    //Console input available
+#define EVT_USB                   (1 << 2)    //USB configuration changed
+#define EVT_SYSTICK               (1 << 3)    //Housekeeping: timeouts, keep alive, led test, MSX led pins
+#define EVT_LEDS                  (1 << 4)    //PS/2 keyboard leds must be updated
+#define EVT_MACRO                 (1 << 5)    //MSX read the whole matrix since the last macro key
+#define EVT_AUTOFIRE              (1 << 6)    //MSX read the column of a held autofire key
+#define EVT_SHIFT_SEQ             (1 << 7)    //MSX read what the last smooth typing key waited for
+#define EVT_NUM_SOURCES           8
+/**@}*/
+
+
+/**
+ * @brief Starts the DWT cycle counter, used to measure the sleep time.
+ */
+void main_events_setup(void);
+
+/**
+ * @brief Raises events to the main loop. It may be called from ISR's of any priority.
+ *
+ * @param events OR of EVT_xxx.
+ */
+void main_event_set(uint32_t events);
+
+/**
+ * @brief Sleeps (WFI) until at least one event is raised.
+ *
+ * @return Raised events, that are cleared.
+ */
+uint32_t main_event_wait(void);
+
+/**
+ * @brief Console command "idle": prints sleep ratio and wake ups per source.
+ *
+ * @param args "reset" clears the statistics.
+ */
+void main_events_console_cmd(uint8_t *args);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined MAIN_EVENTS_H
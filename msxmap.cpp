@@ -45,6 +45,22 @@
 //Use Tab width=2
 
 #include "msxmap.h"
+#include "main_events.h"
+#if LATENCY_TRACE == true
+#include "latency.h"
+#endif  //#if LATENCY_TRACE == true
+#if DB_REMAP == true
+#include "remap.h"
+#endif  //#if DB_REMAP == true
+#if CHORDS == true
+#include "chord.h"
+#endif  //#if CHORDS == true
+#if LAYERS == true
+#include "layer.h"
+#endif  //#if LAYERS == true
+#if USB_TELEMETRY == true
+#include "telemetry.h"
+#endif  //#if USB_TELEMETRY == true
 
 
 #define MAX_TIME_OF_IDLE_KEYSCAN_SYSTICKS 4   //30 / 4 = 7.5 times per second is the maximum sweep speed
@@ -75,6 +91,7 @@
 uint8_t* base_of_database;
 extern uint32_t systicks;                     //Declared on sys_timer.cpp
 extern bool ps2numlockstate;                  //Declared on ps2handl.c
+extern bool caps_state;                       //Declared on ps2handl.c
 bool do_next_keep_alive;
 volatile bool shiftstate;
 extern volatile bool update_ps2_leds;         //Declared on ps2handl.c
@@ -91,7 +108,9 @@ volatile uint16_t scanline;
 volatile uint32_t formerscancode;
 volatile uint8_t scancode[4];                 //scancode[0] stores the quantity of bytes;
 
+#if CHORDS != true
 uint8_t CtrlAltDel;
+#endif  //#if CHORDS != true
 //First record of unused V.1.0 Database
 uint8_t UNUSED_DATABASE[(uint8_t)DB_NUM_COLS] = {0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x04, 0x08};
 
@@ -102,6 +121,38 @@ uint8_t dispatch_keys_queue_buffer[DISPATCH_QUEUE_SIZE];
 
 struct sring dispatch_keys_queue;
 
+#if MSX_PAIRING == true
+struct msx_pairing msx_pairings[MSX_PAIRING_SLOTS];
+struct msx_pairing *msx_pairing_recording;    //Slot of the make being dispatched, or NULL
+#endif  //#if MSX_PAIRING == true
+
+#if CHORDS == true
+uint8_t *msx_flash_database;                  //Database selected by database_setup(), while the built-in one is switched in
+#endif  //#if CHORDS == true
+
+#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
+volatile bool msx_y_followed;                 //The macro player, the autofire or the smooth typing follow the MSX reads
+#endif  //#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
+
+#if SHIFT_SEQUENCER == true
+volatile uint8_t msx_queue_unread;            //Columns MSX must read before the next smooth typing key
+uint32_t msx_queue_step_systicks;             //Of the last smooth typing key put on the matrix
+#endif  //#if SHIFT_SEQUENCER == true
+
+#if MSX_NKRO == true
+uint8_t msx_pressed[MSX_NKRO_COLUMNS];        //Pressed set: one bit per X of each Y. The x_bits columns are built from it
+uint8_t msx_key_refs[MSX_NKRO_COLUMNS][8];    //PS/2 keys holding each MSX key
+uint8_t msx_modifier_pressed[MSX_NKRO_COLUMNS]; //Keys pressed by a modifier dependent mapping, out of the pairing table
+uint16_t msx_nkro_last_make;                  //PS/2 key of the last make, until its break: typematic repeats it
+bool msx_nkro_repeat;                         //The make being dispatched is a typematic repeat
+bool msx_nkro_modifier_dependent;             //The line being dispatched maps by Shift, NumLock or RUS/LAT
+// BSRR images of each X: pressed pulls the pin down (reset half), released sets it
+const uint32_t X_PRESS_BSRR[8] = { X0_CLEAR_OR, X1_CLEAR_OR, X2_CLEAR_OR, X3_CLEAR_OR,
+                                   X4_CLEAR_OR, X5_CLEAR_OR, X6_CLEAR_OR, X7_CLEAR_OR };
+const uint32_t X_RELEASE_BSRR[8] = { X0_SET_OR, X1_SET_OR, X2_SET_OR, X3_SET_OR,
+                                     X4_SET_OR, X5_SET_OR, X6_SET_OR, X7_SET_OR };
+#endif  //#if MSX_NKRO == true
+
 // Table to translate the Y order: From port read to the expected one:
 const uint8_t Y_XLAT_TABLE[uint8_t(16)] = { 0b0000, 0b1000, 0b0100, 0b1100,
                                             0b0010, 0b1010, 0b0110, 0b1110,
@@ -371,6 +422,41 @@ void msxmap::msx_interface_setup(void)
 }
 
 
+void msxmap::msx_release_all_keys(void)
+{
+  for(uint8_t i = 0; i < 16+1; i++)
+    x_bits[i] = ALL_X_SET;
+  //Y8 to Y10 are not on x_bits: compute_x_bits_and_check_interrupt_stuck() drives their pins
+  gpio_set(CTRL_PORT, CTRL_PIN);
+  gpio_set(SHIFT_PORT, SHIFT_PIN);
+  gpio_set(RUSLAT_PORT, RUSLAT_PIN);
+  shiftstate = false;
+#if MSX_PAIRING == true
+  for(uint8_t i = 0; i < MSX_PAIRING_SLOTS; i++)
+    msx_pairings[i].ps2_key = MSX_PAIRING_FREE;
+  msx_pairing_recording = NULL;
+#endif  //#if MSX_PAIRING == true
+#if MSX_NKRO == true
+  memset(msx_pressed, 0, sizeof(msx_pressed));
+  memset(msx_key_refs, 0, sizeof(msx_key_refs));
+  memset(msx_modifier_pressed, 0, sizeof(msx_modifier_pressed));
+  msx_nkro_last_make = MSX_PAIRING_FREE;
+#endif  //#if MSX_NKRO == true
+#if CHORDS == true
+  chord_clear();
+#endif  //#if CHORDS == true
+#if MACROS == true
+  macro_stop();
+#endif  //#if MACROS == true
+#if AUTOFIRE == true
+  autofire_clear();
+#endif  //#if AUTOFIRE == true
+#if SHIFT_SEQUENCER == true
+  msx_queue_unread = 0;
+#endif  //#if SHIFT_SEQUENCER == true
+}
+
+
 // Verify if there is an available ps2_byte_received on the receive ring buffer, but does not fetch this one
 //Input: void
 //Output: True if there is char available in input buffer or False if none
@@ -425,11 +511,20 @@ uint8_t msxmap::put_msx_disp_keys_queue_buffer(uint8_t data_word)
 
 //The objective of this routine is implement a smooth typing.
 //The usage is to put a byte key (bit 7:4 represents Y, bit 3 is the release=1/press=0, bits 2:0 are the X )
-//F = 15Hz. This routine is called from Ticks interrupt routine
+//F = 7.5Hz. This routine is called from Ticks interrupt routine, and from main loop on EVT_SHIFT_SEQ
 void msxmap::msxqueuekeys(void)
 {
   uint8_t x_local, y_local, readkey;
   bool x_local_setb;
+#if SHIFT_SEQUENCER == true
+  //The former key waits for its MSX reads, unless MSX stopped scanning them
+  if(msx_queue_unread)
+  {
+    if(systicks - msx_queue_step_systicks < MAX_TIME_OF_IDLE_KEYSCAN_SYSTICKS)
+      return;
+    msx_queue_unread = 0;
+  }
+#endif  //#if SHIFT_SEQUENCER == true
   if (available_msx_disp_keys_queue_buffer())
   {
     //This routine is allways called AFTER the mapped condition has been tested 
@@ -440,12 +535,39 @@ void msxmap::msxqueuekeys(void)
     // Compute x_bits of ch and verifies when Y was last updated,
     // with aim to update MSX keys, no matters if the MSX has the interrupts stucked. 
     compute_x_bits_and_check_interrupt_stuck(y_local, x_local, x_local_setb);
+#if SHIFT_SEQUENCER == true
+    msx_shift_seq_arm(readkey);
+#endif  //#if SHIFT_SEQUENCER == true
   }
 }
 
 
 void msxmap::convert2msx()
 {
+#if CHORDS == true
+  const struct chord *fired;
+  uint8_t chord_flags = chord_event(scancode, &fired);
+
+  if(fired)
+    msx_chord_action(fired);
+  if(chord_flags & CHORD_SWALLOW)
+    return;
+  if(chord_flags & CHORD_SHIFT_MAKE)
+    shiftstate = true;
+  if(chord_flags & CHORD_SHIFT_BREAK)
+    shiftstate = false;
+  if(chord_flags & CHORD_MODIFIER_BREAK)
+  {
+#if MSX_NKRO == true
+    //Shift and/or Graph and/or Control and/or Code were/was released: release the keys their breaks may not find
+    msx_nkro_release_modifier_dependent();
+#else
+    //Shift and/or Graph and/or Control and/or Code were/was released, then force release of all other keys
+    for(uint8_t i = 0; i < 16+1; i++)
+      x_bits[ i ] = X7_SET_OR | X6_SET_OR | X5_SET_OR | X4_SET_OR | X3_SET_OR | X2_SET_OR | X1_SET_OR | X0_SET_OR;
+#endif  //#if MSX_NKRO == true
+  }
+#else
   switch(CtrlAltDel)
   {
     case 0:
@@ -493,6 +615,7 @@ void msxmap::convert2msx()
     //NumLock Pressed. Toggle NumLock status
     ps2numlockstate = !ps2numlockstate;
     update_ps2_leds = true;  //this will force update_leds at main loop
+    main_event_set(EVT_LEDS);
     return;
   }
 
@@ -553,43 +676,60 @@ void msxmap::convert2msx()
   ( scancode[3] == (uint8_t)0x11))
      )
   {
+#if MSX_NKRO == true
+    //Shift and/or Graph and/or Control and/or Code were/was released: release the keys their breaks may not find
+    msx_nkro_release_modifier_dependent();
+#else
     //Shift and/or Graph and/or Control and/or Code were/was released, then force release of all other keys
     for(uint8_t i = 0; i < 16+1; i++)
       x_bits[ i ] = X7_SET_OR | X6_SET_OR | X5_SET_OR | X4_SET_OR | X3_SET_OR | X2_SET_OR | X1_SET_OR | X0_SET_OR;
+#endif  //#if MSX_NKRO == true
   }
 
-#if 0
-    if (
-    ((scancode[0] == (uint8_t)3)    &&
-    ( scancode[1] == (uint8_t)0xE1) &&
-    ( scancode[2] == (uint8_t)0x14) &&
-    ( scancode[3] == (uint8_t)0x77))  ||
-    ((scancode[0] == (uint8_t)2)    &&
-    ( scancode[1] == (uint8_t)0xE0) &&
-    ( scancode[2] == (uint8_t)0x7E))  )
-    {
-      //Pause Break Key & Control + Break (Control was already sent at this time).
-      //Create an effect of press and release of MSX STOP, through:
-      //dispatch MSX STOP pressed 3 times and 1 MSX STOP release
-      for(uint16_t i = 0; i < 3; i++) //Keep the MSX STOP key pressed for a while
-	put_msx_disp_keys_queue_buffer(Y_STOP<<NIBBLE | X_STOP);
-      put_msx_disp_keys_queue_buffer(Y_STOP<<NIBBLE | X_POLARITY_BIT_MASK | X_STOP);  //Then release MSX STOP key
-      return;
-    }
-#endif
+#endif  //#if CHORDS == true
+#if MSX_NKRO == true
+  msx_nkro_track_make();
+#endif  //#if MSX_NKRO == true
+#if AUTOFIRE == true
+  msx_autofire_break();
+#endif  //#if AUTOFIRE == true
+#if MSX_PAIRING == true
+  //A break undoes its make, whatever the modifiers are now
+  if(msx_pairing_release())
+    return;
+#endif  //#if MSX_PAIRING == true
+#if DB_REMAP == true
+  //Lines remapped on console are found before the Database ones
+  const uint8_t *remap_line = remap_lookup(scancode);
+  if(remap_line)
+  {
+    msx_dispatch(remap_line);
+    return;
+  }
+#endif  //#if DB_REMAP == true
+#if LAYERS == true
+  //Keys of the layer selected by the LEDs are found before the Database ones
+  const uint8_t *layer_line = layer_lookup(scancode);
+  if(layer_line)
+  {
+    msx_dispatch(layer_line);
+    return;
+  }
+#endif  //#if LAYERS == true
+
   //Now searches for PS/2 scan code in Database to match. First search first column
   scanline = 1;
   while ( 
   //(MSX_KEYB_DATABASE_CONVERSION[scanline][0] != scancode[1]) &&
-  (*(base_of_database+scanline*DB_NUM_COLS+0) != scancode[1]) &&
-  (scanline < N_DATABASE_REGISTERS) )
+  (scanline < N_DATABASE_REGISTERS) &&
+  (*(base_of_database+scanline*DB_NUM_COLS+0) != scancode[1]) )
   {
     scanline++;
   }
   if (
   (scancode[0] == (uint8_t)1) && 
-  (scancode[1]  == *(base_of_database+scanline*DB_NUM_COLS+0)) &&
-  (scanline < N_DATABASE_REGISTERS) )
+  (scanline < N_DATABASE_REGISTERS) &&
+  (scancode[1]  == *(base_of_database+scanline*DB_NUM_COLS+0)) )
   {
     //1 byte key
     msx_dispatch();
@@ -600,13 +740,14 @@ void msxmap::convert2msx()
   {
     //2 bytes key, then now search match on second byte of scancode
     while ( 
-    (*(base_of_database+scanline*DB_NUM_COLS+1) != scancode[2]) &&
-    (scanline < N_DATABASE_REGISTERS))
+    (scanline < N_DATABASE_REGISTERS) &&
+    (*(base_of_database+scanline*DB_NUM_COLS+1) != scancode[2]) )
     {
       scanline++;
     }
     if(
     (scancode[0] == (uint8_t)2) && 
+    (scanline < N_DATABASE_REGISTERS) &&
     (scancode[1] == *(base_of_database+scanline*DB_NUM_COLS+0)) &&
     (scancode[2] == *(base_of_database+scanline*DB_NUM_COLS+1)) )
     {
@@ -616,13 +757,14 @@ void msxmap::convert2msx()
     }
     //3 bytes key, then now search match on third byte of scancode
     while (
-    (*(base_of_database+scanline*DB_NUM_COLS+2) != scancode[3]) &&
-    (scanline < N_DATABASE_REGISTERS) )
+    (scanline < N_DATABASE_REGISTERS) &&
+    (*(base_of_database+scanline*DB_NUM_COLS+2) != scancode[3]) )
     {
       scanline++;
     }
     if( 
     (scancode[0] == 3) && 
+    (scanline < N_DATABASE_REGISTERS) &&
     (scancode[1] == *(base_of_database+scanline*DB_NUM_COLS+0)) &&
     (scancode[2] == *(base_of_database+scanline*DB_NUM_COLS+1)) &&
     (scancode[3] == *(base_of_database+scanline*DB_NUM_COLS+2)) )
@@ -715,12 +857,35 @@ void msxmap::convert2msx()
   
   */
 
-//void msxmap::msx_dispatch(volatile uint16_t scanline)
 void msxmap::msx_dispatch(void)
+{
+  msx_dispatch((const uint8_t*)base_of_database + scanline * DB_NUM_COLS);
+}
+
+
+//void msxmap::msx_dispatch(volatile uint16_t scanline)
+void msxmap::msx_dispatch(const uint8_t *line)
 {
   volatile uint8_t y_local = 0xf, x_local;
   volatile bool x_local_setb;
+#if LAYERS == true
+  //As mount_scancode() sampled it for the layer lookup
+  bool rusLatState = caps_state;
+#else
   bool rusLatState = gpio_get (RUSLAT_LED_PORT, RUSLAT_LED_PIN) != 0;
+#endif  //#if LAYERS == true
+#if AUTOFIRE == true
+  //Typematic repeats would press it again, out of its pace. Its pairing is kept for the break
+  if(msx_autofire_make(line))
+    return;
+#endif  //#if AUTOFIRE == true
+#if MSX_PAIRING == true
+  msx_pairing_begin();
+#endif  //#if MSX_PAIRING == true
+#if MSX_NKRO == true
+  msx_nkro_modifier_dependent = (line[CASEx_TYPE] & CASE_MASK) != 0;
+#endif  //#if MSX_NKRO == true
+#if LAYERS == false
   if (rusLatState) // Kostyl
   {
     uint8_t code = scancode[0] == 1 ? scancode[1] : scancode[2];
@@ -745,17 +910,21 @@ void msxmap::msx_dispatch(void)
       }
     if (y_local != y_dummy)
     {
-      uint8_t tableVal = base_of_database[scanline * DB_NUM_COLS + CASE0_KEY0];
+      uint8_t tableVal = line[CASE0_KEY0];
       x_local_setb = (tableVal & (uint8_t) X_POLARITY_BIT_MASK) >> X_POLARITY_BIT_POSITION;
-      compute_x_bits_and_check_interrupt_stuck (y_local, x_local, x_local_setb);
+#if MSX_NKRO == true
+      msx_nkro_modifier_dependent = true;
+#endif  //#if MSX_NKRO == true
+      dispatch_key_now(y_local, x_local, x_local_setb);
       return;
     }
   }
-  switch(base_of_database[scanline*DB_NUM_COLS+CASEx_TYPE] & CASE_MASK)
+#endif  //#if LAYERS == false
+  switch(line[CASEx_TYPE] & CASE_MASK)
   {
     case 0:
     {
-      uint8_t tableVal = base_of_database[scanline * DB_NUM_COLS+ CASE0_KEY0];
+      uint8_t tableVal = line[CASE0_KEY0];
       // .0 - Default mapping (Columns 4 & 5)
       // Key 0:
 
@@ -767,31 +936,31 @@ void msxmap::msx_dispatch(void)
         x_local_setb = (tableVal & (uint8_t)X_POLARITY_BIT_MASK) >> X_POLARITY_BIT_POSITION;
         //Calculates x_bits of Key 0 and checks if the time in which the data of Line X of Column Y was updated,
         // in order to update keys even without the PPI being updated.
-        compute_x_bits_and_check_interrupt_stuck(y_local, x_local, x_local_setb);
+        dispatch_key_now(y_local, x_local, x_local_setb);
       }
       // Key 1:
-      tableVal = base_of_database[scanline*DB_NUM_COLS+CASE0_KEY1];
+      tableVal = line[CASE0_KEY1];
       y_local = (tableVal & (uint8_t)Y_LOCAL_MASK) >> NIBBLE;
       // Verify if key is mapped
       if (y_local != y_dummy)
       {
         x_local = tableVal & (uint8_t)X_LOCAL_MASK;
-        x_local_setb = (*(base_of_database+scanline*DB_NUM_COLS+CASE0_KEY0) & (uint8_t)X_POLARITY_BIT_MASK) >> X_POLARITY_BIT_POSITION;
-        compute_x_bits_and_check_interrupt_stuck(y_local, x_local, x_local_setb);
+        x_local_setb = (line[CASE0_KEY0] & (uint8_t)X_POLARITY_BIT_MASK) >> X_POLARITY_BIT_POSITION;
+        dispatch_key_now(y_local, x_local, x_local_setb);
 #if 0
-	  if( ((*(base_of_database+scanline*DB_NUM_COLS+CASE0_KEY1)) & ~(uint8_t)X_POLARITY_BIT_MASK) == (MSX_SHIFT_PRESS))
+	  if( ((line[CASE0_KEY1]) & ~(uint8_t)X_POLARITY_BIT_MASK) == (MSX_SHIFT_PRESS))
 	  {
 	    //Shift key
 	    if(shiftstate)
-	      put_msx_disp_keys_queue_buffer(MSX_SHIFT_PRESS);  //return MSX Shift key as pressed state
+	      dispatch_key_queued(MSX_SHIFT_PRESS);  //return MSX Shift key as pressed state
 	    else
-	      put_msx_disp_keys_queue_buffer(MSX_SHIFT_PRESS | X_POLARITY_BIT_MASK);  //return MSX Shift key as released state
-	  } //  if( ((*(base_of_database+scanline*DB_NUM_COLS+CASE0_KEY1)) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
-	  else // if( ((*(base_of_database+scanline*DB_NUM_COLS+CASE0_KEY1)) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
+	      dispatch_key_queued(MSX_SHIFT_PRESS | X_POLARITY_BIT_MASK);  //return MSX Shift key as released state
+	  } //  if( ((line[CASE0_KEY1]) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
+	  else // if( ((line[CASE0_KEY1]) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
 	  {
 	    //Other key: different from Shift key
-	    put_msx_disp_keys_queue_buffer(*(base_of_database+scanline*DB_NUM_COLS+CASE0_KEY1));
-	  } //else // if( ((*(base_of_database+scanline*DB_NUM_COLS+CASE0_KEY1)) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
+	    dispatch_key_queued(line[CASE0_KEY1]);
+	  } //else // if( ((line[CASE0_KEY1]) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
 #endif
 	  } //if (y_local != y_dummy)
       break;
@@ -805,7 +974,7 @@ void msxmap::msx_dispatch(void)
 	state = rusLatState;
       if (state == shiftstate)
       {
-	uint8_t tableVal = base_of_database[scanline * DB_NUM_COLS + CASE0_KEY0];
+	uint8_t tableVal = line[CASE0_KEY0];
         //numlock and Shift have different status
         // Key 0 (PS/2 NumLock ON (Default)):
 	y_local = (tableVal & (uint8_t) Y_LOCAL_MASK) >> NIBBLE;
@@ -814,10 +983,10 @@ void msxmap::msx_dispatch(void)
         {
           x_local = tableVal & (uint8_t)X_LOCAL_MASK;
           x_local_setb = (tableVal & (uint8_t)X_POLARITY_BIT_MASK) >> X_POLARITY_BIT_POSITION;
-          compute_x_bits_and_check_interrupt_stuck(y_local, x_local, x_local_setb);
+          dispatch_key_now(y_local, x_local, x_local_setb);
         }
         // Key 1 (PS/2 NumLock ON (Default)):
-        tableVal = base_of_database[scanline*DB_NUM_COLS+CASE0_KEY1];
+        tableVal = line[CASE0_KEY1];
         y_local = (tableVal & (uint8_t)Y_LOCAL_MASK) >> NIBBLE;
         // Verify if key is mapped
         if (y_local != y_dummy)
@@ -827,20 +996,20 @@ void msxmap::msx_dispatch(void)
           {
             //Shift key
             if(shiftstate)
-              put_msx_disp_keys_queue_buffer(MSX_SHIFT_PRESS);  //return MSX Shift key as pressed state
+              dispatch_key_queued(MSX_SHIFT_PRESS);  //return MSX Shift key as pressed state
             else
-              put_msx_disp_keys_queue_buffer(MSX_SHIFT_PRESS | X_POLARITY_BIT_MASK);  //return MSX Shift key as released state
+              dispatch_key_queued(MSX_SHIFT_PRESS | X_POLARITY_BIT_MASK);  //return MSX Shift key as released state
           } //if( (Y_SHIFT == y_local) && (X_SHIFT == x_local) )
           else // if( (Y_SHIFT == y_local) && (X_SHIFT == x_local) )
           {
             //Other key: different from Shift key
-            put_msx_disp_keys_queue_buffer(tableVal);
+            dispatch_key_queued(tableVal);
           } //else // if( (Y_SHIFT == y_local) && (X_SHIFT == x_local) )
         } //if (y_local != y_dummy)
       }
       else //if (state != shiftstate)
       {
-	uint8_t tableVal = base_of_database[scanline * DB_NUM_COLS + CASE1_KEY0];
+	uint8_t tableVal = line[CASE1_KEY0];
         //numlock and Shift share the same status
         // Verify if there are keys mapped
         // Key 0 (PS/2 NumLock OFF):
@@ -852,10 +1021,10 @@ void msxmap::msx_dispatch(void)
           x_local_setb = (tableVal & (uint8_t)X_POLARITY_BIT_MASK) >> X_POLARITY_BIT_POSITION;
           //Calculates x_bits of Key 0 and checks if the time in which the data of Line X of Column Y was updated,
           // in order to update keys even without the PPI being updated.
-          compute_x_bits_and_check_interrupt_stuck(y_local, x_local, x_local_setb);
+          dispatch_key_now(y_local, x_local, x_local_setb);
         } //if (y_local != y_dummy)
         // Key 1 (PS/2 NumLock OFF):
-        tableVal = base_of_database[scanline * DB_NUM_COLS + CASE1_KEY1];
+        tableVal = line[CASE1_KEY1];
         y_local = (tableVal & (uint8_t)Y_LOCAL_MASK) >> NIBBLE;
         // Verify if key is mapped
         if (y_local != y_dummy)
@@ -864,15 +1033,15 @@ void msxmap::msx_dispatch(void)
           {
             //Shift key
             if(shiftstate)
-              put_msx_disp_keys_queue_buffer(MSX_SHIFT_PRESS);  //return MSX Shift key as pressed state
+              dispatch_key_queued(MSX_SHIFT_PRESS);  //return MSX Shift key as pressed state
             else
-              put_msx_disp_keys_queue_buffer(MSX_SHIFT_PRESS | X_POLARITY_BIT_MASK);  //return MSX Shift key as released state
-          } //if( ((*(base_of_database+scanline*DB_NUM_COLS+CASE1_KEY1)) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
-          else // if( ((*(base_of_database+scanline*DB_NUM_COLS+CASE1_KEY1)) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
+              dispatch_key_queued(MSX_SHIFT_PRESS | X_POLARITY_BIT_MASK);  //return MSX Shift key as released state
+          } //if( ((line[CASE1_KEY1]) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
+          else // if( ((line[CASE1_KEY1]) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
           {
             //Other key: different from Shift key
-            put_msx_disp_keys_queue_buffer(*(base_of_database+scanline*DB_NUM_COLS+CASE1_KEY1));
-          } //else // if( ((*(base_of_database+scanline*DB_NUM_COLS+CASE1_KEY1)) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
+            dispatch_key_queued(line[CASE1_KEY1]);
+          } //else // if( ((line[CASE1_KEY1]) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
         } //if (y_local != y_dummy)
       } //if (ps2numlockstate ^ shiftstate)
       break;
@@ -884,7 +1053,7 @@ void msxmap::msx_dispatch(void)
       {
         //Shift state is OFF (not pressed), so performs as CASE 0 (see the displacement CASE0_KEY...)
         // Key 0 (PS/2 NumLock ON (Default)):
-	uint8_t tableVal = base_of_database[scanline * DB_NUM_COLS + CASE0_KEY0];
+	uint8_t tableVal = line[CASE0_KEY0];
         y_local = (tableVal & (uint8_t)Y_LOCAL_MASK)  >> NIBBLE;
         if (y_local != y_dummy) // Verify if key is mapped
         {
@@ -892,10 +1061,10 @@ void msxmap::msx_dispatch(void)
           x_local_setb = (tableVal & (uint8_t)X_POLARITY_BIT_MASK) != 0;
           //Calculates x_bits of Key 0 and checks if the time in which the data of Line X of Column Y was updated,
           // in order to update keys even without the PPI being updated.
-          compute_x_bits_and_check_interrupt_stuck(y_local, x_local, x_local_setb);
+          dispatch_key_now(y_local, x_local, x_local_setb);
         }
         // Key 1 (PS/2 NumLock ON (Default)):
-        tableVal =  base_of_database[scanline * DB_NUM_COLS + CASE0_KEY1];
+        tableVal =  line[CASE0_KEY1];
         y_local = (tableVal & (uint8_t)Y_LOCAL_MASK) >> NIBBLE;
         if (y_local != y_dummy) // Verify if key is mapped
         {
@@ -904,22 +1073,22 @@ void msxmap::msx_dispatch(void)
           {
             //Shift key
             if(shiftstate)
-              put_msx_disp_keys_queue_buffer(MSX_SHIFT_PRESS);  //return MSX Shift key as pressed state
+              dispatch_key_queued(MSX_SHIFT_PRESS);  //return MSX Shift key as pressed state
             else
-              put_msx_disp_keys_queue_buffer(MSX_SHIFT_PRESS | X_POLARITY_BIT_MASK);  //return MSX Shift key as released state
-          } //if( (*(base_of_database+scanline*DB_NUM_COLS+CASE0_KEY1) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
-          else // if( (*(base_of_database+scanline*DB_NUM_COLS+CASE0_KEY1) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
+              dispatch_key_queued(MSX_SHIFT_PRESS | X_POLARITY_BIT_MASK);  //return MSX Shift key as released state
+          } //if( (line[CASE0_KEY1] & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
+          else // if( (line[CASE0_KEY1] & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
           {
             //Other key: different from Shift key
-            put_msx_disp_keys_queue_buffer(tableVal);
-          } //else // if( (*(base_of_database+scanline*DB_NUM_COLS+CASE0_KEY1) & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
+            dispatch_key_queued(tableVal);
+          } //else // if( (line[CASE0_KEY1] & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
         } //if (y_local != y_dummy)
       }
       else //case 2: shiftstate is ON now!, so it is a true case 2 (see the displacement CASE2_KEY...)
       {
         // Check for mapped keys
         // Key 0 (PS/2 Left and Right Shift):
-	uint8_t tableVal = base_of_database[scanline * DB_NUM_COLS + CASE2_KEY0];
+	uint8_t tableVal = line[CASE2_KEY0];
 	y_local = (tableVal & (uint8_t) Y_LOCAL_MASK) >> NIBBLE;
         //static uint8_t waitForRelease = 0;
         if (y_local != y_dummy) // Verify if key is mapped
@@ -929,39 +1098,47 @@ void msxmap::msx_dispatch(void)
             x_local_setb = ((tableVal & (uint8_t)X_POLARITY_BIT_MASK) != 0);
             if ((tableVal & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS)
               x_local_setb ^= rusLatState;
-            compute_x_bits_and_check_interrupt_stuck(y_local, x_local, x_local_setb);
+            dispatch_key_now(y_local, x_local, x_local_setb);
             if (false)
             {
               //and then, as it is CODE (or GRAPH) Release, reinsert the dropped MSX Shift key
               if(shiftstate)
-                put_msx_disp_keys_queue_buffer(MSX_SHIFT_PRESS);  //return MSX Shift key as pressed state
+                dispatch_key_queued(MSX_SHIFT_PRESS);  //return MSX Shift key as pressed state
               else
-                put_msx_disp_keys_queue_buffer(MSX_SHIFT_PRESS | X_POLARITY_BIT_MASK);  //return MSX Shift key as released state
+                dispatch_key_queued(MSX_SHIFT_PRESS | X_POLARITY_BIT_MASK);  //return MSX Shift key as released state
             }
           }
         } //if (y_local != y_dummy)
         // Key 1 (PS/2 Left and Right Shift):
-        tableVal = base_of_database[scanline * DB_NUM_COLS + CASE2_KEY1];
+        tableVal = line[CASE2_KEY1];
         y_local = (tableVal & (uint8_t)Y_LOCAL_MASK) >> NIBBLE;
         // Verify if key is mapped
         if (y_local != y_dummy)
         {
-            put_msx_disp_keys_queue_buffer(tableVal);
+            dispatch_key_queued(tableVal);
             //waitForRelease = tableVal | X_POLARITY_BIT_MASK;
             //if CODE key released or GRAPH key released
         } //if (y_local != y_dummy)
       } //case 2: if (!shiftstate)
     }  // .2 -  Alternative mappings (PS/2 Left and Right Shift)  (Columns 6 and 7)
-  } //switch(*(base_of_database+scanline*DB_NUM_COLS+3) & CASE_MASK)
-} //void msxmap::msx_dispatch(void)
+  } //switch(line[3] & CASE_MASK)
+} //void msxmap::msx_dispatch(const uint8_t *line)
 
 
 void msxmap::compute_x_bits_and_check_interrupt_stuck (
   volatile uint8_t y_local, uint8_t x_local, bool x_local_setb)
 {
   uint16_t msx_Y_scan;
+#if MACROS == true
+  macro_record_key((uint8_t)((y_local << NIBBLE) | (x_local_setb ? X_POLARITY_BIT_MASK : 0) | (x_local & X_LOCAL_MASK)));
+#endif  //#if MACROS == true
   if (y_local>7)
     x_local = y_local;
+#if MSX_NKRO == true
+  if(x_local < 8)
+    msx_nkro_key(y_local, x_local, x_local_setb);
+  else
+#endif  //#if MSX_NKRO == true
   switch (x_local)
   {
     case 0:
@@ -1094,6 +1271,13 @@ void msxmap::compute_x_bits_and_check_interrupt_stuck (
     }
   }
   x_bits[16] = x_bits[y_local];
+#if LATENCY_TRACE == true
+  latency_x_bits_updated(y_local);
+#endif  //#if LATENCY_TRACE == true
+#if USB_TELEMETRY == true
+  if(telemetry_on)
+    telemetry_put(TELEMETRY_REC_MATRIX, (uint8_t)y_local, (uint8_t)x_local, x_local_setb ? 1 : 0);
+#endif  //#if USB_TELEMETRY == true
   //See when the Y colunm's XLine was updated, in order to update keys even without the PPI being updated.
   uint16_t port = gpio_port_read (Y0_PORT);
   msx_Y_scan = (port & Y_MASK_1) >> 3 | (port & Y_MASK_2) >> 5;
@@ -1129,11 +1313,502 @@ void msxmap::compute_x_bits_and_check_interrupt_stuck (
 }
 
 
+void msxmap::dispatch_key_now(uint8_t y_local, uint8_t x_local, bool x_local_setb)
+{
+  uint8_t key = (uint8_t)((y_local << NIBBLE) | (x_local_setb ? X_POLARITY_BIT_MASK : 0) | (x_local & X_LOCAL_MASK));
+  bool paired = false;
+
+#if MSX_PAIRING == true
+  if(msx_pairing_recording && (msx_pairing_recording->n_actions < MSX_PAIRING_ACTIONS))
+  {
+    msx_pairing_recording->actions[msx_pairing_recording->n_actions++] = key;
+    paired = true;
+  }
+#endif  //#if MSX_PAIRING == true
+#if MSX_NKRO == true
+  msx_nkro_account(key, paired);
+#endif  //#if MSX_NKRO == true
+#if SHIFT_SEQUENCER == true
+  //Behind the smooth typing keys not seen yet: MSX must see the keys in the order they were dispatched
+  if(msx_shift_seq_busy() && put_msx_disp_keys_queue_buffer(key))
+    return;
+#endif  //#if SHIFT_SEQUENCER == true
+  (void)key;
+  (void)paired;
+  compute_x_bits_and_check_interrupt_stuck(y_local, x_local, x_local_setb);
+#if SHIFT_SEQUENCER == true
+  //A CTRL, SHIFT or RUS/LAT line change is seen by a whole matrix read before the keys that follow it
+  if(y_local > 7)
+    msx_shift_seq_arm(key);
+#endif  //#if SHIFT_SEQUENCER == true
+}
+
+
+void msxmap::dispatch_key_queued(uint8_t key)
+{
+  bool paired = false;
+
+#if MSX_PAIRING == true
+  if(msx_pairing_recording && (msx_pairing_recording->n_actions < MSX_PAIRING_ACTIONS))
+  {
+    msx_pairing_recording->actions[msx_pairing_recording->n_actions++] = key;
+    paired = true;
+  }
+#endif  //#if MSX_PAIRING == true
+#if MSX_NKRO == true
+  msx_nkro_account(key, paired);
+#endif  //#if MSX_NKRO == true
+  (void)paired;
+  put_msx_disp_keys_queue_buffer(key);
+}
+
+
+#if CHORDS == true
+void msxmap::msx_chord_action(const struct chord *fired)
+{
+#if MACROS == true
+  uint8_t slot;
+
+#endif  //#if MACROS == true
+  switch(fired->action)
+  {
+    case DB_CHORD_ACT_RESET:
+      //User messages
+      con_send_string((uint8_t*)"Reset requested by user\r\n");
+      reset_requested();
+      break;
+    case DB_CHORD_ACT_NUMLOCK:
+      ps2numlockstate = !ps2numlockstate;
+      update_ps2_leds = true;  //this will force update_leds at main loop
+      main_event_set(EVT_LEDS);
+      break;
+    case DB_CHORD_ACT_LAYOUT:
+      msx_layout_switch();
+      break;
+    case DB_CHORD_ACT_MSX_KEY:
+      //Keep the MSX key pressed for 3 SysTicks, then release it. Out of the pressed set references: a PS/2 key
+      //holding the same MSX key keeps it pressed
+      for(uint8_t i = 0; i < 3; i++)
+        put_msx_disp_keys_queue_buffer(fired->arg & (uint8_t)~X_POLARITY_BIT_MASK);
+      put_msx_disp_keys_queue_buffer(fired->arg | X_POLARITY_BIT_MASK);
+      break;
+#if MACROS == true
+    case DB_CHORD_ACT_MACRO:
+    case DB_CHORD_ACT_MACRO_REC:
+      slot = fired->arg & (uint8_t)~MACRO_REC_DELAYS;
+      if( (slot < 1) || (slot > MACRO_SLOTS) )
+        break;
+      if(fired->action == DB_CHORD_ACT_MACRO)
+        macro_play_slot(slot);
+      else if(macro_recording())
+        macro_record_stop();
+      else
+        macro_record_start(slot, (fired->arg & MACRO_REC_DELAYS) != 0);
+      break;
+#endif  //#if MACROS == true
+  }
+}
+
+
+void msxmap::msx_layout_switch(void)
+{
+  uint8_t *built_in = (uint8_t*)&DEFAULT_MSX_KEYB_DATABASE_CONVERSION[0][0];
+
+  if(base_of_database != built_in)
+  {
+    msx_flash_database = base_of_database;
+    base_of_database = built_in;
+  }
+  else if(msx_flash_database)
+    base_of_database = msx_flash_database;
+  else
+    return;                                   //database_setup() selected the built-in one: nothing to switch
+  msx_release_all_keys();
+  y_dummy = base_of_database[3] & 0x0F;
+  chord_setup();
+#if LAYERS == true
+  layer_setup();
+#endif  //#if LAYERS == true
+  con_send_string(base_of_database == built_in ? (uint8_t*)"Built-in Database\r\n" : (uint8_t*)"Flash Database\r\n");
+}
+#endif  //#if CHORDS == true
+
+
+#if MACROS == true
+void msxmap::msx_macro_poll(void)
+{
+  uint8_t key;
+
+  //Out of the pressed set references: a PS/2 key holding the same MSX key keeps it pressed
+  while((key = macro_next()) != MACRO_NONE)
+  {
+    compute_x_bits_and_check_interrupt_stuck((key & Y_LOCAL_MASK) >> NIBBLE, key & X_LOCAL_MASK,
+                                             (key & X_POLARITY_BIT_MASK) != 0);
+    //Followed before the wait starts, so no read of it is missed
+    msx_y_followed = true;
+    macro_played();
+  }
+  //As msx_shift_seq_poll(): a SysTick msx_shift_seq_arm() may set msx_y_followed meanwhile
+  systick_interrupt_disable();
+  msx_y_follow();
+  systick_interrupt_enable();
+}
+#endif  //#if MACROS == true
+
+
+#if AUTOFIRE == true
+bool msxmap::msx_autofire_make(const uint8_t *line)
+{
+  uint8_t period = autofire_period(line[CASEx_TYPE]), key = line[CASE0_KEY0];
+  uint16_t ps2_key;
+  bool release;
+
+  if( !period || (line[CASEx_TYPE] & CASE_MASK) )
+    return false;
+  ps2_key = msx_pairing_key(&release);
+  if( release || (key & X_POLARITY_BIT_MASK) || (((key & Y_LOCAL_MASK) >> NIBBLE) >= AUTOFIRE_COLUMNS) )
+    return false;
+  if(autofire_held(ps2_key))
+    return true;
+  //It is pressed by the dispatch that follows: the first toggle (a release) comes after period reads
+  autofire_start(ps2_key, key, period);
+  //As msx_macro_poll()
+  systick_interrupt_disable();
+  msx_y_follow();
+  systick_interrupt_enable();
+  return false;
+}
+
+
+void msxmap::msx_autofire_break(void)
+{
+  uint16_t ps2_key;
+  uint8_t key;
+  bool release;
+
+  if(!autofire_columns)
+    return;
+  ps2_key = msx_pairing_key(&release);
+  if(!release)
+    return;
+  key = autofire_stop(ps2_key);
+  if(key != AUTOFIRE_NONE)
+    msx_autofire_put(key);
+  systick_interrupt_disable();
+  msx_y_follow();
+  systick_interrupt_enable();
+}
+
+
+void msxmap::msx_autofire_poll(void)
+{
+  uint8_t key;
+
+  while((key = autofire_next()) != AUTOFIRE_NONE)
+    msx_autofire_put(key);
+}
+
+
+void msxmap::msx_autofire_put(uint8_t key)
+{
+  uint8_t y_local = (key & Y_LOCAL_MASK) >> NIBBLE, x_local = key & X_LOCAL_MASK;
+
+#if MSX_NKRO == true
+  //The pressed set is changed alone: its references stay with the held PS/2 key
+  uint32_t column = 0;
+  uint8_t pressed;
+
+  if(key & X_POLARITY_BIT_MASK)
+    msx_pressed[y_local] &= (uint8_t)~(1 << x_local);
+  else
+    msx_pressed[y_local] |= (uint8_t)(1 << x_local);
+  pressed = msx_pressed[y_local];
+  for(uint8_t x = 0; x < 8; x++, pressed >>= 1)
+    column |= (pressed & 1) ? X_PRESS_BSRR[x] : X_RELEASE_BSRR[x];
+  x_bits[y_local] = column;
+#else
+  compute_x_bits_and_check_interrupt_stuck(y_local, x_local, (key & X_POLARITY_BIT_MASK) != 0);
+#endif  //#if MSX_NKRO == true
+}
+#endif  //#if AUTOFIRE == true
+
+
+#if SHIFT_SEQUENCER == true
+bool msxmap::msx_shift_seq_busy(void)
+{
+  return (msx_queue_unread != 0) || available_msx_disp_keys_queue_buffer();
+}
+
+
+bool msxmap::msx_shift_seq_arm(uint8_t key)
+{
+  uint8_t y_local = (key & Y_LOCAL_MASK) >> NIBBLE;
+  bool scanning = false;
+
+  //Only while MSX scans: otherwise the keys go at SysTick pace, as before
+  for(uint8_t y = 0; y < 8; y++)
+    scanning = scanning || (systicks - previous_y_systick[y] <= MAX_TIME_OF_IDLE_KEYSCAN_SYSTICKS);
+  if(!scanning)
+    return false;
+  msx_queue_step_systicks = systicks;
+  //The CTRL, SHIFT and RUS/LAT lines have no column: a whole matrix read sees them
+  msx_queue_unread = (y_local < 8) ? (uint8_t)(1 << y_local) : (uint8_t)0xFF;
+  msx_y_followed = true;
+  return true;
+}
+
+
+void msxmap::msx_shift_seq_poll(void)
+{
+  //msxqueuekeys() runs on SysTick as well, and its msx_shift_seq_arm() sets msx_y_followed: a stale
+  //msx_y_follow() result must not overwrite it
+  systick_interrupt_disable();
+  msxqueuekeys();
+  msx_y_follow();
+  systick_interrupt_enable();
+}
+#endif  //#if SHIFT_SEQUENCER == true
+
+
+#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
+void msxmap::msx_y_follow(void)
+{
+  bool followed = false;
+
+#if MACROS == true
+  followed = followed || (macro_unread != 0);
+#endif  //#if MACROS == true
+#if AUTOFIRE == true
+  followed = followed || (autofire_columns != 0);
+#endif  //#if AUTOFIRE == true
+#if SHIFT_SEQUENCER == true
+  followed = followed || (msx_queue_unread != 0);
+#endif  //#if SHIFT_SEQUENCER == true
+  msx_y_followed = followed;
+}
+#endif  //#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
+
+
+#if MSX_PAIRING == true
+uint16_t msxmap::msx_pairing_key(bool *release)
+{
+  uint16_t ps2_key = MSX_PAIRING_FREE;
+  uint8_t idx = 1, code;
+
+  *release = false;
+  if( (scancode[0] >= 2) && (scancode[1] == 0xE0) )
+  {
+    ps2_key = MSX_PAIRING_E0;
+    idx++;
+  }
+  if( (idx < scancode[0]) && (scancode[idx] == 0xF0) )
+  {
+    *release = true;
+    idx++;
+  }
+  if(idx != scancode[0])
+    return MSX_PAIRING_FREE;                    //Pause and other sequences are not paired
+  code = scancode[idx];
+  if( (code == 0xE0) || (code == 0xE1) || (code == 0xF0) )
+    return MSX_PAIRING_FREE;
+  return ps2_key | code;
+}
+
+
+void msxmap::msx_pairing_begin(void)
+{
+  struct msx_pairing *free_slot = NULL;
+  uint16_t ps2_key;
+  bool release;
+
+  msx_pairing_recording = NULL;
+  ps2_key = msx_pairing_key(&release);
+  if( (ps2_key == MSX_PAIRING_FREE) || release )
+    return;
+  for(uint8_t i = 0; i < MSX_PAIRING_SLOTS; i++)
+  {
+    if(msx_pairings[i].ps2_key == ps2_key)
+    {
+      //Make of a held key (typematic): the MSX keys are put again, so they are recorded again
+      free_slot = &msx_pairings[i];
+      break;
+    }
+    if( !free_slot && (msx_pairings[i].ps2_key == MSX_PAIRING_FREE) )
+      free_slot = &msx_pairings[i];
+  }
+  //No free slot: its break searches the Database, as before
+  if(!free_slot)
+    return;
+  free_slot->ps2_key = ps2_key;
+  free_slot->n_actions = 0;
+  msx_pairing_recording = free_slot;
+}
+
+
+bool msxmap::msx_pairing_release(void)
+{
+  struct msx_pairing *slot = NULL;
+  uint16_t ps2_key;
+  uint8_t action, undo;
+  bool release, queued;
+
+  ps2_key = msx_pairing_key(&release);
+  if( (ps2_key == MSX_PAIRING_FREE) || !release )
+    return false;
+  for(uint8_t i = 0; i < MSX_PAIRING_SLOTS; i++)
+    if(msx_pairings[i].ps2_key == ps2_key)
+    {
+      slot = &msx_pairings[i];
+      break;
+    }
+  if(!slot)
+    return false;
+#if SHIFT_SEQUENCER == true
+  queued = msx_shift_seq_busy();
+#else
+  queued = available_msx_disp_keys_queue_buffer();
+#endif  //#if SHIFT_SEQUENCER == true
+  for(uint8_t i = slot->n_actions; i-- > 0; )
+  {
+    action = slot->actions[i];
+    if( (action & ~(uint8_t)X_POLARITY_BIT_MASK) == MSX_SHIFT_PRESS )
+      undo = shiftstate ? MSX_SHIFT_PRESS : (MSX_SHIFT_PRESS | X_POLARITY_BIT_MASK);
+    else if(action & X_POLARITY_BIT_MASK)
+      continue;
+    else
+      undo = action | X_POLARITY_BIT_MASK;
+#if MSX_NKRO == true
+    msx_nkro_account(undo, true);
+#endif  //#if MSX_NKRO == true
+    if( !queued || !put_msx_disp_keys_queue_buffer(undo) )
+    {
+      compute_x_bits_and_check_interrupt_stuck((undo & Y_LOCAL_MASK) >> NIBBLE, undo & X_LOCAL_MASK,
+                                               (undo & X_POLARITY_BIT_MASK) != 0);
+#if SHIFT_SEQUENCER == true
+      //The SHIFT restore of a shift substitution goes after MSX read the key release
+      queued = msx_shift_seq_arm(undo);
+#endif  //#if SHIFT_SEQUENCER == true
+    }
+  }
+  slot->ps2_key = MSX_PAIRING_FREE;
+  return true;
+}
+#endif  //#if MSX_PAIRING == true
+
+
+#if MSX_NKRO == true
+void msxmap::msx_nkro_track_make(void)
+{
+  uint16_t ps2_key;
+  bool release;
+
+  ps2_key = msx_pairing_key(&release);
+  msx_nkro_repeat = false;
+  if(ps2_key == MSX_PAIRING_FREE)
+    return;
+  if(release)
+  {
+    if(ps2_key == msx_nkro_last_make)
+      msx_nkro_last_make = MSX_PAIRING_FREE;
+    return;
+  }
+  //Typematic repeats the last pressed key. A make of a key still paired is taken as a repeat as well
+  msx_nkro_repeat = (ps2_key == msx_nkro_last_make);
+  for(uint8_t i = 0; (i < MSX_PAIRING_SLOTS) && !msx_nkro_repeat; i++)
+    msx_nkro_repeat = (msx_pairings[i].ps2_key == ps2_key);
+  msx_nkro_last_make = ps2_key;
+}
+
+
+void msxmap::msx_nkro_account(uint8_t key, bool paired)
+{
+  uint8_t y_local = (key & Y_LOCAL_MASK) >> NIBBLE, x_local = key & X_LOCAL_MASK;
+  uint8_t *refs;
+
+  if(y_local >= MSX_NKRO_COLUMNS)
+    return;                                   //CTRL, SHIFT and RUS/LAT lines follow their last update
+  refs = &msx_key_refs[y_local][x_local];
+  if(key & X_POLARITY_BIT_MASK)
+  {
+    if(*refs)
+      (*refs)--;
+    if(!*refs)
+      msx_modifier_pressed[y_local] &= (uint8_t)~(1 << x_local);
+    return;
+  }
+  if(msx_nkro_repeat)
+    return;
+  if(*refs < MSX_NKRO_MAX_REFS)
+    (*refs)++;
+  if(msx_nkro_modifier_dependent && !paired)
+    msx_modifier_pressed[y_local] |= (uint8_t)(1 << x_local);
+}
+
+
+void msxmap::msx_nkro_key(uint8_t y_local, uint8_t x_local, bool x_local_setb)
+{
+  uint8_t pressed = msx_pressed[y_local];
+  uint32_t column = 0;
+
+  if(!x_local_setb)
+    pressed |= (uint8_t)(1 << x_local);
+  else if(!msx_key_refs[y_local][x_local])
+    pressed &= (uint8_t)~(1 << x_local);
+  msx_pressed[y_local] = pressed;
+  for(uint8_t x = 0; x < 8; x++, pressed >>= 1)
+    column |= (pressed & 1) ? X_PRESS_BSRR[x] : X_RELEASE_BSRR[x];
+  x_bits[y_local] = column;
+}
+
+
+void msxmap::msx_nkro_release_modifier_dependent(void)
+{
+  uint8_t marked;
+
+  for(uint8_t y = 0; y < MSX_NKRO_COLUMNS; y++)
+  {
+    marked = msx_modifier_pressed[y];
+    if(!marked)
+      continue;
+    msx_modifier_pressed[y] = 0;
+    for(uint8_t x = 0; x < 8; x++)
+      if( (marked & (1 << x)) && msx_key_refs[y][x] )
+        msx_key_refs[y][x]--;
+    for(uint8_t x = 0; x < 8; x++)
+      if(marked & (1 << x))
+        compute_x_bits_and_check_interrupt_stuck(y, x, true);
+  }
+}
+#endif  //#if MSX_NKRO == true
+
 /*************************************************************************************************/
 /*************************************************************************************************/
 /******************************************* ISR's ***********************************************/
 /*************************************************************************************************/
 /*************************************************************************************************/
+#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
+//After the X write: the one test of the Y scan ISR's is msx_y_followed, whatever follows the reads
+void msx_y_served(uint16_t y)
+{
+#if MACROS == true
+  if(macro_unread)
+    macro_y_served((uint8_t)y);
+#endif  //#if MACROS == true
+#if AUTOFIRE == true
+  if(autofire_columns)
+    autofire_y_served((uint8_t)y);
+#endif  //#if AUTOFIRE == true
+#if SHIFT_SEQUENCER == true
+  if(msx_queue_unread && (y < 8))
+  {
+    msx_queue_unread &= (uint8_t)~(1 << y);
+    if(!msx_queue_unread)
+      main_event_set(EVT_SHIFT_SEQ);
+  }
+#endif  //#if SHIFT_SEQUENCER == true
+}
+#endif  //#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
+
 #if MCU == STM32F103
 void exti15_10_isr(void) // PC2 and PC3 - It works like interrupt on change of each one of Y connected pins
 {
@@ -1147,6 +1822,14 @@ void exti15_10_isr(void) // PC2 and PC3 - It works like interrupt on change of e
   msx_Y_scan = ((msx_Y_scan >> 8) & 0x3) | ((msx_Y_scan >> 9) & 0xC);
   
   GPIOB_BSRR = x_bits[msx_Y_scan]; //Atomic GPIOB update => Release and press MSX keys for this column
+#if LATENCY_TRACE == true
+  if(msx_Y_scan == latency_wait_y)
+    latency_y_served();
+#endif  //#if LATENCY_TRACE == true
+#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
+  if(msx_y_followed)
+    msx_y_served(msx_Y_scan);
+#endif  //#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
 
   //Debug & performance measurement
   gpio_set(Dbg_Yint_PORT, Dbg_Yint2and3_PIN); //Signs end of interruption. Default condition is "1"
@@ -1170,6 +1853,14 @@ void exti9_5_isr(void) // PC0 and PC1 - It works like interrupt on change of eac
   msx_Y_scan = ((msx_Y_scan >> 8) & 0x3) | ((msx_Y_scan >> 9) & 0xC);
 
   GPIOB_BSRR = x_bits[msx_Y_scan]; //Atomic GPIOB update => Release and press MSX keys for this column
+#if LATENCY_TRACE == true
+  if(msx_Y_scan == latency_wait_y)
+    latency_y_served();
+#endif  //#if LATENCY_TRACE == true
+#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
+  if(msx_y_followed)
+    msx_y_served(msx_Y_scan);
+#endif  //#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
 
   //Debug & performance measurement
   gpio_set(Dbg_Yint_PORT, Dbg_Yint0and1_PIN); //Signs end of interruption. Default condition is "1"
@@ -1202,6 +1893,17 @@ void exti9_5_isr(void) // PC3:0 - This ISR works like interrupt on change of eac
   }
 
   GPIO_BSRR (X_PORT) = X_BITS; //Atomic GPIOB update => Release and press MSX keys for this column. This ends time criticity.
+#if LATENCY_TRACE == true
+  if(msx_Y_scan == latency_wait_y)
+    latency_y_served();
+#endif  //#if LATENCY_TRACE == true
+#if USB_TELEMETRY == true
+  telemetry_y_reads++;
+#endif  //#if USB_TELEMETRY == true
+#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
+  if(msx_y_followed)
+    msx_y_served(msx_Y_scan);
+#endif  //#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
 
   //Performance measurement
   //GPIO_BSRR(Dbg_Yint_PORT) = Dbg_Yint_PIN; //Signs end of interruption. Default condition is "1". This line is useful only to measure performance.
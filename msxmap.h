@@ -55,10 +55,52 @@
 #include "ps2handl.h"
 #include "serial.h"
 #include "dbasemgt.h"
+#if CHORDS == true
+#include "chord.h"
+#endif  //#if CHORDS == true
+#if MACROS == true
+#include "macro.h"
+#endif  //#if MACROS == true
+#if AUTOFIRE == true
+#include "autofire.h"
+#endif  //#if AUTOFIRE == true
 
 //Use Tab width=2
 
 
+#if MSX_PAIRING == true
+#define MSX_PAIRING_SLOTS         8           //PS/2 keys held at once with their MSX keys recorded
+#define MSX_PAIRING_ACTIONS       2           //MSX keys put by a make: the two keys of a Database line
+#define MSX_PAIRING_FREE          0           //ps2_key of a free slot
+#define MSX_PAIRING_E0            0x100       //ps2_key of E0 prefixed keys
+
+/**
+ * MSX keys a held PS/2 key put on the matrix at its make, so its break undoes them without a new Database search.
+ * Actions are coded as the Database MSX keys: Y on bits 7-4, release on bit 3, X on bits 2-0.
+ */
+struct msx_pairing
+{
+  uint16_t ps2_key;                           //Last byte of the make code, plus MSX_PAIRING_E0 if E0 prefixed
+  uint8_t  n_actions;
+  uint8_t  actions[MSX_PAIRING_ACTIONS];
+};
+#endif  //#if MSX_PAIRING == true
+
+#if MSX_NKRO == true
+#if MSX_PAIRING != true
+#error "MSX_NKRO needs MSX_PAIRING: typematic repeats are told apart by their PS/2 key"
+#endif  //#if MSX_PAIRING != true
+#define MSX_NKRO_COLUMNS          8           //Y0 to Y7 are the matrix: Y8 and above are the CTRL, SHIFT and RUS/LAT lines
+#define MSX_NKRO_MAX_REFS         255
+#endif  //#if MSX_NKRO == true
+
+#if AUTOFIRE == true
+#if MSX_PAIRING != true
+#error "AUTOFIRE needs MSX_PAIRING: the break that stops it is told by its PS/2 key"
+#endif  //#if MSX_PAIRING != true
+#endif  //#if AUTOFIRE == true
+
+
 class msxmap
 {
 private:
@@ -75,6 +117,11 @@ public:
   */
   void msxqueuekeys(void);
   
+  /**
+   * Release all MSX keys, when PS/2 keyboard is lost or re-initialized
+  */
+  void msx_release_all_keys(void);
+
   /**
    * Get the PS/2 event and do a pre-filter
   */
@@ -84,6 +131,13 @@ public:
    * Convert from PS/2 event to MSX keyboard matrix
   */
   void msx_dispatch(void);
+
+  /**
+   * Convert from PS/2 event to MSX keyboard matrix, through a Database line out of the Database (RAM overlay)
+   *
+   * line The 8 columns of the line: scan code, control byte and MSX keys
+  */
+  void msx_dispatch(const uint8_t *line);
   
   /**
    * Check the availability MSX key in buffer, to implement a smooth typing.
@@ -111,6 +165,151 @@ public:
    * x_local_setb 0 if keypress or 1 if key release
   */  void compute_x_bits_and_check_interrupt_stuck ( 
           volatile uint8_t y_local, volatile uint8_t x_local, volatile bool x_local_setb);
+
+  /**
+   * Update the MSX key now, as compute_x_bits_and_check_interrupt_stuck(), recording it on the pairing of the make
+   * being dispatched.
+  */
+  void dispatch_key_now(uint8_t y_local, uint8_t x_local, bool x_local_setb);
+
+  /**
+   * Put the MSX key on the smooth typing buffer, as put_msx_disp_keys_queue_buffer(), recording it on the pairing of
+   * the make being dispatched.
+  */
+  void dispatch_key_queued(uint8_t key);
+
+#if MSX_PAIRING == true
+  /**
+   * PS/2 key of the mounted scan code.
+   *
+   * release Set true if it is a break code
+   * Returns the ps2_key of struct msx_pairing, or MSX_PAIRING_FREE if the scan code is not a make or break of one key
+  */
+  uint16_t msx_pairing_key(bool *release);
+
+  /**
+   * Take a slot to record what the make of the mounted scan code puts on the MSX matrix. Called before its dispatch.
+  */
+  void msx_pairing_begin(void);
+
+  /**
+   * Undo what the make of the mounted break code put on the MSX matrix, in reverse order. The SHIFT goes back to
+   * shiftstate, and keys the make released are not pressed again. When the smooth typing buffer has keys, the undo
+   * goes after them, so it never overtakes a queued press.
+   *
+   * Returns false if the make was not recorded (the Database has to be searched)
+  */
+  bool msx_pairing_release(void);
+#endif  //#if MSX_PAIRING == true
+
+#if MSX_NKRO == true
+  /**
+   * Follow the make of the mounted scan code, to tell typematic repeats apart: a repeat does not take a new
+   * reference of its MSX keys. Called before the break pairing and the Database search.
+  */
+  void msx_nkro_track_make(void);
+
+  /**
+   * Count the holders of a MSX matrix key, when it is dispatched (now or queued).
+   *
+   * key MSX key coded as the Database: Y on bits 7-4, release on bit 3, X on bits 2-0
+   * paired true if the make that presses it is recorded on the pairing table
+  */
+  void msx_nkro_account(uint8_t key, bool paired);
+
+  /**
+   * Press or release a MSX matrix key on the pressed set, and rebuild the word of its column. A release
+   * is kept pressed while other PS/2 keys hold it.
+  */
+  void msx_nkro_key(uint8_t y_local, uint8_t x_local, bool x_local_setb);
+
+  /**
+   * On release of Shift, Ctrl, Graph or Code, release only the keys whose make mapped by the modifiers
+   * and was not paired: their breaks may map to other MSX keys. Other held keys stay pressed.
+  */
+  void msx_nkro_release_modifier_dependent(void);
+#endif  //#if MSX_NKRO == true
+
+#if CHORDS == true
+  /**
+   * Run the action of a chord fired by chord_event(): reset, NumLock toggle, layout switch or a press and release
+   * of a MSX key (through the smooth typing buffer).
+  */
+  void msx_chord_action(const struct chord *fired);
+
+  /**
+   * Switch between the Database selected by database_setup() and the built-in one (DEFAULT_MSX_KEYB_DATABASE_CONVERSION),
+   * with all MSX keys released. The chords are loaded again from the new one.
+  */
+  void msx_layout_switch(void);
+#endif  //#if CHORDS == true
+
+#if MACROS == true
+  /**
+   * Put on the MSX matrix the keys of the macro being played, each one when MSX has read the whole matrix since the
+   * former one. Called from main loop on EVT_MACRO and EVT_SYSTICK.
+  */
+  void msx_macro_poll(void);
+#endif  //#if MACROS == true
+
+#if AUTOFIRE == true
+  /**
+   * Start the autofire of the mounted make, when its Database line has a period on the control byte: case type 0
+   * only, on its first MSX key. Called before its dispatch and pairing.
+   *
+   * Returns true if it is a typematic repeat of a key on autofire, that must not be dispatched
+  */
+  bool msx_autofire_make(const uint8_t *line);
+
+  /**
+   * Stop the autofire of the mounted break, with its MSX key pressed again if the autofire left it released, so
+   * the break releases it as any other key. Called before the break pairing.
+  */
+  void msx_autofire_break(void);
+
+  /**
+   * Toggle the autofire keys whose column MSX read their period times since the last toggle. Called from main loop on
+   * EVT_AUTOFIRE.
+  */
+  void msx_autofire_poll(void);
+
+  /**
+   * Press or release an autofire key on the MSX matrix, out of the pressed set references: the PS/2 key holding it
+   * is still down.
+  */
+  void msx_autofire_put(uint8_t key);
+#endif  //#if AUTOFIRE == true
+
+#if SHIFT_SEQUENCER == true
+  /**
+   * Tell if smooth typing keys are queued, or the last one is still waiting for its MSX reads. Keys dispatched now
+   * go behind them.
+  */
+  bool msx_shift_seq_busy(void);
+
+  /**
+   * Start waiting the MSX reads of a key just put on the matrix: its column, or the whole matrix for the CTRL, SHIFT
+   * and RUS/LAT lines. The next smooth typing key goes when they were read, or after MAX_TIME_OF_IDLE_KEYSCAN_SYSTICKS.
+   *
+   * key MSX key coded as the Database: Y on bits 7-4, release on bit 3, X on bits 2-0
+   * Returns false if MSX is not scanning: no wait is started
+  */
+  bool msx_shift_seq_arm(uint8_t key);
+
+  /**
+   * Put on the matrix the next smooth typing key, once MSX read what the former one waited for. Called from main loop
+   * on EVT_SHIFT_SEQ.
+  */
+  void msx_shift_seq_poll(void);
+#endif  //#if SHIFT_SEQUENCER == true
+
+#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
+  /**
+   * Tell the Y scan ISR's whether the macro player, the autofire or the smooth typing follow the MSX reads: they test
+   * only it. Called with SysTick disabled, as its msxqueuekeys() may set msx_y_followed meanwhile.
+  */
+  void msx_y_follow(void);
+#endif  //#if (MACROS == true) || (AUTOFIRE == true) || (SHIFT_SEQUENCER == true)
 };
 
 
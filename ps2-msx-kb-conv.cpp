@@ -65,11 +65,33 @@
 #include "cdcacm.h"
 #endif  //#if USE_USB == true
 #include "version.h"
+#include "console.h"
+#include "boot_trace.h"
+#include "main_events.h"
+#if LATENCY_TRACE == true
+#include "latency.h"
+#endif  //#if LATENCY_TRACE == true
+#if DB_REMAP == true
+#include "remap.h"
+#endif  //#if DB_REMAP == true
+#if CHORDS == true
+#include "chord.h"
+#endif  //#if CHORDS == true
+#if LAYERS == true
+#include "layer.h"
+#endif  //#if LAYERS == true
+#if MACROS == true
+#include "macro.h"
+#endif  //#if MACROS == true
+#if USB_TELEMETRY == true
+#include "telemetry.h"
+#endif  //#if USB_TELEMETRY == true
 
 //#define DO_PRAGMA(x) _Pragma (#x)
 //#define TODO(x) DO_PRAGMA(message (#x))
 
 #define  DELAY_JHONSON  6
+#define  JHONSON_STEPS  7   //Led states of the human led test, each one lasting DELAY_JHONSON ticks
 
 //Variáveis globais
 extern uint32_t systicks;                         //Declared on sys_timer.cpp
@@ -84,6 +106,7 @@ extern bool     compatible_database;              //Declared on msxmap.cpp
 extern uint8_t  scancode[4];                      //Declared on msxmap.cpp
 extern uint32_t formerscancode;                   //Declared on msxmap.cpp
 extern bool     do_next_keep_alive;               //Declared on msxmap.cpp
+extern bool     ps2_keyb_replugged;               //Declared on ps2handl.c
 extern uint8_t  serial_no[LEN_SERIAL_No + 1];     //Declared on serial_no.c
 #if USE_USB == true
 extern int      usb_configured;                   //Declared on cdcacm.c
@@ -91,8 +114,19 @@ int             usb_configured_prev;
 #endif  //#if USE_USB === true
 
 
+//Led states of the human led test (Jhonson Counter mode): bit 0=Num, bit 1=Caps, bit 2=Scroll
+const uint8_t jhonson_leds[JHONSON_STEPS] = {0b000, 0b001, 0b011, 0b111, 0b110, 0b100, 0b000};
+
+
+enum PS2_DETECT_STATUS ps2_detect_status = PS2_DETECT_RUNNING;
+bool            ps2_keyb_reinit;                  //Detection is recovering a keyboard after boot
+
+
 //Prototype area
 void end_of_code(uint32_t*);
+void update_database_and_halt(void);
+void boot_database_reset(void);
+void keyboard_reinit(bool power_cycle);
 
 int main(void)
 {
@@ -128,7 +162,21 @@ int main(void)
   rcc_periph_clock_enable(RCC_GPIOB);
   rcc_periph_clock_enable(RCC_GPIOC);
 
+  //The boot is a set of concurrent jobs: USB enumeration, PS/2 keyboard BAT and detection run in background,
+  //while the MSX matrix is already served (released) and the database is validated.
+  //High Resolution Timer is the time base of the boot timeline, so it is configured first.
+  //It also handles PS/2 Clock interrupts (via CC) and micro second Delay.
+  tim_hr_setup(TIM_HR);
+  boot_mark("Clocks and TIM_HR");
+
+  //MSX interface is put live as soon as possible, with all keys released (x_bits = ALL_X_SET)
+  msxmap object;
+  object.msx_interface_setup();
+  boot_mark("MSX interface live");
+
+  //Keyboard starts its BAT (up to 2.5s) here
   power_on_ps2_keyboard();
+  boot_mark("PS/2 powered up");
 
   //Debug & performance measurement
   general_debug_setup();
@@ -142,9 +190,9 @@ int main(void)
   serial_setup();
 
 #if USE_USB == true
+  //USB is enumerated in background. Main loop informs when it is concluded.
   cdcacm_init();
-  //Give some time to USB be enumerated and recognized by the OS and terminal app
-  for (uint32_t i = 0; i < 0x4000000; i++) __asm__("nop");
+  boot_mark("USB enumeration started");
 #endif  //#if USE_USB == true
 
   con_send_string((uint8_t*)"\r\n\n\r\nPS/2 to MSX Keyboard Converter " FIRMWARE_VERSION);
@@ -202,7 +250,7 @@ int main(void)
   if(usb_configured)
     con_send_string((uint8_t*)". USB has been enumerated => Console and UART are over USB;\r\n");
   else
-    con_send_string((uint8_t*)". USB host not found => Using Console over UART;\r\n. USB not disabled\r\n");
+    con_send_string((uint8_t*)". USB enumeration in progress => Using Console over UART meanwhile;\r\n");
 #else //#if USE_USB == true
   con_send_string((uint8_t*)". Non USB version => Console is over UART.\r\n");
 #endif  //#if USE_USB == true
@@ -215,90 +263,103 @@ int main(void)
   con_send_string((uint8_t*)". ARM System Timer;\r\n");
 
   systick_setup();
+  main_events_setup();
   
   con_send_string((uint8_t*)". Independent Watch Dog Timer;\r\n");
 
   // Turn on the Independent WatchDog Timer
   iwdg_set_period_ms(100);  // 3 x sys_timer
   iwdg_start();
+  boot_mark("Systick and IWDG");
 
   con_send_string((uint8_t*)". High resolution Timer;\r\n");
+  con_send_string((uint8_t*)". 5V compatible pin ports and interrupts to interface to MSX (all keys released);\r\n");
 
-  // Now configure High Resolution Timer for PS/2 Clock interrupts (via CC) and micro second Delay
-  tim_hr_setup(TIM_HR);
-
-  con_send_string((uint8_t*)". PS/2 Port: Waiting up to 2.5s (75 ticks) with powered on keyboard\r\n");
-  con_send_string((uint8_t*)"  to proceed BAT: |.....|\r  to proceed BAT: |");
-
-  ps2_keyb_detect();
+  con_send_string((uint8_t*)". PS/2 Port: Waiting up to 2.5s (75 ticks) in background with powered on keyboard to proceed BAT;\r\n");
+  ps2_keyb_detect_start();
 
   con_send_string((uint8_t*)". Database with know-how to manage and interface PS/2 Keyboard to MSX:\r\n");
   //Check the Database version, get y_dummy, ps2numlockstate and enable_xon_xoff
   database_setup();
-
-  con_send_string((uint8_t*)". 5V compatible pin ports and interrupts to interface to MSX.\r\n");
-
-  msxmap object;
-  object.msx_interface_setup();
-
-  if (!compatible_database || !ps2_keyb_detected)
-  {
-    //Here it will allow update the Database Conversion, as the PS/2 keyboard was not detected
-    //or Database is incompatible, so at this point, this module is not working as target planned.
-
-    //No PS/2 keyboard, so power off the port.
-    power_off_ps2_keyboard();
-
-    //Init procedure to fillin MSXTABLE by receiving an INTEL HEX through USART1
-    //Disables all interrupts but systicks and USART
-    exti_disable_request(Y3_exti | Y2_exti | Y1_exti | Y0_exti);
-    timer_disable_irq(TIM_HR, TIM_DIER_CC1IE | TIM_DIER_UIE);
-    exti_disable_request(PS2_CLK_I_EXTI);
-
-    //Read the MSX Database Table Intel Hex by serial (or USB when available) and flashes 2560 bytes, from 0x08007600 to 0x08007FFF
-    //Up to 3 databases can be put in flash without need to erase. It is automatically managed.
-    flash_rw();
-
-    //Halt here.
-    for(;;);
-  }
-
-  con_send_string((uint8_t*)"\r\nBoot complete. Be welcome!\r\n");
-
-  //Test keyboard leds for humans, using Jhonson Counter mode.
-  uint32_t systicks_base = systicks;
-  ps2_update_leds(false, false, false);
-  while (systicks < (systicks_base + 1 * DELAY_JHONSON)) __asm("nop");
-
-  ps2_update_leds(true, false, false);
-  while (systicks < (systicks_base + 2 * DELAY_JHONSON)) __asm("nop");
-
-  ps2_update_leds(true, true, false);
-  while (systicks < (systicks_base + 3 * DELAY_JHONSON)) __asm("nop");
-
-  ps2_update_leds(true, true, true);
-  while (systicks < (systicks_base + 4 * DELAY_JHONSON)) __asm("nop");
-
-  ps2_update_leds(false, true, true);
-  while (systicks < (systicks_base + 5 * DELAY_JHONSON)) __asm("nop");
-
-  ps2_update_leds(false, false, true);
-  while (systicks < (systicks_base + 6 * DELAY_JHONSON)) __asm("nop");
-
-  ps2_update_leds(false, false, false);
-  while (systicks < (systicks_base + 7 * DELAY_JHONSON)) __asm("nop");
+  boot_mark("Database validated");
+#if DB_REMAP == true
+  remap_setup();
+#endif  //#if DB_REMAP == true
+#if CHORDS == true
+  chord_setup();
+#endif  //#if CHORDS == true
+#if LAYERS == true
+  layer_setup();
+#endif  //#if LAYERS == true
+#if MACROS == true
+  macro_setup();
+#endif  //#if MACROS == true
+#if USB_TELEMETRY == true
+  telemetry_setup();
+#endif  //#if USB_TELEMETRY == true
+
+  if (!compatible_database)
+    update_database_and_halt();
 
 
   /*********************************************************************************************/
   /************************************** Main Loop ********************************************/
   /*********************************************************************************************/
   uint32_t* ptr_scancode = (uint32_t*)scancode;
+  uint8_t jhonson_step = JHONSON_STEPS + 1;   //Led test is not running
+  uint32_t systicks_base = 0;
+  uint32_t events;
   for(;;)
   {
+    //Sleep until an ISR raises an event: PS/2 frame, console RX, USB, systick or led change
+    events = main_event_wait();
+
+    //While the boot or a keyboard recovery is not complete, only follows PS/2 keyboard detection
+    if (ps2_detect_status == PS2_DETECT_RUNNING)
+    {
+      if (events & (EVT_PS2 | EVT_SYSTICK))
+        ps2_detect_status = ps2_keyb_detect_poll();
+      if (ps2_detect_status == PS2_DETECT_FAILED)
+      {
+        if (!ps2_keyb_reinit)
+        {
+          boot_database_reset();
+          update_database_and_halt();
+        }
+        //Keyboard is still unplugged or hung: keep trying until it comes back
+        ps2_keyb_redetect_start(true);
+        ps2_detect_status = PS2_DETECT_RUNNING;
+      }
+      else if (ps2_detect_status == PS2_DETECT_OK && ps2_keyb_reinit)
+      {
+        ps2_keyb_reinit = false;
+        con_send_string((uint8_t*)"Keyboard re-initialized.\r\n");
+        //Restore keyboard leds
+        update_ps2_leds = true;
+      }
+      else if (ps2_detect_status == PS2_DETECT_OK)
+      {
+        boot_database_reset();
+        boot_mark("Boot complete");
+        con_send_string((uint8_t*)"\r\nBoot complete. Be welcome!\r\n");
+        //Test keyboard leds for humans, using Jhonson Counter mode.
+        systicks_base = systicks;
+        jhonson_step = 0;
+      }
+    }
+    //Keyboard was replugged (or reset itself): recover it without MCU reset
+    else if (ps2_keyb_replugged)
+    {
+      con_send_string((uint8_t*)"\r\nKeyboard BAT received: Re-initializing it.\r\n");
+      keyboard_reinit(false);
+    }
     //The first functionality running in the main loop
-    //New key processing:
-    if (mount_scancode())
+    //New key processing (systick also samples MSX Caps and Kana led pins):
+    else if ((events & (EVT_PS2 | EVT_SYSTICK)) && mount_scancode())
     {
+#if LATENCY_TRACE == true
+      latency_scancode_mounted(*ptr_scancode);
+#endif  //#if LATENCY_TRACE == true
       //At this point, we already have the assembled compound keys code, so
       //to avoid unnecessary processing at convert2msx, check if this last scancode
       //is different from the former one.
@@ -330,26 +391,66 @@ int main(void)
       //Now we can reset to prepair to do a new mount_scancode (Clear to read a new key press or release)
       *ptr_scancode = 0;
       mount_scancode_OK = false;
+      //ps2_recv_buffer may have more bytes: do another pass before sleep
+      main_event_set(EVT_PS2);
     } //if (mount_scancode())
 
+#if MACROS == true
+    //Macro playback: the next MSX key, once MSX read the whole matrix since the former one
+    if(events & (EVT_MACRO | EVT_SYSTICK))
+    {
+      msxmap objeto;
+      objeto.msx_macro_poll();
+    }
+#endif  //#if MACROS == true
+#if AUTOFIRE == true
+    //Autofire: toggles the held keys whose column MSX read their period times
+    if(events & EVT_AUTOFIRE)
+    {
+      msxmap objeto;
+      objeto.msx_autofire_poll();
+    }
+#endif  //#if AUTOFIRE == true
+#if SHIFT_SEQUENCER == true
+    //Smooth typing: the next queued key, once MSX read the former one (a shift change, the whole matrix)
+    if(events & EVT_SHIFT_SEQ)
+    {
+      msxmap objeto;
+      objeto.msx_shift_seq_poll();
+    }
+#endif  //#if SHIFT_SEQUENCER == true
+
     //If keyboard is not responding to commands, reinit it through reset
-    if(!(systicks & (uint32_t)0x7F))
-    { //each ~4s (128 * 1/30)
-      if(do_next_keep_alive)  //when time comes up, do it just once
-      {
-        do_next_keep_alive = false;
-        if(!keyboard_check_alive())
+    if(events & EVT_SYSTICK)
+    {
+      if(ps2_detect_status != PS2_DETECT_RUNNING && !(systicks & (uint32_t)0x7F))
+      { //each ~4s (128 * 1/30)
+        if(do_next_keep_alive)  //when time comes up, do it just once
         {
-          con_send_string((uint8_t*)"Keyboard is non responsive (KeepAlive): Reset requested by the system.\r\n");
-          reset_requested();
+          do_next_keep_alive = false;
+          if(!keyboard_check_alive())
+          {
+            con_send_string((uint8_t*)"Keyboard is non responsive (KeepAlive): Re-initializing it.\r\n");
+            keyboard_reinit(true);
+          }
         }
       }
+      else
+        do_next_keep_alive = true;
     }
-    else
-      do_next_keep_alive = true;
 
     //The second functionality running in main loop: Update the keyboard leds
-    if( !command_running  &&    //Only does led update when the previous one is concluded
+    if(jhonson_step <= JHONSON_STEPS)
+    { //Led test for humans: each state lasts DELAY_JHONSON ticks
+      if( !command_running && (systicks - systicks_base) >= (uint32_t)(jhonson_step * DELAY_JHONSON) )
+      {
+        if(jhonson_step < JHONSON_STEPS)
+          ps2_update_leds(jhonson_leds[jhonson_step] & 0b001, jhonson_leds[jhonson_step] & 0b010,
+                          jhonson_leds[jhonson_step] & 0b100);
+        jhonson_step++;
+      }
+    }
+    else if( !command_running  &&    //Only does led update when the previous one is concluded
         update_ps2_leds )
     {
       update_ps2_leds = false;
@@ -358,23 +459,28 @@ int main(void)
       ps2_update_leds(ps2numlockstate, caps_state, !kana_state);
     } //if ( update_ps2_leds || (caps_state != caps_former) || (kana_state != kana_former) )
 
-    //Keep RX serial buffer empty and echoes to output
-    while(con_available_get_char())
-    {
-      uint8_t ch, m_str[4];
-
-      ch = con_get_char();
-      m_str[0] = ch;
-      m_str[1] = 0;
-      //Don't send X_OFF to avoid to lock the remote terminal, if it has X_ON/X_OFF enabled
-      if(ch != X_OFF)
-        con_send_string(m_str);
-      else
-        con_send_string((uint8_t*)"<X_OFF>");
-    }
+#if LATENCY_TRACE == true
+    //Accumulates the last key event latency, if MSX has already read it
+    latency_poll();
+#endif  //#if LATENCY_TRACE == true
+
+#if USB_TELEMETRY == true
+    //Scan rate and queue depths once per SysTick. An idle telemetry endpoint is restarted here, and then its IN
+    //callback sends the ring as it fills
+    if(events & EVT_SYSTICK)
+      telemetry_sample();
+#if USE_USB == true
+    cdcacm_telemetry_poll();
+#endif  //#if USE_USB == true
+#endif  //#if USB_TELEMETRY == true
+
+    //Keep RX serial buffer empty, echoes to output and runs the diagnostic commands. Not during the boot
+    //detection: a character sent then asks database_reset_request() for the factory reset
+    if( (events & (EVT_CON_RX | EVT_SYSTICK)) && !((ps2_detect_status == PS2_DETECT_RUNNING) && !ps2_keyb_reinit) )
+      console_poll();
 
 #if USE_USB == true
-    if(!usb_configured_prev && usb_configured)
+    if((events & EVT_USB) && !usb_configured_prev && usb_configured)
       con_send_string((uint8_t*)"\r\n\n. USB has been enumerated => Console and UART are now over USB!\r\n");
     usb_configured_prev = usb_configured;
 #endif  //#if USE_USB = true
@@ -384,6 +490,51 @@ int main(void)
   return 0; //Suppose never reach here
 } //int main(void)
 
+/// @brief Database update mode: the PS/2 keyboard was not detected or Database is incompatible,
+/// so this module is not working as target planned. It allows update the Database Conversion and halts.
+void update_database_and_halt(void)
+{
+  //No PS/2 keyboard, so power off the port.
+  power_off_ps2_keyboard();
+
+  //Init procedure to fillin MSXTABLE by receiving an INTEL HEX through USART1
+  //Disables all interrupts but systicks and USART
+  exti_disable_request(Y3_exti | Y2_exti | Y1_exti | Y0_exti);
+  timer_disable_irq(TIM_HR, TIM_DIER_CC1IE | TIM_DIER_UIE);
+  exti_disable_request(PS2_CLK_I_EXTI);
+
+  //Read the MSX Database Table Intel Hex by serial (or USB when available) and flashes 2560 bytes, from 0x08007600 to 0x08007FFF
+  //Up to 3 databases can be put in flash without need to erase. It is automatically managed.
+  flash_rw();
+
+  //Halt here.
+  for(;;);
+}
+
+/// @brief Runs the Database reset the user may have asked while the boot detection of the keyboard was running.
+void boot_database_reset(void)
+{
+  if (!database_reset_request())
+    return;
+  //The flash was erased: select the Database again
+  database_setup();
+  if (!compatible_database)
+    update_database_and_halt();
+}
+
+/// @brief Recovers the PS/2 keyboard in background, while MSX interface keeps running.
+///
+/// @param power_cycle True to power cycle the PS/2 port (non responsive keyboard)
+void keyboard_reinit(bool power_cycle)
+{
+  //Keys held on the lost keyboard will not be released by it anymore
+  msxmap object;
+  object.msx_release_all_keys();
+  ps2_keyb_reinit = true;
+  ps2_keyb_redetect_start(power_cycle);
+  ps2_detect_status = PS2_DETECT_RUNNING;
+}
+
 /// @brief Mark an end of code
 ///
 /// @param *reset_org Pointer to get which was the cause of reset
@@ -0,0 +1,304 @@
+/** @addtogroup 18 ps2trace PS/2 Byte Stream Recorder
+ *
+ * @file ps2_trace.c Record and replay of timestamped PS/2 byte streams.
+ *
+ * @brief <b>Record and replay of timestamped PS/2 byte streams.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * The console is a text channel (con_send_string() stops on a zero byte, and a terminal may
+ * translate control chars), so the binary trace is dumped inside Intel Hex records, as the
+ * Database travels the other way. The records can be captured from any terminal log.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#include <string.h>
+
+#include "ps2_trace.h"
+#include "ps2handl.h"
+#include "console.h"
+#include "main_events.h"
+
+
+#define PS2_TRACE_PLAY_LEAD       1000        //us from the play command to the first byte
+
+
+//Global vars
+uint32_t ps2_trace_ring[PS2_TRACE_RING_SIZE];
+volatile uint32_t ps2_trace_total;                //Entries recorded since start: the next one goes to total % SIZE
+volatile uint32_t ps2_trace_last;                 //TIM_HR of the last entry
+volatile bool ps2_trace_recording;
+volatile bool ps2_trace_play_running;
+ps2_trace_source ps2_trace_play_source;
+uint16_t ps2_trace_play_speed;
+uint32_t ps2_trace_play_entry;                    //Next entry to be put on ps2_recv_buffer
+uint32_t ps2_trace_play_deadline;                 //TIM_HR of it
+uint32_t ps2_trace_play_read, ps2_trace_play_end; //Ring source window
+
+
+//Local prototypes
+uint32_t ps2_trace_entries(void);
+bool ps2_trace_ring_source(uint32_t *entry);
+void ps2_trace_play_step(void);
+uint8_t ps2_trace_image_byte(uint32_t offset);
+void ps2_trace_dump(void);
+
+
+void ps2_trace_record(uint8_t data)
+{
+  uint32_t now, delta;
+
+  if(!ps2_trace_recording)
+    return;
+  now = hr_timer_now();
+  delta = now - ps2_trace_last;
+  ps2_trace_last = now;
+  if(delta > PS2_TRACE_MAX_DELTA)
+    delta = PS2_TRACE_MAX_DELTA;
+  ps2_trace_ring[ps2_trace_total & (PS2_TRACE_RING_SIZE - 1)] = PS2_TRACE_ENTRY(delta, data);
+  ps2_trace_total++;
+}
+
+
+void ps2_trace_start(void)
+{
+  //PS/2 clock ISR is the only writer, and it tests ps2_trace_recording first
+  ps2_trace_recording = false;
+  ps2_trace_total = 0;
+  ps2_trace_last = hr_timer_now();
+  ps2_trace_recording = true;
+}
+
+
+void ps2_trace_stop(void)
+{
+  ps2_trace_recording = false;
+}
+
+
+uint32_t ps2_trace_entries(void)
+{
+  return (ps2_trace_total > PS2_TRACE_RING_SIZE) ? PS2_TRACE_RING_SIZE : ps2_trace_total;
+}
+
+
+bool ps2_trace_ring_source(uint32_t *entry)
+{
+  if(ps2_trace_play_read == ps2_trace_play_end)
+    return false;
+  *entry = ps2_trace_ring[ps2_trace_play_read & (PS2_TRACE_RING_SIZE - 1)];
+  ps2_trace_play_read++;
+  return true;
+}
+
+
+bool ps2_trace_play(ps2_trace_source source, uint16_t speed)
+{
+  if(ps2_trace_play_running)
+    return false;
+  ps2_trace_stop();
+  if(source == NULL)
+  {
+    ps2_trace_play_end = ps2_trace_total;
+    ps2_trace_play_read = ps2_trace_play_end - ps2_trace_entries();
+    source = ps2_trace_ring_source;
+  }
+  if(!source(&ps2_trace_play_entry))
+    return false;
+  ps2_trace_play_source = source;
+  ps2_trace_play_speed = speed ? speed : 1;
+  //The first delta is relative to an event out of the trace
+  ps2_trace_play_deadline = hr_timer_now() + PS2_TRACE_PLAY_LEAD;
+  ps2_trace_play_running = true;
+  if(hr_timer_start(PS2_TRACE_PLAY_LEAD, ps2_trace_play_step) == HR_TIMER_NONE)
+  {
+    ps2_trace_play_running = false;
+    return false;
+  }
+  return true;
+}
+
+
+bool ps2_trace_playing(void)
+{
+  return ps2_trace_play_running;
+}
+
+
+//TIM_HR callback: same priority of PS/2 clock ISR, as ps2_recv_put() requires
+void ps2_trace_play_step(void)
+{
+  int32_t wait;
+
+  ps2_recv_put(PS2_TRACE_DATA(ps2_trace_play_entry));
+  main_event_set(EVT_PS2);
+  if(!ps2_trace_play_source(&ps2_trace_play_entry))
+  {
+    ps2_trace_play_running = false;
+    return;
+  }
+  //Deadlines are kept on the original time line, so the callback latency does not accumulate
+  ps2_trace_play_deadline += PS2_TRACE_DELTA(ps2_trace_play_entry) / ps2_trace_play_speed;
+  wait = (int32_t)(ps2_trace_play_deadline - hr_timer_now());
+  if(hr_timer_start((wait > 0) ? (uint32_t)wait : 0, ps2_trace_play_step) == HR_TIMER_NONE)
+    ps2_trace_play_running = false;
+}
+
+
+//Byte of the binary trace (header and little endian entries) at offset
+uint8_t ps2_trace_image_byte(uint32_t offset)
+{
+  uint32_t entries = ps2_trace_entries();
+  uint32_t lost = ps2_trace_total - entries;
+  uint32_t entry;
+
+  if(offset >= PS2_TRACE_HEADER_SIZE)
+  {
+    offset -= PS2_TRACE_HEADER_SIZE;
+    entry = ps2_trace_ring[(ps2_trace_total - entries + offset / 4) & (PS2_TRACE_RING_SIZE - 1)];
+    return (uint8_t)(entry >> (8 * (offset & 3)));
+  }
+  switch(offset)
+  {
+    case 0:
+      return 'P';
+    case 1:
+      return 'S';
+    case 2:
+      return '2';
+    case 3:
+      return 'T';
+    case 4:
+      return PS2_TRACE_VERSION;
+    case 5:
+      return lost ? PS2_TRACE_FLAG_WRAPPED : 0;
+    case 8: case 9: case 10: case 11:
+      return (uint8_t)(entries >> (8 * (offset - 8)));
+    case 12: case 13: case 14: case 15:
+      return (uint8_t)(lost >> (8 * (offset - 12)));
+    default:
+      return 0;
+  }
+}
+
+
+//Intel Hex records from address 0: the trace is smaller than 64KB, so no extended address record is needed
+void ps2_trace_dump(void)
+{
+  uint32_t size = PS2_TRACE_HEADER_SIZE + 4 * ps2_trace_entries();
+  uint8_t line[1 + 2 * (4 + PS2_TRACE_HEX_RECORD + 1) + 3], len, sum, data;
+
+  for(uint32_t offset = 0; offset < size; offset += len)
+  {
+    len = ((size - offset) > PS2_TRACE_HEX_RECORD) ? PS2_TRACE_HEX_RECORD : (uint8_t)(size - offset);
+    sum = len + (uint8_t)(offset >> 8) + (uint8_t)offset;
+    line[0] = ':';
+    conv_uint8_to_2a_hex(len, &line[1]);
+    conv_uint16_to_4a_hex((uint16_t)offset, &line[3]);
+    conv_uint8_to_2a_hex(0, &line[7]);
+    for(uint8_t i = 0; i < len; i++)
+    {
+      data = ps2_trace_image_byte(offset + i);
+      sum += data;
+      conv_uint8_to_2a_hex(data, &line[9 + 2 * i]);
+    }
+    conv_uint8_to_2a_hex((uint8_t)(0 - sum), &line[9 + 2 * len]);
+    line[11 + 2 * len] = '\r';
+    line[12 + 2 * len] = '\n';
+    line[13 + 2 * len] = 0;
+    con_send_string(line);
+  }
+  con_send_string((uint8_t*)":00000001FF\r\n");
+}
+
+
+void ps2_trace_console_cmd(uint8_t *args)
+{
+  uint8_t *word = console_next_word(&args);
+  uint8_t mountstring[16];
+  uint32_t speed = 1;
+
+  if(strcmp((const char*)word, "start") == 0)
+  {
+    if(ps2_trace_play_running)
+    {
+      con_send_string((uint8_t*)"Replay running.\r\n");
+      return;
+    }
+    ps2_trace_start();
+    con_send_string((uint8_t*)"Recording PS/2 bytes.\r\n");
+    return;
+  }
+  if(strcmp((const char*)word, "stop") == 0)
+  {
+    ps2_trace_stop();
+    con_send_string((uint8_t*)"Recording stopped.\r\n");
+    return;
+  }
+  if(strcmp((const char*)word, "dump") == 0)
+  {
+    //Entries must not move while they are sent
+    ps2_trace_stop();
+    ps2_trace_dump();
+    return;
+  }
+  if(strcmp((const char*)word, "play") == 0)
+  {
+    word = console_next_word(&args);
+    if( *word && (!console_word_to_uint32(word, &speed) || !speed || (speed > PS2_TRACE_MAX_SPEED)) )
+    {
+      con_send_string((uint8_t*)"Usage: ps2rec play [speed 1-1000]\r\n");
+      return;
+    }
+    if(!ps2_trace_play(NULL, (uint16_t)speed))
+      con_send_string((uint8_t*)"Nothing to replay.\r\n");
+    else
+      con_send_string((uint8_t*)"Replaying.\r\n");
+    return;
+  }
+
+  con_send_string((uint8_t*)"Recording: ");
+  con_send_string((uint8_t*)(ps2_trace_recording ? "on" : "off"));
+  con_send_string((uint8_t*)", replay: ");
+  con_send_string((uint8_t*)(ps2_trace_play_running ? "running" : "idle"));
+  con_send_string((uint8_t*)"\r\nEntries: ");
+  conv_uint32_to_dec(ps2_trace_entries(), mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)" of ");
+  conv_uint32_to_dec(PS2_TRACE_RING_SIZE, mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)", lost (overwritten): ");
+  conv_uint32_to_dec(ps2_trace_total - ps2_trace_entries(), mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)"\r\n");
+}
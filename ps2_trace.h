@@ -0,0 +1,136 @@
+/** @defgroup 18 ps2trace PS/2 Byte Stream Recorder
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file ps2_trace.h Record and replay of timestamped PS/2 byte streams.
+ *
+ * @brief <b>Record and replay of timestamped PS/2 byte streams. Header file of ps2_trace.c.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * Each byte the PS/2 clock ISR puts on ps2_recv_buffer is recorded on a RAM ring, with the time
+ * elapsed since the former one, from the 1MHz TIM_HR counter. The ring is dumped on console as
+ * Intel Hex records of a binary trace, and it may be replayed through the converter, at the original
+ * or at an accelerated speed. host/ps2-replay-host replays dumped traces through the host build.
+ *
+ * Binary trace (little endian):
+ * - Header (PS2_TRACE_HEADER_SIZE bytes): "PS2T", version, flags, 2 reserved, entries (uint32_t),
+ *   lost entries (uint32_t, overwritten by newer ones);
+ * - Entries (uint32_t): bits 31-8 time since the former byte in us (saturated, first one is
+ *   meaningless), bits 7-0 the PS/2 byte.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined PS2_TRACE_H
+#define PS2_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "system.h"
+#include "hr_timer.h"
+#include "serial.h"
+
+
+/** PS/2 trace sizes and format
+@{*/
+#if MCU == STM32F401
+#define PS2_TRACE_RING_SIZE       4096        //Entries (16KB). Must be a power of 2
+#else   //#if MCU == STM32F401
+#define PS2_TRACE_RING_SIZE       128         //Entries (512 bytes). Must be a power of 2
+#endif  //#if MCU == STM32F401
+#define PS2_TRACE_HEADER_SIZE     16
+#define PS2_TRACE_VERSION         1
+#define PS2_TRACE_FLAG_WRAPPED    (1 << 0)    //Oldest entries were overwritten
+#define PS2_TRACE_MAX_DELTA       0xFFFFFF    //Longer idle times are saturated (16.7s)
+#define PS2_TRACE_MAX_SPEED       1000
+#define PS2_TRACE_HEX_RECORD      32          //Data bytes per Intel Hex record of the dump
+#define PS2_TRACE_ENTRY(delta, data)  (((uint32_t)(delta) << 8) | (uint8_t)(data))
+#define PS2_TRACE_DELTA(entry)    ((entry) >> 8)
+#define PS2_TRACE_DATA(entry)     ((uint8_t)(entry))
+/**@}*/
+
+/** Source of entries to be replayed: returns false at the end of the trace */
+typedef bool (*ps2_trace_source)(uint32_t *entry);
+
+/**
+ * @brief Records a PS/2 byte, if recording is on. Called from ps2_clock_receive().
+ *
+ * @param data PS/2 byte received.
+ */
+void ps2_trace_record(uint8_t data);
+
+/**
+ * @brief Clears the ring and starts recording.
+ */
+void ps2_trace_start(void);
+
+/**
+ * @brief Stops recording. The ring keeps its entries.
+ */
+void ps2_trace_stop(void);
+
+/**
+ * @brief Replays a trace: each byte is put on ps2_recv_buffer from a TIM_HR callback, on its original
+ * time divided by speed. Recording is stopped. Must be called from main loop.
+ *
+ * @param source Entries to be replayed, or NULL for the ring.
+ * @param speed Time divider, 1 to PS2_TRACE_MAX_SPEED.
+ * @return false if a replay is already running or the trace is empty.
+ */
+bool ps2_trace_play(ps2_trace_source source, uint16_t speed);
+
+/**
+ * @brief Tells if a replay is running.
+ *
+ * @return true until the last byte is put on ps2_recv_buffer.
+ */
+bool ps2_trace_playing(void);
+
+/**
+ * @brief Console command "ps2rec": status, "start", "stop", "dump" (Intel Hex) or "play [speed]".
+ *
+ * @param args Rest of the command line.
+ */
+void ps2_trace_console_cmd(uint8_t *args);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined PS2_TRACE_H
@@ -44,6 +44,17 @@
 
 
 #include "ps2handl.h"
+#include "boot_trace.h"
+#include "main_events.h"
+#if LATENCY_TRACE == true
+#include "latency.h"
+#endif  //#if LATENCY_TRACE == true
+#if PS2_TRACE == true
+#include "ps2_trace.h"
+#endif  //#if PS2_TRACE == true
+#if USB_TELEMETRY == true
+#include "telemetry.h"
+#endif  //#if USB_TELEMETRY == true
 
 
 //PS/2 keyboard iteration constants
@@ -62,6 +73,18 @@
 #define KB_SUCCESSFULL_BAT                0xAA
 #define KB_ERROR_BAT                      0xFC
 
+//Steps of ps2_keyb_detect_poll()
+#define DETECT_POWER_CYCLE                9
+#define DETECT_WAIT_BAT                   0
+#define DETECT_WAIT_READ_ID_ACK           1
+#define DETECT_WAIT_FIRST_ID              2
+#define DETECT_WAIT_SECOND_ID             3
+#define DETECT_WAIT_TYPE2_ACK             4
+#define DETECT_TYPE3_PAUSE                5
+#define DETECT_WAIT_TYPE3_ACK             6
+#define DETECT_DONE_OK                    7
+#define DETECT_DONE_FAILED                8
+
 
 //Global Vars
 volatile uint16_t ps2int_state;
@@ -91,6 +114,9 @@ volatile bool ps2_keystr_e1 = false;
 volatile bool ps2_keystr_f0 = false;
 volatile uint8_t ps2_byte_received;
 volatile uint8_t mount_scancode_count_status = 0;
+uint8_t ps2_detect_step = DETECT_DONE_FAILED;     //used on ps2_keyb_detect_poll()
+uint32_t ps2_detect_start;                        //systicks mark of the current ps2_keyb_detect_poll() step
+volatile bool ps2_keyb_replugged;                 //A spontaneous BAT (0xAA) is waiting in ps2_recv_buffer
 
 //Need to stay as global to avoid creating different instancies
 volatile uint8_t ps2_recv_buffer[PS2_RECV_BUFFER_SIZE];
@@ -226,6 +252,22 @@ void init_ps2_recv_buffer()
     ps2_recv_buffer[i]=0;
 }
 
+//Put a received byte on the receive ring buffer. Called from PS/2 clock ISR and from ps2_trace replay,
+//both at the same IRQ priority, so they do not preempt each other.
+void ps2_recv_put(uint8_t data)
+{
+  uint8_t i = ps2_recv_put_ptr;
+  uint8_t i_next = (i + 1) & (uint8_t)(PS2_RECV_BUFFER_SIZE - 1);
+  if (i_next != ps2_recv_get_ptr)
+  {
+    ps2_recv_buffer[i] = data;
+#if LATENCY_TRACE == true
+    latency_byte_stop(i);
+#endif  //#if LATENCY_TRACE == true
+    ps2_recv_put_ptr = i_next;
+  }
+}
+
 // Verify if there is an available ps2_byte_received on the receive ring buffer, but does not fetch this one
 bool available_ps2_byte()
 {
@@ -249,19 +291,18 @@ uint8_t get_ps2_byte(volatile uint8_t *buff)
     //No char in buffer
     return 0;
   result = buff[i];
+#if LATENCY_TRACE == true
+  latency_byte_pulled(i);
+#endif  //#if LATENCY_TRACE == true
   i++;
   ps2_recv_get_ptr = i & (uint16_t)(PS2_RECV_BUFFER_SIZE - 1); //if(i >= (uint16_t)SERIAL_RING_BUFFER_SIZE) i = 0;
   return result;
 }
 
 
-bool ps2_keyb_detect(void)
+void ps2_keyb_detect_start(void)
 {
-  uint32_t systicks_start_command;  //Initial time mark
-  uint8_t mountstring[16];          //Used in con_send_string()
   uint8_t ch;
-  //uint16_t qty_in_buffer;
-  /*serial_wait_tx_ends();*/
 
   //Clean RX serial buffer to not false glitch database_setup
   while (con_available_get_char())
@@ -269,145 +310,172 @@ bool ps2_keyb_detect(void)
   ch&= 0xFF;  //only to avoid unused variable warning.
 
   //Wait for 2.5s to keyboard execute its own power on and BAT (Basic Assurance Test) procedure
-  systicks_start_command = systicks;
-  prev_systicks = systicks;
   ps2_keyb_detected = false;
-  uint16_t localcount = 0;
-  while ( ((systicks-systicks_start_command) < (25 * FREQ_INT_SYSTICK / 10)) && (!available_ps2_byte()) ) //Wait 2500ms for keyboard power on
-  {
-    if(prev_systicks != systicks)
-    {//systicks updated. Each 15 ticks is a "#"  |.....|
-      if((systicks - systicks_start_command - localcount) > 14)
-      {
-        localcount = systicks - systicks_start_command;
-        con_send_string((uint8_t*)"\r  to proceed BAT: |");
-        for(uint16_t i = 0; i < (uint8_t)(localcount / 15); i++)
-          con_send_string((uint8_t*)"#");
-      }
-    }
-    prev_systicks = systicks; //To avoid errors on keyboard power up BEFORE the first access
-  }
-  //Fill bar graph
-  localcount = systicks - systicks_start_command;
-  con_send_string((uint8_t*)"\r  to proceed BAT: |");
-  for(uint16_t i = 0; i < (uint8_t)(localcount / 15); i++)
-    con_send_string((uint8_t*)"#");
+  ps2_detect_start = systicks;
+  ps2_detect_step = DETECT_WAIT_BAT;
+}
 
-  if ((systicks-systicks_start_command) >= (25*3))
-  {
-    //User messages
-    con_send_string((uint8_t*)"\r\n..  Timeout on BAT: No keyboard!\r\n");
-    return ps2_keyb_detected;
-  }
-  //PS/2 keyboard might already sent its BAT result. Check it:
-  ps2_byte_received = get_ps2_byte(&ps2_recv_buffer[0]);
-  if(ps2_byte_received != 0)
-  {
-    if(ps2_byte_received == KB_SUCCESSFULL_BAT)
-    {
-      //User messages
-      con_send_string((uint8_t*)"\r\n..  BAT (Basic Assurance Test) OK in ");
-      conv_uint32_to_dec((prev_systicks - systicks_start_command), &mountstring[0]);
-      con_send_string((uint8_t*)&mountstring[0]);
-      con_send_string((uint8_t*)" ticks;\r\n");
-    }
-    else
-    {
-      //User messages
-      con_send_string((uint8_t*)"..  BAT not OK: Received 0x");
-      conv_uint8_to_2a_hex(ps2_byte_received, &mountstring[0]);
-      con_send_string((uint8_t*)&mountstring[0]);
-      con_send_string((uint8_t*)" instead of 0xAA\r\n");
-    }
-  }
-  
-  //Send command Read ID. It musts responds with 0xFA (implicit), 0xAB, 0x83
-  // Wait clock line to be unactive for 100 ms (3 systicks)
-  //con_send_string((uint8_t*)"Sending Read ID comm\r\n");
-  systicks_start_command = systicks;
-  ps2_send_command(COMM_READ_ID, ARG_NO_ARG); //Read ID command.
-  while (command_running && (systicks - systicks_start_command) < (3 * FREQ_INT_SYSTICK / 10)) //Must be excecuted in less than 100ms
+
+void ps2_keyb_redetect_start(bool power_cycle)
+{
+  ps2_keyb_detected = false;
+  ps2_keyb_replugged = false;
+  reset_mount_scancode_machine();
+  mount_scancode_OK = false;
+  formerscancode = 0;
+  ps2_detect_start = systicks;
+  if(power_cycle)
   {
-    prev_systicks = systicks; //To avoid errors on keyboard power up BEFORE the first access
-    if(systicks != systicks_start_command)
-      prev_systicks = systicks; //To avoid errors on keyboard power up BEFORE the first access
+    //Keyboard does not answer: restart it by its power line, like a replug
+    power_off_ps2_keyboard();
+    ps2_detect_step = DETECT_POWER_CYCLE;
   }
-  if (!command_running)
+  else
+    //Keyboard is already executing its own BAT, or it is still unplugged
+    ps2_detect_step = DETECT_WAIT_BAT;
+}
+
+
+enum PS2_DETECT_STATUS ps2_keyb_detect_poll(void)
+{
+  uint8_t mountstring[16];          //Used in con_send_string()
+  uint32_t elapsed = systicks - ps2_detect_start;
+
+  switch(ps2_detect_step)
   {
-    //con_send_string((uint8_t*)"Waiting 0xAB\r\n");
-    systicks_start_command = systicks;
-    while(!available_ps2_byte() && (systicks - systicks_start_command) < (FREQ_INT_SYSTICK / 10))
-    __asm("nop");
-    ps2_byte_received = get_ps2_byte(&ps2_recv_buffer[0]);
-    if(ps2_byte_received == KB_FIRST_ID)
-    {
-      //con_send_string((uint8_t*)"Waiting 0x83\r\n");
-      systicks_start_command = systicks;
-      while(!available_ps2_byte() && (systicks - systicks_start_command) < (FREQ_INT_SYSTICK / 10))
-      __asm("nop");
+    case DETECT_POWER_CYCLE:
+      if(elapsed < (FREQ_INT_SYSTICK / 10))  //100ms powered off
+        return PS2_DETECT_RUNNING;
+      power_on_ps2_keyboard();    //It also cleans ps2_recv_buffer and PS/2 clock interrupt machine
+      ps2_detect_start = systicks;
+      ps2_detect_step = DETECT_WAIT_BAT;
+      return PS2_DETECT_RUNNING;
+
+    case DETECT_WAIT_BAT:
+      if(!available_ps2_byte())
+      {
+        if(elapsed < (25 * FREQ_INT_SYSTICK / 10)) //Wait 2500ms for keyboard power on
+          return PS2_DETECT_RUNNING;
+        //User messages
+        con_send_string((uint8_t*)"..  Timeout on BAT: No keyboard!\r\n");
+        ps2_detect_step = DETECT_DONE_FAILED;
+        return PS2_DETECT_FAILED;
+      }
+      //PS/2 keyboard has sent its BAT result. Check it:
       ps2_byte_received = get_ps2_byte(&ps2_recv_buffer[0]);
-      if(ps2_byte_received == KB_SECOND_ID)
+      if(ps2_byte_received == KB_SUCCESSFULL_BAT)
       {
-        ps2_keyb_detected = true;
         //User messages
-        con_send_string((uint8_t*)"..  PS/2 Keyboard detected;\r\n");
+        con_send_string((uint8_t*)"..  BAT (Basic Assurance Test) OK in ");
+        conv_uint32_to_dec(elapsed, &mountstring[0]);
+        con_send_string((uint8_t*)&mountstring[0]);
+        con_send_string((uint8_t*)" ticks;\r\n");
       }
       else
       {
-        //con_send_string((uint8_t*)"Did not receive 0x83");
-        con_send_string((uint8_t*)"..  PS/2 Keyboard not detected!\r\n");
-        return ps2_keyb_detected;
+        //User messages
+        con_send_string((uint8_t*)"..  BAT not OK: Received 0x");
+        conv_uint8_to_2a_hex(ps2_byte_received, &mountstring[0]);
+        con_send_string((uint8_t*)&mountstring[0]);
+        con_send_string((uint8_t*)" instead of 0xAA\r\n");
       }
-    }
-    else
-    {
-      //con_send_string((uint8_t*)"Did not receive 0xAB");
-      return ps2_keyb_detected;
-    }
-  }
-  else
-  {
-    //User messages
-    /*con_send_string((uint8_t*)"PS/2 ReadID command not OK. Elapsed time was ");
-    conv_uint32_to_8a_hex((systicks - systicks_start_command), &mountstring[0]);
-    con_send_string((uint8_t*)&mountstring[0]);
-    con_send_string((uint8_t*)"\r\n"); */
-    return ps2_keyb_detected;
-  }
-
-  //The objective of this block is to minimize the keyboard interruptions, to keep time to high priority MSX interrupts.
-  //Send type 3 command 0xFA (Set Key Type Make/Break - This one only disables typematic repeat):
-  //  If it does not receive "ack" (0xFA), then send type 2 command 0xF3 + 0x7F (2cps repeat rate + 1 second delay)
-  //  It musts respond with an "ack" after the first byte, than with a second "ack" after the second byte.
-  //User messages
-  //con_send_string((uint8_t*)"Type 2 sets typematic repeat 0xF3 0x7F requested\r\n");
-  
-  //Type 2 command: Set typematic rate to 2 cps and delay to 1 second.
-  systicks_start_command = systicks;
-  ps2_send_command(COMM_SET_TYPEMATIC_RATEDELAY, ARG_LOWRATE_LOWDELAY);
-  while (command_running && (systicks - systicks_start_command) < (2 * FREQ_INT_SYSTICK / 10)) //Must be excecuted in less than 200ms
-    __asm("nop");
-  if (!command_running)
-    //User messages
-    con_send_string((uint8_t*)"..  Delay 1 second to repeat, 2cps repeat rate (Type 2 command) OK;\r\n");
-  else
-  {
-    //User messages
-    con_send_string((uint8_t*)"..  Type 3 Disables typematic repeat 0xFA requested\r\n");
+      boot_mark("PS/2 BAT received");
+      //Send command Read ID. It musts responds with 0xFA (implicit), 0xAB, 0x83
+      ps2_detect_start = systicks;
+      ps2_send_command(COMM_READ_ID, ARG_NO_ARG); //Read ID command.
+      ps2_detect_step = DETECT_WAIT_READ_ID_ACK;
+      return PS2_DETECT_RUNNING;
+
+    case DETECT_WAIT_READ_ID_ACK:
+      if(command_running)
+      {
+        if(elapsed < (3 * FREQ_INT_SYSTICK / 10)) //Must be excecuted in less than 100ms
+          return PS2_DETECT_RUNNING;
+        ps2_detect_step = DETECT_DONE_FAILED;
+        return PS2_DETECT_FAILED;
+      }
+      ps2_detect_start = systicks;
+      ps2_detect_step = DETECT_WAIT_FIRST_ID;
+      return PS2_DETECT_RUNNING;
 
-    //.1 second delay (to display serial contents)
-    systicks_start_command = systicks;
-    while ((systicks - systicks_start_command) < (FREQ_INT_SYSTICK / 10)) __asm("nop");
+    case DETECT_WAIT_FIRST_ID:
+      if(!available_ps2_byte() && elapsed < (FREQ_INT_SYSTICK / 10))
+        return PS2_DETECT_RUNNING;
+      ps2_byte_received = get_ps2_byte(&ps2_recv_buffer[0]);
+      if(ps2_byte_received != KB_FIRST_ID)
+      {
+        ps2_detect_step = DETECT_DONE_FAILED;
+        return PS2_DETECT_FAILED;
+      }
+      ps2_detect_start = systicks;
+      ps2_detect_step = DETECT_WAIT_SECOND_ID;
+      return PS2_DETECT_RUNNING;
 
-    systicks_start_command = systicks;
-    //Type 3 command: Set All Keys Make/Break: This one only disables typematic repeat and applies to all keys
-    ps2_send_command(COMM_TYPE3_NO_REPEAT, ARG_NO_ARG);
-    while (command_running && (systicks - systicks_start_command) < (FREQ_INT_SYSTICK / 10)) __asm("nop"); //Must be excecuted in less than 100ms
-    if (!command_running)
+    case DETECT_WAIT_SECOND_ID:
+      if(!available_ps2_byte() && elapsed < (FREQ_INT_SYSTICK / 10))
+        return PS2_DETECT_RUNNING;
+      ps2_byte_received = get_ps2_byte(&ps2_recv_buffer[0]);
+      if(ps2_byte_received != KB_SECOND_ID)
+      {
+        con_send_string((uint8_t*)"..  PS/2 Keyboard not detected!\r\n");
+        ps2_detect_step = DETECT_DONE_FAILED;
+        return PS2_DETECT_FAILED;
+      }
+      ps2_keyb_detected = true;
       //User messages
-      con_send_string((uint8_t*)"..  Type 3 Disables typematic 0xFA repeat OK\r\n");
-  }
-  return ps2_keyb_detected;
+      con_send_string((uint8_t*)"..  PS/2 Keyboard detected;\r\n");
+      boot_mark("PS/2 keyboard detected");
+      //The objective of this block is to minimize the keyboard interruptions, to keep time to high priority MSX interrupts.
+      //Send type 2 command 0xF3 + 0x7F (2cps repeat rate + 1 second delay):
+      //  It musts respond with an "ack" after the first byte, than with a second "ack" after the second byte.
+      //  If it does not receive "ack" (0xFA), then send type 3 command 0xF8 (Set All Keys Make/Break - This one only
+      //  disables typematic repeat).
+      ps2_detect_start = systicks;
+      ps2_send_command(COMM_SET_TYPEMATIC_RATEDELAY, ARG_LOWRATE_LOWDELAY);
+      ps2_detect_step = DETECT_WAIT_TYPE2_ACK;
+      return PS2_DETECT_RUNNING;
+
+    case DETECT_WAIT_TYPE2_ACK:
+      if(command_running && elapsed < (2 * FREQ_INT_SYSTICK / 10)) //Must be excecuted in less than 200ms
+        return PS2_DETECT_RUNNING;
+      if(!command_running)
+      {
+        //User messages
+        con_send_string((uint8_t*)"..  Delay 1 second to repeat, 2cps repeat rate (Type 2 command) OK;\r\n");
+        ps2_detect_step = DETECT_DONE_OK;
+        return PS2_DETECT_OK;
+      }
+      //User messages
+      con_send_string((uint8_t*)"..  Type 3 Disables typematic repeat 0xFA requested\r\n");
+      //.1 second delay (to display serial contents)
+      ps2_detect_start = systicks;
+      ps2_detect_step = DETECT_TYPE3_PAUSE;
+      return PS2_DETECT_RUNNING;
+
+    case DETECT_TYPE3_PAUSE:
+      if(elapsed < (FREQ_INT_SYSTICK / 10))
+        return PS2_DETECT_RUNNING;
+      //Type 3 command: Set All Keys Make/Break: This one only disables typematic repeat and applies to all keys
+      ps2_detect_start = systicks;
+      ps2_send_command(COMM_TYPE3_NO_REPEAT, ARG_NO_ARG);
+      ps2_detect_step = DETECT_WAIT_TYPE3_ACK;
+      return PS2_DETECT_RUNNING;
+
+    case DETECT_WAIT_TYPE3_ACK:
+      if(command_running && elapsed < (FREQ_INT_SYSTICK / 10)) //Must be excecuted in less than 100ms
+        return PS2_DETECT_RUNNING;
+      if (!command_running)
+        //User messages
+        con_send_string((uint8_t*)"..  Type 3 Disables typematic 0xFA repeat OK\r\n");
+      ps2_detect_step = DETECT_DONE_OK;
+      return PS2_DETECT_OK;
+
+    case DETECT_DONE_OK:
+      return PS2_DETECT_OK;
+
+    default:
+      return PS2_DETECT_FAILED;
+  } //switch(ps2_detect_step)
 }
 
 
@@ -476,14 +544,14 @@ void ps2_update_leds(bool num, bool caps, bool scroll)
 //Insert a delay before run send_start_bit_now()
 void send_start_bit_next(uint16_t x_usec)
 {
-  delay_usec(TIM_HR, x_usec, send_start_bit_now); //wait x_usec and go to send_start_bit on TIM_HR_TIMER overflow interrupt
+  delay_usec(TIM_HR, x_usec, send_start_bit_now); //wait x_usec and go to send_start_bit on TIM_HR deadline (CC2)
 }
 
 
 //This three functions are the split of Transmit Initiator, to avoid stuck inside an interrupt due to 120u and 20usec
 void send_start_bit_now(void)
 {
-  timer_disable_irq(TIM_HR, TIM_DIER_CC1IE);  // Disable interrupt on Capture/Compare1, but keeps on overflow
+  timer_disable_irq(TIM_HR, TIM_DIER_CC1IE);  // Disable interrupt on Capture/Compare1, but keeps overflow and deadlines
 #if PS2_CLK_INTERRUPT == GPIO_INT
   exti_disable_request(PS2_CLK_I_EXTI);
 #endif  
@@ -494,7 +562,7 @@ void send_start_bit_now(void)
   //Something was wrong with original delay, so I decided to use TIM_HR_TIMER Capture/Compare interrupt
   // See hr_timer_delay.c file
   //now insert a 120us delay and run step 2 of send_start_bit function
-  delay_usec(TIM_HR, 120, send_start_bit2); //wait 120usec and go to send_start_bit2 on TIM_HR_TIMER overflow interrupt
+  delay_usec(TIM_HR, 120, send_start_bit2); //wait 120usec and go to send_start_bit2 on TIM_HR deadline (CC2)
 }
 
 
@@ -502,7 +570,7 @@ void send_start_bit2(void) //Second part of send_start_bit
 {
   gpio_clear(PS2_DATA_PORT, PS2_DATA_PIN); //this is the start bit
   //now insert a 10us delay and run step 3 of send_start_bit function
-  delay_usec(TIM_HR, 10, send_start_bit3); /*wait 10usec and go to send_start_bit3 on TIM_HR_TIMER overflow interrupt*/
+  delay_usec(TIM_HR, 10, send_start_bit3); /*wait 10usec and go to send_start_bit3 on TIM_HR deadline (CC2)*/
 }
 
 
@@ -537,6 +605,8 @@ void ps2_clock_update(bool ps2datapin_logicstate)
       gpio_set(PS2_DATA_PORT, PS2_DATA_PIN);
       ps2int_state = PS2INT_RECEIVE;
       ps2int_RX_bit_idx = 0;
+      //Restart the count, otherwise each low bit of the next frames would reset the receiver again
+      acctimeps2data0 = 0;
     }
   }
   else
@@ -588,6 +658,10 @@ void ps2_clock_send(bool ps2datapin_logicstate)
   //|variável| = `if`(condição) ? <valor1 se true> : <valor2 se false>;:
   //Only two TX states of send: ps2_send_command & send_argument
   uint8_t data_byte = (ps2int_state == PS2INT_SEND_COMMAND) ? command : argument;
+#if USB_TELEMETRY == true
+  if(telemetry_on && !ps2int_TX_bit_idx)
+    telemetry_put(TELEMETRY_REC_PS2, data_byte, TELEMETRY_PS2_SENT, 0);
+#endif  //#if USB_TELEMETRY == true
   //if( (ps2int_TX_bit_idx >= 0) && (ps2int_TX_bit_idx < 8) ) //The first test will be always true
   if(ps2int_TX_bit_idx < 8)
   {
@@ -756,6 +830,7 @@ void ps2_clock_receive(bool ps2datapin_logicstate)
   else if(ps2int_RX_bit_idx == 10)
   {  // start + 8 + stop + parity (but started with 0)
     ps2int_RX_bit_idx = 0;  //next (reset) PS/2 receive condition
+    main_event_set(EVT_PS2);
 
     stop_bit = ps2datapin_logicstate;
     bool parity_ok = __builtin_parity((data_word<<1)|parity_bit);
@@ -780,14 +855,14 @@ void ps2_clock_receive(bool ps2datapin_logicstate)
     { // ps2int_status receive procesing block (begin)
       if (ps2int_state == PS2INT_RECEIVE)
       {
-        //this put routine is new
-        uint8_t i = ps2_recv_put_ptr;
-        uint8_t i_next = (i + 1) & (uint8_t)(PS2_RECV_BUFFER_SIZE - 1);
-        if (i_next != ps2_recv_get_ptr)
-        {
-          ps2_recv_buffer[i] = data_word;
-          ps2_recv_put_ptr = i_next;
-        }
+#if PS2_TRACE == true
+        ps2_trace_record(data_word);
+#endif  //#if PS2_TRACE == true
+#if USB_TELEMETRY == true
+        if(telemetry_on)
+          telemetry_put(TELEMETRY_REC_PS2, data_word, TELEMETRY_PS2_RECEIVED, 0);
+#endif  //#if USB_TELEMETRY == true
+        ps2_recv_put(data_word);
       }
 
       else if (ps2int_state == PS2INT_WAIT_FOR_COMMAND_ACK)
@@ -934,14 +1009,29 @@ bool mount_scancode()
 {
   //Check MSX CAPS and Kana status update
   if( (caps_state = (gpio_get(RUSLAT_LED_PORT, RUSLAT_LED_PIN)!=0)) != caps_former )
+  {
     update_ps2_leds = true;
+    main_event_set(EVT_LEDS);
+  }
   if( (kana_state = gpio_get(KANA_PORT, KANA_PIN)) != kana_former )
+  {
     update_ps2_leds = true;
+    main_event_set(EVT_LEDS);
+  }
   // static uint16_t prev_state_index=0;
   if (!mount_scancode_OK)
   { 
     while(available_ps2_byte() && !mount_scancode_OK)
     {
+      if( (mount_scancode_count_status == 0) &&
+          (ps2_recv_buffer[ps2_recv_get_ptr] == KB_SUCCESSFULL_BAT) )
+      {
+        //Keyboard was replugged (or reset itself) and has just finished its BAT. Leave 0xAA in
+        //ps2_recv_buffer, so ps2_keyb_detect_poll() resumes the detection from there.
+        ps2_keyb_replugged = true;
+        main_event_set(EVT_PS2);
+        return false;
+      }
       ps2_byte_received = get_ps2_byte(&ps2_recv_buffer[0]);
       //User messages (debug)
       /*con_send_string((uint8_t*)"Mount_scancode RX Ch=");
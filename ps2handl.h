@@ -75,6 +75,13 @@ enum ps2int{
   PS2INT_WAIT_FOR_ECHO
 };
 
+//Results of ps2_keyb_detect_poll()
+enum PS2_DETECT_STATUS{
+  PS2_DETECT_RUNNING =                    0,
+  PS2_DETECT_OK,
+  PS2_DETECT_FAILED
+};
+
 /**
  * @brief Turn on the 5V to power the PS/2 keyboard on
  */
@@ -91,11 +98,28 @@ void power_off_ps2_keyboard(void);
 void reset_requested(void);
 
 /**
- * @brief Detect a connected PS/2 Keyboard
+ * @brief Starts the background detection of a connected PS/2 Keyboard. It must be followed by
+ * ps2_keyb_detect_poll() calls until it returns other than PS2_DETECT_RUNNING.
+ *
+ */
+void ps2_keyb_detect_start(void);
+
+/**
+ * @brief Restarts the PS/2 Keyboard detection after boot, to recover the keyboard without MCU reset.
+ * It must be followed by ps2_keyb_detect_poll() calls, like ps2_keyb_detect_start().
+ *
+ * @param power_cycle True to turn the PS/2 port off for 100ms before waiting BAT (non responsive keyboard),
+ * or false to only wait BAT (replugged keyboard).
+ */
+void ps2_keyb_redetect_start(bool power_cycle);
+
+/**
+ * @brief Advances the PS/2 Keyboard detection (BAT wait, Read ID and typematic setup) without blocking.
  *
- * @return True if keyboard is connected and responds to POST and ID.
+ * @return PS2_DETECT_RUNNING while in progress, PS2_DETECT_OK if keyboard is connected and responds
+ * to POST and ID, or PS2_DETECT_FAILED otherwise.
  */
-bool ps2_keyb_detect(void);
+enum PS2_DETECT_STATUS ps2_keyb_detect_poll(void);
 
 /**
  * @brief Enter point of PS/2 clock line, called from interrupt handled by msxhid
@@ -104,6 +128,14 @@ bool ps2_keyb_detect(void);
  */
 void ps2_clock_update(bool ps2datapin_logicstate);
 
+/**
+ * @brief Puts a received byte on ps2_recv_buffer, to be fetched by mount_scancode(). Dropped if it is full.
+ * Must be called from an ISR of IRQ_PRI_EXT15 priority (PS/2 clock or TIM_HR).
+ *
+ * @param data PS/2 byte.
+ */
+void ps2_recv_put(uint8_t data);
+
 /**
  * @brief Enter point of PS/2 clock line, called from interrupt handled by msxhid
  * 
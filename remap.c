@@ -0,0 +1,479 @@
+/** @addtogroup 19 remap Database Remap Overlay
+ *
+ * @file remap.c RAM overlay of Database lines, edited on console.
+ *
+ * @brief <b>RAM overlay of Database lines, edited on console.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * The lines keep the Database format, so msx_dispatch() runs them as it runs the flash ones. Their
+ * scan code columns are zero padded: a PS/2 keyboard never sends 0x00 as a scan code byte.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#include <string.h>
+
+#include "remap.h"
+#include "console.h"
+#include "dbasemgt.h"
+
+
+#define REMAP_CODE_COLS           3           //Scan code columns of a Database line
+#define REMAP_CONTROL_COL         3
+#define REMAP_KEYS_COL            4
+#define REMAP_CONTROL_FIXED       0xF4        //Reserved bits of the control byte, kept at high state (as db-compiler)
+#define REMAP_CONTROL_SHIFT       0x08        //Combined shift
+#define REMAP_CONTROL_CASE        0x03
+#define REMAP_CONTROL_PERIOD      0xF0        //Autofire period (autofire.h), or 0xF
+#define REMAP_CONTROL_PERIOD_SHIFT 4
+#define REMAP_MAX_PERIOD          14          //AUTOFIRE_MAX_PERIOD of autofire.h
+#define REMAP_KEY_RELEASE         0x08
+#define REMAP_TEXT_SIZE           48
+
+
+//Global vars
+uint8_t remap_lines[REMAP_SLOTS][DB_NUM_COLS];    //Free if column 0 is 0
+uint8_t remap_filter[REMAP_FILTER_BITS / 8];
+uint8_t remap_count;
+extern uint8_t y_dummy;                           //Declared on msxmap.cpp
+
+
+//Local prototypes
+uint16_t remap_filter_index(uint8_t len, uint8_t last);
+void remap_filter_build(void);
+int8_t remap_find(const uint8_t *code);
+bool remap_parse_hex(uint8_t *word, uint8_t *value);
+bool remap_parse_control(uint8_t *word, uint8_t *control);
+bool remap_parse_key(uint8_t *word, uint8_t *key);
+bool remap_parse_code(uint8_t *word, uint8_t **args, uint8_t *code, uint8_t **next);
+void remap_set(uint8_t *word, uint8_t *args);
+void remap_del(uint8_t *args);
+void remap_list(void);
+void remap_text_key(uint8_t key, uint8_t *text);
+#if MCU == STM32F401
+uint32_t remap_store_check(const uint8_t *record, bool *valid);
+void remap_store_found(const uint8_t *record, void *ctx);
+void remap_save(void);
+bool remap_load(void);
+#endif  //#if MCU == STM32F401
+
+
+#if MCU == STM32F401
+const flash_log_t remap_store = {REMAP_STORE_ADDR, REMAP_STORE_SIZE, REMAP_STORE_TAG0, REMAP_STORE_TAG1, remap_store_check};
+#endif  //#if MCU == STM32F401
+
+
+uint16_t remap_filter_index(uint8_t len, uint8_t last)
+{
+  return (uint16_t)(((len - 1) << 8) | last);
+}
+
+
+void remap_filter_build(void)
+{
+  uint16_t index;
+  uint8_t len;
+
+  memset(remap_filter, 0, sizeof(remap_filter));
+  remap_count = 0;
+  for(uint8_t i = 0; i < REMAP_SLOTS; i++)
+  {
+    if(!remap_lines[i][0])
+      continue;
+    for(len = 1; (len < REMAP_CODE_COLS) && remap_lines[i][len]; len++)
+      ;
+    index = remap_filter_index(len, remap_lines[i][len - 1]);
+    remap_filter[index >> 3] |= (uint8_t)(1 << (index & 7));
+    remap_count++;
+  }
+}
+
+
+//code: REMAP_CODE_COLS bytes, zero padded. Returns the slot, or -1
+int8_t remap_find(const uint8_t *code)
+{
+  for(uint8_t i = 0; i < REMAP_SLOTS; i++)
+    if( remap_lines[i][0] && !memcmp(remap_lines[i], code, REMAP_CODE_COLS) )
+      return (int8_t)i;
+  return -1;
+}
+
+
+void remap_setup(void)
+{
+  memset(remap_lines, 0, sizeof(remap_lines));
+#if MCU == STM32F401
+  if(remap_load())
+    return;
+#endif  //#if MCU == STM32F401
+  remap_filter_build();
+}
+
+
+const uint8_t* remap_lookup(const volatile uint8_t *scancode)
+{
+  uint8_t len = scancode[0], i;
+  uint16_t index;
+
+  if( !remap_count || !len || (len > REMAP_CODE_COLS) )
+    return NULL;
+  //Keys not remapped stop here, on one bit test
+  index = remap_filter_index(len, scancode[len]);
+  if(!(remap_filter[index >> 3] & (1 << (index & 7))))
+    return NULL;
+  for(i = 0; i < REMAP_SLOTS; i++)
+  {
+    if( (remap_lines[i][0] == scancode[1]) &&
+        (remap_lines[i][1] == ((len > 1) ? scancode[2] : 0)) &&
+        (remap_lines[i][2] == ((len > 2) ? scancode[3] : 0)) )
+      return remap_lines[i];
+  }
+  return NULL;
+}
+
+
+bool remap_parse_hex(uint8_t *word, uint8_t *value)
+{
+  uint8_t digit, result = 0;
+
+  if( !word[0] || !word[1] || word[2] )
+    return false;
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    if( (word[i] >= '0') && (word[i] <= '9') )
+      digit = word[i] - '0';
+    else if( ((word[i] | 0x20) >= 'a') && ((word[i] | 0x20) <= 'f') )
+      digit = (word[i] | 0x20) - 'a' + 10;
+    else
+      return false;
+    result = (uint8_t)((result << 4) | digit);
+  }
+  *value = result;
+  return true;
+}
+
+
+//0, 1, 2 with optional s (combined shift) and optional a and the autofire period, as host/db-compiler
+bool remap_parse_control(uint8_t *word, uint8_t *control)
+{
+  uint32_t period;
+
+  if( (word[0] < '0') || (word[0] > '2') )
+    return false;
+  *control = REMAP_CONTROL_FIXED | (uint8_t)(word[0] - '0');
+  word++;
+  if( (*word | 0x20) == 's' )
+  {
+    *control |= REMAP_CONTROL_SHIFT;
+    word++;
+  }
+  if( (*word | 0x20) == 'a' )
+  {
+    if( !console_word_to_uint32(word + 1, &period) || (period < 1) || (period > REMAP_MAX_PERIOD) )
+      return false;
+    *control = (uint8_t)((*control & (uint8_t)~REMAP_CONTROL_PERIOD) | (period << REMAP_CONTROL_PERIOD_SHIFT));
+    return true;
+  }
+  return *word == 0;
+}
+
+
+//YyXx[r] or --
+bool remap_parse_key(uint8_t *word, uint8_t *key)
+{
+  uint8_t y = 0, x;
+
+  if( (word[0] == '-') && (word[1] == '-') && !word[2] )
+  {
+    *key = (uint8_t)((y_dummy << 4) | 0x0F);
+    return true;
+  }
+  if( ((word[0] | 0x20) != 'y') || (word[1] < '0') || (word[1] > '9') )
+    return false;
+  for(word++; (*word >= '0') && (*word <= '9'); word++)
+    y = (uint8_t)(y * 10 + (*word - '0'));
+  if( (y > 15) || ((word[0] | 0x20) != 'x') || (word[1] < '0') || (word[1] > '7') )
+    return false;
+  x = word[1] - '0';
+  word += 2;
+  *key = (uint8_t)((y << 4) | x);
+  if( (*word | 0x20) == 'r' )
+  {
+    *key |= REMAP_KEY_RELEASE;
+    word++;
+  }
+  return *word == 0;
+}
+
+
+//Scan code bytes from word up to the ':' (or the end of the line). next is the word after them
+bool remap_parse_code(uint8_t *word, uint8_t **args, uint8_t *code, uint8_t **next)
+{
+  uint8_t len = 0;
+
+  memset(code, 0, REMAP_CODE_COLS);
+  for(; *word && strcmp((const char*)word, ":"); word = console_next_word(args))
+  {
+    if( (len >= REMAP_CODE_COLS) || !remap_parse_hex(word, &code[len]) || !code[len] )
+      return false;
+    len++;
+  }
+  *next = word;
+  return len != 0;
+}
+
+
+void remap_set(uint8_t *word, uint8_t *args)
+{
+  uint8_t line[DB_NUM_COLS];
+  int8_t slot;
+
+  if( !remap_parse_code(word, &args, line, &word) || strcmp((const char*)word, ":") ||
+      !remap_parse_control(console_next_word(&args), &line[REMAP_CONTROL_COL]) )
+  {
+    con_send_string((uint8_t*)"Usage: remap code : case[s][aN] keys, as \"remap E0 75 : 0 Y1X4\"\r\n");
+    return;
+  }
+  for(uint8_t i = REMAP_KEYS_COL; i < DB_NUM_COLS; i++)
+  {
+    word = console_next_word(&args);
+    if(!*word)
+      line[i] = (uint8_t)((y_dummy << 4) | 0x0F);
+    else if(!remap_parse_key(word, &line[i]))
+    {
+      con_send_string((uint8_t*)"Keys are YyXx, with r for release, or --\r\n");
+      return;
+    }
+  }
+  slot = remap_find(line);
+  for(uint8_t i = 0; (slot < 0) && (i < REMAP_SLOTS); i++)
+    if(!remap_lines[i][0])
+      slot = (int8_t)i;
+  if(slot < 0)
+  {
+    con_send_string((uint8_t*)"No free remap slot.\r\n");
+    return;
+  }
+  memcpy(remap_lines[slot], line, DB_NUM_COLS);
+  remap_filter_build();
+}
+
+
+void remap_del(uint8_t *args)
+{
+  uint8_t code[REMAP_CODE_COLS], *word;
+  int8_t slot;
+
+  if( !remap_parse_code(console_next_word(&args), &args, code, &word) || *word )
+  {
+    con_send_string((uint8_t*)"Usage: remap del code\r\n");
+    return;
+  }
+  slot = remap_find(code);
+  if(slot < 0)
+  {
+    con_send_string((uint8_t*)"Not remapped.\r\n");
+    return;
+  }
+  remap_lines[slot][0] = 0;
+  remap_filter_build();
+}
+
+
+void remap_text_key(uint8_t key, uint8_t *text)
+{
+  uint8_t y = key >> 4;
+
+  if(y == y_dummy)
+  {
+    strcpy((char*)text, " --");
+    return;
+  }
+  *text++ = ' ';
+  *text++ = 'Y';
+  if(y > 9)
+    *text++ = '1';
+  *text++ = (uint8_t)('0' + y % 10);
+  *text++ = 'X';
+  *text++ = (uint8_t)('0' + (key & 0x07));
+  if(key & REMAP_KEY_RELEASE)
+    *text++ = 'r';
+  *text = 0;
+}
+
+
+void remap_list(void)
+{
+  uint8_t text[REMAP_TEXT_SIZE], *pos, control;
+
+  for(uint8_t i = 0; i < REMAP_SLOTS; i++)
+  {
+    if(!remap_lines[i][0])
+      continue;
+    pos = text;
+    for(uint8_t c = 0; (c < REMAP_CODE_COLS) && remap_lines[i][c]; c++)
+    {
+      conv_uint8_to_2a_hex(remap_lines[i][c], pos);
+      pos[2] = ' ';
+      pos += 3;
+    }
+    control = remap_lines[i][REMAP_CONTROL_COL];
+    *pos++ = ':';
+    *pos++ = ' ';
+    *pos++ = (uint8_t)('0' + (control & REMAP_CONTROL_CASE));
+    if(control & REMAP_CONTROL_SHIFT)
+      *pos++ = 's';
+    if( (control & REMAP_CONTROL_PERIOD) && ((control >> REMAP_CONTROL_PERIOD_SHIFT) <= REMAP_MAX_PERIOD) )
+    {
+      *pos++ = 'a';
+      conv_uint32_to_dec(control >> REMAP_CONTROL_PERIOD_SHIFT, pos);
+      pos += strlen((char*)pos);
+    }
+    for(uint8_t c = REMAP_KEYS_COL; c < DB_NUM_COLS; c++)
+    {
+      remap_text_key(remap_lines[i][c], pos);
+      pos += strlen((char*)pos);
+    }
+    strcat((char*)text, "\r\n");
+    con_send_string(text);
+  }
+  conv_uint32_to_dec(remap_count, text);
+  con_send_string(text);
+  con_send_string((uint8_t*)" of ");
+  conv_uint32_to_dec(REMAP_SLOTS, text);
+  con_send_string(text);
+  con_send_string((uint8_t*)" remap slots used.\r\n");
+}
+
+
+#if MCU == STM32F401
+uint32_t remap_store_check(const uint8_t *record, bool *valid)
+{
+  uint32_t size = DB_NUM_COLS * (1 + (uint32_t)record[2]);
+  uint8_t sum = record[2] + record[3];
+
+  if(record[2] > REMAP_SLOTS)
+    return 0;
+  for(uint32_t i = DB_NUM_COLS; i < size; i++)
+    sum += record[i];
+  *valid = (sum == 0);
+  return size;
+}
+
+
+void remap_store_found(const uint8_t *record, void *ctx)
+{
+  *(const uint8_t**)ctx = record;
+}
+
+
+bool remap_load(void)
+{
+  const uint8_t *record = NULL;
+
+  flash_log_scan(&remap_store, remap_store_found, &record);
+  if(!record)
+    return false;
+  memset(remap_lines, 0, sizeof(remap_lines));
+  memcpy(remap_lines, record + DB_NUM_COLS, DB_NUM_COLS * (uint32_t)record[2]);
+  remap_filter_build();
+  return true;
+}
+
+
+void remap_save(void)
+{
+  uint8_t header[DB_NUM_COLS] = {REMAP_STORE_TAG0, REMAP_STORE_TAG1, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF}, sum = 0;
+  uint8_t body[REMAP_SLOTS][DB_NUM_COLS];
+  uint8_t lines = 0;
+
+  for(uint8_t i = 0; i < REMAP_SLOTS; i++)
+  {
+    if(!remap_lines[i][0])
+      continue;
+    memcpy(body[lines++], remap_lines[i], DB_NUM_COLS);
+    for(uint8_t c = 0; c < DB_NUM_COLS; c++)
+      sum += remap_lines[i][c];
+  }
+  header[2] = lines;
+  header[3] = (uint8_t)(0 - sum - lines);
+  switch(flash_log_append(&remap_store, header, (const uint8_t*)body, DB_NUM_COLS * (uint32_t)lines))
+  {
+  case FLASH_LOG_OK:
+    con_send_string((uint8_t*)"Remaps saved.\r\n");
+    break;
+  case FLASH_LOG_FULL:
+    con_send_string((uint8_t*)"Remap store is full: it is erased with the sector, on the next Database update.\r\n");
+    break;
+  default:
+    con_send_string((uint8_t*)"Flash write error.\r\n");
+    break;
+  }
+}
+#endif  //#if MCU == STM32F401
+
+
+void remap_console_cmd(uint8_t *args)
+{
+  uint8_t *word = console_next_word(&args);
+
+  if(!*word)
+  {
+    remap_list();
+    return;
+  }
+  if(strcmp((const char*)word, "del") == 0)
+  {
+    remap_del(args);
+    return;
+  }
+  if(strcmp((const char*)word, "clear") == 0)
+  {
+    memset(remap_lines, 0, sizeof(remap_lines));
+    remap_filter_build();
+    return;
+  }
+  if( (strcmp((const char*)word, "save") == 0) || (strcmp((const char*)word, "load") == 0) )
+  {
+#if MCU == STM32F401
+    if(word[0] == 's')
+      remap_save();
+    else if(!remap_load())
+      con_send_string((uint8_t*)"No remaps saved.\r\n");
+#else   //#if MCU == STM32F401
+    con_send_string((uint8_t*)"No flash room for remaps on this MCU: they last until power off.\r\n");
+#endif  //#if MCU == STM32F401
+    return;
+  }
+  remap_set(word, args);
+}
@@ -0,0 +1,104 @@
+/** @defgroup 19 remap Database Remap Overlay
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file remap.h RAM overlay of Database lines, edited on console.
+ *
+ * @brief <b>RAM overlay of Database lines, edited on console. Header file of remap.c.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * A remap is a Database line (scan code, control byte and MSX keys) kept on RAM. convert2msx()
+ * looks for it before the Database search, so a key is changed at once, with no new Intel Hex nor
+ * flash erase. A bit filter, indexed by the scan code length and last byte, answers on one test
+ * for the keys that are not remapped. Make and break are separate lines, as on the Database.
+ *
+ * On STM32F401, "remap save" appends the remaps as a record on the free room of flash sector 3,
+ * below the Database images (REMAP_STORE_ADDR), and the last record is loaded on boot:
+ * - Header line: 'R', 'M', lines, checksum (lines plus all bytes of the lines plus it sum 0), 0xFF x 4;
+ * - The Database lines.
+ * The room is erased with the sector, when a Database update finds no free image place.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined REMAP_H
+#define REMAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "system.h"
+#include "serial.h"
+
+
+/** Remap sizes and store format
+@{*/
+#define REMAP_SLOTS               16          //Database lines on the overlay
+#define REMAP_FILTER_BITS         (3 * 256)   //Scan code length (1 to 3) x last byte
+#define REMAP_STORE_TAG0          'R'
+#define REMAP_STORE_TAG1          'M'
+/**@}*/
+
+/**
+ * @brief Clears the overlay and, on STM32F401, loads the last record saved on flash.
+ *
+ * To be called after database_setup(), as "--" keys are coded with y_dummy.
+ */
+void remap_setup(void);
+
+/**
+ * @brief Looks for the remapped line of a mounted scan code.
+ *
+ * @param scancode Mounted scan code: scancode[0] is the quantity of bytes.
+ * @return The Database line (8 columns), or NULL if the scan code is not remapped.
+ */
+const uint8_t* remap_lookup(const volatile uint8_t *scancode);
+
+/**
+ * @brief Console command "remap": lists the remaps; "code : case keys" sets a line, as a layout line of
+ * host/db-compiler ("E0 75 : 0 Y1X4"); "del code", "clear", "save" (on flash) or "load" (from flash).
+ *
+ * @param args Rest of the command line.
+ */
+void remap_console_cmd(uint8_t *args);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined REMAP_H
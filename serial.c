@@ -44,6 +44,7 @@
 //Use Tab width=2
 
 #include "serial.h"
+#include "main_events.h"
 
 // See the inspiring file:
 // https://github.com/libopencm3/libopencm3-examples/blob/master/examples/stm32/f1/stm32-h103/usart_irq_printf/usart_irq_printf.c
@@ -91,6 +92,8 @@ void ring_init(struct sring *ring, uint8_t *buf, uint16_t buffer_size)
   ring->bufSzMask = buffer_size - 1;            //buffer_size_mask;
   ring->put_ptr = 0;
   ring->get_ptr = 0;
+  ring->xoff_trigger = X_OFF_TRIGGER(buffer_size);
+  ring->xon_trigger = X_ON_TRIGGER(buffer_size);
 }
 
 
@@ -467,6 +470,19 @@ void con_send_string(uint8_t* string)
 
 
 
+//Ready to be used outside this module.
+// Wait until TX buffers are sent.
+void con_wait_tx_empty(void)
+{
+#if USE_USB == true
+  while(QTTY_CHAR_IN(uart_tx_ring) || QTTY_CHAR_IN(con_tx_ring))
+#else   //#if USE_USB == true
+  while(QTTY_CHAR_IN(uart_tx_ring))
+#endif  //#if USE_USB == true
+    __asm("wfi");
+}
+
+
 //---------------------------------------------------------------------------------------
 //----------------------------Communication input routines-------------------------------
 //---------------------------------------------------------------------------------------
@@ -514,12 +530,23 @@ uint16_t con_available_get_char(void)
 }
 
 
+#if USE_USB == true
+//The USB OUT endpoint that feeds the ring was set to NAK by its callback (cdcacm.c), when the ring had no room for
+//a full packet or got over its X_OFF trigger. Its consumer clears the NAK once it brings the ring under X_ON trigger.
+static void ring_release_out_ep(struct sring *ring, uint8_t ep, uint16_t qty_in_buffer)
+{
+  if( (qty_in_buffer < ring->xon_trigger) && (!nak_cleared[ep]) )
+    clear_nak_endpoint(ep);
+}
+#endif  //#if USE_USB == true
+
+
 //xon_xoff_control
 static void xon_xoff_rx_control(struct sring *ring, uint16_t qty_in_buffer)
 {
   if (enable_xon_xoff)
   {
-    if (qty_in_buffer >= (3 * ring->bufSzMask / 4)) //X_OFF_TRIGGER)
+    if (qty_in_buffer >= ring->xoff_trigger)
     {
       xon_condition = false;
       if (!xoff_condition)                          //To send X_OFF only once
@@ -528,7 +555,7 @@ static void xon_xoff_rx_control(struct sring *ring, uint16_t qty_in_buffer)
         xonoff_sendnow = true;
       }
     }
-    else if (qty_in_buffer < (ring->bufSzMask / 2)) //(uint16_t)X_ON_TRIGGER)
+    else if (qty_in_buffer < ring->xon_trigger)
     {
       xoff_condition = false;
       if (!xon_condition)                           //To send X_ON only once
@@ -536,7 +563,7 @@ static void xon_xoff_rx_control(struct sring *ring, uint16_t qty_in_buffer)
         xon_condition = true;
         xonoff_sendnow = true;
       }  //if (!xon_condition)
-    } //else if (*qty_in_buffer <= (uint16_t)X_ON_TRIGGER)
+    } //else if (qty_in_buffer < ring->xon_trigger)
   } //if (enable_xon_xoff)
 }
 
@@ -553,12 +580,7 @@ static int8_t ring_rx_get_ch(uint16_t *qty_in_buffer)
   if(usb_configured)
   {
     ch = ring_get_ch(&con_rx_ring, qty_in_buffer);
-    if ( (*qty_in_buffer >= (3 * con_rx_ring.bufSzMask / 4)) && (nak_cleared[EP_CON_DATA_OUT]) )
-      //con_rx_ring is running out of space. Set NAK on endpoint.
-      set_nak_endpoint(EP_CON_DATA_OUT);
-    else if ( (*qty_in_buffer < (con_rx_ring.bufSzMask / 2)) && (!nak_cleared[EP_CON_DATA_OUT]) )
-      //Now con_rx_ring has space. Clear NAK on endpoint.
-      clear_nak_endpoint(EP_CON_DATA_OUT);
+    ring_release_out_ep(&con_rx_ring, EP_CON_DATA_OUT, *qty_in_buffer);
     return ch;
   } //if(usb_configured)
   else
@@ -593,8 +615,11 @@ static uint8_t getchar_locked(void)
   uint16_t bin; //information to be discarded
   if(usb_configured)
   {
+    uint8_t ch;
     while(con_rx_ring.get_ptr == con_rx_ring.put_ptr) __asm("nop");
-    return(uint8_t)ring_get_ch(&con_rx_ring, &bin);
+    ch = ring_get_ch(&con_rx_ring, &bin);
+    ring_release_out_ep(&con_rx_ring, EP_CON_DATA_OUT, bin);
+    return ch;
   }
   else
   {
@@ -685,6 +710,7 @@ void insert_in_con_rx(uint8_t ch)
 #else   //#if USE_USB == true
   ring_put_ch(&uart_rx_ring, ch);
 #endif  //#if USE_USB == true
+  main_event_set(EVT_CON_RX);
 }
 
 
@@ -901,6 +927,8 @@ static void usart_rx_read_dma(void)
 
   //Update dma get pointer for the next DMA reading
   dma_rx_ring.get_ptr = (dma_rx_ring.get_ptr + qtty_dma_rx) & (dma_rx_ring.bufSzMask);
+  if(qtty_dma_rx)
+    main_event_set(EVT_CON_RX);
 
   //Now clear USART_SR_IDLE, to avoid IDLE new interrupts without new incoming chars.
   //It will be processed through a read to the USART_SR register followed by a read to the USART_DR register.
@@ -964,6 +992,9 @@ ISR_DMA_CH_USART_TX
   uart_tx_ring.get_ptr = (uart_tx_ring.get_ptr + last_dma_tx_set_number_of_data) & uart_tx_ring.bufSzMask;
 
   last_dma_tx_set_number_of_data = 0;
+#if USE_USB == true
+  ring_release_out_ep(&uart_tx_ring, EP_UART_DATA_OUT, QTTY_CHAR_IN(uart_tx_ring));
+#endif  //#if USE_USB == true
 
   if(!QTTY_CHAR_IN(uart_tx_ring))
     //Return with DMA disabled, as it it not necessary anymore. 
@@ -140,6 +140,12 @@ uint16_t ring_put_ch(struct sring* ring, uint8_t ch);
 void con_send_string(uint8_t* string);
 
 
+/**
+ * @brief Sleeps (WFI) until the console TX buffers were sent. It is a blocking function.
+ */
+void con_wait_tx_empty(void);
+
+
 /**
  * @brief It returns the number of availabe bytes in the specified ring. It is a non blocking function
  *
@@ -41,6 +41,7 @@
  */
 
 #include "sys_timer.h"
+#include "main_events.h"
 //Use Tab width=2
 
 
@@ -95,6 +96,7 @@ void sys_tick_handler(void) // f=30Hz (Each 33,33ms)
   iwdg_reset(); //Prevent from reset
 
   systicks++;
+  main_event_set(EVT_SYSTICK);
 
   ticks++;
   if( (ps2_keyb_detected == true) && (ticks >= (10*3)) )
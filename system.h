@@ -87,6 +87,37 @@ extern "C" {
 #define N_DATABASE_REGISTERS      320
 #define DATABASE_SIZE             N_DATABASE_REGISTERS * DB_NUM_COLS
 
+/* Database extension lines, built by host/db-compiler after the last key line. Their first column
+ * is DB_EXT_MARK, never a first scan code byte, so convert2msx() does not match them. A header line
+ * {DB_EXT_MARK, DB_EXT_TAG, type, records, record size, payload lines, 0xFF, 0xFF} is followed by
+ * its payload lines {DB_EXT_MARK, 7 bytes of records}. */
+#define DB_EXT_MARK               0xFF
+#define DB_EXT_TAG                'X'
+#define DB_EXT_PAYLOAD_COLS       (DB_NUM_COLS - 1)
+#define DB_EXT_LOOKUP_INDEX       1           //Records {first scan code byte, first line low, first line high}
+#define DB_EXT_CHAR_MAP           2           //Records {char, MSX key (Y << 4 | X), DB_CHAR_xxx modifiers}
+#define DB_CHAR_SHIFT             (1 << 0)
+#define DB_CHAR_CTRL              (1 << 1)
+#define DB_CHAR_GRAPH             (1 << 2)
+#define DB_CHAR_CODE              (1 << 3)
+#define DB_EXT_CHORDS             3           //Records {DB_CHORD_xxx << 4 | keys, DB_CHORD_ACT_xxx, argument, 3 make code bytes, E0 mask}
+#define DB_CHORD_MAX_KEYS         3
+#define DB_CHORD_CHORD            0           //Fired on the make of the last key, while the other ones are held
+#define DB_CHORD_SEQUENCE         1           //Fired on the make of the last key, after the other ones made in order
+#define DB_CHORD_TAP              2           //Fired on a short press of the last key, while the other ones are held
+#define DB_CHORD_HOLD             3           //Fired on a long press of the last key, while the other ones are held
+#define DB_CHORD_ACT_RESET        1
+#define DB_CHORD_ACT_NUMLOCK      2
+#define DB_CHORD_ACT_LAYOUT       3           //Flash Database <-> built-in DEFAULT_MSX_KEYB_DATABASE_CONVERSION
+#define DB_CHORD_ACT_MSX_KEY      4           //Press and release of the MSX key of the argument (Y << 4 | X)
+#define DB_CHORD_ACT_MACRO        5           //Plays the macro slot of the argument (1 to MACRO_SLOTS)
+#define DB_CHORD_ACT_MACRO_REC    6           //Starts or stops recording the slot of the argument (plus MACRO_REC_DELAYS)
+#define DB_EXT_LAYERS             4           //Records {DB_LAYER_xxx << 4 | DB_LAYER_E0, make code byte, MSX key 0, MSX key 1}
+#define DB_LAYER_E0               (1 << 0)
+#define DB_LAYER_RUSLAT           0           //Selected by RUSLAT_LED (Caps Lock LED): the first source lit wins
+#define DB_LAYER_KANA             1           //Selected by KANA_PORT/KANA_PIN
+#define DB_LAYER_SOURCES          2
+
 #if MCU == STM32F103
 #define NUM_DATABASE_IMG          2
 //Address of Base of flash page, used to put various Databases without need of erase each time
@@ -109,6 +140,11 @@ extern "C" {
 #define FLASH_SECTOR3_BASE        0x0800C000
 #define FLASH_SECTOR3_TOP         0x0800FFFF
 #define FLASH_SECTOR3_NUMBER      3
+//Below the lowest of the NUM_DATABASE_IMG Database images: the remaps and the macros saved on console
+#define REMAP_STORE_ADDR          FLASH_SECTOR3_BASE
+#define REMAP_STORE_SIZE          0x200
+#define MACRO_STORE_ADDR          (REMAP_STORE_ADDR + REMAP_STORE_SIZE)
+#define MACRO_STORE_SIZE          0x200
 #endif  //#if MCU == STM32F401
 
 
@@ -148,6 +184,32 @@ extern "C" {
 /**@}*/
 
 
+/* Diagnostics */
+/** Diagnostics features
+ *
+ * They are shown through console commands (type help on console).
+@{*/
+#define LATENCY_TRACE             true      //Key latency tracer, from PS/2 stop bit to MSX Y scan read
+#define BENCH_KERNELS             true      //Hot path microbenchmarks (DWT cycles per call)
+#define PS2_TRACE                 true      //Record and replay of timestamped PS/2 byte streams
+#define USB_TELEMETRY             true      //Binary records of the converter state on a vendor bulk USB interface (needs USE_USB)
+/**@}*/
+
+
+/* Key mapping */
+/** Key mapping features
+@{*/
+#define MSX_PAIRING               true      //Breaks undo what their makes put on the MSX matrix, with no Database search
+#define MSX_NKRO                  true      //Pressed-key set of the MSX matrix: modifier releases keep the other held keys
+#define DB_REMAP                  true      //RAM overlay of Database lines, edited on console ("remap")
+#define CHORDS                    true      //Chord table of the Database (or built-in): CtrlAltDel, NumLock and others
+#define MACROS                    true      //Macro recorder and player, paced by the MSX column reads ("macro")
+#define AUTOFIRE                  true      //Autofire period on the control byte high nibble, paced by the column reads
+#define SHIFT_SEQUENCER           true      //Smooth typing keys (CASE 2 shift substitutions) paced by the column reads
+#define LAYERS                    true      //Alternate layers of the Database, selected by RUS/LAT or Kana LED
+/**@}*/
+
+
 /* USB related definitions */
 
 /* Define the usage of USB */
@@ -163,6 +225,12 @@ extern "C" {
 #undef  USE_USB                             //***** DO NOT CHANGE IT! In PS/2 keyboard Interface for MSX design blue pill DO NOT have sufficient hardware resouces (5V tolerant pins and Flash room) to support USB and basic target functionality.
 #define USE_USB                   false     //***** DO NOT CHANGE IT! In PS/2 keyboard Interface for MSX design blue pill DO NOT have sufficient hardware resouces (5V tolerant pins and Flash room) to support USB and basic target functionality.
 #endif  //##if (MCU == STM32F103) && (USE_USB == true)
+//The telemetry records are sent only on USB: with no USB, no ring, RAM or ISR hooks are built. The host build keeps
+//them, as its tools take the ring as the endpoint would (host/ppi_scan_host.cpp -t)
+#if (USE_USB == false) && (USB_TELEMETRY == true) && !defined OPENCM3_HOST_H
+#undef  USB_TELEMETRY
+#define USB_TELEMETRY             false
+#endif  //#if (USE_USB == false) && (USB_TELEMETRY == true) && !defined OPENCM3_HOST_H
 #if USE_USB == true
 #if MCU == STM32F103
 #define USB_DRIVER                st_usbfs_v1_usb_driver
@@ -198,11 +266,12 @@ extern "C" {
 #define SEND_ENCAPSULATED_COMMAND_bRequest 0  //Get in https://docs.microsoft.com/en-us/windows-hardware/drivers/network/control-channel-characteristics
 #define GET_ENCAPSULATED_RESPONSE_bRequest 1  //Get in https://docs.microsoft.com/en-us/windows-hardware/drivers/network/control-channel-characteristics
 
+#endif  //#if USE_USB == true
+
+//Out of USE_USB, as host/telemetry-reader finds the converter by them
 #define USB_PID                   0x5740      //ST CDC from various forums
 #define USB_VID                   0x1d50      //OpenMoko
 
-#endif  //#if USE_USB == true
-
 #define DESIGN_DEF                "PS/2 to MSX Keyboard Converter "
 
 /**  Index of each USB interface.
@@ -214,6 +283,9 @@ enum INTF{
   INTF_CON_DATA,
   INTF_UART_COMM,
   INTF_UART_DATA,
+#if USB_TELEMETRY == true
+  INTF_TELEMETRY,
+#endif  //#if USB_TELEMETRY == true
 };
 
 //  USB Endpoints addresses. Starts with 1, as endpoint 0 is the default.
@@ -231,8 +303,21 @@ enum ENDPOINT{
   EP_CON_COMM_IN,                             //First endpoint: valid add CDC Command 
   EP_UART_DATA_IN,                            //CDC Data IN of Second endpoint
   EP_UART_COMM_IN,                            //Second endpoint: CDC Command
+#if USB_TELEMETRY == true
+  EP_CON_NOTIF_IN,                            //Console CDC Command, moved from EP_CON_COMM_IN
+#endif  //#if USB_TELEMETRY == true
 };
 
+#if USB_TELEMETRY == true
+//STM32F401 OTG FS has IN endpoints 1 to 3 only (RM0368: OTG_DIEPCTL1 to 3, OTG_DIEPTXF1 to 3). The telemetry bulk IN
+//takes the number of the console CDC Command (notification) endpoint, that the firmware never writes, and that one
+//moves beyond them, as the UART one (4) already was: its setup lands on reserved OTG registers and it never sends.
+#define EP_TELEMETRY_IN           EP_CON_COMM_IN
+#define EP_CON_NOTIF              EP_CON_NOTIF_IN
+#else //#if USB_TELEMETRY == true
+#define EP_CON_NOTIF              EP_CON_COMM_IN
+#endif  //#if USB_TELEMETRY == true
+
 /**  USB buffers sizes.
  *
 @{*/
@@ -579,13 +664,9 @@ enum ENDPOINT{
 #define UART_RX_RING_BUFFER_SIZE  BASE_RING_BUFFER_SIZE
 #endif  //#if USE_USB == true
 
-#if USE_USB == true
-#define X_OFF_TRIGGER             (3 * CON_RX_RING_BUFFER_SIZE / 4)
-#define X_ON_TRIGGER              (CON_RX_RING_BUFFER_SIZE / 2)
-#else //#if USE_USB == true
-#define X_OFF_TRIGGER             (3 * UART_TX_RING_BUFFER_SIZE / 4)
-#define X_ON_TRIGGER              (UART_TX_RING_BUFFER_SIZE / 2)
-#endif  //#if USE_USB == true
+//Each ring keeps its own triggers, computed by ring_init() from its size
+#define X_OFF_TRIGGER(SIZE)       (3 * (SIZE) / 4)
+#define X_ON_TRIGGER(SIZE)        ((SIZE) / 2)
 
 
 /**  Defines X_ON and X_OFF.
@@ -782,6 +863,14 @@ struct sring
  *
  */
   uint16_t get_ptr;
+/**  Defines the quantity of chars from which its producer is held: X_OFF sent, or USB OUT endpoint on NAK.
+ *
+ */
+  uint16_t xoff_trigger;
+/**  Defines the quantity of chars below which its producer is released: X_ON sent, or NAK cleared.
+ *
+ */
+  uint16_t xon_trigger;
 };
 
 #endif  //#ifndef T_SYSTEM_H
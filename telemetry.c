@@ -0,0 +1,232 @@
+/** @addtogroup 22 telemetry USB Telemetry
+ *
+ * @file telemetry.c Binary records of the converter state, streamed on a vendor bulk USB interface.
+ *
+ * @brief <b>Binary records of the converter state, streamed on a vendor bulk USB interface.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * A record is written with BASEPRI at IRQ_PRI_TIM_HR, and only then put_ptr moves: the IN callback
+ * never sees half a record, and producers of different priorities (PS/2 ISR's, SysTick and main
+ * loop) do not mix their bytes. The Y scan ISR's, more urgent, are never held: they put no record,
+ * and only count the column reads on telemetry_y_reads.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#include <string.h>
+
+#include "telemetry.h"
+#include "hr_timer.h"
+#include "ps2handl.h"
+#include "console.h"
+
+
+#define TELEMETRY_QUEUE_MAX       0xFF
+#define TELEMETRY_LOCK_PRIORITY   IRQ_PRI_TIM_HR  //The most urgent producer (as IRQ_PRI_EXT15)
+
+
+//Global vars
+struct sring telemetry_ring;
+uint8_t telemetry_ring_buffer[TELEMETRY_RING_SIZE];
+volatile bool telemetry_on;
+volatile uint16_t telemetry_y_reads;
+uint16_t telemetry_y_reads_former;                //At the former SCAN record
+volatile uint32_t telemetry_dropped;              //Not yet told by a DROPPED record
+uint32_t telemetry_dropped_total;
+uint32_t telemetry_records;
+extern struct sring dispatch_keys_queue;          //Declared on msxmap.cpp
+extern volatile uint8_t ps2_recv_put_ptr;         //Declared on ps2handl.c
+extern volatile uint8_t ps2_recv_get_ptr;         //Declared on ps2handl.c
+#if USE_USB == true
+extern int usb_configured;                        //Declared on cdcacm.c
+#endif  //#if USE_USB == true
+
+
+//Local prototypes
+void telemetry_write(uint16_t put, uint8_t type, uint32_t payload, uint32_t now);
+
+
+#if defined __ARM_ARCH
+//BASEPRI_MAX only raises the masking: a producer that preempted another one keeps its level
+static inline uint32_t telemetry_lock(void)
+{
+  uint32_t former;
+
+  __asm__ volatile("mrs %0, basepri" : "=r" (former));
+  __asm__ volatile("msr basepri_max, %0" : : "r" (TELEMETRY_LOCK_PRIORITY) : "memory");
+  return former;
+}
+
+
+static inline void telemetry_unlock(uint32_t former)
+{
+  __asm__ volatile("msr basepri, %0" : : "r" (former) : "memory");
+}
+#else //#if defined __ARM_ARCH
+#define telemetry_lock()          host_basepri_raise(TELEMETRY_LOCK_PRIORITY)
+#define telemetry_unlock(FORMER)  host_basepri_set(FORMER)
+#endif  //#if defined __ARM_ARCH
+
+
+void telemetry_setup(void)
+{
+  telemetry_on = false;
+  ring_init(&telemetry_ring, telemetry_ring_buffer, TELEMETRY_RING_SIZE);
+  telemetry_dropped = 0;
+  telemetry_dropped_total = 0;
+  telemetry_records = 0;
+}
+
+
+void telemetry_start(void)
+{
+  uint32_t former = telemetry_lock();
+
+  telemetry_ring.get_ptr = telemetry_ring.put_ptr;
+  telemetry_dropped = 0;
+  telemetry_dropped_total = 0;
+  telemetry_records = 0;
+  telemetry_y_reads_former = telemetry_y_reads;
+  telemetry_on = true;
+  telemetry_unlock(former);
+  telemetry_put(TELEMETRY_REC_START, TELEMETRY_VERSION, FREQ_INT_SYSTICK, 0);
+}
+
+
+void telemetry_stop(void)
+{
+  telemetry_on = false;
+}
+
+
+//telemetry_lock() must be held
+void telemetry_write(uint16_t put, uint8_t type, uint32_t payload, uint32_t now)
+{
+  uint8_t *p = &telemetry_ring.data[put];
+
+  p[0] = type;
+  p[1] = (uint8_t)payload;
+  p[2] = (uint8_t)(payload >> 8);
+  p[3] = (uint8_t)(payload >> 16);
+  p[4] = (uint8_t)now;
+  p[5] = (uint8_t)(now >> 8);
+  p[6] = (uint8_t)(now >> 16);
+  p[7] = (uint8_t)(now >> 24);
+  telemetry_records++;
+}
+
+
+void telemetry_put(uint8_t type, uint8_t b1, uint8_t b2, uint8_t b3)
+{
+  uint32_t former, now;
+  uint16_t put, room, needed;
+
+  former = telemetry_lock();
+  now = hr_timer_now();
+  put = telemetry_ring.put_ptr;
+  //One byte of the ring is never used, as on ring_put_ch(): whole records fit in the rest
+  room = (telemetry_ring.get_ptr - put - 1) & telemetry_ring.bufSzMask;
+  needed = telemetry_dropped ? 2 * TELEMETRY_RECORD_SIZE : TELEMETRY_RECORD_SIZE;
+  if(room < needed)
+  {
+    if(telemetry_dropped < TELEMETRY_MAX_DROPPED)
+      telemetry_dropped++;
+    telemetry_dropped_total++;
+    telemetry_unlock(former);
+    return;
+  }
+  if(telemetry_dropped)
+  {
+    telemetry_write(put, TELEMETRY_REC_DROPPED, telemetry_dropped, now);
+    put = (put + TELEMETRY_RECORD_SIZE) & telemetry_ring.bufSzMask;
+    telemetry_dropped = 0;
+  }
+  telemetry_write(put, type, b1 | ((uint32_t)b2 << 8) | ((uint32_t)b3 << 16), now);
+  telemetry_ring.put_ptr = (put + TELEMETRY_RECORD_SIZE) & telemetry_ring.bufSzMask;
+  telemetry_unlock(former);
+}
+
+
+void telemetry_sample(void)
+{
+  uint16_t reads, depth;
+
+  if(!telemetry_on)
+    return;
+  //Only the Y scan ISR writes telemetry_y_reads
+  reads = telemetry_y_reads - telemetry_y_reads_former;
+  telemetry_y_reads_former += reads;
+  telemetry_put(TELEMETRY_REC_SCAN, (uint8_t)reads, (uint8_t)(reads >> 8), 0);
+  depth = QTTY_CHAR_IN(telemetry_ring) / TELEMETRY_RECORD_SIZE;
+  telemetry_put(TELEMETRY_REC_QUEUE, (uint8_t)QTTY_CHAR_IN(dispatch_keys_queue),
+                (uint8_t)((ps2_recv_put_ptr - ps2_recv_get_ptr) & (PS2_RECV_BUFFER_SIZE - 1)),
+                (depth > TELEMETRY_QUEUE_MAX) ? TELEMETRY_QUEUE_MAX : (uint8_t)depth);
+}
+
+
+void telemetry_console_cmd(uint8_t *args)
+{
+  uint8_t *word = console_next_word(&args);
+  uint8_t mountstring[16];
+
+  if(strcmp((const char*)word, "on") == 0)
+  {
+    telemetry_start();
+    con_send_string((uint8_t*)"Telemetry on.\r\n");
+    return;
+  }
+  if(strcmp((const char*)word, "off") == 0)
+  {
+    telemetry_stop();
+    con_send_string((uint8_t*)"Telemetry off.\r\n");
+    return;
+  }
+
+  con_send_string((uint8_t*)"Telemetry: ");
+  con_send_string((uint8_t*)(telemetry_on ? "on" : "off"));
+#if USE_USB == true
+  con_send_string((uint8_t*)(usb_configured ? ", USB configured" : ", USB not configured"));
+#else //#if USE_USB == true
+  con_send_string((uint8_t*)", no USB on this build");
+#endif  //#if USE_USB == true
+  con_send_string((uint8_t*)"\r\nRecords: ");
+  conv_uint32_to_dec(telemetry_records, mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)", not sent: ");
+  conv_uint32_to_dec(QTTY_CHAR_IN(telemetry_ring) / TELEMETRY_RECORD_SIZE, mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)", dropped: ");
+  conv_uint32_to_dec(telemetry_dropped_total, mountstring);
+  con_send_string(mountstring);
+  con_send_string((uint8_t*)"\r\n");
+}
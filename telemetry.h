@@ -0,0 +1,159 @@
+/** @defgroup 22 telemetry USB Telemetry
+ *
+ * @ingroup infrastructure_apis
+ *
+ * @file telemetry.h Binary records of the converter state, streamed on a vendor bulk USB interface.
+ *
+ * @brief <b>Binary records of the converter state, streamed on a vendor bulk USB interface. Header file of telemetry.c.</b>
+ *
+ * @version 1.0.0
+ *
+ * @author @htmlonly &copy; @endhtmlonly 2026
+ * ps2tomsxUSB contributors
+ *
+ * @date 18 October 2026
+ *
+ * The producers (PS/2 clock ISR, MSX matrix updates and the SysTick samples of main loop) put fixed
+ * size records on a RAM ring: a few stores, with no formatting and no wait. A record with no room
+ * is dropped and counted. The ring is sent as is by the IN callback of the telemetry endpoint
+ * (cdcacm.c), as the console ring, so packets are full at USB full speed while there is data.
+ * Records are TELEMETRY_RECORD_SIZE bytes and the ring is a multiple of the packet size, so a record
+ * never crosses a packet. host/telemetry-reader starts the stream (vendor request TELEMETRY_REQ_START
+ * on the interface), reads and decodes it.
+ *
+ * Record (little endian):
+ * - Byte 0: TELEMETRY_REC_xxx type;
+ * - Bytes 1 to 3: payload, as the type;
+ * - Bytes 4 to 7: TIM_HR time (us, wraps after 71 minutes).
+ * Payloads:
+ * - START: version, FREQ_INT_SYSTICK, 0;
+ * - PS2: byte, TELEMETRY_PS2_RECEIVED or TELEMETRY_PS2_SENT, 0;
+ * - MATRIX: Y (8 to 10 are the CTRL, SHIFT and RUS/LAT lines), X, 1 for a release or 0 for a press;
+ * - SCAN: column reads by MSX since the former SCAN record (uint16_t), 0. One per SysTick;
+ * - QUEUE: depth of dispatch_keys_queue, of ps2_recv_buffer and of the telemetry ring (in records,
+ *   saturated at 255). One per SysTick;
+ * - DROPPED: records dropped since the former DROPPED record (24 bits). Put before the next record
+ *   that has room.
+ *
+ * LGPL License Terms ref lgpl_license
+ */
+
+/*
+ * This file is part of the PS/2 to MSX keyboard Converter Enviroment,
+ * covering MSX keyboard Converter and MSX Keyboard Subsystem Emulator
+ * designs, based on libopencm3 project.
+ *
+ * Copyright (C) 2026 ps2tomsxUSB contributors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Use Tab width=2
+
+
+#if !defined TELEMETRY_H
+#define TELEMETRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "system.h"
+#include "serial.h"
+
+
+/** Telemetry sizes and format
+@{*/
+#define TELEMETRY_RING_SIZE       4096        //Bytes (512 records). Power of 2, multiple of the packet size
+#define TELEMETRY_RECORD_SIZE     8
+#define TELEMETRY_VERSION         1
+#define TELEMETRY_REC_START       0x01
+#define TELEMETRY_REC_PS2         0x02
+#define TELEMETRY_REC_MATRIX      0x03
+#define TELEMETRY_REC_SCAN        0x04
+#define TELEMETRY_REC_QUEUE       0x05
+#define TELEMETRY_REC_DROPPED     0x06
+#define TELEMETRY_PS2_RECEIVED    0
+#define TELEMETRY_PS2_SENT        1
+#define TELEMETRY_MAX_DROPPED     0xFFFFFF
+/**@}*/
+
+/** Vendor requests to the telemetry interface (bmRequestType 0x41: host to device, vendor, interface)
+@{*/
+#define TELEMETRY_REQ_START       0x01        //Clears the ring and starts putting records
+#define TELEMETRY_REQ_STOP        0x02
+/**@}*/
+
+/**
+ * @brief The ring sent on the telemetry endpoint. Its put_ptr moves by whole records.
+ */
+extern struct sring telemetry_ring;
+
+/**
+ * @brief Records are put only while it is true. Producers test it before calling telemetry_put().
+ */
+extern volatile bool telemetry_on;
+
+/**
+ * @brief Column reads by MSX, counted by the Y scan ISR on STM32F401.
+ */
+extern volatile uint16_t telemetry_y_reads;
+
+/**
+ * @brief Inits the ring, stopped.
+ */
+void telemetry_setup(void);
+
+/**
+ * @brief Clears the ring and starts putting records, with a START one.
+ */
+void telemetry_start(void);
+
+/**
+ * @brief Stops putting records. The ring keeps the ones not sent yet.
+ */
+void telemetry_stop(void);
+
+/**
+ * @brief Puts a record on the ring, or counts it as dropped if there is no room. Callable from main loop and
+ * from ISR's up to IRQ_PRI_TIM_HR, not from the Y scan ones (telemetry.c).
+ *
+ * @param type TELEMETRY_REC_xxx.
+ * @param b1 First payload byte.
+ * @param b2 Second payload byte.
+ * @param b3 Third payload byte.
+ */
+void telemetry_put(uint8_t type, uint8_t b1, uint8_t b2, uint8_t b3);
+
+/**
+ * @brief Puts the SCAN and QUEUE records. To be called from main loop, on EVT_SYSTICK.
+ */
+void telemetry_sample(void);
+
+/**
+ * @brief Console command "telem": status, "on" or "off".
+ *
+ * @param args Rest of the command line.
+ */
+void telemetry_console_cmd(uint8_t *args);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //#if !defined TELEMETRY_H
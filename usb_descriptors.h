@@ -75,6 +75,9 @@ static const char *usb_strings[] = {
   DESIGN_DEF "Converter USB <-> Serial",      //  Serial Port
   DESIGN_DEF "USB-Serial ACM Port",           //  Serial ACM Port
   DESIGN_DEF "USB-Serial DataPort",           //  Serial DATA Port
+#if USB_TELEMETRY == true
+  DESIGN_DEF "Telemetry",                     //  Telemetry (vendor bulk) Port
+#endif  //#if USB_TELEMETRY == true
 };
 
 #define NUM_STRINGS (sizeof(usb_strings) / sizeof(usb_strings[0]))
@@ -89,6 +92,9 @@ enum usb_strings_index {  //  Index of USB strings.  Must sync with *usb_strings
   USB_STRINGS_UART,
   USB_STRINGS_UART_COMM,
   USB_STRINGS_UART_DATA,
+#if USB_TELEMETRY == true
+  USB_STRINGS_TELEMETRY,
+#endif  //#if USB_TELEMETRY == true
 };
 
 static const struct usb_device_descriptor dev_desc = {
@@ -128,7 +134,7 @@ static const struct usb_device_descriptor dev_desc = {
 static const struct usb_endpoint_descriptor con_comm_endp[] = {{
   .bLength = USB_DT_ENDPOINT_SIZE,            //7 (as defined in usbstd.h)
   .bDescriptorType = USB_DT_ENDPOINT,         //5 (as defined in usbstd.h)
-  .bEndpointAddress = EP_CON_COMM_IN,         //0x82 Console USB IN Control Endpoint//EP_CON_COMM_IN=0x83 originally
+  .bEndpointAddress = EP_CON_NOTIF,           //0x82 Console USB IN Control Endpoint (0x85 with USB_TELEMETRY)
   .bmAttributes = USB_ENDPOINT_ATTR_INTERRUPT,//0x03 (as defined in usbstd.h)
   .wMaxPacketSize = COMM_PACKET_SIZE,         //16 - Smaller than others
   .bInterval = 255,
@@ -345,6 +351,35 @@ static const struct usb_iface_assoc_descriptor uart_iface_assoc = //  Copied fro
 #endif  //#if (CDC_ONLY_ON_USB == true)
 
 
+#if USB_TELEMETRY == true
+// Telemetry interface: vendor specific, read by host/telemetry-reader
+//  Telemetry Endpoint Descriptor
+static const struct usb_endpoint_descriptor telemetry_endp[] = {{
+  .bLength = USB_DT_ENDPOINT_SIZE,            //7 (as defined in usbstd.h)
+  .bDescriptorType = USB_DT_ENDPOINT,         //5 (as defined in usbstd.h)
+  .bEndpointAddress = EP_TELEMETRY_IN,        //0x82 Telemetry USB IN Data Endpoint
+  .bmAttributes = USB_ENDPOINT_ATTR_BULK,     //0x02 (as defined in usbstd.h)
+  .wMaxPacketSize = USBD_DATA_BUFFER_SIZE,    //64
+  .bInterval = 1,
+} };
+
+//  Telemetry Interface Descriptor
+static const struct usb_interface_descriptor telemetry_iface[] = {{
+  .bLength = USB_DT_INTERFACE_SIZE,           //9 (as defined in usbstd.h)
+  .bDescriptorType = USB_DT_INTERFACE,        //4 (as defined in usbstd.h)
+  .bInterfaceNumber = INTF_TELEMETRY,         //  Vendor interface ID is 4
+  .bAlternateSetting = 0,
+  .bNumEndpoints = 1,                         //1 EP: Data IN
+  .bInterfaceClass = USB_CLASS_VENDOR,        //0xFF (as defined in usbstd.h)
+  .bInterfaceSubClass = 0,
+  .bInterfaceProtocol = 0,
+  .iInterface = USB_STRINGS_TELEMETRY,        //  Name of Telemetry interface (index of string descriptor)
+
+  .endpoint = telemetry_endp,
+} };
+#endif  //#if USB_TELEMETRY == true
+
+
 // Both Console and UART ACM interfaces
 //  USB Configuration Descriptor (Both interfaces)
 static const struct usb_interface interfaces[] = {
@@ -367,6 +402,11 @@ static const struct usb_interface interfaces[] = {
 }, {
   .num_altsetting = 1,
   .altsetting = uart_data_iface,              //Index must sync with INTF_UART_DATA.
+#if USB_TELEMETRY == true
+}, {
+  .num_altsetting = 1,
+  .altsetting = telemetry_iface,              //Index must sync with INTF_TELEMETRY.
+#endif  //#if USB_TELEMETRY == true
 },};
 
 
@@ -375,7 +415,7 @@ static const struct usb_config_descriptor config = {
   .bDescriptorType = USB_DT_CONFIGURATION,
   .wTotalLength = 0,                          //Libopencm3 will fill this automatically at sending time
   .bNumInterfaces = sizeof(interfaces)    / \
-                    sizeof(interfaces[0]),    //  We will have 4 interfaces
+                    sizeof(interfaces[0]),    //  We will have 4 interfaces (5 with USB_TELEMETRY)
   .bConfigurationValue = 1,                   //  This is the configuration ID 1
   .iConfiguration = 0,                        //  Configuration string (0 means none)
   .bmAttributes = USB_CONFIG_ATTR_DEFAULT | \